@@ -0,0 +1,117 @@
+/*
+ * Reads all packets of a file without decoding them, to measure the
+ * demuxer alone.
+ *
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <inttypes.h>
+
+#include "config.h"
+#include "stream/stream.h"
+#include "libmpdemux/demuxer.h"
+#include "osdep/timer.h"
+#include "libavutil/common.h"
+#include "mp_msg.h"
+
+// linking hacks
+char *info_name;
+char *info_artist;
+char *info_genre;
+char *info_subject;
+char *info_copyright;
+char *info_sourceform;
+char *info_comment;
+
+char* out_filename = NULL;
+char* force_fourcc=NULL;
+char* passtmpfile="divx2pass.log";
+
+static int read_packet(demux_stream_t *ds, unsigned *packets, int64_t *bytes)
+{
+    unsigned char *start;
+    int len;
+    if (!ds->sh || ds->eof)
+        return 0;
+    len = ds_get_packet(ds, &start);
+    if (len < 0)
+        return 0;
+    (*packets)++;
+    *bytes += len;
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    int file_format = DEMUXER_TYPE_UNKNOWN;
+    int passes = 1, pass;
+    unsigned packets = 0, time = 0;
+    int64_t bytes = 0;
+    demux_packet_stats_t stats;
+    stream_t *stream;
+    demuxer_t *demuxer;
+
+    if (argc < 2) {
+        printf("Usage: %s <file> [passes]\n", argv[0]);
+        return 1;
+    }
+    if (argc > 2)
+        passes = FFMAX(atoi(argv[2]), 1);
+
+    mp_msg_init();
+    InitTimer();
+    stream = open_stream(argv[1], NULL, &file_format);
+    if (!stream) {
+        mp_msg(MSGT_DEMUX, MSGL_FATAL, "Cannot open %s\n", argv[1]);
+        return 1;
+    }
+    demuxer = demux_open(stream, file_format, -1, -1, -2, argv[1]);
+    if (!demuxer) {
+        mp_msg(MSGT_DEMUX, MSGL_FATAL, "Cannot demux %s\n", argv[1]);
+        free_stream(stream);
+        return 1;
+    }
+
+    for (pass = 0; pass < passes; pass++) {
+        unsigned t0 = GetTimer();
+        if (pass && !demux_seek(demuxer, 0, 0, SEEK_ABSOLUTE))
+            break;
+        // alternate like playback does, so that both queues stay short
+        while (read_packet(demuxer->video, &packets, &bytes) |
+               read_packet(demuxer->audio, &packets, &bytes))
+            ;
+        time += GetTimer() - t0;
+    }
+
+    demux_packet_get_stats(&stats);
+    printf("%s: %s demuxer, %d pass(es)\n", argv[1], demuxer->desc->name, pass);
+    printf("%u packets, %"PRId64" kB in %.3fs: %.0f packets/s, %.1f MB/s\n",
+           packets, bytes >> 10, time / 1e6,
+           time ? packets / (time / 1e6) : 0.0,
+           time ? bytes / (time / 1e6) / (1 << 20) : 0.0);
+    printf("packet allocator: %u headers, %u payloads (%u large), "
+           "%u moved on resize, %u slabs, peak %"PRId64" kB\n",
+           stats.packets, stats.requests, stats.large, stats.copies,
+           stats.slabs, stats.peak_bytes >> 10);
+
+    free_demuxer(demuxer);
+    free_stream(stream);
+    demux_packet_uninit();
+    return 0;
+}
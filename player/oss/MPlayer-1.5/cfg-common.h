@@ -27,6 +27,7 @@
 #include "libmpcodecs/vd.h"
 #include "libmpcodecs/vf_scale.h"
 #include "libmpdemux/demux_audio.h"
+#include "libmpdemux/demux_mkv.h"
 #include "libmpdemux/demux_mpg.h"
 #include "libmpdemux/demux_ts.h"
 #include "libmpdemux/demux_viv.h"
@@ -416,6 +417,7 @@ const m_option_t common_opts[] = {
     {"forceidx", &index_mode, CONF_TYPE_FLAG, 0, -1, 2, NULL},
     {"saveidx", &index_file_save, CONF_TYPE_STRING, 0, 0, 0, NULL},
     {"loadidx", &index_file_load, CONF_TYPE_STRING, 0, 0, 0, NULL},
+    {"mkvindex", &mkv_index_mode, CONF_TYPE_INT, CONF_RANGE, 0, 2, NULL},
 
     // select audio/video/subtitle stream
     {"aid", &audio_id, CONF_TYPE_INT, CONF_RANGE, -2, 8190, NULL},
@@ -427,6 +429,7 @@ const m_option_t common_opts[] = {
 
     { "hr-mp3-seek", &hr_mp3_seek, CONF_TYPE_FLAG, 0, 0, 1, NULL },
     { "nohr-mp3-seek", &hr_mp3_seek, CONF_TYPE_FLAG, 0, 1, 0, NULL},
+    { "mp3index", &mp3_index_mode, CONF_TYPE_INT, CONF_RANGE, 0, 2, NULL},
 
     { "rawaudio", &demux_rawaudio_opts, CONF_TYPE_SUBCONFIG, 0, 0, 0, NULL},
     { "rawvideo", &demux_rawvideo_opts, CONF_TYPE_SUBCONFIG, 0, 0, 0, NULL},
@@ -537,6 +540,7 @@ const m_option_t common_opts[] = {
     {"tsprobe", &ts_probe, CONF_TYPE_POSITION, 0, 0, TS_MAX_PROBE_SIZE, NULL},
     {"psprobe", &ps_probe, CONF_TYPE_POSITION, 0, 0, TS_MAX_PROBE_SIZE, NULL},
     {"tskeepbroken", &ts_keep_broken, CONF_TYPE_FLAG, 0, 0, 1, NULL},
+    {"tsindex", &ts_index_mode, CONF_TYPE_INT, CONF_RANGE, 0, 2, NULL},
 
     // draw by slices or whole frame (useful with libmpeg2/libavcodec)
     {"slices", &vd_use_slices, CONF_TYPE_FLAG, 0, 0, 1, NULL},
@@ -630,6 +634,7 @@ const m_option_t common_opts[] = {
     {"ass-border-color", &ass_border_color, CONF_TYPE_STRING, 0, 0, 0, NULL},
     {"ass-styles", &ass_styles_file, CONF_TYPE_STRING, 0, 0, 0, NULL},
     {"ass-hinting", &ass_hinting, CONF_TYPE_INT, CONF_RANGE, 0, 7, NULL},
+    {"ass-threads", &ass_threads, CONF_TYPE_INT, CONF_RANGE, 1, 16, NULL},
 #endif
 #ifdef CONFIG_FONTCONFIG
     {"fontconfig", &font_fontconfig, CONF_TYPE_FLAG, 0, -1, 1, NULL},
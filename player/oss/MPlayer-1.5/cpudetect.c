@@ -262,6 +262,38 @@ do_cpuid(unsigned int ax, unsigned int *p)
 #endif
 }
 
+// cpuid leaves with subleaves, such as 7, need ecx set as well
+static void do_cpuid_count(unsigned int ax, unsigned int cx, unsigned int *p)
+{
+#ifdef _MSC_VER
+    __cpuidex(p, ax, cx);
+#else
+    __asm__ volatile
+        ("mov %%"REG_b", %%"REG_S"\n\t"
+         "cpuid\n\t"
+         "xchg %%"REG_b", %%"REG_S
+         : "=a" (p[0]), "=S" (p[1]),
+           "=c" (p[2]), "=d" (p[3])
+         : "0" (ax), "2" (cx));
+#endif
+}
+
+// return TRUE if the OS saves the YMM registers on context switches
+static int has_os_ymm_support(void)
+{
+    unsigned int lo, hi;
+#ifdef _MSC_VER
+    unsigned long long xcr0 = _xgetbv(0);
+    lo = xcr0;
+    hi = xcr0 >> 32;
+#else
+    __asm__ volatile (".byte 0x0f, 0x01, 0xd0" /* xgetbv */
+                      : "=a" (lo), "=d" (hi) : "c" (0));
+#endif
+    (void)hi;
+    return (lo & 6) == 6;
+}
+
 void GetCpuCaps( CpuCaps *caps)
 {
     unsigned int regs[4];
@@ -309,6 +341,13 @@ void GetCpuCaps( CpuCaps *caps)
         caps->hasSSE42 = (regs2[2] & (1 << 20)) >> 20; // 0x0100000
         caps->hasAVX  = (regs2[2] & (1 << 28 )) >> 28; // 0x10000000
         caps->hasMMX2 = caps->hasSSE; // SSE cpus supports mmxext too
+        // AVX2 also needs the OS to enable the YMM state (OSXSAVE + XCR0)
+        if (caps->hasAVX && (regs2[2] & (1 << 27)) && regs[0] >= 7 &&
+            has_os_ymm_support()) {
+            unsigned int regs7[4];
+            do_cpuid_count(7, 0, regs7);
+            caps->hasAVX2 = (regs7[1] & (1 << 5)) >> 5; // 0x0000020
+        }
         cl_size = ((regs2[1] >> 8) & 0xFF)*8;
         if(cl_size) caps->cl_size = cl_size;
 
@@ -375,6 +414,10 @@ void GetCpuCaps( CpuCaps *caps)
         if(caps->hasSSE2) mp_msg(MSGT_CPUDETECT,MSGL_WARN,"SSE2 supported but disabled\n");
         caps->hasSSE2=0;
 #endif
+#if !HAVE_AVX2
+        if(caps->hasAVX2) mp_msg(MSGT_CPUDETECT,MSGL_WARN,"AVX2 supported but disabled\n");
+        caps->hasAVX2=0;
+#endif
 #if !HAVE_AMD3DNOW
         if(caps->has3DNow) mp_msg(MSGT_CPUDETECT,MSGL_WARN,"3DNow supported but disabled\n");
         caps->has3DNow=0;
@@ -454,6 +497,7 @@ void GetCpuCaps( CpuCaps *caps)
     caps->hasSSE42=0;
     caps->hasSSE4a=0;
     caps->hasAVX=0;
+    caps->hasAVX2=0;
     caps->isX86=0;
     caps->hasAltiVec = 0;
 #if HAVE_ALTIVEC
@@ -83,6 +83,7 @@ static const char help_text[] = MSGTR_Help;
 #define MSGTR_DumpBytesWritten "dump: %"PRIu64" bytes written\r"
 #define MSGTR_DumpBytesWrittenTo "dump: %"PRIu64" bytes written to '%s'.\n"
 #define MSGTR_FPSnotspecified "FPS not specified in the header or invalid, use the -fps option.\n"
+#define MSGTR_ThreadNeedsCorrectPts "The thread filter needs -correct-pts, enabling it.\n"
 #define MSGTR_TryForceAudioFmtStr "Trying to force audio codec driver family %s...\n"
 #define MSGTR_CantFindAudioCodec "Cannot find codec for audio format 0x%X.\n"
 #define MSGTR_TryForceVideoFmtStr "Trying to force video codec driver family %s...\n"
@@ -325,6 +325,17 @@ int ass_fonts_update(ASS_Renderer *priv);
 void ass_set_cache_limits(ASS_Renderer *priv, int glyph_max,
                           int bitmap_max_size);
 
+/**
+ * \brief Set the number of threads used to render the events of a frame.
+ * Events are laid out one at a time; their glyphs are rasterized, blurred
+ * and composited in parallel.  The image list does not depend on it.
+ *
+ * \param priv renderer handle
+ * \param threads number of threads, 1 (the default) renders serially
+ * \return 0 on success, -1 if threads are not available
+ */
+int ass_set_threads(ASS_Renderer *priv, int threads);
+
 /**
  * \brief Render a frame, producing a list of ASS_Image.
  * \param priv renderer handle
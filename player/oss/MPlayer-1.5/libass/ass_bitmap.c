@@ -17,6 +17,8 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include "config.h"
+
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
@@ -25,12 +27,118 @@
 #include FT_GLYPH_H
 #include FT_OUTLINE_H
 
+#include "libavutil/attributes.h"
+#include "cpudetect.h"
 #include "ass_utils.h"
 #include "ass_bitmap.h"
 
+#if ARCH_X86 && HAVE_EMMINTRIN_H
+#if HAVE_SSE2 || CONFIG_RUNTIME_CPUDETECT
+#define COMPILE_SSE2
+#endif
+// the AVX2 intrinsics need either a compiler targeting AVX2 or one that
+// can enable it for single functions
+#if defined(__AVX2__) || (CONFIG_RUNTIME_CPUDETECT && AV_GCC_VERSION_AT_LEAST(4, 9))
+#define COMPILE_AVX2
+#endif
+#endif
+
+#ifdef COMPILE_SSE2
+#include <emmintrin.h>
+
+#define VEC             __m128i
+#define VL              16
+#define VZERO           _mm_setzero_si128
+#define VLOADU(p)       _mm_loadu_si128((const __m128i *)(p))
+#define VSTOREU(p, v)   _mm_storeu_si128((__m128i *)(p), v)
+#define VLOAD8TO16(p)   _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(p)), \
+                                          _mm_setzero_si128())
+#define VPACK16TO8      _mm_packus_epi16
+#define VSET1_8         _mm_set1_epi8
+#define VSET1_16        _mm_set1_epi16
+#define VADD16          _mm_add_epi16
+#define VMUL16          _mm_mullo_epi16
+#define VSRL16          _mm_srli_epi16
+#define VSUB8           _mm_sub_epi8
+#define VADDSU8         _mm_adds_epu8
+#define VSUBSU8         _mm_subs_epu8
+#define VMAXU8          _mm_max_epu8
+#define VCMPEQ8         _mm_cmpeq_epi8
+#define VCMPEQ16        _mm_cmpeq_epi16
+#define VAND            _mm_and_si128
+#define VANDNOT         _mm_andnot_si128
+#define VUNPACKLO8      _mm_unpacklo_epi8
+#define VUNPACKHI8      _mm_unpackhi_epi8
+#define VPACKUS16       _mm_packus_epi16
+#define RENAME(a)       a ## _sse2
+#define FUNC_ATTR       ATTR_TARGET_SSE2
+#include "ass_bitmap_template.c"
+#undef VEC
+#undef VL
+#undef VZERO
+#undef VLOADU
+#undef VSTOREU
+#undef VLOAD8TO16
+#undef VPACK16TO8
+#undef VSET1_8
+#undef VSET1_16
+#undef VADD16
+#undef VMUL16
+#undef VSRL16
+#undef VSUB8
+#undef VADDSU8
+#undef VSUBSU8
+#undef VMAXU8
+#undef VCMPEQ8
+#undef VCMPEQ16
+#undef VAND
+#undef VANDNOT
+#undef VUNPACKLO8
+#undef VUNPACKHI8
+#undef VPACKUS16
+#undef RENAME
+#undef FUNC_ATTR
+#endif /* COMPILE_SSE2 */
+
+#ifdef COMPILE_AVX2
+#include <immintrin.h>
+
+#define VEC             __m256i
+#define VL              32
+#define VZERO           _mm256_setzero_si256
+#define VLOADU(p)       _mm256_loadu_si256((const __m256i *)(p))
+#define VSTOREU(p, v)   _mm256_storeu_si256((__m256i *)(p), v)
+#define VLOAD8TO16(p)   _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(p)))
+#define VPACK16TO8(a, b) _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xd8)
+#define VSET1_8         _mm256_set1_epi8
+#define VSET1_16        _mm256_set1_epi16
+#define VADD16          _mm256_add_epi16
+#define VMUL16          _mm256_mullo_epi16
+#define VSRL16          _mm256_srli_epi16
+#define VSUB8           _mm256_sub_epi8
+#define VADDSU8         _mm256_adds_epu8
+#define VSUBSU8         _mm256_subs_epu8
+#define VMAXU8          _mm256_max_epu8
+#define VCMPEQ8         _mm256_cmpeq_epi8
+#define VCMPEQ16        _mm256_cmpeq_epi16
+#define VAND            _mm256_and_si256
+#define VANDNOT         _mm256_andnot_si256
+#define VUNPACKLO8      _mm256_unpacklo_epi8
+#define VUNPACKHI8      _mm256_unpackhi_epi8
+#define VPACKUS16       _mm256_packus_epi16
+#define RENAME(a)       a ## _avx2
+#if CONFIG_RUNTIME_CPUDETECT
+#define FUNC_ATTR       __attribute__((target("avx2")))
+#else
+#define FUNC_ATTR
+#endif
+#include "ass_bitmap_template.c"
+#endif /* COMPILE_AVX2 */
+
 struct ass_synth_priv {
     int tmp_w, tmp_h;
     unsigned short *tmp;
+    unsigned short *tmp_simd;   // scratch of the vector gauss_blur, after tmp
 
     int g_r;
     int g_w;
@@ -114,7 +222,11 @@ static void resize_tmp(ASS_SynthPriv *priv, int w, int h)
     while (priv->tmp_h < h)
         priv->tmp_h *= 2;
     free(priv->tmp);
-    priv->tmp = malloc((priv->tmp_w + 1) * priv->tmp_h * sizeof(short));
+    // the radius is at most half the size, so the scratch needs at most
+    // 2 * w + 16 * h shorts
+    priv->tmp = malloc(((priv->tmp_w + 1) * priv->tmp_h +
+                        2 * priv->tmp_w + 16 * priv->tmp_h) * sizeof(short));
+    priv->tmp_simd = priv->tmp + (priv->tmp_w + 1) * priv->tmp_h;
 }
 
 ASS_SynthPriv *ass_synth_init(double radius)
@@ -234,6 +346,19 @@ static void fix_outline(Bitmap *bm_g, Bitmap *bm_o)
     unsigned char *o =
         bm_o->buffer + (t - bm_o->top) * bm_o->stride + (l - bm_o->left);
 
+#ifdef COMPILE_AVX2
+    if (gCpuCaps.hasAVX2) {
+        fix_outline_avx2(g, bm_g->stride, o, bm_o->stride, r - l, b - t);
+        return;
+    }
+#endif
+#ifdef COMPILE_SSE2
+    if (gCpuCaps.hasSSE2) {
+        fix_outline_sse2(g, bm_g->stride, o, bm_o->stride, r - l, b - t);
+        return;
+    }
+#endif
+
     for (y = 0; y < b - t; ++y) {
         for (x = 0; x < r - l; ++x) {
             unsigned char c_g, c_o;
@@ -302,15 +427,33 @@ static void shift_bitmap(Bitmap *bm, int shift_x, int shift_y)
 /*
  * Gaussian blur.  An fast pure C implementation from MPlayer.
  */
-static void ass_gauss_blur(unsigned char *buffer, unsigned short *tmp2,
-                           int width, int height, int stride, int *m2,
-                           int r, int mwidth)
+static void ass_gauss_blur(ASS_SynthPriv *priv, unsigned char *buffer,
+                           int width, int height, int stride)
 {
-
+    unsigned short *tmp2 = priv->tmp;
+    int *m2 = (int *) priv->gt2;
+    int r = priv->g_r;
+    int mwidth = priv->g_w;
     int x, y;
 
     unsigned char *s = buffer;
     unsigned short *t = tmp2 + 1;
+
+#ifdef COMPILE_AVX2
+    if (gCpuCaps.hasAVX2) {
+        gauss_blur_avx2(buffer, tmp2, width, height, stride, priv->g, r,
+                        mwidth, priv->tmp_simd);
+        return;
+    }
+#endif
+#ifdef COMPILE_SSE2
+    if (gCpuCaps.hasSSE2) {
+        gauss_blur_sse2(buffer, tmp2, width, height, stride, priv->g, r,
+                        mwidth, priv->tmp_simd);
+        return;
+    }
+#endif
+
     for (y = 0; y < height; y++) {
         memset(t - 1, 0, (width + 1) * sizeof(short));
 
@@ -433,6 +576,19 @@ static void be_blur(Bitmap *bm)
     unsigned int x, y;
     unsigned int old_sum, new_sum;
 
+#ifdef COMPILE_AVX2
+    if (gCpuCaps.hasAVX2) {
+        be_blur_avx2(buf, w, h, s);
+        return;
+    }
+#endif
+#ifdef COMPILE_SSE2
+    if (gCpuCaps.hasSSE2) {
+        be_blur_sse2(buf, w, h, s);
+        return;
+    }
+#endif
+
     for (y = 0; y < h; y++) {
         old_sum = 2 * buf[y * s];
         for (x = 0; x < w - 1; x++) {
@@ -497,15 +653,11 @@ int outline_to_bitmap3(ASS_Library *library, ASS_SynthPriv *priv_blur,
             resize_tmp(priv_blur, (*bm_g)->w, (*bm_g)->h);
         generate_tables(priv_blur, blur_radius);
         if (*bm_o)
-            ass_gauss_blur((*bm_o)->buffer, priv_blur->tmp,
-                           (*bm_o)->w, (*bm_o)->h, (*bm_o)->stride,
-                           (int *) priv_blur->gt2, priv_blur->g_r,
-                           priv_blur->g_w);
+            ass_gauss_blur(priv_blur, (*bm_o)->buffer,
+                           (*bm_o)->w, (*bm_o)->h, (*bm_o)->stride);
         if (!*bm_o || border_style == 3)
-            ass_gauss_blur((*bm_g)->buffer, priv_blur->tmp,
-                           (*bm_g)->w, (*bm_g)->h, (*bm_g)->stride,
-                           (int *) priv_blur->gt2, priv_blur->g_r,
-                           priv_blur->g_w);
+            ass_gauss_blur(priv_blur, (*bm_g)->buffer,
+                           (*bm_g)->w, (*bm_g)->h, (*bm_g)->stride);
     }
 
     // Create shadow and fix outline as needed
@@ -526,3 +678,86 @@ int outline_to_bitmap3(ASS_Library *library, ASS_SynthPriv *priv_blur,
 
     return 0;
 }
+
+void ass_add_bitmaps(unsigned char *dst, int dst_stride,
+                     const unsigned char *src, int src_stride, int w, int h)
+{
+    int x, y;
+
+#ifdef COMPILE_AVX2
+    if (gCpuCaps.hasAVX2) {
+        add_bitmaps_avx2(dst, dst_stride, src, src_stride, w, h);
+        return;
+    }
+#endif
+#ifdef COMPILE_SSE2
+    if (gCpuCaps.hasSSE2) {
+        add_bitmaps_sse2(dst, dst_stride, src, src_stride, w, h);
+        return;
+    }
+#endif
+
+    for (y = 0; y < h; y++) {
+        for (x = 0; x < w; x++)
+            dst[x] = FFMIN(dst[x] + src[x], 255);
+        dst += dst_stride;
+        src += src_stride;
+    }
+}
+
+void ass_sub_bitmaps(unsigned char *dst, int dst_stride,
+                     const unsigned char *src, int src_stride, int w, int h)
+{
+    int x, y;
+
+#ifdef COMPILE_AVX2
+    if (gCpuCaps.hasAVX2) {
+        sub_bitmaps_avx2(dst, dst_stride, src, src_stride, w, h);
+        return;
+    }
+#endif
+#ifdef COMPILE_SSE2
+    if (gCpuCaps.hasSSE2) {
+        sub_bitmaps_sse2(dst, dst_stride, src, src_stride, w, h);
+        return;
+    }
+#endif
+
+    for (y = 0; y < h; y++) {
+        for (x = 0; x < w; x++)
+            dst[x] = FFMAX(dst[x] - src[x], 0);
+        dst += dst_stride;
+        src += src_stride;
+    }
+}
+
+void ass_mul_bitmaps(unsigned char *dst, int dst_stride,
+                     const unsigned char *src1, int src1_stride,
+                     const unsigned char *src2, int src2_stride,
+                     int w, int h)
+{
+    int x, y;
+
+#ifdef COMPILE_AVX2
+    if (gCpuCaps.hasAVX2) {
+        mul_bitmaps_avx2(dst, dst_stride, src1, src1_stride,
+                         src2, src2_stride, w, h);
+        return;
+    }
+#endif
+#ifdef COMPILE_SSE2
+    if (gCpuCaps.hasSSE2) {
+        mul_bitmaps_sse2(dst, dst_stride, src1, src1_stride,
+                         src2, src2_stride, w, h);
+        return;
+    }
+#endif
+
+    for (y = 0; y < h; y++) {
+        for (x = 0; x < w; x++)
+            dst[x] = (src1[x] * src2[x] + 255) >> 8;
+        dst += dst_stride;
+        src1 += src1_stride;
+        src2 += src2_stride;
+    }
+}
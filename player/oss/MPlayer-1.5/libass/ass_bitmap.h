@@ -56,4 +56,17 @@ int outline_to_bitmap3(ASS_Library *library, ASS_SynthPriv *priv_blur,
 
 void ass_free_bitmap(Bitmap *bm);
 
+/**
+ * \brief compositing of w x h pixel areas of two bitmaps
+ * add/sub saturate at 255/0, mul computes (src1 * src2 + 255) >> 8
+ */
+void ass_add_bitmaps(unsigned char *dst, int dst_stride,
+                     const unsigned char *src, int src_stride, int w, int h);
+void ass_sub_bitmaps(unsigned char *dst, int dst_stride,
+                     const unsigned char *src, int src_stride, int w, int h);
+void ass_mul_bitmaps(unsigned char *dst, int dst_stride,
+                     const unsigned char *src1, int src1_stride,
+                     const unsigned char *src2, int src2_stride,
+                     int w, int h);
+
 #endif                          /* LIBASS_BITMAP_H */
@@ -0,0 +1,276 @@
+/*
+ * Copyright (C) 2006 Evgeniy Stepanov <eugeni.stepanov@gmail.com>
+ *
+ * This file is part of libass.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Vector versions of the bitmap functions in ass_bitmap.c, included once
+ * per instruction set with VEC, VL, the V* operations, RENAME and
+ * FUNC_ATTR defined.  Every function gives exactly the same result as its
+ * C counterpart; the columns or pixels left over at the right edge are
+ * done with the C code.  VUNPACKLO8/VUNPACKHI8 and VPACKUS16 may work
+ * within 128-bit lanes, only VLOAD8TO16 and VPACK16TO8 keep the order of
+ * the pixels.
+ */
+
+// (l + 2 * c + r) >> 2 per byte
+static inline FUNC_ATTR VEC RENAME(blur121)(VEC l, VEC c, VEC r)
+{
+    const VEC zero = VZERO();
+    VEC lo = VADD16(VADD16(VUNPACKLO8(l, zero), VUNPACKLO8(r, zero)),
+                    VADD16(VUNPACKLO8(c, zero), VUNPACKLO8(c, zero)));
+    VEC hi = VADD16(VADD16(VUNPACKHI8(l, zero), VUNPACKHI8(r, zero)),
+                    VADD16(VUNPACKHI8(c, zero), VUNPACKHI8(c, zero)));
+    return VPACKUS16(VSRL16(lo, 2), VSRL16(hi, 2));
+}
+
+static FUNC_ATTR void RENAME(be_blur)(unsigned char *buf, int w, int h,
+                                      int s)
+{
+    int x, y;
+    unsigned int old_sum, new_sum;
+
+    for (y = 0; y < h; y++) {
+        unsigned char *p = buf + y * s;
+        old_sum = 2 * p[0];
+        x = 0;
+        if (w > VL + 1) {
+            // each block is stored only after the next one has been loaded,
+            // so that its left neighbour is still the unblurred pixel
+            const unsigned char first = (3 * p[0] + p[1]) >> 2;
+            VEC out = VZERO();
+            for (x = 1; x + VL < w; x += VL) {
+                VEC l = VLOADU(p + x - 1);
+                VEC c = VLOADU(p + x);
+                VEC r = VLOADU(p + x + 1);
+                if (x > 1)
+                    VSTOREU(p + x - VL, out);
+                else
+                    p[0] = first;
+                out = RENAME(blur121)(l, c, r);
+            }
+            old_sum = p[x - 1] + p[x];
+            VSTOREU(p + x - VL, out);
+        }
+        for (; x < w - 1; x++) {
+            new_sum = p[x] + p[x + 1];
+            p[x] = (old_sum + new_sum) >> 2;
+            old_sum = new_sum;
+        }
+    }
+
+    for (x = 0; x + VL <= w; x += VL) {
+        VEC prev = VLOADU(buf + x);
+        for (y = 0; y < h - 1; y++) {
+            VEC c = VLOADU(buf + y * s + x);
+            VEC n = VLOADU(buf + (y + 1) * s + x);
+            VSTOREU(buf + y * s + x, RENAME(blur121)(prev, c, n));
+            prev = c;
+        }
+    }
+    for (; x < w; x++) {
+        old_sum = 2 * buf[x];
+        for (y = 0; y < h - 1; y++) {
+            new_sum = buf[y * s + x] + buf[(y + 1) * s + x];
+            buf[y * s + x] = (old_sum + new_sum) >> 2;
+            old_sum = new_sum;
+        }
+    }
+}
+
+/*
+ * Same as ass_gauss_blur(), but every output is gathered from its inputs
+ * instead of having the inputs scattered over the outputs, so that a
+ * vector of neighbouring outputs can be summed at once.  All sums wrap
+ * around at 16 bits just like the unsigned short accumulators of the C
+ * version.  scratch holds width + 2 * r + height * VL / 2 shorts.
+ */
+static FUNC_ATTR void RENAME(gauss_blur)(unsigned char *buffer,
+                                         unsigned short *tmp2,
+                                         int width, int height, int stride,
+                                         const unsigned *g, int r,
+                                         int mwidth, unsigned short *scratch)
+{
+    const int n = VL / 2;
+    const VEC zero = VZERO();
+    const VEC c128 = VSET1_16(128);
+    unsigned short *pad = scratch;
+    unsigned short *q = scratch + width + 2 * r;
+    int x, y, j, k;
+
+    // horizontal pass: t[j] = sum of g[k] * s[j + r - k]
+    memset(pad, 0, (width + 2 * r) * sizeof(short));
+    for (y = 0; y < height; y++) {
+        unsigned char *s = buffer + y * stride;
+        unsigned short *t = tmp2 + 1 + y * (width + 1);
+        for (x = 0; x + n <= width; x += n)
+            VSTOREU(pad + r + x, VLOAD8TO16(s + x));
+        for (; x < width; x++)
+            pad[r + x] = s[x];
+
+        t[-1] = 0;
+        for (j = 0; j + n <= width; j += n) {
+            VEC acc = VZERO();
+            for (k = 0; k < mwidth; k++)
+                acc = VADD16(acc, VMUL16(VLOADU(pad + j + 2 * r - k),
+                                         VSET1_16(g[k])));
+            VSTOREU(t + j, acc);
+        }
+        for (; j < width; j++) {
+            unsigned short acc = 0;
+            for (k = 0; k < mwidth; k++)
+                acc += g[k] * pad[j + 2 * r - k];
+            t[j] = acc;
+        }
+    }
+
+    /* Vertical pass.  The output of column x shares its slot with the
+     * input of column x - 1, which is left at 128 (or 0 if it was 0) as
+     * rounding for the output.  Inputs of the rows below r are added two
+     * rows further down, like the first loop of the C version does. */
+    for (x = 0; x < width; x += n) {
+        const int cols = FFMIN(n, width - x);
+        for (y = 0; y < height; y++) {
+            unsigned short *in = tmp2 + y * (width + 1) + x + 1;
+            if (cols == n) {
+                VEC v = VLOADU(in);
+                VEC nonzero = VANDNOT(VCMPEQ16(v, zero), c128);
+                VSTOREU(q + y * n, VSRL16(VADD16(v, c128), 8));
+                VSTOREU(in, nonzero);
+            } else {
+                for (k = 0; k < cols; k++) {
+                    q[y * n + k] = (in[k] + 128) >> 8;
+                    in[k] = in[k] ? 128 : 0;
+                }
+            }
+        }
+        for (j = 0; j < height; j++) {
+            unsigned short *out = tmp2 + j * (width + 1) + x;
+            const int lo = FFMAX(r, j - r), hi = FFMIN(height - 1, j + r);
+            const int lo2 = FFMAX(0, j - r - 2), hi2 = FFMIN(r - 1, j - 1);
+            if (cols == n) {
+                VEC acc = VLOADU(out);
+                for (y = lo; y <= hi; y++)
+                    acc = VADD16(acc, VMUL16(VLOADU(q + y * n),
+                                             VSET1_16(g[j - y + r])));
+                for (y = lo2; y <= hi2; y++)
+                    acc = VADD16(acc, VMUL16(VLOADU(q + y * n),
+                                             VSET1_16(g[j - y + r - 2])));
+                VSTOREU(out, acc);
+            } else {
+                for (k = 0; k < cols; k++) {
+                    unsigned short acc = out[k];
+                    for (y = lo; y <= hi; y++)
+                        acc += g[j - y + r] * q[y * n + k];
+                    for (y = lo2; y <= hi2; y++)
+                        acc += g[j - y + r - 2] * q[y * n + k];
+                    out[k] = acc;
+                }
+            }
+        }
+    }
+
+    for (y = 0; y < height; y++) {
+        unsigned char *s = buffer + y * stride;
+        unsigned short *t = tmp2 + y * (width + 1);
+        for (x = 0; x + VL <= width; x += VL)
+            VSTOREU(s + x, VPACK16TO8(VSRL16(VLOADU(t + x), 8),
+                                      VSRL16(VLOADU(t + x + n), 8)));
+        for (; x < width; x++)
+            s[x] = t[x] >> 8;
+    }
+}
+
+static FUNC_ATTR void RENAME(fix_outline)(unsigned char *g, int g_stride,
+                                          unsigned char *o, int o_stride,
+                                          int w, int h)
+{
+    const VEC mask7f = VSET1_8(0x7f);
+    int x, y;
+
+    for (y = 0; y < h; y++) {
+        for (x = 0; x + VL <= w; x += VL) {
+            VEC vg = VLOADU(g + x);
+            VEC vo = VLOADU(o + x);
+            VEC not_above = VCMPEQ8(VMAXU8(vo, vg), vg);
+            VEC half = VAND(VSRL16(vg, 1), mask7f);
+            VSTOREU(o + x, VANDNOT(not_above, VSUB8(vo, half)));
+        }
+        for (; x < w; x++)
+            o[x] = (o[x] > g[x]) ? o[x] - (g[x] / 2) : 0;
+        g += g_stride;
+        o += o_stride;
+    }
+}
+
+static FUNC_ATTR void RENAME(add_bitmaps)(unsigned char *dst, int dst_stride,
+                                          const unsigned char *src,
+                                          int src_stride, int w, int h)
+{
+    int x, y;
+
+    for (y = 0; y < h; y++) {
+        for (x = 0; x + VL <= w; x += VL)
+            VSTOREU(dst + x, VADDSU8(VLOADU(dst + x), VLOADU(src + x)));
+        for (; x < w; x++)
+            dst[x] = FFMIN(dst[x] + src[x], 255);
+        dst += dst_stride;
+        src += src_stride;
+    }
+}
+
+static FUNC_ATTR void RENAME(sub_bitmaps)(unsigned char *dst, int dst_stride,
+                                          const unsigned char *src,
+                                          int src_stride, int w, int h)
+{
+    int x, y;
+
+    for (y = 0; y < h; y++) {
+        for (x = 0; x + VL <= w; x += VL)
+            VSTOREU(dst + x, VSUBSU8(VLOADU(dst + x), VLOADU(src + x)));
+        for (; x < w; x++)
+            dst[x] = FFMAX(dst[x] - src[x], 0);
+        dst += dst_stride;
+        src += src_stride;
+    }
+}
+
+static FUNC_ATTR void RENAME(mul_bitmaps)(unsigned char *dst, int dst_stride,
+                                          const unsigned char *src1,
+                                          int src1_stride,
+                                          const unsigned char *src2,
+                                          int src2_stride, int w, int h)
+{
+    const VEC zero = VZERO();
+    const VEC c255 = VSET1_16(255);
+    int x, y;
+
+    for (y = 0; y < h; y++) {
+        for (x = 0; x + VL <= w; x += VL) {
+            VEC a = VLOADU(src1 + x);
+            VEC b = VLOADU(src2 + x);
+            VEC lo = VMUL16(VUNPACKLO8(a, zero), VUNPACKLO8(b, zero));
+            VEC hi = VMUL16(VUNPACKHI8(a, zero), VUNPACKHI8(b, zero));
+            VSTOREU(dst + x, VPACKUS16(VSRL16(VADD16(lo, c255), 8),
+                                       VSRL16(VADD16(hi, c255), 8)));
+        }
+        for (; x < w; x++)
+            dst[x] = (src1[x] * src2[x] + 255) >> 8;
+        dst += dst_stride;
+        src1 += src1_stride;
+        src2 += src2_stride;
+    }
+}
@@ -23,6 +23,9 @@
 #include <ft2build.h>
 #include FT_OUTLINE_H
 #include <assert.h>
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
 
 #include "ass_utils.h"
 #include "ass_font.h"
@@ -193,8 +196,21 @@ struct cache {
     unsigned hits;
     unsigned misses;
     unsigned items;
+
+#if HAVE_PTHREADS
+    // events of a frame may be rendered by several threads
+    pthread_mutex_t lock;
+#endif
 };
 
+#if HAVE_PTHREADS
+#define cache_lock(c)   pthread_mutex_lock(&(c)->lock)
+#define cache_unlock(c) pthread_mutex_unlock(&(c)->lock)
+#else
+#define cache_lock(c)
+#define cache_unlock(c)
+#endif
+
 // Hash for a simple (single value or array) type
 static unsigned hash_simple(void *key, size_t key_size)
 {
@@ -235,6 +251,9 @@ Cache *ass_cache_create(HashFunction hash_func, HashCompare compare_func,
     cache->key_size = key_size;
     cache->value_size = value_size;
     cache->map = calloc(cache->buckets, sizeof(CacheItem *));
+#if HAVE_PTHREADS
+    pthread_mutex_init(&cache->lock, NULL);
+#endif
 
     return cache;
 }
@@ -242,36 +261,47 @@ Cache *ass_cache_create(HashFunction hash_func, HashCompare compare_func,
 void *ass_cache_put(Cache *cache, void *key, void *value)
 {
     unsigned bucket = cache->hash_func(key, cache->key_size) % cache->buckets;
-    CacheItem **item = &cache->map[bucket];
+    CacheItem **item;
+    CacheItem *new_item = calloc(1, sizeof(CacheItem));
+    new_item->key = malloc(cache->key_size);
+    new_item->value = malloc(cache->value_size);
+    memcpy(new_item->key, key, cache->key_size);
+    memcpy(new_item->value, value, cache->value_size);
+
+    // Another thread may have added the same key meanwhile; the copy
+    // found first keeps being used by get, this one stays valid anyway.
+    cache_lock(cache);
+    item = &cache->map[bucket];
     while (*item)
         item = &(*item)->next;
-    (*item) = calloc(1, sizeof(CacheItem));
-    (*item)->key = malloc(cache->key_size);
-    (*item)->value = malloc(cache->value_size);
-    memcpy((*item)->key, key, cache->key_size);
-    memcpy((*item)->value, value, cache->value_size);
+    *item = new_item;
 
     cache->items++;
     if (cache->size_func)
         cache->cache_size += cache->size_func(value, cache->value_size);
     else
         cache->cache_size++;
+    cache_unlock(cache);
 
-    return (*item)->value;
+    return new_item->value;
 }
 
 void *ass_cache_get(Cache *cache, void *key)
 {
     unsigned bucket = cache->hash_func(key, cache->key_size) % cache->buckets;
-    CacheItem *item = cache->map[bucket];
+    CacheItem *item;
+    cache_lock(cache);
+    item = cache->map[bucket];
     while (item) {
         if (cache->compare_func(key, item->key, cache->key_size)) {
             cache->hits++;
+            cache_unlock(cache);
             return item->value;
         }
         item = item->next;
     }
     cache->misses++;
+    cache_unlock(cache);
     return NULL;
 }
 
@@ -279,8 +309,11 @@ int ass_cache_empty(Cache *cache, size_t max_size)
 {
     int i;
 
-    if (cache->cache_size < max_size)
+    cache_lock(cache);
+    if (cache->cache_size < max_size) {
+        cache_unlock(cache);
         return 0;
+    }
 
     for (i = 0; i < cache->buckets; i++) {
         CacheItem *item = cache->map[i];
@@ -294,6 +327,7 @@ int ass_cache_empty(Cache *cache, size_t max_size)
     }
 
     cache->items = cache->hits = cache->misses = cache->cache_size = 0;
+    cache_unlock(cache);
 
     return 1;
 }
@@ -301,6 +335,7 @@ int ass_cache_empty(Cache *cache, size_t max_size)
 void ass_cache_stats(Cache *cache, size_t *size, unsigned *hits,
                      unsigned *misses, unsigned *count)
 {
+    cache_lock(cache);
     if (size)
         *size = cache->cache_size;
     if (hits)
@@ -309,12 +344,16 @@ void ass_cache_stats(Cache *cache, size_t *size, unsigned *hits,
         *misses = cache->misses;
     if (count)
         *count = cache->items;
+    cache_unlock(cache);
 }
 
 void ass_cache_done(Cache *cache)
 {
     ass_cache_empty(cache, 0);
     free(cache->map);
+#if HAVE_PTHREADS
+    pthread_mutex_destroy(&cache->lock);
+#endif
     free(cache);
 }
 
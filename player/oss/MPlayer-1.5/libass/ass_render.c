@@ -20,6 +20,9 @@
 
 #include <assert.h>
 #include <math.h>
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
 
 #include "ass_render.h"
 #include "ass_parse.h"
@@ -57,6 +60,7 @@ ASS_Renderer *ass_renderer_init(ASS_Library *library)
 
     priv->library = library;
     priv->ftlibrary = ft;
+    priv->raster_ftlibrary = ft;
     // images_root and related stuff is zero-filled in calloc
 
     priv->cache.font_cache = ass_font_cache_create();
@@ -106,6 +110,8 @@ static void free_list_clear(ASS_Renderer *render_priv)
 
 void ass_renderer_done(ASS_Renderer *render_priv)
 {
+    ass_render_pool_done(render_priv);
+
     ass_cache_done(render_priv->cache.font_cache);
     ass_cache_done(render_priv->cache.bitmap_cache);
     ass_cache_done(render_priv->cache.composite_cache);
@@ -445,8 +451,7 @@ render_overlap(ASS_Renderer *render_priv, ASS_Image **last_tail,
 {
     int left, top, bottom, right;
     int old_left, old_top, w, h, cur_left, cur_top;
-    int x, y, opos, cpos;
-    char m;
+    int y, opos, cpos;
     CompositeHashKey hk;
     CompositeHashValue *hv;
     CompositeHashValue chv;
@@ -461,7 +466,6 @@ render_overlap(ASS_Renderer *render_priv, ASS_Image **last_tail,
     int bs = (*tail)->stride;
     int bh = (*tail)->h;
     unsigned char *a;
-    unsigned char *b;
 
     if ((*last_tail)->bitmap == (*tail)->bitmap)
         return;
@@ -504,17 +508,14 @@ render_overlap(ASS_Renderer *render_priv, ASS_Image **last_tail,
     }
     // Allocate new bitmaps and copy over data
     a = clone_bitmap_buffer(*last_tail);
-    b = clone_bitmap_buffer(*tail);
+    clone_bitmap_buffer(*tail);
 
     // Blend overlapping area
+    opos = old_top * as + old_left;
+    cpos = cur_top * bs + cur_left;
+    ass_add_bitmaps((*tail)->bitmap + cpos, bs, a + opos, as, w, h);
     for (y = 0; y < h; y++)
-        for (x = 0; x < w; x++) {
-            opos = (old_top + y) * (as) + (old_left + x);
-            cpos = (cur_top + y) * (bs) + (cur_left + x);
-            m = FFMIN(a[opos] + b[cpos], 0xff);
-            (*last_tail)->bitmap[opos] = 0;
-            (*tail)->bitmap[cpos] = m;
-        }
+        memset((*last_tail)->bitmap + opos + y * as, 0, w);
 
     // Insert bitmaps into the cache
     chv.a = (*last_tail)->bitmap;
@@ -588,7 +589,7 @@ static void blend_vector_clip(ASS_Renderer *render_priv,
                 drawing->scale_x, drawing->scale_y, drawing->text);
 
         clip_bm = outline_to_bitmap(render_priv->library,
-                render_priv->ftlibrary, outline, 0);
+                render_priv->raster_ftlibrary, outline, 0);
 
         // Add to cache
         memset(&v, 0, sizeof(v));
@@ -602,7 +603,7 @@ blend_vector_error:
 
     // Iterate through bitmaps and blend/clip them
     for (cur = head; cur; cur = cur->next) {
-        int left, top, right, bottom, apos, bpos, y, x, w, h;
+        int left, top, right, bottom, apos, bpos, w, h;
         int ax, ay, aw, ah, as;
         int bx, by, bw, bh, bs;
         int aleft, atop, bleft, btop;
@@ -632,6 +633,8 @@ blend_vector_error:
         h = bottom - top;
         bleft = left - bx;
         btop = top - by;
+        apos = atop * as + aleft;
+        bpos = btop * bs + bleft;
 
         if (render_priv->state.clip_drawing_mode) {
             // Inverse clip
@@ -647,12 +650,7 @@ blend_vector_error:
 
             // Blend together
             memcpy(nbuffer, abuffer, as * (ah - 1) + aw);
-            for (y = 0; y < h; y++)
-                for (x = 0; x < w; x++) {
-                    apos = (atop + y) * as + aleft + x;
-                    bpos = (btop + y) * bs + bleft + x;
-                    nbuffer[apos] = FFMAX(0, abuffer[apos] - bbuffer[bpos]);
-                }
+            ass_sub_bitmaps(nbuffer + apos, as, bbuffer + bpos, bs, w, h);
         } else {
             // Regular clip
             if (ax + aw < bx || ay + ah < by || ax > bx + bw ||
@@ -667,12 +665,8 @@ blend_vector_error:
             free_list_add(render_priv, nbuffer);
 
             // Blend together
-            for (y = 0; y < h; y++)
-                for (x = 0; x < w; x++) {
-                    apos = (atop + y) * as + aleft + x;
-                    bpos = (btop + y) * bs + bleft + x;
-                    nbuffer[apos] = (abuffer[apos] * bbuffer[bpos] + 255) >> 8;
-                }
+            ass_mul_bitmaps(nbuffer + apos, as, abuffer + apos, as,
+                            bbuffer + bpos, bs, w, h);
         }
         cur->bitmap = nbuffer;
     }
@@ -1277,8 +1271,8 @@ get_bitmap_glyph(ASS_Renderer *render_priv, GlyphInfo *info)
 
         hash_val.bm = hash_val.bm_o = hash_val.bm_s = 0;
 
-        outline_copy(render_priv->ftlibrary, info->outline, &outline);
-        outline_copy(render_priv->ftlibrary, info->border, &border);
+        outline_copy(render_priv->raster_ftlibrary, info->outline, &outline);
+        outline_copy(render_priv->raster_ftlibrary, info->border, &border);
 
         // calculating rotation shift vector (from rotation origin to the glyph basepoint)
         shift.x = key->shift_x;
@@ -1310,7 +1304,7 @@ get_bitmap_glyph(ASS_Renderer *render_priv, GlyphInfo *info)
         // render glyph
         error = outline_to_bitmap3(render_priv->library,
                 render_priv->synth_priv,
-                render_priv->ftlibrary,
+                render_priv->raster_ftlibrary,
                 outline, border,
                 &hash_val.bm, &hash_val.bm_o,
                 &hash_val.bm_s, info->be,
@@ -1324,8 +1318,8 @@ get_bitmap_glyph(ASS_Renderer *render_priv, GlyphInfo *info)
         val = ass_cache_put(render_priv->cache.bitmap_cache, &info->hash_key,
                 &hash_val);
 
-        outline_free(render_priv->ftlibrary, outline);
-        outline_free(render_priv->ftlibrary, border);
+        outline_free(render_priv->raster_ftlibrary, outline);
+        outline_free(render_priv->raster_ftlibrary, border);
     }
 
     info->bm = val->bm;
@@ -1674,6 +1668,51 @@ fill_bitmap_hash(ASS_Renderer *priv, GlyphInfo *info,
             (int) (info->shadow_y * priv->border_scale));
 }
 
+/*
+ * Events of a frame can be rendered on a pool of threads. Each thread works
+ * on its own copy of the renderer, with separate render context, text info,
+ * shaper and blur buffers, and shares the caches with the others.  Parsing
+ * and layout go through FreeType faces, fontconfig and the per-font shaper
+ * data, none of which may be used concurrently, so that part of an event is
+ * done under layout_lock.  Rasterizing, blurring and compositing the glyphs
+ * run in parallel.
+ */
+#if HAVE_PTHREADS
+struct render_pool {
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;      // there are jobs to take
+    pthread_cond_t done;        // the last job of the frame has finished
+    pthread_mutex_t layout_lock;
+    int n_workers;
+    pthread_t *threads;
+    ASS_Renderer **workers;     // render contexts of the threads
+    // jobs of the current frame, protected by lock
+    EventImages *jobs;
+    int *results;
+    int results_size;
+    int n_jobs;
+    int next_job;
+    int jobs_left;
+    int quit;
+};
+#endif
+
+static void layout_lock(ASS_Renderer *render_priv)
+{
+#if HAVE_PTHREADS
+    if (render_priv->pool)
+        pthread_mutex_lock(&render_priv->pool->layout_lock);
+#endif
+}
+
+static void layout_unlock(ASS_Renderer *render_priv)
+{
+#if HAVE_PTHREADS
+    if (render_priv->pool)
+        pthread_mutex_unlock(&render_priv->pool->layout_lock);
+#endif
+}
+
 /**
  * \brief Main ass rendering function, glues everything together
  * \param event event to render
@@ -1709,6 +1748,7 @@ ass_render_event(ASS_Renderer *render_priv, ASS_Event *event,
         return 1;
     }
 
+    layout_lock(render_priv);
     init_render_context(render_priv, event);
 
     drawing = render_priv->state.drawing;
@@ -1778,6 +1818,7 @@ ass_render_event(ASS_Renderer *render_priv, ASS_Event *event,
         // face could have been changed in get_next_char
         if (!render_priv->state.font) {
             free_render_context(render_priv);
+            layout_unlock(render_priv);
             return 1;
         }
 
@@ -1836,6 +1877,7 @@ ass_render_event(ASS_Renderer *render_priv, ASS_Event *event,
     if (text_info->length == 0) {
         // no valid symbols in the event; this can be smth like {comment}
         free_render_context(render_priv);
+        layout_unlock(render_priv);
         return 1;
     }
 
@@ -2147,6 +2189,8 @@ ass_render_event(ASS_Renderer *render_priv, ASS_Event *event,
         }
     }
 
+    layout_unlock(render_priv);
+
     // convert glyphs to bitmaps
     int left = render_priv->settings.left_margin;
     device_x = (device_x - left) * render_priv->font_scale_x + left;
@@ -2525,6 +2569,280 @@ static int ass_detect_change(ASS_Renderer *priv)
     return diff;
 }
 
+/**
+ * \brief Render the events active at the given time, in track order
+ * \return number of events in priv->eimg
+ */
+static int render_events(ASS_Renderer *priv, ASS_Track *track, long long now)
+{
+    int i, cnt, rc;
+
+    cnt = 0;
+    for (i = 0; i < track->n_events; ++i) {
+        ASS_Event *event = track->events + i;
+        if ((event->Start <= now)
+            && (now < (event->Start + event->Duration))) {
+            if (cnt >= priv->eimg_size) {
+                priv->eimg_size += 100;
+                priv->eimg =
+                    realloc(priv->eimg,
+                            priv->eimg_size * sizeof(EventImages));
+            }
+            rc = ass_render_event(priv, event, priv->eimg + cnt);
+            if (!rc)
+                ++cnt;
+        }
+    }
+    return cnt;
+}
+
+#if HAVE_PTHREADS
+static ASS_Renderer *worker_new(void)
+{
+    ASS_Renderer *w = calloc(1, sizeof(ASS_Renderer));
+
+    if (!w)
+        return NULL;
+    if (FT_Init_FreeType(&w->raster_ftlibrary)) {
+        free(w);
+        return NULL;
+    }
+    w->synth_priv = ass_synth_init(BLUR_MAX_RADIUS);
+    w->shaper = ass_shaper_new(0);
+    w->text_info.max_glyphs = MAX_GLYPHS_INITIAL;
+    w->text_info.max_lines = MAX_LINES_INITIAL;
+    w->text_info.glyphs = calloc(MAX_GLYPHS_INITIAL, sizeof(GlyphInfo));
+    w->text_info.lines = calloc(MAX_LINES_INITIAL, sizeof(LineInfo));
+
+    return w;
+}
+
+static void worker_done(ASS_Renderer *w)
+{
+    if (w->state.stroker)
+        FT_Stroker_Done(w->state.stroker);
+    FT_Done_FreeType(w->raster_ftlibrary);
+    ass_synth_done(w->synth_priv);
+    ass_shaper_free(w->shaper);
+    free(w->text_info.glyphs);
+    free(w->text_info.lines);
+    free_list_clear(w);
+    free(w);
+}
+
+/**
+ * \brief Update a worker's copy of the renderer for a new frame
+ * Everything but the per-thread state is taken over from the main renderer.
+ */
+static void worker_sync(ASS_Renderer *w, ASS_Renderer *priv)
+{
+    RenderContext state = w->state;
+    TextInfo text_info = w->text_info;
+    ASS_Shaper *shaper = w->shaper;
+    ASS_SynthPriv *synth_priv = w->synth_priv;
+    FT_Library raster_ftlibrary = w->raster_ftlibrary;
+
+    free_list_clear(w);
+    *w = *priv;
+    w->state = state;
+    w->text_info = text_info;
+    w->shaper = shaper;
+    w->synth_priv = synth_priv;
+    w->raster_ftlibrary = raster_ftlibrary;
+    w->free_head = w->free_tail = NULL;
+
+    ass_shaper_set_kerning(shaper, priv->track->Kerning);
+    ass_shaper_set_language(shaper, priv->track->Language);
+    ass_shaper_set_level(shaper, priv->settings.shaper);
+}
+
+static void *render_thread(void *arg)
+{
+    ASS_Renderer *w = arg;
+    RenderPool *pool = w->pool;
+    int job, rc;
+
+    pthread_mutex_lock(&pool->lock);
+    while (1) {
+        while (!pool->quit && pool->next_job >= pool->n_jobs)
+            pthread_cond_wait(&pool->wakeup, &pool->lock);
+        if (pool->quit)
+            break;
+        job = pool->next_job++;
+        pthread_mutex_unlock(&pool->lock);
+
+        rc = ass_render_event(w, pool->jobs[job].event, pool->jobs + job);
+
+        pthread_mutex_lock(&pool->lock);
+        pool->results[job] = rc;
+        if (!--pool->jobs_left)
+            pthread_cond_signal(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+/**
+ * \brief Render the active events on the thread pool
+ * The calling thread takes jobs as well.  Successfully rendered events are
+ * returned in track order, so the result does not depend on which thread
+ * finished first.
+ * \return number of events in priv->eimg
+ */
+static int render_events_pool(ASS_Renderer *priv, ASS_Track *track,
+                              long long now)
+{
+    RenderPool *pool = priv->pool;
+    int i, n, cnt, job, rc;
+
+    n = 0;
+    for (i = 0; i < track->n_events; ++i) {
+        ASS_Event *event = track->events + i;
+        if ((event->Start <= now)
+            && (now < (event->Start + event->Duration))) {
+            if (n >= priv->eimg_size) {
+                priv->eimg_size += 100;
+                priv->eimg =
+                    realloc(priv->eimg,
+                            priv->eimg_size * sizeof(EventImages));
+            }
+            priv->eimg[n++].event = event;
+        }
+    }
+    if (n > pool->results_size) {
+        pool->results_size = priv->eimg_size;
+        pool->results =
+            realloc(pool->results, pool->results_size * sizeof(int));
+    }
+
+    // the workers are idle between frames
+    for (i = 0; i < pool->n_workers; i++)
+        worker_sync(pool->workers[i], priv);
+
+    pthread_mutex_lock(&pool->lock);
+    pool->jobs = priv->eimg;
+    pool->n_jobs = n;
+    pool->next_job = 0;
+    pool->jobs_left = n;
+    pthread_cond_broadcast(&pool->wakeup);
+    while (pool->next_job < pool->n_jobs) {
+        job = pool->next_job++;
+        pthread_mutex_unlock(&pool->lock);
+
+        rc = ass_render_event(priv, priv->eimg[job].event, priv->eimg + job);
+
+        pthread_mutex_lock(&pool->lock);
+        pool->results[job] = rc;
+        pool->jobs_left--;
+    }
+    while (pool->jobs_left)
+        pthread_cond_wait(&pool->done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+
+    cnt = 0;
+    for (i = 0; i < n; i++)
+        if (!pool->results[i])
+            priv->eimg[cnt++] = priv->eimg[i];
+
+    return cnt;
+}
+#endif
+
+/**
+ * \brief Start worker threads for rendering events
+ * \param threads total number of threads, including the caller;
+ *        1 or less renders serially
+ * \return 0 on success, -1 if no worker thread could be started
+ */
+int ass_render_pool_init(ASS_Renderer *priv, int threads)
+{
+#if HAVE_PTHREADS
+    RenderPool *pool;
+    int i;
+
+    if (priv->pool && priv->pool->n_workers == threads - 1)
+        return 0;
+    ass_render_pool_done(priv);
+    if (threads <= 1)
+        return 0;
+
+    pool = calloc(1, sizeof(RenderPool));
+    if (!pool)
+        return -1;
+    pool->threads = calloc(threads - 1, sizeof(pthread_t));
+    pool->workers = calloc(threads - 1, sizeof(ASS_Renderer *));
+    if (!pool->threads || !pool->workers) {
+        free(pool->threads);
+        free(pool->workers);
+        free(pool);
+        return -1;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wakeup, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    pthread_mutex_init(&pool->layout_lock, NULL);
+    priv->pool = pool;
+
+    for (i = 0; i < threads - 1; i++) {
+        ASS_Renderer *w = worker_new();
+        if (!w)
+            break;
+        w->pool = pool;
+        if (pthread_create(&pool->threads[i], NULL, render_thread, w)) {
+            worker_done(w);
+            break;
+        }
+        pool->workers[i] = w;
+        pool->n_workers++;
+    }
+    if (!pool->n_workers) {
+        ass_msg(priv->library, MSGL_WARN, "Failed to start render threads");
+        ass_render_pool_done(priv);
+        return -1;
+    }
+    ass_msg(priv->library, MSGL_V, "Rendering events on %d threads",
+            pool->n_workers + 1);
+
+    return 0;
+#else
+    return threads > 1 ? -1 : 0;
+#endif
+}
+
+/**
+ * \brief Stop the worker threads, if any
+ */
+void ass_render_pool_done(ASS_Renderer *priv)
+{
+#if HAVE_PTHREADS
+    RenderPool *pool = priv->pool;
+    int i;
+
+    if (!pool)
+        return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = 1;
+    pthread_cond_broadcast(&pool->wakeup);
+    pthread_mutex_unlock(&pool->lock);
+    for (i = 0; i < pool->n_workers; i++) {
+        pthread_join(pool->threads[i], NULL);
+        worker_done(pool->workers[i]);
+    }
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->wakeup);
+    pthread_cond_destroy(&pool->done);
+    pthread_mutex_destroy(&pool->layout_lock);
+    free(pool->threads);
+    free(pool->workers);
+    free(pool->results);
+    free(pool);
+    priv->pool = NULL;
+#endif
+}
+
 /**
  * \brief render a frame
  * \param priv library handle
@@ -2551,22 +2869,12 @@ ASS_Image *ass_render_frame(ASS_Renderer *priv, ASS_Track *track,
     }
 
     // render events separately
-    cnt = 0;
-    for (i = 0; i < track->n_events; ++i) {
-        ASS_Event *event = track->events + i;
-        if ((event->Start <= now)
-            && (now < (event->Start + event->Duration))) {
-            if (cnt >= priv->eimg_size) {
-                priv->eimg_size += 100;
-                priv->eimg =
-                    realloc(priv->eimg,
-                            priv->eimg_size * sizeof(EventImages));
-            }
-            rc = ass_render_event(priv, event, priv->eimg + cnt);
-            if (!rc)
-                ++cnt;
-        }
-    }
+#if HAVE_PTHREADS
+    if (priv->pool)
+        cnt = render_events_pool(priv, track, now);
+    else
+#endif
+    cnt = render_events(priv, track, now);
 
     // sort by layer
     qsort(priv->eimg, cnt, sizeof(EventImages), cmp_event_layer);
@@ -242,6 +242,8 @@ typedef struct {
     int font_encoding;
 } RenderContext;
 
+typedef struct render_pool RenderPool;
+
 typedef struct {
     Cache *font_cache;
     Cache *outline_cache;
@@ -254,6 +256,7 @@ typedef struct {
 struct ass_renderer {
     ASS_Library *library;
     FT_Library ftlibrary;
+    FT_Library raster_ftlibrary;    // for rasterizing, one per render thread
     FCInstance *fontconfig_priv;
     ASS_Settings settings;
     int render_id;
@@ -288,6 +291,8 @@ struct ass_renderer {
 
     FreeList *free_head;
     FreeList *free_tail;
+
+    RenderPool *pool;           // worker threads, NULL if rendering serially
 };
 
 typedef struct render_priv {
@@ -309,6 +314,8 @@ typedef struct {
 
 void reset_render_context(ASS_Renderer *render_priv, ASS_Style *style);
 void ass_free_images(ASS_Image *img);
+int ass_render_pool_init(ASS_Renderer *priv, int threads);
+void ass_render_pool_done(ASS_Renderer *priv);
 
 // XXX: this is actually in ass.c, includes should be fixed later on
 void ass_lazy_track_init(ASS_Library *lib, ASS_Track *track);
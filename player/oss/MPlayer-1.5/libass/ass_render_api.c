@@ -170,3 +170,8 @@ void ass_set_cache_limits(ASS_Renderer *render_priv, int glyph_max,
     render_priv->cache.bitmap_max_size = bitmap_max ? 1048576 * bitmap_max :
                                          BITMAP_CACHE_MAX_SIZE;
 }
+
+int ass_set_threads(ASS_Renderer *priv, int threads)
+{
+    return ass_render_pool_init(priv, threads);
+}
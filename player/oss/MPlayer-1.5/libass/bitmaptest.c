@@ -0,0 +1,152 @@
+/*
+ * Checks that the SSE2 and AVX2 versions of the bitmap functions of libass
+ * give exactly the results of the C versions, for the instruction sets the
+ * CPU supports.
+ *
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdio.h>
+
+#include "libavutil/common.h"
+
+// the functions to check are static
+#include "ass_bitmap.c"
+
+#define MAX_W   300
+#define MAX_H   40
+#define STRIDE  (MAX_W + 32)
+#define SIZE    (STRIDE * MAX_H)
+
+enum { IMPL_C, IMPL_SSE2, IMPL_AVX2, NB_IMPLS };
+
+static const char * const impl_names[NB_IMPLS] = { "C", "SSE2", "AVX2" };
+
+// widths around the vector lengths, and heights, to check the edges
+static const int widths[]  = { 1, 2, 7, 15, 16, 17, 31, 32, 33, 47, 64,
+                               100, 255, MAX_W };
+static const int heights[] = { 1, 2, 3, 16, MAX_H };
+static const double radii[] = { 0.5, 1.0, 2.5, 6.0, 15.0 };
+
+static unsigned rand_state = 1;
+
+static int next_rand(void)
+{
+    rand_state = rand_state * 1103515245 + 12345;
+    return (rand_state >> 16) & 0x7fff;
+}
+
+// random glyph-like content: mostly 0 and 255 with some ramps
+static void fill(unsigned char *buf)
+{
+    int i;
+    for (i = 0; i < SIZE; i++) {
+        int r = next_rand() % 8;
+        buf[i] = r < 3 ? 0 : r < 6 ? 255 : next_rand() & 255;
+    }
+}
+
+static void select_impl(const CpuCaps *caps, int impl)
+{
+    gCpuCaps.hasSSE2 = impl >= IMPL_SSE2 && caps->hasSSE2;
+    gCpuCaps.hasAVX2 = impl >= IMPL_AVX2 && caps->hasAVX2;
+}
+
+static int compare(const char *func, int impl, int w, int h, double param,
+                   const unsigned char *ref, const unsigned char *out)
+{
+    int x, y;
+    for (y = 0; y < h; y++)
+        for (x = 0; x < w; x++)
+            if (ref[y * STRIDE + x] != out[y * STRIDE + x]) {
+                printf("%s %s differs at %d,%d of %dx%d (%g): %d instead of %d\n",
+                       func, impl_names[impl], x, y, w, h, param,
+                       out[y * STRIDE + x], ref[y * STRIDE + x]);
+                return 1;
+            }
+    return 0;
+}
+
+int main(void)
+{
+    static unsigned char src1[SIZE], src2[SIZE], ref[SIZE], out[SIZE];
+    ASS_SynthPriv *priv = ass_synth_init(0);
+    CpuCaps caps;
+    int impl, iw, ih, ir, failed = 0, checked = 0;
+
+    GetCpuCaps(&caps);
+    gCpuCaps = caps;
+    resize_tmp(priv, MAX_W, MAX_H);
+
+    for (impl = IMPL_SSE2; impl < NB_IMPLS; impl++) {
+        if ((impl == IMPL_SSE2 && !caps.hasSSE2) ||
+            (impl == IMPL_AVX2 && !caps.hasAVX2)) {
+            printf("%s: not supported by the CPU, skipped\n",
+                   impl_names[impl]);
+            continue;
+        }
+        for (iw = 0; iw < FF_ARRAY_ELEMS(widths); iw++)
+            for (ih = 0; ih < FF_ARRAY_ELEMS(heights); ih++) {
+                int w = widths[iw], h = heights[ih];
+                Bitmap bm = { 0, 0, w, h, STRIDE, NULL };
+
+                fill(src1);
+                fill(src2);
+
+#define CHECK(name, param, call)                                        \
+                do {                                                    \
+                    memcpy(ref, src2, SIZE);                            \
+                    select_impl(&caps, IMPL_C);                         \
+                    call(ref);                                          \
+                    memcpy(out, src2, SIZE);                            \
+                    select_impl(&caps, impl);                           \
+                    call(out);                                          \
+                    failed += compare(name, impl, w, h, param, ref, out); \
+                    checked++;                                          \
+                } while (0)
+
+#define ADD(dst)    ass_add_bitmaps(dst, STRIDE, src1, STRIDE, w, h)
+#define SUB(dst)    ass_sub_bitmaps(dst, STRIDE, src1, STRIDE, w, h)
+#define MUL(dst)    ass_mul_bitmaps(dst, STRIDE, src1, STRIDE, src2, STRIDE, w, h)
+#define BE(dst)     (bm.buffer = dst, be_blur(&bm))
+#define FIX(dst)    do {                                                \
+                        Bitmap g = bm, o = bm;                          \
+                        g.buffer = src1;                                \
+                        o.buffer = dst;                                 \
+                        fix_outline(&g, &o);                            \
+                    } while (0)
+#define GAUSS(dst)  ass_gauss_blur(priv, dst, w, h, STRIDE)
+
+                CHECK("add_bitmaps", 0, ADD);
+                CHECK("sub_bitmaps", 0, SUB);
+                CHECK("mul_bitmaps", 0, MUL);
+                CHECK("be_blur", 0, BE);
+                CHECK("fix_outline", 0, FIX);
+                // libass adds a border of the radius plus one pixel
+                for (ir = 0; ir < FF_ARRAY_ELEMS(radii); ir++)
+                    if (2 * (radii[ir] + 1) <= FFMIN(w, h)) {
+                        generate_tables(priv, radii[ir]);
+                        CHECK("gauss_blur", radii[ir], GAUSS);
+                    }
+            }
+        printf("%s: checked\n", impl_names[impl]);
+    }
+
+    ass_synth_done(priv);
+    printf("%d checks, %d failed\n", checked, failed);
+    return failed != 0;
+}
@@ -349,6 +349,8 @@ static int decode_audio(sh_audio_t *sh_audio,unsigned char *buf,int minlen,int m
 	av_init_packet(&pkt);
 	pkt.data = start;
 	pkt.size = x;
+	if (sh_audio->ds->flags & DP_PREROLL)
+	    pkt.flags |= AV_PKT_FLAG_DISCARD;
 	if (pts != MP_NOPTS_VALUE) {
 	    sh_audio->pts = pts;
 	    sh_audio->pts_bytes = 0;
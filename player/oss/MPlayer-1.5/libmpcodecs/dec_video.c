@@ -157,6 +157,10 @@ void resync_video_stream(sh_video_t *sh_video)
     sh_video->last_pts         = MP_NOPTS_VALUE;
     if (mpvdec)
         mpvdec->control(sh_video, VDCTRL_RESYNC_STREAM, NULL);
+    if (sh_video->vfilter) {
+        vf_instance_t *vf = sh_video->vfilter;
+        vf->control(vf, VFCTRL_RESET, NULL);
+    }
 }
 
 int get_current_video_decoder_lag(sh_video_t *sh_video)
@@ -29,9 +29,177 @@
 #include "libmpcodecs/img_format.h"
 #include "libmpcodecs/mp_image.h"
 #include "libvo/fastmemcpy.h"
+#include "libavutil/common.h"
 #include "libavutil/mem.h"
+#include "libavutil/thread.h"
 #include "mp_msg.h"
 
+/* Plane memory comes from a pool shared by the decoders and all filters, so
+ * that reallocations on format changes and filter chain rebuilds reuse
+ * buffers (and their already mapped pages) instead of going to the system.
+ * Buffers are grouped in size classes of 8 steps per power of two. */
+
+// keeps the alignment of av_malloc for the data after the header
+#define POOL_HEADER_SIZE 64
+#define POOL_MIN_SIZE 4096
+#define POOL_CLASSES 160
+// free buffers of a class not asked for in this many requests are released
+#define POOL_MAX_IDLE 64
+
+typedef struct pool_buffer {
+    struct pool_buffer *next; // in the free list of its class
+    int size_class;
+    int refcount;
+} pool_buffer_t;
+
+static struct {
+    pool_buffer_t *free[POOL_CLASSES];
+    unsigned last_request[POOL_CLASSES];
+    int64_t used_bytes, free_bytes;
+    mp_image_pool_stats_t stats;
+} pool;
+static AVMutex pool_mutex = AV_MUTEX_INITIALIZER;
+
+/* Class 0 holds up to POOL_MIN_SIZE, then for 2^k < size <= 2^(k+1) there
+ * are 8 classes of m * 2^(k-3) bytes, with m from 9 to 16. */
+static int pool_class(size_t size)
+{
+    int k = 12;
+    if (size <= POOL_MIN_SIZE)
+        return 0;
+    while ((size - 1) >> (k + 1))
+        k++;
+    return (k - 12) * 8 + ((size - 1) >> (k - 3)) - 7;
+}
+
+static size_t pool_class_size(int size_class)
+{
+    if (!size_class)
+        return POOL_MIN_SIZE;
+    size_class--;
+    return (size_t)(9 + size_class % 8) << (12 + size_class / 8 - 3);
+}
+
+static pool_buffer_t *pool_header(void *buf)
+{
+    return (pool_buffer_t *)((uint8_t *)buf - POOL_HEADER_SIZE);
+}
+
+static void pool_release_class(int size_class)
+{
+    while (pool.free[size_class]) {
+        pool_buffer_t *b = pool.free[size_class];
+        pool.free[size_class] = b->next;
+        pool.free_bytes -= pool_class_size(size_class);
+        pool.stats.released++;
+        av_free(b);
+    }
+}
+
+void *mp_image_buffer_alloc(size_t size)
+{
+    size_t class_size;
+    int size_class, i;
+    pool_buffer_t *b;
+
+    if (size > INT_MAX)
+        return NULL;
+    size_class = pool_class(size);
+    class_size = pool_class_size(size_class);
+    ff_mutex_lock(&pool_mutex);
+    pool.stats.requests++;
+    pool.last_request[size_class] = pool.stats.requests;
+    for (i = 0; i < POOL_CLASSES; i++)
+        if (pool.free[i] &&
+            pool.stats.requests - pool.last_request[i] > POOL_MAX_IDLE)
+            pool_release_class(i);
+
+    b = pool.free[size_class];
+    if (b) {
+        pool.free[size_class] = b->next;
+        pool.free_bytes -= class_size;
+        pool.stats.reused++;
+    } else {
+        // do not hold more than the most that was ever in use
+        int64_t peak = FFMAX(pool.stats.peak_bytes, pool.used_bytes + class_size);
+        for (i = POOL_CLASSES - 1; i >= 0 &&
+             pool.used_bytes + pool.free_bytes + class_size > peak; i--)
+            pool_release_class(i);
+        b = av_malloc(POOL_HEADER_SIZE + class_size);
+        if (!b) {
+            ff_mutex_unlock(&pool_mutex);
+            return NULL;
+        }
+        b->size_class = size_class;
+    }
+    b->refcount = 1;
+    pool.used_bytes += class_size;
+    pool.stats.peak_bytes = FFMAX(pool.stats.peak_bytes, pool.used_bytes);
+    ff_mutex_unlock(&pool_mutex);
+    return (uint8_t *)b + POOL_HEADER_SIZE;
+}
+
+void mp_image_buffer_ref(void *buf)
+{
+    ff_mutex_lock(&pool_mutex);
+    pool_header(buf)->refcount++;
+    ff_mutex_unlock(&pool_mutex);
+}
+
+void mp_image_buffer_unref(void *buf)
+{
+    pool_buffer_t *b;
+    if (!buf)
+        return;
+    b = pool_header(buf);
+    ff_mutex_lock(&pool_mutex);
+    if (!--b->refcount) {
+        int64_t size = pool_class_size(b->size_class);
+        b->next = pool.free[b->size_class];
+        pool.free[b->size_class] = b;
+        pool.used_bytes -= size;
+        pool.free_bytes += size;
+    }
+    ff_mutex_unlock(&pool_mutex);
+}
+
+int mp_image_buffer_shared(void *buf)
+{
+    int shared;
+    ff_mutex_lock(&pool_mutex);
+    shared = pool_header(buf)->refcount > 1;
+    ff_mutex_unlock(&pool_mutex);
+    return shared;
+}
+
+void mp_image_pool_get_stats(mp_image_pool_stats_t *stats)
+{
+    ff_mutex_lock(&pool_mutex);
+    *stats = pool.stats;
+    ff_mutex_unlock(&pool_mutex);
+}
+
+void mp_image_pool_uninit(void)
+{
+    int i;
+    ff_mutex_lock(&pool_mutex);
+    for (i = 0; i < POOL_CLASSES; i++)
+        pool_release_class(i);
+    ff_mutex_unlock(&pool_mutex);
+}
+
+void mp_image_free_planes(mp_image_t *mpi)
+{
+    if (!(mpi->flags & MP_IMGFLAG_ALLOCATED))
+        return;
+    /* because we allocate the whole image at once */
+    mp_image_buffer_unref(mpi->planes[0]);
+    if (mpi->flags & MP_IMGFLAG_RGB_PALETTE)
+        mp_image_buffer_unref(mpi->planes[1]);
+    memset(mpi->planes, 0, sizeof(mpi->planes));
+    mpi->flags &= ~MP_IMGFLAG_ALLOCATED;
+}
+
 void mp_image_alloc_planes(mp_image_t *mpi) {
   /* This condition is stricter than needed, but I want to be sure that every
    * calculation step can fit in int32_t. This assumption is true over most of
@@ -49,10 +217,12 @@ void mp_image_alloc_planes(mp_image_t *mpi) {
         mp_msg(MSGT_DECVIDEO,MSGL_WARN,"mp_image: Unreasonable image parameters\n");
         return;
   }
-    mpi->planes[0]=av_malloc(mpi->bpp*mpi->width*(mpi->height+2)/8+
-                            mpi->chroma_width*mpi->chroma_height);
+    mpi->planes[0]=mp_image_buffer_alloc(mpi->bpp*mpi->width*(mpi->height+2)/8+
+                                         mpi->chroma_width*mpi->chroma_height);
   } else
-    mpi->planes[0]=av_malloc(mpi->bpp*mpi->width*(mpi->height+2)/8);
+    mpi->planes[0]=mp_image_buffer_alloc(mpi->bpp*mpi->width*(mpi->height+2)/8);
+  if (!mpi->planes[0])
+    return;
   if (mpi->flags&MP_IMGFLAG_PLANAR) {
     int bpp = IMGFMT_IS_YUVP16(mpi->imgfmt)? 2 : 1;
     // YV12/I420/YVU9/IF09. feel free to add other planar formats here...
@@ -79,8 +249,14 @@ void mp_image_alloc_planes(mp_image_t *mpi) {
     }
   } else {
     mpi->stride[0]=mpi->width*mpi->bpp/8;
-    if (mpi->flags & MP_IMGFLAG_RGB_PALETTE)
-      mpi->planes[1] = av_malloc(1024);
+    if (mpi->flags & MP_IMGFLAG_RGB_PALETTE) {
+      mpi->planes[1] = mp_image_buffer_alloc(1024);
+      if (!mpi->planes[1]) {
+        mp_image_buffer_unref(mpi->planes[0]);
+        mpi->planes[0] = NULL;
+        return;
+      }
+    }
   }
   mpi->flags|=MP_IMGFLAG_ALLOCATED;
 }
@@ -261,12 +437,7 @@ mp_image_t* new_mp_image(int w,int h){
 
 void free_mp_image(mp_image_t* mpi){
     if(!mpi) return;
-    if(mpi->flags&MP_IMGFLAG_ALLOCATED){
-        /* because we allocate the whole image at once */
-        av_free(mpi->planes[0]);
-        if (mpi->flags & MP_IMGFLAG_RGB_PALETTE)
-            av_free(mpi->planes[1]);
-    }
+    mp_image_free_planes(mpi);
     free(mpi);
 }
 
@@ -19,6 +19,7 @@
 #ifndef MPLAYER_MP_IMAGE_H
 #define MPLAYER_MP_IMAGE_H
 
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -138,6 +139,24 @@ void free_mp_image(mp_image_t* mpi);
 
 mp_image_t* alloc_mpi(int w, int h, unsigned long int fmt);
 void mp_image_alloc_planes(mp_image_t *mpi);
+void mp_image_free_planes(mp_image_t *mpi);
 void copy_mpi(mp_image_t *dmpi, mp_image_t *mpi);
 
+typedef struct mp_image_pool_stats {
+    unsigned requests; // buffers asked for
+    unsigned reused;   // of those, served from the pool
+    unsigned released; // buffers given back to the system
+    int64_t peak_bytes; // most memory in use at once
+} mp_image_pool_stats_t;
+
+/* Reference counted plane memory, shared by the decoders and filters.
+ * A buffer returns to the pool when the last reference is dropped. */
+void *mp_image_buffer_alloc(size_t size);
+void mp_image_buffer_ref(void *buf);
+void mp_image_buffer_unref(void *buf);
+// whether more than one reference to the buffer is held
+int mp_image_buffer_shared(void *buf);
+void mp_image_pool_get_stats(mp_image_pool_stats_t *stats);
+void mp_image_pool_uninit(void);
+
 #endif /* MPLAYER_MP_IMAGE_H */
@@ -0,0 +1,200 @@
+/*
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * A pool of threads shared by the filters that split their frames into
+ * slices.  Each run is a batch of jobs, queued until all of its jobs are
+ * taken; several filters (e.g. on the threads of vf_thread) may run
+ * batches at the same time.  The calling thread works on its own batch as
+ * well, so a filter with threads=n runs on at most n threads.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "mp_msg.h"
+#include "libavutil/common.h"
+#include "slice_threads.h"
+
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
+struct slice_batch {
+    slice_batch_t *next;
+    slice_func_t *func;
+    void *ctx;
+    int jobs;
+    int next_job;
+    int jobs_left;
+    int progress[SLICE_MAX_THREADS];
+};
+
+#if HAVE_PTHREADS
+static pthread_mutex_t setup_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wakeup = PTHREAD_COND_INITIALIZER;  // jobs to take
+static pthread_cond_t changed = PTHREAD_COND_INITIALIZER; // job done, progress
+static pthread_t workers[SLICE_MAX_THREADS - 1];
+static int n_threads;
+static int users;
+static int quit;
+static slice_batch_t *pending; // batches with jobs left to take, oldest first
+
+// must be called with lock held
+static int take_job(slice_batch_t *b)
+{
+    int job = b->next_job++;
+    if (b->next_job == b->jobs) {
+        slice_batch_t **p = &pending;
+        while (*p != b)
+            p = &(*p)->next;
+        *p = b->next;
+    }
+    return job;
+}
+
+static void *worker(void *arg)
+{
+    pthread_mutex_lock(&lock);
+    for (;;) {
+        slice_batch_t *b;
+        int job;
+        while (!quit && !pending)
+            pthread_cond_wait(&wakeup, &lock);
+        if (quit)
+            break;
+        b = pending;
+        job = take_job(b);
+        pthread_mutex_unlock(&lock);
+        b->func(b, b->ctx, job);
+        pthread_mutex_lock(&lock);
+        if (!--b->jobs_left)
+            pthread_cond_broadcast(&changed);
+    }
+    pthread_mutex_unlock(&lock);
+    return NULL;
+}
+#endif /* HAVE_PTHREADS */
+
+int slice_threads_parse(const char *args)
+{
+    const char *p = args ? strstr(args, "threads=") : NULL;
+    return p ? av_clip(atoi(p + 8), 1, SLICE_MAX_THREADS) : 1;
+}
+
+void slice_threads_init(int threads)
+{
+#if HAVE_PTHREADS
+    pthread_mutex_lock(&setup_lock);
+    users++;
+    threads = FFMIN(threads, SLICE_MAX_THREADS);
+    while (n_threads < threads - 1) {
+        if (pthread_create(&workers[n_threads], NULL, worker, NULL)) {
+            mp_msg(MSGT_VFILTER, MSGL_WARN,
+                   "Could not start slice threads, using %d.\n",
+                   n_threads + 1);
+            break;
+        }
+        n_threads++;
+    }
+    pthread_mutex_unlock(&setup_lock);
+#else
+    if (threads > 1)
+        mp_msg(MSGT_VFILTER, MSGL_WARN,
+               "Compiled without thread support, using 1 thread.\n");
+#endif
+}
+
+void slice_threads_uninit(void)
+{
+#if HAVE_PTHREADS
+    int i;
+    pthread_mutex_lock(&setup_lock);
+    if (users > 0 && !--users && n_threads) {
+        pthread_mutex_lock(&lock);
+        quit = 1;
+        pthread_cond_broadcast(&wakeup);
+        pthread_mutex_unlock(&lock);
+        for (i = 0; i < n_threads; i++)
+            pthread_join(workers[i], NULL);
+        n_threads = 0;
+        quit = 0;
+    }
+    pthread_mutex_unlock(&setup_lock);
+#endif
+}
+
+void slice_threads_run(int jobs, slice_func_t *func, void *ctx)
+{
+    slice_batch_t b;
+    int job;
+
+    memset(&b, 0, sizeof(b));
+    b.func      = func;
+    b.ctx       = ctx;
+    b.jobs      = FFMIN(jobs, SLICE_MAX_THREADS);
+    b.jobs_left = b.jobs;
+
+#if HAVE_PTHREADS
+    pthread_mutex_lock(&lock);
+    if (n_threads && b.jobs > 1) {
+        slice_batch_t **p = &pending;
+        while (*p)
+            p = &(*p)->next;
+        *p = &b;
+        pthread_cond_broadcast(&wakeup);
+        while (b.next_job < b.jobs) {
+            job = take_job(&b);
+            pthread_mutex_unlock(&lock);
+            func(&b, ctx, job);
+            pthread_mutex_lock(&lock);
+            b.jobs_left--;
+        }
+        while (b.jobs_left)
+            pthread_cond_wait(&changed, &lock);
+        pthread_mutex_unlock(&lock);
+        return;
+    }
+    pthread_mutex_unlock(&lock);
+#endif
+    for (job = 0; job < b.jobs; job++)
+        func(&b, ctx, job);
+}
+
+void slice_report_progress(slice_batch_t *b, int job, int progress)
+{
+#if HAVE_PTHREADS
+    pthread_mutex_lock(&lock);
+    b->progress[job] = progress;
+    pthread_cond_broadcast(&changed);
+    pthread_mutex_unlock(&lock);
+#endif
+}
+
+// job must come before the caller's own, which it thus cannot wait for
+void slice_await_progress(slice_batch_t *b, int job, int progress)
+{
+#if HAVE_PTHREADS
+    pthread_mutex_lock(&lock);
+    while (b->progress[job] < progress)
+        pthread_cond_wait(&changed, &lock);
+    pthread_mutex_unlock(&lock);
+#endif
+}
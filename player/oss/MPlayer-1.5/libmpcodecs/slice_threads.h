@@ -0,0 +1,46 @@
+/*
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPLAYER_SLICE_THREADS_H
+#define MPLAYER_SLICE_THREADS_H
+
+#define SLICE_MAX_THREADS 16
+
+typedef struct slice_batch slice_batch_t;
+
+typedef void slice_func_t(slice_batch_t *batch, void *ctx, int job);
+
+// value of a threads=<1-16> suboption anywhere in args, 1 if there is none
+int slice_threads_parse(const char *args);
+
+// take a reference to the shared pool, with at least threads - 1 workers
+void slice_threads_init(int threads);
+void slice_threads_uninit(void);
+
+/*
+ * Run func for jobs 0 to jobs - 1 (at most SLICE_MAX_THREADS) on the pool
+ * and the calling thread and return when all of them are done.  Jobs are
+ * started in order, so a job may wait for the progress of an earlier job
+ * of the same run.
+ */
+void slice_threads_run(int jobs, slice_func_t *func, void *ctx);
+
+void slice_report_progress(slice_batch_t *batch, int job, int progress);
+void slice_await_progress(slice_batch_t *batch, int job, int progress);
+
+#endif /* MPLAYER_SLICE_THREADS_H */
@@ -112,6 +112,7 @@ extern const vf_info_t vf_info_swapuv;
 extern const vf_info_t vf_info_telecine;
 extern const vf_info_t vf_info_test;
 extern const vf_info_t vf_info_tfields;
+extern const vf_info_t vf_info_thread;
 extern const vf_info_t vf_info_tile;
 extern const vf_info_t vf_info_tinterlace;
 extern const vf_info_t vf_info_unsharp;
@@ -183,6 +184,7 @@ static const vf_info_t* const filter_list[]={
     &vf_info_telecine,
     &vf_info_tinterlace,
     &vf_info_tfields,
+    &vf_info_thread,
     &vf_info_ivtc,
     &vf_info_ilpack,
     &vf_info_dsize,
@@ -276,6 +278,16 @@ void vf_mpi_clear(mp_image_t* mpi,int x0,int y0,int w,int h){
     }
 }
 
+static mp_image_t *get_temp_image(vf_instance_t *vf, int w, int h){
+  mp_image_t *mpi;
+  if(!vf->imgctx.temp_images[0]) vf->imgctx.temp_images[0]=new_mp_image(w,h);
+  mpi=vf->imgctx.temp_images[0];
+  // the previous image may still be read on another thread (vf_thread)
+  if((mpi->flags&MP_IMGFLAG_ALLOCATED) && mp_image_buffer_shared(mpi->planes[0]))
+      mp_image_free_planes(mpi);
+  return mpi;
+}
+
 mp_image_t* vf_get_image(vf_instance_t* vf, unsigned int outfmt, int mp_imgtype, int mp_imgflag, int w, int h){
   mp_image_t* mpi=NULL;
   int w2;
@@ -320,13 +332,11 @@ mp_image_t* vf_get_image(vf_instance_t* vf, unsigned int outfmt, int mp_imgtype,
     mpi=vf->imgctx.static_images[0];
     break;
   case MP_IMGTYPE_TEMP:
-    if(!vf->imgctx.temp_images[0]) vf->imgctx.temp_images[0]=new_mp_image(w2,h);
-    mpi=vf->imgctx.temp_images[0];
+    mpi=get_temp_image(vf,w2,h);
     break;
   case MP_IMGTYPE_IPB:
     if(!(mp_imgflag&MP_IMGFLAG_READABLE)){ // B frame:
-      if(!vf->imgctx.temp_images[0]) vf->imgctx.temp_images[0]=new_mp_image(w2,h);
-      mpi=vf->imgctx.temp_images[0];
+      mpi=get_temp_image(vf,w2,h);
       break;
     }
   case MP_IMGTYPE_IP:
@@ -369,13 +379,7 @@ mp_image_t* vf_get_image(vf_instance_t* vf, unsigned int outfmt, int mp_imgtype,
         if(mpi->flags&MP_IMGFLAG_ALLOCATED){
             if(mpi->width<w2 || mpi->height<h || mpi->imgfmt != outfmt || missing_palette){
                 // need to re-allocate buffer memory:
-                av_freep(&mpi->planes[0]);
-                if (mpi->flags & MP_IMGFLAG_RGB_PALETTE)
-                    av_freep(&mpi->planes[1]);
-                mpi->planes[1] = NULL;
-                mpi->planes[2] = NULL;
-                mpi->planes[3] = NULL;
-                mpi->flags&=~MP_IMGFLAG_ALLOCATED;
+                mp_image_free_planes(mpi);
                 mpi->bpp = 0;
                 mp_msg(MSGT_VFILTER,MSGL_V,"vf.c: have to REALLOCATE buffer memory in vf_%s :(\n",
                        vf->info->name);
@@ -612,7 +616,9 @@ int vf_output_queued_frame(vf_instance_t *vf)
         vf_instance_t *current;
         vf_instance_t *last=NULL;
         int (*tmp)(vf_instance_t *);
-        for (current = vf; current; current = current->next)
+        // filters running on other threads are taken care of by vf_thread
+        for (current = vf; current;
+             current = current->async_end ? current->async_end : current->next)
             if (current->continue_buffered_image)
                 last = current;
         if (!last)
@@ -753,12 +759,19 @@ void vf_next_draw_slice(struct vf_instance *vf,unsigned char** src, int * stride
 
 vf_instance_t* append_filters(vf_instance_t* last){
   vf_instance_t* vf;
-  int i;
+  int i, j;
 
   if(vf_settings) {
     // We want to add them in the 'right order'
     for(i = 0 ; vf_settings[i].name ; i++)
       /* NOP */;
+    // the frames of threaded filters return to this thread before 'last'
+    for(j = 0 ; j < i ; j++)
+      if(!strcmp(vf_settings[j].name,"thread")) {
+        vf = vf_open_thread_sink(last);
+        if(vf) last=vf;
+        break;
+      }
     for(i-- ; i >= 0 ; i--) {
       //printf("Open filter %s\n",vf_settings[i].name);
       vf = vf_open_filter(last,vf_settings[i].name,vf_settings[i].attribs);
@@ -82,6 +82,8 @@ typedef struct vf_instance {
     vf_image_context_t imgctx;
     vf_format_context_t fmt;
     struct vf_instance *next;
+    // the filters up to this one run on other threads (vf_thread)
+    struct vf_instance *async_end;
     mp_image_t *dmpi;
     struct vf_priv_s* priv;
 } vf_instance_t;
@@ -112,6 +114,8 @@ typedef struct vf_seteq_s
 #define VFCTRL_GET_ENDPTS      18 /* Return last endpts value that reached vf_vo*/
 #define VFCTRL_SET_DEINTERLACE 19 /* Set deinterlacing status */
 #define VFCTRL_GET_DEINTERLACE 20 /* Get deinterlacing status */
+#define VFCTRL_DRAIN_FRAMES    21 /* For playback - queue delayed frames for vf_output_queued_frame */
+#define VFCTRL_RESET           22 /* Drop delayed frames, e.g. after a seek */
 
 #include "vfcap.h"
 
@@ -143,6 +147,7 @@ int vf_next_put_image(struct vf_instance *vf,mp_image_t *mpi, double pts, double
 void vf_next_draw_slice (struct vf_instance *vf, unsigned char** src, int* stride, int w,int h, int x, int y);
 
 vf_instance_t* append_filters(vf_instance_t* last);
+vf_instance_t *vf_open_thread_sink(vf_instance_t *next);
 
 void vf_uninit_filter(vf_instance_t* vf);
 void vf_uninit_filter_chain(vf_instance_t* vf);
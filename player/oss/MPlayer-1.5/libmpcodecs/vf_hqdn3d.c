@@ -28,41 +28,70 @@
 #include "img_format.h"
 #include "mp_image.h"
 #include "vf.h"
+#include "slice_threads.h"
+#include "libavutil/common.h"
 
 #define PARAM1_DEFAULT 4.0
 #define PARAM2_DEFAULT 3.0
 #define PARAM3_DEFAULT 6.0
 
+// lines a strip goes ahead before the strip on its right may follow
+#define SYNC_LINES 16
+
 //===========================================================================//
 
 struct vf_priv_s {
         int Coefs[4][512*16];
         unsigned int *Line;
+        unsigned int *Carry;
         unsigned short *Frame[3];
+        int threads;
 };
 
+/* Every pixel depends on all the pixels left of and above it, so frames
+ * cannot be cut into horizontal slices.  Instead each thread works on a
+ * vertical strip of every plane, line by line, running SYNC_LINES behind
+ * the strip on its left, which hands over the horizontal filter state at
+ * the end of each line through Carry. */
+typedef struct Strip {
+        slice_batch_t *batch;
+        int job;
+        int X0, X1;           // columns of this strip
+        int done;             // lines of the previous planes
+        unsigned int *Carry;  // PixelAnt at the left edge of each line
+} Strip;
+
 
 /***************************************************************************/
 
-static void uninit(struct vf_instance *vf)
+static void free_buffers(struct vf_instance *vf)
 {
         free(vf->priv->Line);
+        free(vf->priv->Carry);
         free(vf->priv->Frame[0]);
         free(vf->priv->Frame[1]);
         free(vf->priv->Frame[2]);
 
         vf->priv->Line     = NULL;
+        vf->priv->Carry    = NULL;
         vf->priv->Frame[0] = NULL;
         vf->priv->Frame[1] = NULL;
         vf->priv->Frame[2] = NULL;
 }
 
+static void uninit(struct vf_instance *vf)
+{
+        free_buffers(vf);
+        slice_threads_uninit();
+}
+
 static int config(struct vf_instance *vf,
         int width, int height, int d_width, int d_height,
         unsigned int flags, unsigned int outfmt){
 
-        uninit(vf);
+        free_buffers(vf);
         vf->priv->Line = malloc(width*sizeof(int));
+        vf->priv->Carry = malloc(3*height*sizeof(int));
 
         return vf_next_config(vf,width,height,d_width,d_height,flags,outfmt);
 }
@@ -74,18 +103,32 @@ static inline unsigned int LowPassMul(unsigned int PrevMul, unsigned int CurrMul
     return CurrMul + Coef[d];
 }
 
+static void StripBegin(Strip *s, int Y, int H)
+{
+    if (s->X0 && !(Y % SYNC_LINES))
+        slice_await_progress(s->batch, s->job - 1,
+                             s->done + FFMIN(Y + SYNC_LINES, H));
+}
+
+static void StripEnd(Strip *s, int Y, int H, unsigned int PixelAnt)
+{
+    s->Carry[Y] = PixelAnt;
+    if (!((Y + 1) % SYNC_LINES) || Y + 1 == H)
+        slice_report_progress(s->batch, s->job, s->done + Y + 1);
+}
+
 static void deNoiseTemporal(
                     unsigned char *Frame,        // mpi->planes[x]
                     unsigned char *FrameDest,    // dmpi->planes[x]
                     unsigned short *FrameAnt,
                     int W, int H, int sStride, int dStride,
-                    int *Temporal)
+                    int *Temporal, Strip *s)
 {
     long X, Y;
     unsigned int PixelDst;
 
     for (Y = 0; Y < H; Y++){
-        for (X = 0; X < W; X++){
+        for (X = s->X0; X < s->X1; X++){
             PixelDst = LowPassMul(FrameAnt[X]<<8, Frame[X]<<16, Temporal);
             FrameAnt[X] = ((PixelDst+0x1000007F)>>8);
             FrameDest[X]= ((PixelDst+0x10007FFF)>>16);
@@ -94,6 +137,7 @@ static void deNoiseTemporal(
         FrameDest += dStride;
         FrameAnt += W;
     }
+    slice_report_progress(s->batch, s->job, s->done + H);
 }
 
 static void deNoiseSpacial(
@@ -101,101 +145,111 @@ static void deNoiseSpacial(
                     unsigned char *FrameDest,    // dmpi->planes[x]
                     unsigned int *LineAnt,       // vf->priv->Line (width bytes)
                     int W, int H, int sStride, int dStride,
-                    int *Horizontal, int *Vertical)
+                    int *Horizontal, int *Vertical, Strip *s)
 {
     long X, Y;
     long sLineOffs = 0, dLineOffs = 0;
     unsigned int PixelAnt;
     unsigned int PixelDst;
 
-    /* First pixel has no left nor top neighbor. */
-    PixelDst = LineAnt[0] = PixelAnt = Frame[0]<<16;
-    FrameDest[0]= ((PixelDst+0x10007FFF)>>16);
+    StripBegin(s, 0, H);
+    if (!s->X0) {
+        /* First pixel has no left nor top neighbor. */
+        PixelDst = LineAnt[0] = PixelAnt = Frame[0]<<16;
+        FrameDest[0]= ((PixelDst+0x10007FFF)>>16);
+    } else
+        PixelAnt = s->Carry[0];
 
     /* First line has no top neighbor, only left. */
-    for (X = 1; X < W; X++){
+    for (X = FFMAX(s->X0, 1); X < s->X1; X++){
         PixelDst = LineAnt[X] = LowPassMul(PixelAnt, Frame[X]<<16, Horizontal);
         FrameDest[X]= ((PixelDst+0x10007FFF)>>16);
     }
+    StripEnd(s, 0, H, PixelAnt);
 
     for (Y = 1; Y < H; Y++){
         unsigned int PixelAnt;
         sLineOffs += sStride, dLineOffs += dStride;
-        /* First pixel on each line doesn't have previous pixel */
-        PixelAnt = Frame[sLineOffs]<<16;
-        PixelDst = LineAnt[0] = LowPassMul(LineAnt[0], PixelAnt, Vertical);
-        FrameDest[dLineOffs]= ((PixelDst+0x10007FFF)>>16);
-
-        for (X = 1; X < W; X++){
+        StripBegin(s, Y, H);
+        if (!s->X0) {
+            /* First pixel on each line doesn't have previous pixel */
+            PixelAnt = Frame[sLineOffs]<<16;
+            PixelDst = LineAnt[0] = LowPassMul(LineAnt[0], PixelAnt, Vertical);
+            FrameDest[dLineOffs]= ((PixelDst+0x10007FFF)>>16);
+        } else
+            PixelAnt = s->Carry[Y];
+
+        for (X = FFMAX(s->X0, 1); X < s->X1; X++){
             unsigned int PixelDst;
             /* The rest are normal */
             PixelAnt = LowPassMul(PixelAnt, Frame[sLineOffs+X]<<16, Horizontal);
             PixelDst = LineAnt[X] = LowPassMul(LineAnt[X], PixelAnt, Vertical);
             FrameDest[dLineOffs+X]= ((PixelDst+0x10007FFF)>>16);
         }
+        StripEnd(s, Y, H, PixelAnt);
     }
 }
 
 static void deNoise(unsigned char *Frame,        // mpi->planes[x]
                     unsigned char *FrameDest,    // dmpi->planes[x]
                     unsigned int *LineAnt,      // vf->priv->Line (width bytes)
-                    unsigned short **FrameAntPtr,
+                    unsigned short *FrameAnt,
                     int W, int H, int sStride, int dStride,
-                    int *Horizontal, int *Vertical, int *Temporal)
+                    int *Horizontal, int *Vertical, int *Temporal,
+                    Strip *s)
 {
     long X, Y;
     long sLineOffs = 0, dLineOffs = 0;
     unsigned int PixelAnt;
     unsigned int PixelDst;
-    unsigned short* FrameAnt=(*FrameAntPtr);
-
-    if(!FrameAnt){
-        (*FrameAntPtr)=FrameAnt=malloc(W*H*sizeof(unsigned short));
-        for (Y = 0; Y < H; Y++){
-            unsigned short* dst=&FrameAnt[Y*W];
-            unsigned char* src=Frame+Y*sStride;
-            for (X = 0; X < W; X++) dst[X]=src[X]<<8;
-        }
-    }
 
     if(!Horizontal[0] && !Vertical[0]){
         deNoiseTemporal(Frame, FrameDest, FrameAnt,
-                        W, H, sStride, dStride, Temporal);
+                        W, H, sStride, dStride, Temporal, s);
         return;
     }
     if(!Temporal[0]){
         deNoiseSpacial(Frame, FrameDest, LineAnt,
-                       W, H, sStride, dStride, Horizontal, Vertical);
+                       W, H, sStride, dStride, Horizontal, Vertical, s);
         return;
     }
 
-    /* First pixel has no left nor top neighbor. Only previous frame */
-    LineAnt[0] = PixelAnt = Frame[0]<<16;
-    PixelDst = LowPassMul(FrameAnt[0]<<8, PixelAnt, Temporal);
-    FrameAnt[0] = ((PixelDst+0x1000007F)>>8);
-    FrameDest[0]= ((PixelDst+0x10007FFF)>>16);
+    StripBegin(s, 0, H);
+    if (!s->X0) {
+        /* First pixel has no left nor top neighbor. Only previous frame */
+        LineAnt[0] = PixelAnt = Frame[0]<<16;
+        PixelDst = LowPassMul(FrameAnt[0]<<8, PixelAnt, Temporal);
+        FrameAnt[0] = ((PixelDst+0x1000007F)>>8);
+        FrameDest[0]= ((PixelDst+0x10007FFF)>>16);
+    } else
+        PixelAnt = s->Carry[0];
 
     /* First line has no top neighbor. Only left one for each pixel and
      * last frame */
-    for (X = 1; X < W; X++){
+    for (X = FFMAX(s->X0, 1); X < s->X1; X++){
         LineAnt[X] = PixelAnt = LowPassMul(PixelAnt, Frame[X]<<16, Horizontal);
         PixelDst = LowPassMul(FrameAnt[X]<<8, PixelAnt, Temporal);
         FrameAnt[X] = ((PixelDst+0x1000007F)>>8);
         FrameDest[X]= ((PixelDst+0x10007FFF)>>16);
     }
+    StripEnd(s, 0, H, PixelAnt);
 
     for (Y = 1; Y < H; Y++){
         unsigned int PixelAnt;
         unsigned short* LinePrev=&FrameAnt[Y*W];
         sLineOffs += sStride, dLineOffs += dStride;
-        /* First pixel on each line doesn't have previous pixel */
-        PixelAnt = Frame[sLineOffs]<<16;
-        LineAnt[0] = LowPassMul(LineAnt[0], PixelAnt, Vertical);
-        PixelDst = LowPassMul(LinePrev[0]<<8, LineAnt[0], Temporal);
-        LinePrev[0] = ((PixelDst+0x1000007F)>>8);
-        FrameDest[dLineOffs]= ((PixelDst+0x10007FFF)>>16);
-
-        for (X = 1; X < W; X++){
+        StripBegin(s, Y, H);
+        if (!s->X0) {
+            /* First pixel on each line doesn't have previous pixel */
+            PixelAnt = Frame[sLineOffs]<<16;
+            LineAnt[0] = LowPassMul(LineAnt[0], PixelAnt, Vertical);
+            PixelDst = LowPassMul(LinePrev[0]<<8, LineAnt[0], Temporal);
+            LinePrev[0] = ((PixelDst+0x1000007F)>>8);
+            FrameDest[dLineOffs]= ((PixelDst+0x10007FFF)>>16);
+        } else
+            PixelAnt = s->Carry[Y];
+
+        for (X = FFMAX(s->X0, 1); X < s->X1; X++){
             unsigned int PixelDst;
             /* The rest are normal */
             PixelAnt = LowPassMul(PixelAnt, Frame[sLineOffs+X]<<16, Horizontal);
@@ -204,14 +258,68 @@ static void deNoise(unsigned char *Frame,        // mpi->planes[x]
             LinePrev[X] = ((PixelDst+0x1000007F)>>8);
             FrameDest[dLineOffs+X]= ((PixelDst+0x10007FFF)>>16);
         }
+        StripEnd(s, Y, H, PixelAnt);
+    }
+}
+
+static void initFrameAnt(unsigned char *Frame, unsigned short **FrameAntPtr,
+                         int W, int H, int sStride)
+{
+    long X, Y;
+    unsigned short* FrameAnt;
+
+    if(*FrameAntPtr)
+        return;
+    (*FrameAntPtr)=FrameAnt=malloc(W*H*sizeof(unsigned short));
+    for (Y = 0; Y < H; Y++){
+        unsigned short* dst=&FrameAnt[Y*W];
+        unsigned char* src=Frame+Y*sStride;
+        for (X = 0; X < W; X++) dst[X]=src[X]<<8;
     }
 }
 
+struct slice_args {
+        struct vf_priv_s *priv;
+        mp_image_t *dmpi, *mpi;
+};
+
+static void deNoiseStrips(slice_batch_t *batch, void *ctx, int job)
+{
+        struct slice_args *a = ctx;
+        struct vf_priv_s *priv = a->priv;
+        mp_image_t *dmpi = a->dmpi, *mpi = a->mpi;
+        int i;
+        Strip s;
+
+        s.batch = batch;
+        s.job   = job;
+        s.done  = 0;
+        for (i = 0; i < 3; i++) {
+                int W = i ? mpi->w >> mpi->chroma_x_shift : mpi->w;
+                int H = i ? mpi->h >> mpi->chroma_y_shift : mpi->h;
+                // a strip starting at column 0 must be the first one
+                int strips = FFMIN(priv->threads, W);
+                s.X0    = W *  job      / strips;
+                s.X1    = W * (job + 1) / strips;
+                s.Carry = priv->Carry + i * mpi->h;
+                if (job < strips)
+                        deNoise(mpi->planes[i], dmpi->planes[i],
+                                priv->Line, priv->Frame[i], W, H,
+                                mpi->stride[i], dmpi->stride[i],
+                                priv->Coefs[i ? 2 : 0],
+                                priv->Coefs[i ? 2 : 0],
+                                priv->Coefs[i ? 3 : 1], &s);
+                else
+                        slice_report_progress(batch, job, s.done + H);
+                s.done += H;
+        }
+}
 
 static int put_image(struct vf_instance *vf, mp_image_t *mpi, double pts, double endpts){
         int cw= mpi->w >> mpi->chroma_x_shift;
         int ch= mpi->h >> mpi->chroma_y_shift;
         int W = mpi->w, H = mpi->h;
+        struct slice_args a;
 
         mp_image_t *dmpi=vf_get_image(vf->next,mpi->imgfmt,
                 MP_IMGTYPE_TEMP, MP_IMGFLAG_ACCEPT_STRIDE,
@@ -219,24 +327,14 @@ static int put_image(struct vf_instance *vf, mp_image_t *mpi, double pts, double
 
         if(!dmpi) return 0;
 
-        deNoise(mpi->planes[0], dmpi->planes[0],
-                vf->priv->Line, &vf->priv->Frame[0], W, H,
-                mpi->stride[0], dmpi->stride[0],
-                vf->priv->Coefs[0],
-                vf->priv->Coefs[0],
-                vf->priv->Coefs[1]);
-        deNoise(mpi->planes[1], dmpi->planes[1],
-                vf->priv->Line, &vf->priv->Frame[1], cw, ch,
-                mpi->stride[1], dmpi->stride[1],
-                vf->priv->Coefs[2],
-                vf->priv->Coefs[2],
-                vf->priv->Coefs[3]);
-        deNoise(mpi->planes[2], dmpi->planes[2],
-                vf->priv->Line, &vf->priv->Frame[2], cw, ch,
-                mpi->stride[2], dmpi->stride[2],
-                vf->priv->Coefs[2],
-                vf->priv->Coefs[2],
-                vf->priv->Coefs[3]);
+        initFrameAnt(mpi->planes[0], &vf->priv->Frame[0], W, H, mpi->stride[0]);
+        initFrameAnt(mpi->planes[1], &vf->priv->Frame[1], cw, ch, mpi->stride[1]);
+        initFrameAnt(mpi->planes[2], &vf->priv->Frame[2], cw, ch, mpi->stride[2]);
+
+        a.priv = vf->priv;
+        a.dmpi = dmpi;
+        a.mpi  = mpi;
+        slice_threads_run(vf->priv->threads, deNoiseStrips, &a);
 
         return vf_next_put_image(vf, dmpi, pts, endpts);
 }
@@ -358,6 +456,9 @@ static int vf_open(vf_instance_t *vf, char *args){
         PrecalcCoefs(vf->priv->Coefs[2], ChromSpac);
         PrecalcCoefs(vf->priv->Coefs[3], ChromTmp);
 
+        vf->priv->threads = slice_threads_parse(args);
+        slice_threads_init(vf->priv->threads);
+
         return 1;
 }
 
@@ -0,0 +1,613 @@
+/*
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Runs the filters following each "thread" instance, up to the next one,
+ * on a thread of their own, so that the filters of a chain work on
+ * successive frames at the same time.  The instances are connected by
+ * bounded queues of frames.  append_filters() adds one more instance after
+ * the user filters (the sink), where the frames return to the main thread
+ * in their original order before going on to vf_ass, the vo or the encoder.
+ *
+ * The first instance of the chain (the entry) owns the pipeline.  Frames
+ * coming out of the sink are passed on by the entry, one per put_image()
+ * and the rest through vf_output_queued_frame().  Controls meant for the
+ * output are sent straight past the sink; the others go through the
+ * filters, each segment being locked against its thread meanwhile.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "mp_msg.h"
+
+#include "img_format.h"
+#include "mp_image.h"
+#include "vf.h"
+#include "libvo/fastmemcpy.h"
+
+#include "m_option.h"
+#include "m_struct.h"
+
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
+typedef struct frame {
+    struct frame *next;
+    mp_image_t *mpi;
+    double pts, endpts;
+} frame_t;
+
+typedef struct frame_queue {
+    frame_t *head, **tail;
+    int count;
+} frame_queue_t;
+
+#if HAVE_PTHREADS
+typedef struct pipeline {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;         // broadcast on every change of the state
+    pthread_t main_thread;
+    int quit;
+    int frames;                  // queued in a stage or being filtered
+    int window;                  // frames let in before waiting for output
+    frame_queue_t out;           // frames that reached the sink
+    int owed;                    // frames taken in without one going out
+    vf_instance_t *entry, *sink;
+    int num_stages;
+    vf_instance_t **stages;      // the instances starting a segment
+} pipeline_t;
+#endif
+
+static const struct vf_priv_s {
+    int queue;
+    int sink;
+#if HAVE_PTHREADS
+    pipeline_t *pipe;
+    frame_queue_t in;
+    pthread_t thread;
+    pthread_mutex_t run_lock;    // held while the segment filters a frame
+#endif
+} vf_priv_dflt = {
+    2,
+    0
+};
+
+#if HAVE_PTHREADS
+
+static void queue_push(frame_queue_t *q, frame_t *f)
+{
+    f->next = NULL;
+    *q->tail = f;
+    q->tail = &f->next;
+    q->count++;
+}
+
+static frame_t *queue_pop(frame_queue_t *q)
+{
+    frame_t *f = q->head;
+    if (f) {
+        q->head = f->next;
+        if (!q->head)
+            q->tail = &q->head;
+        q->count--;
+    }
+    return f;
+}
+
+static void queue_init(frame_queue_t *q)
+{
+    q->head  = NULL;
+    q->tail  = &q->head;
+    q->count = 0;
+}
+
+static void free_frame(frame_t *f)
+{
+    if (f->mpi)
+        free(f->mpi->qscale);
+    free_mp_image(f->mpi);
+    free(f);
+}
+
+static void queue_free(frame_queue_t *q)
+{
+    frame_t *f;
+    while ((f = queue_pop(q)))
+        free_frame(f);
+}
+
+static void copy_planes(mp_image_t *dmpi, mp_image_t *mpi)
+{
+    int i;
+    if (!(mpi->flags & MP_IMGFLAG_PLANAR)) {
+        memcpy_pic(dmpi->planes[0], mpi->planes[0], dmpi->stride[0], mpi->h,
+                   dmpi->stride[0], mpi->stride[0]);
+        if (mpi->flags & MP_IMGFLAG_RGB_PALETTE)
+            memcpy(dmpi->planes[1], mpi->planes[1], 1024);
+        return;
+    }
+    for (i = 0; i < mpi->num_planes; i++) {
+        int h = i == 0 || i == 3 ? mpi->h : dmpi->chroma_height;
+        memcpy_pic(dmpi->planes[i], mpi->planes[i], dmpi->stride[i], h,
+                   dmpi->stride[i], mpi->stride[i]);
+    }
+}
+
+/**
+ * \brief take a frame out of the filter that passed it on
+ *
+ * The planes of a temporary image from the pool are shared, vf_get_image()
+ * gives the filter new ones for its next frame.  Any other image may be
+ * changed or reused behind our back and is copied.
+ */
+static frame_t *hold_frame(mp_image_t *mpi, double pts, double endpts)
+{
+    frame_t *f = calloc(1, sizeof(*f));
+    mp_image_t *dmpi;
+
+    if (!f)
+        return NULL;
+    if ((mpi->flags & MP_IMGFLAG_ALLOCATED) && mpi->type == MP_IMGTYPE_TEMP) {
+        dmpi = new_mp_image(mpi->width, mpi->height);
+        if (dmpi) {
+            *dmpi = *mpi;
+            mp_image_buffer_ref(dmpi->planes[0]);
+            if (dmpi->flags & MP_IMGFLAG_RGB_PALETTE)
+                mp_image_buffer_ref(dmpi->planes[1]);
+        }
+    } else {
+        dmpi = new_mp_image(mpi->w, mpi->h);
+        if (dmpi) {
+            dmpi->flags = mpi->flags & (MP_IMGFLAG_RGB_PALETTE | MP_IMGFLAGMASK_COLORS);
+            mp_image_setfmt(dmpi, mpi->imgfmt);
+            dmpi->chroma_width  = -(-mpi->w >> dmpi->chroma_x_shift);
+            dmpi->chroma_height = -(-mpi->h >> dmpi->chroma_y_shift);
+            if (dmpi->bpp)
+                mp_image_alloc_planes(dmpi);
+            if (!(dmpi->flags & MP_IMGFLAG_ALLOCATED)) {
+                free_mp_image(dmpi);
+                dmpi = NULL;
+            } else {
+                copy_planes(dmpi, mpi);
+                dmpi->fields      = mpi->fields;
+                dmpi->pict_type   = mpi->pict_type;
+                dmpi->qscale_type = mpi->qscale_type;
+                dmpi->qstride     = mpi->qstride;
+            }
+        }
+    }
+    if (!dmpi) {
+        free(f);
+        return NULL;
+    }
+    dmpi->qscale = NULL;
+    if (mpi->qscale) {
+        int w = mpi->qstride;
+        int h = (mpi->h + 15) >> 4;
+        if (!w) {
+            w = (mpi->w + 15) >> 4;
+            h = 1;
+        }
+        dmpi->qscale = malloc(w * h);
+        if (dmpi->qscale)
+            fast_memcpy(dmpi->qscale, mpi->qscale, w * h);
+    }
+    dmpi->usage_count = 1;
+    f->mpi    = dmpi;
+    f->pts    = pts;
+    f->endpts = endpts;
+    return f;
+}
+
+// pass on a frame from the sink, on the main thread
+static int output_frame(pipeline_t *pipe, frame_t *f)
+{
+    int ret = vf_next_put_image(pipe->sink, f->mpi, f->pts, f->endpts);
+    free_frame(f);
+    return ret;
+}
+
+static frame_t *pop_output(pipeline_t *pipe)
+{
+    frame_t *f;
+    pthread_mutex_lock(&pipe->lock);
+    f = queue_pop(&pipe->out);
+    pthread_mutex_unlock(&pipe->lock);
+    return f;
+}
+
+static int have_output(pipeline_t *pipe)
+{
+    int ret;
+    pthread_mutex_lock(&pipe->lock);
+    ret = pipe->out.count > 0;
+    pthread_mutex_unlock(&pipe->lock);
+    return ret;
+}
+
+static int continue_output(vf_instance_t *vf);
+
+static int output_frames(vf_instance_t *vf, int all)
+{
+    pipeline_t *pipe = vf->priv->pipe;
+    frame_t *f;
+    int ret = 0;
+
+    while ((f = pop_output(pipe))) {
+        ret |= output_frame(pipe, f);
+        if (!all)
+            break;
+    }
+    if (have_output(pipe))
+        vf_queue_frame(vf, continue_output);
+    return ret;
+}
+
+static int continue_output(vf_instance_t *vf)
+{
+    return output_frames(vf, 0);
+}
+
+static void wait_idle(pipeline_t *pipe)
+{
+    pthread_mutex_lock(&pipe->lock);
+    while (pipe->frames)
+        pthread_cond_wait(&pipe->cond, &pipe->lock);
+    pthread_mutex_unlock(&pipe->lock);
+}
+
+// pass on all frames in the pipeline, on the main thread
+static void flush_pipeline(pipeline_t *pipe)
+{
+    for (;;) {
+        frame_t *f;
+        pthread_mutex_lock(&pipe->lock);
+        while (!pipe->out.count && pipe->frames)
+            pthread_cond_wait(&pipe->cond, &pipe->lock);
+        f = queue_pop(&pipe->out);
+        pthread_mutex_unlock(&pipe->lock);
+        if (!f)
+            break;
+        output_frame(pipe, f);
+    }
+}
+
+/**
+ * \brief pass on the frames the segment filters queued for later
+ *
+ * Same as vf_output_queued_frame(), limited to the filters of the segment.
+ */
+static void run_queued_frames(vf_instance_t *vf)
+{
+    for (;;) {
+        vf_instance_t *cur, *last = NULL;
+        int (*func)(vf_instance_t *);
+        for (cur = vf->next; cur->info != vf->info; cur = cur->next)
+            if (cur->continue_buffered_image)
+                last = cur;
+        if (!last)
+            break;
+        func = last->continue_buffered_image;
+        last->continue_buffered_image = NULL;
+        func(last);
+    }
+}
+
+static void *stage_thread(void *arg)
+{
+    vf_instance_t *vf = arg;
+    struct vf_priv_s *p = vf->priv;
+    pipeline_t *pipe = p->pipe;
+
+    pthread_mutex_lock(&pipe->lock);
+    for (;;) {
+        frame_t *f;
+        while (!p->in.count && !pipe->quit)
+            pthread_cond_wait(&pipe->cond, &pipe->lock);
+        if (pipe->quit)
+            break;
+        f = queue_pop(&p->in);
+        pthread_cond_broadcast(&pipe->cond);
+        pthread_mutex_unlock(&pipe->lock);
+
+        pthread_mutex_lock(&p->run_lock);
+        vf_next_put_image(vf, f->mpi, f->pts, f->endpts);
+        run_queued_frames(vf);
+        pthread_mutex_unlock(&p->run_lock);
+        free_frame(f);
+
+        pthread_mutex_lock(&pipe->lock);
+        pipe->frames--;
+        pthread_cond_broadcast(&pipe->cond);
+    }
+    pthread_mutex_unlock(&pipe->lock);
+    return NULL;
+}
+
+static void stop_pipeline(pipeline_t *pipe)
+{
+    int i;
+
+    pthread_mutex_lock(&pipe->lock);
+    pipe->quit = 1;
+    pthread_cond_broadcast(&pipe->cond);
+    pthread_mutex_unlock(&pipe->lock);
+    for (i = 0; i < pipe->num_stages; i++) {
+        struct vf_priv_s *p = pipe->stages[i]->priv;
+        pthread_join(p->thread, NULL);
+        pthread_mutex_destroy(&p->run_lock);
+        queue_free(&p->in);
+        p->pipe = NULL;
+    }
+    pipe->sink->priv->pipe = NULL;
+    pipe->entry->async_end = NULL;
+    queue_free(&pipe->out);
+    pthread_cond_destroy(&pipe->cond);
+    pthread_mutex_destroy(&pipe->lock);
+    free(pipe->stages);
+    free(pipe);
+}
+
+static int start_pipeline(vf_instance_t *vf)
+{
+    pipeline_t *pipe;
+    vf_instance_t *cur;
+    int n = 0;
+
+    for (cur = vf; cur; cur = cur->next)
+        if (cur->info == vf->info) {
+            if (cur->priv->sink)
+                break;
+            n++;
+        }
+    if (!cur) {
+        mp_msg(MSGT_VFILTER, MSGL_ERR,
+               "[thread] The filter chain has no end for the threads.\n");
+        return 0;
+    }
+    pipe = calloc(1, sizeof(*pipe));
+    if (!pipe)
+        return 0;
+    pipe->stages = calloc(n, sizeof(*pipe->stages));
+    if (!pipe->stages) {
+        free(pipe);
+        return 0;
+    }
+    pthread_mutex_init(&pipe->lock, NULL);
+    pthread_cond_init(&pipe->cond, NULL);
+    pipe->main_thread = pthread_self();
+    queue_init(&pipe->out);
+    pipe->entry = vf;
+    pipe->sink  = cur;
+    pipe->sink->priv->pipe = pipe;
+    vf->async_end = pipe->sink;
+
+    for (cur = vf; cur != pipe->sink; cur = cur->next) {
+        struct vf_priv_s *p = cur->priv;
+        if (cur->info != vf->info)
+            continue;
+        p->pipe = pipe;
+        queue_init(&p->in);
+        pthread_mutex_init(&p->run_lock, NULL);
+        if (pthread_create(&p->thread, NULL, stage_thread, cur)) {
+            mp_msg(MSGT_VFILTER, MSGL_ERR, "[thread] Cannot create thread.\n");
+            pthread_mutex_destroy(&p->run_lock);
+            p->pipe = NULL;
+            stop_pipeline(pipe);
+            return 0;
+        }
+        pipe->stages[pipe->num_stages++] = cur;
+        pipe->window += p->queue;
+    }
+    mp_msg(MSGT_VFILTER, MSGL_V, "[thread] %d filter threads started.\n",
+           pipe->num_stages);
+    return 1;
+}
+
+static int config(struct vf_instance *vf,
+                  int width, int height, int d_width, int d_height,
+                  unsigned int flags, unsigned int outfmt)
+{
+    struct vf_priv_s *p = vf->priv;
+
+    if (!p->pipe && !p->sink && !start_pipeline(vf))
+        return 0;
+    // frames of the old format leave the pipeline before it is reconfigured
+    if (p->pipe && p->pipe->entry == vf)
+        flush_pipeline(p->pipe);
+    return vf_next_config(vf, width, height, d_width, d_height, flags, outfmt);
+}
+
+static int put_image(struct vf_instance *vf, mp_image_t *mpi,
+                     double pts, double endpts)
+{
+    struct vf_priv_s *p = vf->priv;
+    pipeline_t *pipe = p->pipe;
+    frame_t *f;
+    int unpulled, ret;
+
+    if (!pipe)
+        return vf_next_put_image(vf, mpi, pts, endpts);
+    f = hold_frame(mpi, pts, endpts);
+    if (!f) {
+        mp_msg(MSGT_VFILTER, MSGL_ERR, "[thread] Cannot queue frame.\n");
+        return 0;
+    }
+
+    pthread_mutex_lock(&pipe->lock);
+    if (p->sink) {
+        queue_push(&pipe->out, f);
+        pthread_cond_broadcast(&pipe->cond);
+        pthread_mutex_unlock(&pipe->lock);
+        return 1;
+    }
+    while (p->in.count >= p->queue && !pipe->quit)
+        pthread_cond_wait(&pipe->cond, &pipe->lock);
+    if (pipe->quit) {
+        pthread_mutex_unlock(&pipe->lock);
+        free_frame(f);
+        return 0;
+    }
+    queue_push(&p->in, f);
+    pipe->frames++;
+    pthread_cond_broadcast(&pipe->cond);
+    if (vf != pipe->entry) {
+        pthread_mutex_unlock(&pipe->lock);
+        return 1;
+    }
+    // once the pipeline is filled, one frame goes out for each coming in
+    while (!pipe->out.count && pipe->frames > pipe->window && !pipe->quit)
+        pthread_cond_wait(&pipe->cond, &pipe->lock);
+    pthread_mutex_unlock(&pipe->lock);
+
+    /* Without vf_output_queued_frame() being called (mencoder, or mplayer
+     * without -correct-pts) the queued output is left to us, so pass it
+     * on all at once instead of letting it pile up. */
+    unpulled = vf->continue_buffered_image != NULL;
+    vf->continue_buffered_image = NULL;
+    ret = output_frames(vf, unpulled);
+    if (!ret)
+        pipe->owed++;
+    return ret;
+}
+
+static int control(struct vf_instance *vf, int request, void *data)
+{
+    struct vf_priv_s *p = vf->priv;
+    pipeline_t *pipe = p->pipe;
+    int ret;
+
+    if (!pipe)
+        return vf_next_control(vf, request, data);
+    // the output and the filters of other segments belong to the main thread
+    if (!pthread_equal(pthread_self(), pipe->main_thread))
+        return CONTROL_UNKNOWN;
+
+    switch (request) {
+    case VFCTRL_DRAW_OSD:
+    case VFCTRL_DRAW_EOSD:
+    case VFCTRL_FLIP_PAGE:
+    case VFCTRL_GET_PTS:
+    case VFCTRL_GET_ENDPTS:
+        // about the frame last output, not those still being filtered
+        return vf_next_control(pipe->sink, request, data);
+    case VFCTRL_DRAIN_FRAMES:
+        wait_idle(pipe);
+        if (!have_output(pipe))
+            return CONTROL_FALSE;
+        vf_queue_frame(pipe->entry, continue_output);
+        return CONTROL_TRUE;
+    case VFCTRL_RESET:
+        wait_idle(pipe);
+        pthread_mutex_lock(&pipe->lock);
+        queue_free(&pipe->out);
+        pthread_mutex_unlock(&pipe->lock);
+        pipe->entry->continue_buffered_image = NULL;
+        break;
+    case VFCTRL_DUPLICATE_FRAME:
+        /* mencoder fills in for a frame that did not come out, while it
+         * is only late and will still be encoded */
+        if (vf == pipe->entry && pipe->owed > 0) {
+            pipe->owed--;
+            return CONTROL_TRUE;
+        }
+        break;
+    case VFCTRL_FLUSH_FRAMES:
+        flush_pipeline(pipe);
+        break;
+    }
+    if (p->sink)
+        return vf_next_control(vf, request, data);
+    pthread_mutex_lock(&p->run_lock);
+    ret = vf_next_control(vf, request, data);
+    pthread_mutex_unlock(&p->run_lock);
+    return ret;
+}
+
+#endif /* HAVE_PTHREADS */
+
+static int query_format(struct vf_instance *vf, unsigned int fmt)
+{
+    // the frames must be copied
+    if (fmt == IMGFMT_MPEGPES || IMGFMT_IS_HWACCEL(fmt))
+        return 0;
+    return vf_next_query_format(vf, fmt);
+}
+
+static void uninit(struct vf_instance *vf)
+{
+#if HAVE_PTHREADS
+    if (vf->priv->pipe && vf->priv->pipe->entry == vf)
+        stop_pipeline(vf->priv->pipe);
+#endif
+    free(vf->priv);
+}
+
+static int vf_open(vf_instance_t *vf, char *args)
+{
+    vf->query_format = query_format;
+    vf->uninit = uninit;
+#if HAVE_PTHREADS
+    vf->config = config;
+    vf->put_image = put_image;
+    vf->control = control;
+#else
+    mp_msg(MSGT_VFILTER, MSGL_WARN,
+           "[thread] Compiled without thread support, filtering on the main thread.\n");
+#endif
+    return 1;
+}
+
+#define ST_OFF(f) M_ST_OFF(struct vf_priv_s, f)
+static const m_option_t vf_opts_fields[] = {
+    {"queue", ST_OFF(queue), CONF_TYPE_INT, M_OPT_RANGE, 1, 64, NULL},
+    { NULL, NULL, 0, 0, 0, 0, NULL }
+};
+
+static const m_struct_t vf_opts = {
+    "thread",
+    sizeof(struct vf_priv_s),
+    &vf_priv_dflt,
+    vf_opts_fields
+};
+
+const vf_info_t vf_info_thread = {
+    "run the following filters on a thread of their own",
+    "thread",
+    "",
+    "",
+    vf_open,
+    &vf_opts
+};
+
+/**
+ * \brief open the instance taking the frames of the threads back
+ * \param next filter the frames go to on the main thread
+ */
+vf_instance_t *vf_open_thread_sink(vf_instance_t *next)
+{
+    static const vf_info_t *const list[] = { &vf_info_thread, NULL };
+    vf_instance_t *vf = vf_open_plugin(list, next, "thread", NULL);
+    if (vf)
+        vf->priv->sink = 1;
+    return vf;
+}
@@ -35,6 +35,7 @@
 #include "img_format.h"
 #include "mp_image.h"
 #include "vf.h"
+#include "slice_threads.h"
 #include "libvo/fastmemcpy.h"
 #include "libavutil/common.h"
 
@@ -46,13 +47,14 @@
 typedef struct FilterParam {
     int msizeX, msizeY;
     double amount;
-    uint32_t *SC[MAX_MATRIX_SIZE-1];
+    uint32_t *SC[SLICE_MAX_THREADS][MAX_MATRIX_SIZE-1]; // one set per slice
 } FilterParam;
 
 struct vf_priv_s {
     FilterParam lumaParam;
     FilterParam chromaParam;
     unsigned int outfmt;
+    int threads;
 };
 
 
@@ -68,9 +70,12 @@ Originally published Boston, Nov 98
 
 */
 
-static void unsharp( uint8_t *dst, uint8_t *src, int dstStride, int srcStride, int width, int height, FilterParam *fp ) {
+/* Only lines y0 to y1 - 1 are output.  The filter state is rebuilt from
+   the stepsY lines above, so that a slice gives the same result as the
+   whole plane; it must not be done in place with other slices though. */
+
+static void unsharp( uint8_t *dst, uint8_t *src, int dstStride, int srcStride, int width, int height, int y0, int y1, FilterParam *fp, uint32_t **SC ) {
 
-    uint32_t **SC = fp->SC;
     uint32_t SR[MAX_MATRIX_SIZE-1], Tmp1, Tmp2;
     uint8_t* src2 = src; // avoid gcc warning
 
@@ -85,10 +90,12 @@ static void unsharp( uint8_t *dst, uint8_t *src, int dstStride, int srcStride, i
     if( !fp->amount ) {
         if( src == dst )
             return;
+        dst += y0*dstStride;
+        src += y0*srcStride;
         if( dstStride == srcStride )
-            fast_memcpy( dst, src, srcStride*height );
+            fast_memcpy( dst, src, srcStride*(y1-y0) );
         else
-            for( y=0; y<height; y++, dst+=dstStride, src+=srcStride )
+            for( y=y0; y<y1; y++, dst+=dstStride, src+=srcStride )
                 fast_memcpy( dst, src, width );
         return;
     }
@@ -96,7 +103,9 @@ static void unsharp( uint8_t *dst, uint8_t *src, int dstStride, int srcStride, i
     for( y=0; y<2*stepsY; y++ )
         memset( SC[y], 0, sizeof(SC[y][0]) * (width+2*stepsX) );
 
-    for( y=-stepsY; y<height+stepsY; y++ ) {
+    src += FFMAX(y0-stepsY, 0)*srcStride;
+    dst += FFMAX(y0-stepsY, 0)*dstStride;
+    for( y=y0-stepsY; y<y1+stepsY; y++ ) {
         if( y < height ) src2 = src;
         memset( SR, 0, sizeof(SR[0]) * (2*stepsX-1) );
         for( x=-stepsX; x<width+stepsX; x++ ) {
@@ -109,7 +118,7 @@ static void unsharp( uint8_t *dst, uint8_t *src, int dstStride, int srcStride, i
                 Tmp2 = SC[z+0][x+stepsX] + Tmp1; SC[z+0][x+stepsX] = Tmp1;
                 Tmp1 = SC[z+1][x+stepsX] + Tmp2; SC[z+1][x+stepsX] = Tmp2;
             }
-            if( x>=stepsX && y>=stepsY ) {
+            if( x>=stepsX && y>=y0+stepsY ) {
                 uint8_t* srx = src - stepsY*srcStride + x - stepsX;
                 uint8_t* dsx = dst - stepsY*dstStride + x - stepsX;
 
@@ -130,7 +139,7 @@ static int config( struct vf_instance *vf,
                    int width, int height, int d_width, int d_height,
                    unsigned int flags, unsigned int outfmt ) {
 
-    int z, stepsX, stepsY;
+    int i, z, stepsX, stepsY;
     FilterParam *fp;
     const char *effect;
 
@@ -142,8 +151,9 @@ static int config( struct vf_instance *vf,
     memset( fp->SC, 0, sizeof( fp->SC ) );
     stepsX = fp->msizeX/2;
     stepsY = fp->msizeY/2;
-    for( z=0; z<2*stepsY; z++ )
-        fp->SC[z] = av_malloc(sizeof(*(fp->SC[z])) * (width+2*stepsX));
+    for( i=0; i<vf->priv->threads; i++ )
+        for( z=0; z<2*stepsY; z++ )
+            fp->SC[i][z] = av_malloc(sizeof(*(fp->SC[i][z])) * (width+2*stepsX));
 
     fp = &vf->priv->chromaParam;
     effect = fp->amount == 0 ? "don't touch" : fp->amount < 0 ? "blur" : "sharpen";
@@ -151,8 +161,9 @@ static int config( struct vf_instance *vf,
     memset( fp->SC, 0, sizeof( fp->SC ) );
     stepsX = fp->msizeX/2;
     stepsY = fp->msizeY/2;
-    for( z=0; z<2*stepsY; z++ )
-        fp->SC[z] = av_malloc(sizeof(*(fp->SC[z])) * (width+2*stepsX));
+    for( i=0; i<vf->priv->threads; i++ )
+        for( z=0; z<2*stepsY; z++ )
+            fp->SC[i][z] = av_malloc(sizeof(*(fp->SC[i][z])) * (width+2*stepsX));
 
     return vf_next_config( vf, width, height, d_width, d_height, flags, outfmt );
 }
@@ -164,6 +175,8 @@ static void get_image( struct vf_instance *vf, mp_image_t *mpi ) {
         return; // don't change
     if( mpi->imgfmt!=vf->priv->outfmt )
         return; // colorspace differ
+    if( vf->priv->threads > 1 )
+        return; // slices would overwrite lines other slices still read
 
     mpi->priv =
     vf->dmpi = vf_get_image( vf->next, mpi->imgfmt, mpi->type, mpi->flags, mpi->width, mpi->height );
@@ -179,19 +192,21 @@ static void get_image( struct vf_instance *vf, mp_image_t *mpi ) {
     mpi->flags |= MP_IMGFLAG_DIRECT;
 }
 
-static int put_image( struct vf_instance *vf, mp_image_t *mpi, double pts, double endpts) {
-    mp_image_t *dmpi = mpi->priv;
-    mpi->priv = NULL;
-
-    if( !(mpi->flags & MP_IMGFLAG_DIRECT) )
-        // no DR, so get a new image! hope we'll get DR buffer:
-        dmpi = vf->dmpi = vf_get_image( vf->next,vf->priv->outfmt, MP_IMGTYPE_TEMP, MP_IMGFLAG_ACCEPT_STRIDE, mpi->width, mpi->height);
+struct slice_args {
+    struct vf_priv_s *priv;
+    mp_image_t *dmpi, *mpi;
+};
 
-    unsharp( dmpi->planes[0], mpi->planes[0], dmpi->stride[0], mpi->stride[0], mpi->w,   mpi->h,   &vf->priv->lumaParam );
-    unsharp( dmpi->planes[1], mpi->planes[1], dmpi->stride[1], mpi->stride[1], mpi->w/2, mpi->h/2, &vf->priv->chromaParam );
-    unsharp( dmpi->planes[2], mpi->planes[2], dmpi->stride[2], mpi->stride[2], mpi->w/2, mpi->h/2, &vf->priv->chromaParam );
+static void unsharp_slice( slice_batch_t *batch, void *ctx, int job ) {
+    struct slice_args *a = ctx;
+    struct vf_priv_s *priv = a->priv;
+    mp_image_t *dmpi = a->dmpi, *mpi = a->mpi;
+    int n = priv->threads;
+    int h = mpi->h, ch = mpi->h/2;
 
-    vf_clone_mpi_attributes(dmpi, mpi);
+    unsharp( dmpi->planes[0], mpi->planes[0], dmpi->stride[0], mpi->stride[0], mpi->w,   h,  h*job/n,  h*(job+1)/n,  &priv->lumaParam,   priv->lumaParam.SC[job] );
+    unsharp( dmpi->planes[1], mpi->planes[1], dmpi->stride[1], mpi->stride[1], mpi->w/2, ch, ch*job/n, ch*(job+1)/n, &priv->chromaParam, priv->chromaParam.SC[job] );
+    unsharp( dmpi->planes[2], mpi->planes[2], dmpi->stride[2], mpi->stride[2], mpi->w/2, ch, ch*job/n, ch*(job+1)/n, &priv->chromaParam, priv->chromaParam.SC[job] );
 
 #if HAVE_MMX_INLINE
     if(gCpuCaps.hasMMX)
@@ -201,26 +216,46 @@ static int put_image( struct vf_instance *vf, mp_image_t *mpi, double pts, doubl
     if(gCpuCaps.hasMMX2)
         __asm__ volatile ("sfence\n\t");
 #endif
+}
+
+static int put_image( struct vf_instance *vf, mp_image_t *mpi, double pts, double endpts) {
+    mp_image_t *dmpi = mpi->priv;
+    struct slice_args a = { vf->priv };
+    mpi->priv = NULL;
+
+    if( !(mpi->flags & MP_IMGFLAG_DIRECT) )
+        // no DR, so get a new image! hope we'll get DR buffer:
+        dmpi = vf->dmpi = vf_get_image( vf->next,vf->priv->outfmt, MP_IMGTYPE_TEMP, MP_IMGFLAG_ACCEPT_STRIDE, mpi->width, mpi->height);
+
+    a.dmpi = dmpi;
+    a.mpi = mpi;
+    slice_threads_run( vf->priv->threads, unsharp_slice, &a );
+
+    vf_clone_mpi_attributes(dmpi, mpi);
 
     return vf_next_put_image(vf, dmpi, pts, endpts);
 }
 
 static void uninit( struct vf_instance *vf ) {
-    unsigned int z;
+    unsigned int i, z;
     FilterParam *fp;
 
     if( !vf->priv ) return;
 
     fp = &vf->priv->lumaParam;
-    for( z=0; z<sizeof(fp->SC)/sizeof(fp->SC[0]); z++ ) {
-        av_free( fp->SC[z] );
-        fp->SC[z] = NULL;
-    }
+    for( i=0; i<SLICE_MAX_THREADS; i++ )
+        for( z=0; z<MAX_MATRIX_SIZE-1; z++ ) {
+            av_free( fp->SC[i][z] );
+            fp->SC[i][z] = NULL;
+        }
     fp = &vf->priv->chromaParam;
-    for( z=0; z<sizeof(fp->SC)/sizeof(fp->SC[0]); z++ ) {
-        av_free( fp->SC[z] );
-        fp->SC[z] = NULL;
-    }
+    for( i=0; i<SLICE_MAX_THREADS; i++ )
+        for( z=0; z<MAX_MATRIX_SIZE-1; z++ ) {
+            av_free( fp->SC[i][z] );
+            fp->SC[i][z] = NULL;
+        }
+    if( vf->priv->threads )
+        slice_threads_uninit();
 
     free( vf->priv );
     vf->priv = NULL;
@@ -310,6 +345,9 @@ static int vf_open( vf_instance_t *vf, char *args ) {
         return 0; // no csp match :(
     }
 
+    vf->priv->threads = slice_threads_parse( args );
+    slice_threads_init( vf->priv->threads );
+
     return 1;
 }
 
@@ -31,6 +31,7 @@
 #include "img_format.h"
 #include "mp_image.h"
 #include "vf.h"
+#include "slice_threads.h"
 #include "libmpdemux/demuxer.h"
 #include "libvo/fastmemcpy.h"
 #include "libavutil/common.h"
@@ -48,6 +49,7 @@ struct vf_priv_s {
     int stride[3];
     uint8_t *ref[4][3];
     int do_deinterlace;
+    int threads;
 };
 
 static void (*filter_line)(struct vf_priv_s *p, uint8_t *dst, uint8_t *prev, uint8_t *cur, uint8_t *next, int w, int refs, int parity);
@@ -351,24 +353,35 @@ static void filter_line_c(struct vf_priv_s *p, uint8_t *dst, uint8_t *prev, uint
     }
 }
 
-static void filter(struct vf_priv_s *p, uint8_t *dst[3], int dst_stride[3], int width, int height, int parity, int tff){
+struct filter_args {
+    struct vf_priv_s *p;
+    uint8_t **dst;
+    int *dst_stride;
+    int width, height, parity, tff;
+};
+
+static void filter_slice(slice_batch_t *batch, void *ctx, int job){
+    struct filter_args *a= ctx;
+    struct vf_priv_s *p= a->p;
     int y, i;
 
     for(i=0; i<3; i++){
         int is_chroma= !!i;
-        int w= width >>is_chroma;
-        int h= height>>is_chroma;
+        int w= a->width >>is_chroma;
+        int h= a->height>>is_chroma;
         int refs= p->stride[i];
+        int y0= h* job   /p->threads;
+        int y1= h*(job+1)/p->threads;
 
-        for(y=0; y<h; y++){
-            if((y ^ parity) & 1){
+        for(y=y0; y<y1; y++){
+            if((y ^ a->parity) & 1){
                 uint8_t *prev= &p->ref[0][i][y*refs];
                 uint8_t *cur = &p->ref[1][i][y*refs];
                 uint8_t *next= &p->ref[2][i][y*refs];
-                uint8_t *dst2= &dst[i][y*dst_stride[i]];
-                filter_line(p, dst2, prev, cur, next, w, refs, parity ^ tff);
+                uint8_t *dst2= &a->dst[i][y*a->dst_stride[i]];
+                filter_line(p, dst2, prev, cur, next, w, refs, a->parity ^ a->tff);
             }else{
-                fast_memcpy(&dst[i][y*dst_stride[i]], &p->ref[1][i][y*refs], w);
+                fast_memcpy(&a->dst[i][y*a->dst_stride[i]], &p->ref[1][i][y*refs], w);
             }
         }
     }
@@ -377,6 +390,13 @@ static void filter(struct vf_priv_s *p, uint8_t *dst[3], int dst_stride[3], int
 #endif
 }
 
+// the lines only depend on the stored references, so slices are independent
+static void filter(struct vf_priv_s *p, uint8_t *dst[3], int dst_stride[3], int width, int height, int parity, int tff){
+    struct filter_args a= { p, dst, dst_stride, width, height, parity, tff };
+
+    slice_threads_run(p->threads, filter_slice, &a);
+}
+
 static int config(struct vf_instance *vf,
         int width, int height, int d_width, int d_height,
 	unsigned int flags, unsigned int outfmt){
@@ -388,8 +408,10 @@ static int config(struct vf_instance *vf,
             int h=(((height  +  1) & ( ~1))>>is_chroma) + 6;
 
             vf->priv->stride[i]= w;
+            // filter_line() reads a few pixels past the width, keep them
+            // the same whichever thread or allocation the buffer comes from
             for(j=0; j<3; j++)
-                vf->priv->ref[j][i]= (uint8_t *)malloc(w*h*sizeof(uint8_t))+3*w;
+                vf->priv->ref[j][i]= (uint8_t *)calloc(w*h, sizeof(uint8_t))+3*w;
         }
 
 	return vf_next_config(vf,width,height,d_width,d_height,flags,outfmt);
@@ -463,6 +485,7 @@ static void uninit(struct vf_instance *vf){
         if(*p) free(*p - 3*vf->priv->stride[i/3]);
         *p= NULL;
     }
+    slice_threads_uninit();
     free(vf->priv);
     vf->priv=NULL;
 }
@@ -507,6 +530,8 @@ static int vf_open(vf_instance_t *vf, char *args){
     vf->priv->do_deinterlace=1;
 
     if (args) sscanf(args, "%d:%d", &vf->priv->mode, &vf->priv->parity);
+    vf->priv->threads= slice_threads_parse(args);
+    slice_threads_init(vf->priv->threads);
 
     filter_line = filter_line_c;
 #if HAVE_MMX_INLINE
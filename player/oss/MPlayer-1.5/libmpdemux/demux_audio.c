@@ -22,6 +22,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <inttypes.h>
 #include "stream/stream.h"
 #include "aviprint.h"
 #include "demuxer.h"
@@ -29,8 +30,11 @@
 #include "genres.h"
 #include "mp3_hdr.h"
 #include "demux_audio.h"
+#include "demux_index.h"
 
+#include "libavutil/common.h"
 #include "libavutil/intreadwrite.h"
+#include "libavutil/thread.h"
 
 #include <string.h>
 
@@ -41,10 +45,43 @@
 
 #define HDR_SIZE 4
 
+//! keep the position of every this many MP3 frames
+#define MP3_INDEX_STEP 16
+#define MP3_INDEX_MAGIC "MPMP3IX1"
+//! most frames decoded ahead of the target of an exact seek
+#define MP3_PREROLL_MAX 8
+//! how far layer 3 main data may reach back into previous frames
+#define MP3_RESERVOIR 511
+
+/**
+ * Positions of the MP3 frames from the start of the file on, as far as they
+ * were walked by playback, exact seeks or the background scan; with
+ * -mp3index 2 they are kept across sessions in <file>.mp3idx.
+ */
+typedef struct mp3_index {
+  AVMutex lock;   // taken by playback and the background scan
+  off_t *pos;     // pos[i] is the start of frame i * MP3_INDEX_STEP
+  int count, alloc;
+  int64_t frames; // number of frames known
+  off_t end;      // where frame number frames starts
+  int dirty;      // grown since loaded
+  char *path;     // of the file, NULL if it is not one
+  demux_index_scan_t scan;
+  off_t scan_end;
+} mp3_index_t;
+
 typedef struct da_priv {
   int frmt;
   double next_pts;
   int r_gain;
+  // MP3 only
+  int64_t frame;  // number of the next frame read, -1 if unknown
+  int preroll;    // frames left to be only decoded after an exact seek
+  unsigned int xing_frames;
+  unsigned int xing_bytes;
+  int has_toc;
+  uint8_t toc[100];
+  mp3_index_t index;
 } da_priv_t;
 
 //! rather arbitrary value for maximum length of wav-format headers
@@ -67,6 +104,7 @@ typedef struct mp3_hdr {
 } mp3_hdr_t;
 
 int hr_mp3_seek = 0;
+int mp3_index_mode = 1;
 
 /**
  * \brief free a list of MP3 header descriptions
@@ -314,12 +352,21 @@ static unsigned int mp3_vbr_frames(stream_t *s, off_t off, da_priv_t *priv) {
     data = stream_read_dword(s);
 
     if (data == MKBETAG('X','i','n','g') || data == MKBETAG('I','n','f','o')) {
-      data = stream_read_dword(s);
+      int vbr = data == MKBETAG('X','i','n','g'); // 'Info' is used for CBR
+      unsigned int flags = stream_read_dword(s);
+      off_t lame_pos;
 
-      if (data & 0x1)                   // frames field is present
+      data = flags;
+      if (flags & 0x1)                  // frames field is present
         data = stream_read_dword(s);    // frames
+      lame_pos = stream_tell(s) + 123;
+
+      if (flags & 0x2)                  // bytes field is present
+        priv->xing_bytes = stream_read_dword(s);
+      if ((flags & 0x5) == 0x5 && data) // table of contents for seeking
+        priv->has_toc = stream_read(s, priv->toc, 100) == 100 && vbr;
 
-      if (stream_skip(s, 123)) {
+      if (stream_seek(s, lame_pos)) {
         uint16_t word = stream_read_word(s);
 
         /* Radio ReplayGain */
@@ -381,6 +428,293 @@ static unsigned int id3v2_tag_size(uint8_t maj_ver, stream_t *s) {
   return header_footer_size + size;
 }
 
+/**
+ * \brief extend the MP3 frame index by a frame
+ * Only the first frame not yet known is added, so that playback, exact seeks
+ * and the background scan can all feed it in any order.
+ * \param frame number of the frame, counted from the start of the file
+ * \param pos stream position of its header
+ * \param len its length
+ */
+static void mp3_index_add(mp3_index_t *idx, int64_t frame, off_t pos, int len) {
+  ff_mutex_lock(&idx->lock);
+  if (frame != idx->frames)
+    goto out;
+  if (!(frame % MP3_INDEX_STEP)) {
+    if (idx->count == idx->alloc) {
+      int alloc = FFMAX(2 * idx->alloc, 1024);
+      off_t *p = realloc(idx->pos, alloc * sizeof(*p));
+      if (!p)
+        goto out;
+      idx->pos = p;
+      idx->alloc = alloc;
+    }
+    idx->pos[idx->count++] = pos;
+  }
+  idx->frames++;
+  idx->end = pos + len;
+  idx->dirty = 1;
+out:
+  ff_mutex_unlock(&idx->lock);
+}
+
+#if HAVE_THREADS
+/**
+ * \brief background walk over the MP3 frames of the whole file, reading it
+ * through its own file handle
+ * Frames are found the same way demux_audio_fill_buffer() does, so the
+ * positions agree with those of playback.
+ */
+static void *mp3_index_scan(void *arg) {
+  mp3_index_t *idx = arg;
+  uint8_t *buf = malloc(DEMUX_INDEX_SCAN_CHUNK);
+  FILE *f = fopen(idx->path, "rb");
+  int64_t frame = 0;
+  off_t pos = 0;
+
+  if (!f || !buf)
+    goto end;
+
+  while (!idx->scan.stop) {
+    int i = 0, got;
+    // continue from wherever playback or a seek got further
+    ff_mutex_lock(&idx->lock);
+    if (idx->frames >= frame) {
+      frame = idx->frames;
+      pos = idx->end;
+    }
+    ff_mutex_unlock(&idx->lock);
+    if (pos >= idx->scan_end || fseeko(f, pos, SEEK_SET))
+      break;
+    got = fread(buf, 1, DEMUX_INDEX_SCAN_CHUNK, f);
+    while (i + 4 <= got && pos + i < idx->scan_end) {
+      int len = mp_decode_mp3_header(buf + i);
+      if (len < 0) {
+        i++;
+        continue;
+      }
+      if (i + len > got)
+        break;
+      mp3_index_add(idx, frame++, pos + i, len);
+      i += len;
+    }
+    pos += i;
+    if (got < DEMUX_INDEX_SCAN_CHUNK)
+      break;
+    demux_index_scan_pause(&idx->scan, pos);
+  }
+  mp_msg(MSGT_DEMUX, MSGL_V, "demux_audio: MP3 index scan %s with %"PRId64" frames\n",
+         idx->scan.stop ? "stopped" : "finished", frame);
+
+end:
+  if (f)
+    fclose(f);
+  free(buf);
+  return NULL;
+}
+#endif
+
+static int mp3_index_is_entry(stream_t *s) {
+  uint8_t hdr[4];
+  return stream_read(s, hdr, 4) == 4 && mp_decode_mp3_header(hdr) > 0;
+}
+
+static void mp3_index_load(demuxer_t *demuxer) {
+  da_priv_t *priv = demuxer->priv;
+  mp3_index_t *idx = &priv->index;
+  uint8_t buf[20];
+  FILE *f;
+  uint64_t size;
+  int64_t frames;
+  off_t end, *pos = NULL, last = demuxer->movi_start - 1;
+  int count, i, ok = 1;
+
+  f = demux_index_open_read(demuxer, idx->path, ".mp3idx", MP3_INDEX_MAGIC, &size);
+  if (!f)
+    return;
+  if (fread(buf, 1, 20, f) != 20)
+    goto fail;
+  frames = AV_RL64(buf);
+  end = AV_RL64(buf + 8);
+  count = AV_RL32(buf + 16);
+  if (frames <= 0 || frames > (int64_t)(INT_MAX / sizeof(*pos)) * MP3_INDEX_STEP ||
+      count != (frames + MP3_INDEX_STEP - 1) / MP3_INDEX_STEP)
+    goto fail;
+  pos = malloc(count * sizeof(*pos));
+  if (!pos)
+    goto fail;
+  for (i = 0; i < count && ok; i++) {
+    if (fread(buf, 1, 8, f) != 8)
+      goto fail;
+    pos[i] = AV_RL64(buf);
+    ok = pos[i] > last && pos[i] < end;
+    last = pos[i];
+  }
+  fclose(f);
+
+  ok = ok && end <= size &&
+       demux_index_check(demuxer->stream, pos, count, sizeof(*pos), mp3_index_is_entry);
+  demux_index_loaded(idx->path, ".mp3idx", ok);
+  if (!ok) {
+    free(pos);
+    return;
+  }
+  idx->pos = pos;
+  idx->count = idx->alloc = count;
+  idx->frames = frames;
+  idx->end = end;
+  return;
+
+fail:
+  fclose(f);
+  free(pos);
+}
+
+static void mp3_index_save(demuxer_t *demuxer) {
+  da_priv_t *priv = demuxer->priv;
+  mp3_index_t *idx = &priv->index;
+  uint8_t buf[20];
+  FILE *f;
+  int i, ok;
+
+  if (!idx->dirty)
+    return;
+  f = demux_index_open_write(demuxer, idx->path, ".mp3idx", MP3_INDEX_MAGIC);
+  if (!f)
+    return;
+  AV_WL64(buf, idx->frames);
+  AV_WL64(buf + 8, idx->end);
+  AV_WL32(buf + 16, idx->count);
+  ok = fwrite(buf, 1, 20, f) == 20;
+  for (i = 0; i < idx->count && ok; i++) {
+    AV_WL64(buf, idx->pos[i]);
+    ok &= fwrite(buf, 1, 8, f) == 8;
+  }
+  demux_index_close_write(f, ok, idx->path, ".mp3idx");
+}
+
+static void mp3_index_init(demuxer_t *demuxer) {
+  da_priv_t *priv = demuxer->priv;
+  mp3_index_t *idx = &priv->index;
+  stream_t *s = demuxer->stream;
+  off_t start = stream_tell(s);
+
+  ff_mutex_init(&idx->lock, NULL);
+  idx->end = demuxer->movi_start;
+  // frame numbers are only known when reading from the first one on
+  priv->frame = start == demuxer->movi_start ? 0 : -1;
+  if (!mp3_index_mode || !(idx->path = demux_index_path(demuxer)))
+    return;
+  if (mp3_index_mode >= DEMUX_INDEX_SIDECAR) {
+    mp3_index_load(demuxer);
+    stream_seek(s, start);
+  }
+#if HAVE_THREADS
+  idx->scan_end = demuxer->movi_end ? demuxer->movi_end : INT64_MAX;
+  demux_index_scan_start(&idx->scan, mp3_index_scan, idx, idx->end);
+#endif
+}
+
+static void mp3_index_uninit(demuxer_t *demuxer) {
+  da_priv_t *priv = demuxer->priv;
+  mp3_index_t *idx = &priv->index;
+
+  demux_index_scan_stop(&idx->scan);
+  if (idx->path && mp3_index_mode >= DEMUX_INDEX_SIDECAR)
+    mp3_index_save(demuxer);
+  free(idx->pos);
+  free(idx->path);
+  ff_mutex_destroy(&idx->lock);
+}
+
+/**
+ * \brief seek exactly to the start of an MP3 frame
+ * Walks from the closest indexed frame before the target, or from the end of
+ * the index if the target is beyond it, extending the index on the way.
+ * Layer 3 frames can take part of their data from the frames before them
+ * (bit reservoir), so reading resumes a few frames early, and those frames
+ * are marked to be decoded but not played.
+ * \param frame number of the target frame, counted from the start of the file
+ */
+static void mp3_index_seek(demuxer_t *demuxer, int64_t frame) {
+  static const int side_info[2][2] = {{32, 17}, {17, 9}};
+  da_priv_t *priv = demuxer->priv;
+  sh_audio_t *sh = demuxer->audio->sh;
+  mp3_index_t *idx = &priv->index;
+  stream_t *s = demuxer->stream;
+  // the frames up to the target, by frame number modulo the size
+  off_t ring_pos[MP3_PREROLL_MAX + 1];
+  int ring_data[MP3_PREROLL_MAX + 1];
+  int64_t f, first = FFMAX(frame - MP3_PREROLL_MAX, 0), start;
+  off_t pos;
+  int n = 0, data = 0, layer = 0;
+
+  ff_mutex_lock(&idx->lock);
+  if (first < idx->frames) {
+    f = first / MP3_INDEX_STEP * MP3_INDEX_STEP;
+    pos = idx->pos[f / MP3_INDEX_STEP];
+  } else {
+    f = idx->frames;
+    pos = idx->end;
+  }
+  ff_mutex_unlock(&idx->lock);
+  start = f;
+
+  stream_seek(s, pos);
+  while (f <= frame) {
+    uint8_t hdr[4];
+    int len, chans, spf;
+    pos = stream_tell(s);
+    stream_read(s, hdr, 4);
+    if (s->eof)
+      break;
+    len = mp_get_mp3_header(hdr, &chans, NULL, &spf, &layer, NULL);
+    if (len < 0) {
+      if (demuxer->movi_end && stream_tell(s) >= demuxer->movi_end)
+        break;
+      stream_skip(s, -3);
+      continue;
+    }
+    ring_pos[f % (MP3_PREROLL_MAX + 1)] = pos;
+    ring_data[f % (MP3_PREROLL_MAX + 1)] = len - 4 - side_info[spf < 1152][chans == 1] -
+                                          (hdr[1] & 1 ? 0 : 2);
+    mp3_index_add(idx, f, pos, len);
+    if (f++ < frame)
+      stream_skip(s, len - 4);
+  }
+
+  if (f > frame) {
+    // the frame before the target has to be decoded right as well, as its
+    // output overlaps that of the target, so its main data is needed too
+    if (layer == 3)
+      while (n < MP3_PREROLL_MAX && frame - n > start && (n < 1 || data < MP3_RESERVOIR))
+        if (++n > 1)
+          data += ring_data[(frame - n) % (MP3_PREROLL_MAX + 1)];
+    stream_seek(s, ring_pos[(frame - n) % (MP3_PREROLL_MAX + 1)]);
+    f = frame - n;
+  }
+  priv->frame = f;
+  priv->preroll = n;
+  priv->next_pts = f * sh->audio.dwScale / (double)sh->samplerate;
+}
+
+/**
+ * \brief estimate the position of a time in an MP3 file from the table of
+ * contents of its Xing header
+ */
+static off_t mp3_toc_pos(demuxer_t *demuxer, double time) {
+  da_priv_t *priv = demuxer->priv;
+  sh_audio_t *sh = demuxer->audio->sh;
+  double duration = (double)priv->xing_frames * sh->audio.dwScale / sh->samplerate;
+  double bytes = priv->xing_bytes ? priv->xing_bytes : demuxer->movi_end - demuxer->movi_start;
+  double percent = av_clipd(time / duration * 100, 0, 100);
+  int a = FFMIN(percent, 99);
+  // the entries are rounded down to 1/256 of the size, take the middle
+  double fa = a ? priv->toc[a] + 0.5 : 0, fb = a < 99 ? priv->toc[a + 1] + 0.5 : 256;
+
+  return demuxer->movi_start + (fa + (fb - fa) * (percent - a)) * bytes / 256;
+}
+
 static int demux_audio_open(demuxer_t* demuxer) {
   stream_t *s;
   sh_audio_t* sh_audio;
@@ -450,7 +784,7 @@ static int demux_audio_open(demuxer_t* demuxer) {
 
   sh_audio = new_sh_audio(demuxer,0, NULL);
 
-  priv = malloc(sizeof(da_priv_t));
+  priv = calloc(1, sizeof(da_priv_t));
   priv->r_gain = INT32_MIN;
 
   switch(frmt) {
@@ -470,7 +804,8 @@ static int demux_audio_open(demuxer_t* demuxer) {
     sh_audio->wf->nBlockAlign = mp3_found->mpa_spf;
     sh_audio->wf->wBitsPerSample = 16;
     sh_audio->wf->cbSize = 0;
-    duration = (double) mp3_vbr_frames(s, demuxer->movi_start, priv) * mp3_found->mpa_spf / mp3_found->mp3_freq;
+    priv->xing_frames = mp3_vbr_frames(s, demuxer->movi_start, priv);
+    duration = (double) priv->xing_frames * mp3_found->mpa_spf / mp3_found->mp3_freq;
     free(mp3_found);
     mp3_found = NULL;
     if(demuxer->movi_end && (s->flags & MP_STREAM_SEEK) == MP_STREAM_SEEK) {
@@ -685,6 +1020,9 @@ static int demux_audio_open(demuxer_t* demuxer) {
     }
   }
 
+  if (frmt == MP3)
+    mp3_index_init(demuxer);
+
   mp_msg(MSGT_DEMUX,MSGL_V,"demux_audio: audio data 0x%X - 0x%X  \n",(int)demuxer->movi_start,(int)demuxer->movi_end);
 
   return DEMUXER_TYPE_AUDIO;
@@ -706,6 +1044,7 @@ static int demux_audio_fill_buffer(demuxer_t *demux, demux_stream_t *ds) {
   case MP3 :
     while(1) {
       uint8_t hdr[4];
+      off_t pos = stream_tell(s);
       stream_read(s,hdr,4);
       if (s->eof)
         return 0;
@@ -723,6 +1062,15 @@ static int demux_audio_fill_buffer(demuxer_t *demux, demux_stream_t *ds) {
 	  return 0;
 	}
 	priv->next_pts += sh_audio->audio.dwScale/(double)sh_audio->samplerate;
+	if (priv->frame >= 0) {
+	  if (mp3_index_mode)
+	    mp3_index_add(&priv->index, priv->frame, pos, l);
+	  priv->frame++;
+	}
+	if (priv->preroll > 0) {
+	  dp->flags |= DP_PREROLL;
+	  priv->preroll--;
+	}
 	break;
       }
     } break;
@@ -791,8 +1139,30 @@ static void demux_audio_seek(demuxer_t *demuxer,float rel_seek_secs,float audio_
     return;
   s = demuxer->stream;
   priv = demuxer->priv;
-
-  if(priv->frmt == MP3 && hr_mp3_seek && !(flags & SEEK_FACTOR)) {
+  priv->frame = -1;
+  priv->preroll = 0;
+
+  if(priv->frmt == MP3 && mp3_index_mode && !(flags & SEEK_FACTOR)) {
+    double time = (flags & SEEK_ABSOLUTE) ? rel_seek_secs : priv->next_pts + rel_seek_secs;
+    int64_t frame = FFMAX(time, 0) * sh_audio->samplerate / sh_audio->audio.dwScale;
+    int known;
+    ff_mutex_lock(&priv->index.lock);
+    known = frame < priv->index.frames;
+    ff_mutex_unlock(&priv->index.lock);
+    // exact whenever it is cheap
+    if(hr_mp3_seek || known) {
+      mp3_index_seek(demuxer, frame);
+      return;
+    }
+    if(priv->has_toc) {
+      pos = mp3_toc_pos(demuxer, time);
+      if(demuxer->movi_end && pos >= demuxer->movi_end)
+        pos = demuxer->movi_end;
+      priv->next_pts = time;
+      stream_seek(s,pos);
+      return;
+    }
+  } else if(priv->frmt == MP3 && hr_mp3_seek && !(flags & SEEK_FACTOR)) {
     len = (flags & SEEK_ABSOLUTE) ? rel_seek_secs - priv->next_pts : rel_seek_secs;
     if(len < 0) {
       stream_seek(s,demuxer->movi_start);
@@ -831,6 +1201,10 @@ static void demux_audio_seek(demuxer_t *demuxer,float rel_seek_secs,float audio_
 static void demux_close_audio(demuxer_t* demuxer) {
   da_priv_t* priv = demuxer->priv;
 
+  if (!priv)
+    return;
+  if (priv->frmt == MP3)
+    mp3_index_uninit(demuxer);
   free(priv);
 }
 
@@ -0,0 +1,212 @@
+/*
+ * Sidecar files and background scans of the seek indexes of the demuxers
+ *
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "config.h"
+#include "mp_msg.h"
+#include "osdep/timer.h"
+#include "libavutil/common.h"
+#include "libavutil/intreadwrite.h"
+#include "demux_index.h"
+
+/**
+ * \brief name of the local file played, to read it from another thread and
+ * to store its index next to it
+ * \return NULL if it is not a local file, else to be freed
+ */
+char *demux_index_path(demuxer_t *demuxer)
+{
+    const char *filename = demuxer->filename;
+
+    if (demuxer->stream->type != STREAMTYPE_FILE || filename == NULL
+        || !strcmp(filename, "-"))
+        return NULL;
+    if (!strncmp(filename, "file://", 7))
+        filename += 7;
+    return strdup(filename);
+}
+
+static char *sidecar_name(const char *path, const char *ext)
+{
+    char *name = malloc(strlen(path) + strlen(ext) + 1);
+
+    if (name)
+        sprintf(name, "%s%s", path, ext);
+    return name;
+}
+
+/**
+ * \brief opens the sidecar index of the file and reads its header
+ * \param size set to the size of the file when the index was written
+ * \return the file positioned after the header, NULL if there is no index
+ *         for this file
+ */
+FILE *demux_index_open_read(demuxer_t *demuxer, const char *path,
+                            const char *ext, const char *magic,
+                            uint64_t *size)
+{
+    char *name = sidecar_name(path, ext);
+    uint8_t buf[16];
+    FILE *f;
+
+    if (name == NULL)
+        return NULL;
+    f = fopen(name, "rb");
+    free(name);
+    if (f == NULL)
+        return NULL;
+    if (fread(buf, 1, 16, f) != 16 || memcmp(buf, magic, 8))
+        goto fail;
+    // recordings still being written only grow, but a shorter file is another one
+    *size = AV_RL64(buf + 8);
+    if (*size > demuxer->stream->end_pos)
+        goto fail;
+    return f;
+
+fail:
+    fclose(f);
+    return NULL;
+}
+
+/**
+ * \brief reports the outcome of loading a sidecar index
+ * \param ok 0 if the index turned out not to match the file
+ */
+void demux_index_loaded(const char *path, const char *ext, int ok)
+{
+    if (ok)
+        mp_msg(MSGT_DEMUX, MSGL_V, "Loaded index %s%s\n", path, ext);
+    else
+        mp_msg(MSGT_DEMUX, MSGL_WARN,
+               "Index %s%s does not match the file, ignoring it\n", path, ext);
+}
+
+/**
+ * \brief spot check that a loaded index still points at what it indexes
+ * \param entries count entries of the given size, each starting with its
+ *        position as an off_t
+ * \param is_entry tells whether the stream is at an indexed position
+ */
+int demux_index_check(stream_t *s, const void *entries, int count,
+                      size_t size, int (*is_entry)(stream_t *s))
+{
+    int i, ok = 1;
+
+    for (i = 0; i < count && ok; i += FFMAX(count / 2, 1)) {
+        stream_seek(s, *(const off_t *)((const uint8_t *)entries + i * size));
+        ok = is_entry(s);
+    }
+    return ok;
+}
+
+/**
+ * \brief creates the sidecar index of the file and writes its header
+ * \return the file, or NULL if it cannot be written
+ */
+FILE *demux_index_open_write(demuxer_t *demuxer, const char *path,
+                             const char *ext, const char *magic)
+{
+    char *name = sidecar_name(path, ext);
+    uint8_t buf[16];
+    FILE *f;
+
+    if (name == NULL)
+        return NULL;
+    f = fopen(name, "wb");
+    if (f == NULL) {
+        mp_msg(MSGT_DEMUX, MSGL_V, "Cannot write index %s\n", name);
+        free(name);
+        return NULL;
+    }
+    free(name);
+    memcpy(buf, magic, 8);
+    AV_WL64(buf + 8, demuxer->stream->end_pos);
+    if (fwrite(buf, 1, 16, f) != 16) {
+        demux_index_close_write(f, 0, path, ext);
+        return NULL;
+    }
+    return f;
+}
+
+/**
+ * \brief closes a sidecar index, removing it if it could not be written
+ * \param ok 0 if writing failed
+ */
+void demux_index_close_write(FILE *f, int ok, const char *path,
+                             const char *ext)
+{
+    char *name;
+
+    if (!fclose(f) && ok)
+        return;
+    name = sidecar_name(path, ext);
+    if (name == NULL)
+        return;
+    mp_msg(MSGT_DEMUX, MSGL_WARN, "Cannot write index %s\n", name);
+    remove(name);
+    free(name);
+}
+
+/**
+ * \brief runs func(arg) to scan the file in a background thread
+ * \param start position the scan starts at
+ * \return 0 if no thread could be started
+ */
+int demux_index_scan_start(demux_index_scan_t *scan, void *(*func)(void *),
+                           void *arg, off_t start)
+{
+    scan->stop = 0;
+    scan->next_pause = start + DEMUX_INDEX_SCAN_CHUNK;
+#if HAVE_THREADS
+    scan->running = !pthread_create(&scan->thread, NULL, func, arg);
+#else
+    scan->running = 0;
+#endif
+    return scan->running;
+}
+
+/**
+ * \brief to be called by a scan as it goes, with the position it reached
+ */
+void demux_index_scan_pause(demux_index_scan_t *scan, off_t pos)
+{
+    if (pos < scan->next_pause)
+        return;
+    // leave the disk to playback most of the time
+    usec_sleep(1000);
+    scan->next_pause = pos + DEMUX_INDEX_SCAN_CHUNK;
+}
+
+/**
+ * \brief ends the scan, if it is still running
+ */
+void demux_index_scan_stop(demux_index_scan_t *scan)
+{
+    if (!scan->running)
+        return;
+    scan->stop = 1;
+#if HAVE_THREADS
+    pthread_join(scan->thread, NULL);
+#endif
+    scan->running = 0;
+}
@@ -0,0 +1,73 @@
+/*
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPLAYER_DEMUX_INDEX_H
+#define MPLAYER_DEMUX_INDEX_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+#include "config.h"
+#include "libavutil/thread.h"
+#include "stream/stream.h"
+#include "demuxer.h"
+
+/*
+ * Shared by the seek indexes that demuxers build for files lacking a usable
+ * one (-mkvindex, -tsindex, -mp3index). All three options take the levels
+ *   0  no index
+ *   1  index what is played and, for local files, the whole file in a
+ *      background thread (default)
+ *   2  also keep the index of local files in a sidecar file next to them,
+ *      <file><ext>, starting with a magic and the size of the file
+ */
+#define DEMUX_INDEX_SIDECAR 2
+
+/// amount a background scan reads between two pauses
+#define DEMUX_INDEX_SCAN_CHUNK (1024 * 1024)
+
+typedef struct demux_index_scan {
+    volatile int stop;  // set to end the scan early
+    int running;
+    off_t next_pause;
+#if HAVE_THREADS
+    pthread_t thread;
+#endif
+} demux_index_scan_t;
+
+char *demux_index_path(demuxer_t *demuxer);
+
+FILE *demux_index_open_read(demuxer_t *demuxer, const char *path,
+                            const char *ext, const char *magic,
+                            uint64_t *size);
+void demux_index_loaded(const char *path, const char *ext, int ok);
+int demux_index_check(stream_t *s, const void *entries, int count,
+                      size_t size, int (*is_entry)(stream_t *s));
+
+FILE *demux_index_open_write(demuxer_t *demuxer, const char *path,
+                             const char *ext, const char *magic);
+void demux_index_close_write(FILE *f, int ok, const char *path,
+                             const char *ext);
+
+int demux_index_scan_start(demux_index_scan_t *scan, void *(*func)(void *),
+                           void *arg, off_t start);
+void demux_index_scan_pause(demux_index_scan_t *scan, off_t pos);
+void demux_index_scan_stop(demux_index_scan_t *scan);
+
+#endif /* MPLAYER_DEMUX_INDEX_H */
@@ -33,6 +33,8 @@
 #include "stheader.h"
 #include "ebml.h"
 #include "matroska.h"
+#include "demux_mkv.h"
+#include "demux_index.h"
 #include "demux_real.h"
 
 #include "sub/ass_mp.h"
@@ -44,6 +46,7 @@
 #include "sub/sub.h"
 
 #include "libavutil/common.h"
+#include "libavutil/thread.h"
 
 #ifdef CONFIG_QTX_CODECS
 #include "loader/qtx/qtxsdk/components.h"
@@ -154,6 +157,26 @@ typedef struct mkv_index {
     uint64_t timecode, filepos;
 } mkv_index_t;
 
+typedef struct mkv_kf_entry {
+    off_t pos;                  // of the cluster holding the keyframe
+    int64_t timecode;           // in ms, not relative to first_tc
+    int cont;                   // no keyframe was missed since the previous entry
+} mkv_kf_entry_t;
+
+typedef struct mkv_kf_index {
+    AVMutex lock;
+    mkv_kf_entry_t *entries;
+    int count, alloc;
+    int complete;               // all the clusters of the file were scanned
+    int dirty;
+    int tnum;                   // track of the keyframes, 0 when not in use
+    off_t last;                 // cluster of the last keyframe played, -1 after a seek
+    char *path;
+    demux_index_scan_t scan;
+    off_t scan_start, scan_prev;
+    uint64_t scan_tc_scale;
+} mkv_kf_index_t;
+
 typedef struct mkv_demuxer {
     off_t segment_start;
 
@@ -179,6 +202,9 @@ typedef struct mkv_demuxer {
 
     uint64_t *cluster_positions;
     int num_cluster_pos;
+    off_t cluster_start;
+
+    mkv_kf_index_t kf_index;
 
     int64_t skip_to_timecode;
     int v_skip_to_keyframe, a_skip_to_keyframe;
@@ -244,6 +270,407 @@ static void add_cluster_position(mkv_demuxer_t *mkv_d, uint64_t position)
     mkv_d->cluster_positions[mkv_d->num_cluster_pos++] = position;
 }
 
+int mkv_index_mode = 1;
+
+/*
+ * Keyframe index for files without Cues: for each cluster holding a keyframe
+ * of the seek track, the timecode of the first one. It is filled while
+ * playing and, for local files, by a thread scanning the whole file; with
+ * -mkvindex 2 it is kept across sessions in <file>.mkvidx.
+ * Entries are sorted by position. Whoever reads clusters in order marks an
+ * entry as following the previous one without a gap, so that seeks only
+ * trust the parts of the file that were actually read.
+ */
+
+#define MKV_INDEX_MAGIC "MPMKVIX1"
+
+/**
+ * \brief adds the keyframe of the cluster at pos
+ * \param prev cluster of the previous keyframe met in the same run of
+ *        clusters, 0 from the start of the file, -1 if not known
+ * must be called with idx->lock held
+ */
+static void mkv_kf_index_insert(mkv_kf_index_t *idx, off_t pos,
+                                int64_t timecode, off_t prev)
+{
+    mkv_kf_entry_t *e;
+    int lo = 0, hi = idx->count;
+
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (idx->entries[mid].pos < pos)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo == idx->count || idx->entries[lo].pos != pos) {
+        grow_array(&idx->entries, idx->count, sizeof(mkv_kf_entry_t));
+        if (!idx->entries) {
+            idx->count = 0;
+            return;
+        }
+        e = idx->entries + lo;
+        memmove(e + 1, e, (idx->count - lo) * sizeof(mkv_kf_entry_t));
+        e->pos      = pos;
+        e->timecode = timecode;
+        e->cont     = 0;
+        idx->count++;
+        idx->dirty = 1;
+    }
+    e = idx->entries + lo;
+    if (!e->cont && (lo ? idx->entries[lo - 1].pos == prev : prev == 0)) {
+        e->cont = 1;
+        idx->dirty = 1;
+    }
+}
+
+static void mkv_kf_index_played(mkv_demuxer_t *mkv_d, int64_t timecode)
+{
+    mkv_kf_index_t *idx = &mkv_d->kf_index;
+
+    ff_mutex_lock(&idx->lock);
+    mkv_kf_index_insert(idx, mkv_d->cluster_start, timecode, idx->last);
+    ff_mutex_unlock(&idx->lock);
+    idx->last = mkv_d->cluster_start;
+}
+
+/**
+ * \brief looks up the cluster to seek to for timecode
+ * \param forward take the keyframe at or after timecode, else the one before
+ * \return 1 if the index covers timecode, 0 if it is not known where it is
+ */
+static int mkv_kf_index_lookup(mkv_kf_index_t *idx, int64_t timecode,
+                               int forward, off_t *pos)
+{
+    int lo = 0, hi, ret = 0;
+
+    ff_mutex_lock(&idx->lock);
+    hi = idx->count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (idx->entries[mid].timecode <= timecode)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    // lo is the first keyframe after timecode
+    if (lo == 0)
+        ret = idx->count && idx->entries[0].cont;
+    else if (lo < idx->count ? idx->entries[lo].cont : idx->complete) {
+        if (!forward || lo == idx->count
+            || idx->entries[lo - 1].timecode == timecode)
+            lo--;
+        ret = 1;
+    }
+    if (ret)
+        *pos = idx->entries[lo].pos;
+    ff_mutex_unlock(&idx->lock);
+
+    return ret;
+}
+
+static int mkv_kf_index_is_entry(stream_t *s)
+{
+    return ebml_read_id(s, NULL) == MATROSKA_ID_CLUSTER;
+}
+
+static void mkv_kf_index_load(demuxer_t *demuxer)
+{
+    mkv_demuxer_t *mkv_d = demuxer->priv;
+    mkv_kf_index_t *idx = &mkv_d->kf_index;
+    uint8_t buf[17];
+    FILE *f;
+    uint64_t size;
+    int count, complete, i, ok = 1;
+
+    f = demux_index_open_read(demuxer, idx->path, ".mkvidx", MKV_INDEX_MAGIC,
+                              &size);
+    if (f == NULL)
+        return;
+    if (fread(buf, 1, 12, f) != 12 || AV_RL32(buf) != idx->tnum)
+        goto fail;
+    complete = AV_RL32(buf + 4) && size == demuxer->stream->end_pos;
+    count = AV_RL32(buf + 8);
+    for (i = 0; i < count && ok; i++) {
+        off_t pos;
+
+        if (fread(buf, 1, 17, f) != 17)
+            goto fail;
+        pos = AV_RL64(buf);
+        if (pos >= size
+            || (idx->count && pos <= idx->entries[idx->count - 1].pos)) {
+            ok = 0;
+            break;
+        }
+        grow_array(&idx->entries, idx->count, sizeof(mkv_kf_entry_t));
+        if (!idx->entries) {
+            idx->count = 0;
+            goto fail;
+        }
+        idx->entries[idx->count].pos      = pos;
+        idx->entries[idx->count].timecode = AV_RL64(buf + 8);
+        idx->entries[idx->count].cont     = buf[16];
+        idx->count++;
+    }
+    fclose(f);
+
+    ok = ok && demux_index_check(demuxer->stream, idx->entries, idx->count,
+                                 sizeof(mkv_kf_entry_t),
+                                 mkv_kf_index_is_entry);
+    demux_index_loaded(idx->path, ".mkvidx", ok);
+    if (!ok) {
+        free(idx->entries);
+        idx->entries = NULL;
+        idx->count = 0;
+        return;
+    }
+    idx->complete = complete;
+    return;
+
+fail:
+    fclose(f);
+    free(idx->entries);
+    idx->entries = NULL;
+    idx->count = 0;
+}
+
+static void mkv_kf_index_save(demuxer_t *demuxer)
+{
+    mkv_demuxer_t *mkv_d = demuxer->priv;
+    mkv_kf_index_t *idx = &mkv_d->kf_index;
+    uint8_t buf[17];
+    FILE *f;
+    int i, ok;
+
+    if (!idx->dirty)
+        return;
+    f = demux_index_open_write(demuxer, idx->path, ".mkvidx", MKV_INDEX_MAGIC);
+    if (f == NULL)
+        return;
+
+    AV_WL32(buf, idx->tnum);
+    AV_WL32(buf + 4, idx->complete);
+    AV_WL32(buf + 8, idx->count);
+    ok = fwrite(buf, 1, 12, f) == 12;
+    for (i = 0; i < idx->count && ok; i++) {
+        AV_WL64(buf, idx->entries[i].pos);
+        AV_WL64(buf + 8, idx->entries[i].timecode);
+        buf[16] = idx->entries[i].cont;
+        ok &= fwrite(buf, 1, 17, f) == 17;
+    }
+    demux_index_close_write(f, ok, idx->path, ".mkvidx");
+}
+
+#if HAVE_THREADS
+/**
+ * \brief reads an EBML ID, or a length if size is set, from f
+ * \return the number of bytes read, 0 if invalid or of unknown size
+ */
+static int mkv_scan_read_num(FILE *f, uint64_t *num, int size)
+{
+    int c = getc(f), mask = 0x80, len = 1, ones, i;
+
+    if (c == EOF || c == 0)
+        return 0;
+    while (!(c & mask)) {
+        mask >>= 1;
+        len++;
+    }
+    if (len > (size ? 8 : 4))
+        return 0;
+    *num = size ? c & (mask - 1) : c;
+    ones = (c & (mask - 1)) == mask - 1;
+    for (i = 1; i < len; i++) {
+        if ((c = getc(f)) == EOF)
+            return 0;
+        *num = *num << 8 | c;
+        ones &= c == 0xff;
+    }
+    return size && ones ? 0 : len;
+}
+
+/**
+ * \brief reads the track number, timecode and flags of a block
+ */
+static int mkv_scan_read_block(FILE *f, uint64_t *track, int16_t *time,
+                               int *flags)
+{
+    uint8_t b[3];
+
+    if (!mkv_scan_read_num(f, track, 1) || fread(b, 1, 3, f) != 3)
+        return 0;
+    *time  = AV_RB16(b);
+    *flags = b[2];
+    return 1;
+}
+
+/**
+ * \brief background scan of the clusters of the whole file for the
+ * keyframes of the seek track, reading it through its own file handle and
+ * skipping the block data
+ */
+static void *mkv_kf_index_scan(void *arg)
+{
+    mkv_kf_index_t *idx = arg;
+    uint64_t tc_scale = idx->scan_tc_scale;
+    off_t pos = idx->scan_start, prev = idx->scan_prev, file_end;
+    int found = 0, done = 0;
+    FILE *f = fopen(idx->path, "rb");
+
+    if (f == NULL || fseeko(f, 0, SEEK_END) || (file_end = ftello(f)) < 0
+        || fseeko(f, pos, SEEK_SET))
+        goto end;
+
+    while (!idx->scan.stop) {
+        uint64_t id, size, cluster_tc = EBML_UINT_INVALID;
+        off_t cluster = pos, end;
+        int got = 0;
+
+        if (pos == file_end) {
+            done = 1;
+            break;
+        }
+        if (!mkv_scan_read_num(f, &id, 0) || !mkv_scan_read_num(f, &size, 1))
+            break;
+        pos = ftello(f);
+        end = pos + size;
+        while (id == MATROSKA_ID_CLUSTER && pos < end && !got) {
+            uint64_t cid, csize, track = 0, num;
+            int16_t time = 0;
+            int flags = 0, key = 0, i;
+
+            if (!mkv_scan_read_num(f, &cid, 0)
+                || !mkv_scan_read_num(f, &csize, 1))
+                goto stop;
+            pos = ftello(f) + csize;
+            switch (cid) {
+            case MATROSKA_ID_CLUSTERTIMECODE:
+                if (csize > 8)
+                    goto stop;
+                for (i = 0, num = 0; i < csize; i++)
+                    num = num << 8 | getc(f);
+                cluster_tc = num * tc_scale;
+                break;
+
+            case MATROSKA_ID_SIMPLEBLOCK:
+                if (!mkv_scan_read_block(f, &track, &time, &flags))
+                    goto stop;
+                key = flags & 0x80;
+                break;
+
+            case MATROSKA_ID_BLOCKGROUP:
+                key = 1;
+                while (ftello(f) < pos) {
+                    uint64_t gid, gsize;
+                    off_t next;
+
+                    if (!mkv_scan_read_num(f, &gid, 0)
+                        || !mkv_scan_read_num(f, &gsize, 1))
+                        goto stop;
+                    next = ftello(f) + gsize;
+                    if (gid == MATROSKA_ID_BLOCK
+                        && !mkv_scan_read_block(f, &track, &time, &flags))
+                        goto stop;
+                    if (gid == MATROSKA_ID_REFERENCEBLOCK)
+                        key = 0;
+                    if (fseeko(f, next, SEEK_SET))
+                        goto stop;
+                }
+                break;
+            }
+            if (key && track == idx->tnum && cluster_tc != EBML_UINT_INVALID) {
+                ff_mutex_lock(&idx->lock);
+                mkv_kf_index_insert(idx, cluster,
+                                    (time * tc_scale + cluster_tc) / 1000000.0,
+                                    prev);
+                ff_mutex_unlock(&idx->lock);
+                prev = cluster;
+                got = 1;
+                found++;
+            }
+            if (fseeko(f, pos, SEEK_SET))
+                goto stop;
+        }
+        pos = end;
+        if (fseeko(f, pos, SEEK_SET))
+            break;
+        demux_index_scan_pause(&idx->scan, pos);
+    }
+stop:
+    if (done) {
+        ff_mutex_lock(&idx->lock);
+        idx->complete = 1;
+        idx->dirty = 1;
+        ff_mutex_unlock(&idx->lock);
+    }
+    mp_msg(MSGT_DEMUX, MSGL_V,
+           "[mkv] Index scan %s at %" PRIu64 " with %d keyframes\n",
+           done ? "finished" : idx->scan.stop ? "stopped" : "failed",
+           (uint64_t) pos, found);
+
+end:
+    if (f)
+        fclose(f);
+    return NULL;
+}
+#endif
+
+/**
+ * \brief sets up the keyframe index when the file has no Cues, must be
+ * called with the stream at the first cluster
+ */
+static void mkv_kf_index_init(demuxer_t *demuxer)
+{
+    mkv_demuxer_t *mkv_d = demuxer->priv;
+    mkv_kf_index_t *idx = &mkv_d->kf_index;
+    stream_t *s = demuxer->stream;
+    off_t start = stream_tell(s);
+
+    if (!mkv_index_mode || !index_mode || mkv_d->indexes || !s->end_pos)
+        return;
+    idx->tnum = demuxer->video->id >= 0 ? demuxer->video->id
+                                        : demuxer->audio->id;
+    if (idx->tnum <= 0) {
+        idx->tnum = 0;
+        return;
+    }
+    idx->path = demux_index_path(demuxer);
+    if (idx->path && mkv_index_mode >= DEMUX_INDEX_SIDECAR)
+        mkv_kf_index_load(demuxer);
+#if HAVE_THREADS
+    if (idx->path && !idx->complete) {
+        int i = 0;
+
+        // go on from the end of the part of the file known from its start
+        idx->scan_start = start;
+        idx->scan_prev = 0;
+        if (idx->count && idx->entries[0].cont) {
+            while (i + 1 < idx->count && idx->entries[i + 1].cont)
+                i++;
+            idx->scan_start = idx->entries[i].pos;
+            idx->scan_prev = i ? idx->entries[i - 1].pos : 0;
+        }
+        idx->scan_tc_scale = mkv_d->tc_scale;
+        demux_index_scan_start(&idx->scan, mkv_kf_index_scan, idx,
+                               idx->scan_start);
+    }
+#endif
+    stream_seek(s, start);
+}
+
+static void mkv_kf_index_uninit(demuxer_t *demuxer)
+{
+    mkv_demuxer_t *mkv_d = demuxer->priv;
+    mkv_kf_index_t *idx = &mkv_d->kf_index;
+
+    demux_index_scan_stop(&idx->scan);
+    if (idx->path && mkv_index_mode >= DEMUX_INDEX_SIDECAR)
+        mkv_kf_index_save(demuxer);
+    free(idx->entries);
+    free(idx->path);
+    ff_mutex_destroy(&idx->lock);
+}
+
 
 #define AAC_SYNC_EXTENSION_TYPE 0x02b7
 static int aac_get_sample_rate_index(uint32_t sample_rate)
@@ -2042,6 +2469,7 @@ static int demux_mkv_open(demuxer_t *demuxer)
     demuxer->priv = mkv_d;
     mkv_d->tc_scale = 1000000;
     mkv_d->segment_start = stream_tell(s);
+    ff_mutex_init(&mkv_d->kf_index.lock, NULL);
     mkv_d->parsed_cues = malloc(sizeof(off_t));
     mkv_d->parsed_seekhead = malloc(sizeof(off_t));
 
@@ -2202,7 +2630,10 @@ static int demux_mkv_open(demuxer_t *demuxer)
         }
     }
 
-    if (s->end_pos == 0 || (mkv_d->indexes == NULL && index_mode < 0))
+    mkv_kf_index_init(demuxer);
+
+    if (s->end_pos == 0
+        || (mkv_d->indexes == NULL && index_mode < 0 && !mkv_d->kf_index.tnum))
         demuxer->seekable = 0;
     else {
         demuxer->movi_start = s->start_pos;
@@ -2220,6 +2651,7 @@ static void demux_close_mkv(demuxer_t *demuxer)
     if (mkv_d) {
         int i;
         free_cached_dps(demuxer);
+        mkv_kf_index_uninit(demuxer);
         if (mkv_d->tracks) {
             for (i = 0; i < mkv_d->num_tracks; i++)
                 demux_mkv_free_trackentry(mkv_d->tracks[i]);
@@ -2606,6 +3038,11 @@ static int handle_block(demuxer_t *demuxer, uint8_t *block, uint64_t length,
         free(lace_size);
         return 1;
     }
+    if (num == mkv_d->kf_index.tnum && !mkv_d->indexes
+        && mkv_d->cluster_start != mkv_d->kf_index.last
+        && (simpleblock ? flags & 0x80 : !block_bref && !block_fref))
+        mkv_kf_index_played(mkv_d, (time * mkv_d->tc_scale +
+                                    mkv_d->cluster_tc) / 1000000.0);
     if (num == demuxer->audio->id) {
         ds = demuxer->audio;
 
@@ -2842,7 +3279,8 @@ static int demux_mkv_fill_buffer(demuxer_t *demuxer, demux_stream_t *ds)
 
         if (ebml_read_id(s, &il) != MATROSKA_ID_CLUSTER)
             return 0;
-        add_cluster_position(mkv_d, stream_tell(s) - il);
+        mkv_d->cluster_start = stream_tell(s) - il;
+        add_cluster_position(mkv_d, mkv_d->cluster_start);
         mkv_d->cluster_size = ebml_read_length(s, NULL);
     }
 
@@ -2857,6 +3295,7 @@ static void demux_mkv_seek(demuxer_t *demuxer, float rel_seek_secs,
         mkv_demuxer_t *mkv_d = (mkv_demuxer_t *) demuxer->priv;
         stream_t *s = demuxer->stream;
         int64_t target_timecode = 0, diff, min_diff = 0xFFFFFFFFFFFFFFFLL;
+        off_t kf_pos;
         int i;
 
         if (!(flags & SEEK_ABSOLUTE))   /* relative seek */
@@ -2864,13 +3303,29 @@ static void demux_mkv_seek(demuxer_t *demuxer, float rel_seek_secs,
         target_timecode += (int64_t) (rel_seek_secs * 1000.0);
         if (target_timecode < 0)
             target_timecode = 0;
-
-        if (mkv_d->indexes == NULL) {   /* no index was found */
-            uint64_t target_filepos, cluster_pos, max_pos;
-
-            target_filepos =
-                (uint64_t) (target_timecode * mkv_d->last_filepos /
-                            (mkv_d->last_pts * 1000.0));
+        mkv_d->kf_index.last = -1;
+
+        if (mkv_d->indexes == NULL && mkv_d->kf_index.tnum
+            && mkv_kf_index_lookup(&mkv_d->kf_index,
+                                   target_timecode + mkv_d->first_tc,
+                                   !(flags & SEEK_ABSOLUTE)
+                                   && target_timecode > mkv_d->last_pts * 1000,
+                                   &kf_pos)) {
+            mkv_d->cluster_size = mkv_d->blockgroup_size = 0;
+            stream_seek(s, kf_pos);
+        } else if (mkv_d->indexes == NULL) {   /* no index was found */
+            uint64_t target_filepos = 0, cluster_pos, max_pos;
+
+            // estimate the position from the bitrate so far, or of the
+            // whole file before anything was played
+            if (mkv_d->last_pts > 0)
+                target_filepos =
+                    (uint64_t) (target_timecode * mkv_d->last_filepos /
+                                (mkv_d->last_pts * 1000.0));
+            else if (mkv_d->duration > 0 && s->end_pos > 0)
+                target_filepos =
+                    (uint64_t) (target_timecode * (double) s->end_pos /
+                                (mkv_d->duration * 1000.0));
 
             max_pos = mkv_d->num_cluster_pos ?
                 mkv_d->cluster_positions[mkv_d->num_cluster_pos - 1] : 0;
@@ -2972,6 +3427,7 @@ static void demux_mkv_seek(demuxer_t *demuxer, float rel_seek_secs,
         mkv_index_t *index = NULL;
         int i;
 
+        mkv_d->kf_index.last = -1;
         if (mkv_d->indexes == NULL) {   /* no index was found *//* I'm lazy... */
             mp_msg(MSGT_DEMUX, MSGL_V, "[mkv] seek unsupported flags\n");
             return;
@@ -0,0 +1,379 @@
+/*
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "libavutil/common.h"
+#include "libavutil/thread.h"
+#include "demuxer.h"
+
+/* Packet headers and payloads are carved out of slabs, blocks holding a
+ * number of objects of one size, instead of being malloc()ed one by one.
+ * Payloads are grouped in size classes of 4 steps per power of two, so a
+ * buffer can mostly be resized in place and a freed one fits the next
+ * packets of similar size.  Slabs with no objects in use are kept only up
+ * to a small amount per cache, so the memory held follows the number of
+ * queued packets.
+ * Packets move between demuxers (e.g. the -audiofile demuxer wrapper) and
+ * outlive them in the decoders, so the caches are shared by all of them. */
+
+#define SLAB_SIZE (64 * 1024)
+// bytes of empty slabs a cache may keep beyond the first one
+#define MAX_EMPTY_BYTES (256 * 1024)
+#define OBJECT_ALIGN 16
+#define CLASS_MIN_SIZE 256
+// payloads larger than the biggest class (1 MiB) are malloc()ed on their own
+#define CLASSES 49
+
+typedef struct slab slab_t;
+
+typedef struct object {
+    slab_t *slab;            // NULL for a large payload outside any slab
+    union {
+        struct object *next; // in the free list of the slab
+        size_t size;         // usable size of a large payload
+    } u;
+} object_t;
+
+typedef struct cache {
+    size_t size;     // usable size of each object
+    int per_slab;
+    slab_t *partial; // slabs with some objects free
+    slab_t *empty;   // slabs with all objects free
+    int empty_count;
+} cache_t;
+
+struct slab {
+    cache_t *cache;
+    slab_t *prev, *next;
+    object_t *free;
+    int used;
+};
+
+static cache_t packet_cache;
+static cache_t payload_cache[CLASSES];
+static int64_t held_bytes;
+static demux_packet_stats_t stats;
+static AVMutex pool_mutex = AV_MUTEX_INITIALIZER;
+
+/* Class 0 holds up to CLASS_MIN_SIZE, then for 2^k < size <= 2^(k+1) there
+ * are 4 classes of m * 2^(k-2) bytes, with m from 5 to 8. */
+static int payload_class(size_t size)
+{
+    int k = 8;
+    if (size <= CLASS_MIN_SIZE)
+        return 0;
+    while ((size - 1) >> (k + 1))
+        k++;
+    return (k - 8) * 4 + ((size - 1) >> (k - 2)) - 3;
+}
+
+static size_t payload_class_size(int size_class)
+{
+    if (!size_class)
+        return CLASS_MIN_SIZE;
+    size_class--;
+    return (size_t)(5 + size_class % 4) << (8 + size_class / 4 - 2);
+}
+
+static size_t object_stride(cache_t *c)
+{
+    return FFALIGN(sizeof(object_t) + c->size, OBJECT_ALIGN);
+}
+
+static size_t slab_bytes(cache_t *c)
+{
+    return FFALIGN(sizeof(slab_t), OBJECT_ALIGN) + c->per_slab * object_stride(c);
+}
+
+static void cache_init(cache_t *c, size_t size)
+{
+    if (c->size)
+        return;
+    c->size     = size;
+    c->per_slab = FFMAX(1, SLAB_SIZE / object_stride(c));
+}
+
+static void slab_link(slab_t **list, slab_t *s)
+{
+    s->prev = NULL;
+    s->next = *list;
+    if (*list)
+        (*list)->prev = s;
+    *list = s;
+}
+
+static void slab_unlink(slab_t **list, slab_t *s)
+{
+    if (s->prev)
+        s->prev->next = s->next;
+    else
+        *list = s->next;
+    if (s->next)
+        s->next->prev = s->prev;
+}
+
+static slab_t *slab_new(cache_t *c)
+{
+    size_t stride = object_stride(c);
+    uint8_t *obj;
+    slab_t *s = malloc(slab_bytes(c));
+    int i;
+    if (!s)
+        return NULL;
+    s->cache = c;
+    s->free  = NULL;
+    s->used  = 0;
+    obj = (uint8_t *)s + FFALIGN(sizeof(slab_t), OBJECT_ALIGN);
+    for (i = c->per_slab - 1; i >= 0; i--) {
+        object_t *o = (object_t *)(obj + i * stride);
+        o->slab   = s;
+        o->u.next = s->free;
+        s->free   = o;
+    }
+    held_bytes += slab_bytes(c);
+    stats.peak_bytes = FFMAX(stats.peak_bytes, held_bytes);
+    stats.slabs++;
+    return s;
+}
+
+static void slab_free(slab_t *s)
+{
+    held_bytes -= slab_bytes(s->cache);
+    free(s);
+}
+
+// must be called with pool_mutex held
+static void *cache_alloc(cache_t *c)
+{
+    slab_t *s = c->partial;
+    object_t *o;
+    if (!s) {
+        s = c->empty;
+        if (s) {
+            c->empty = s->next;
+            c->empty_count--;
+        } else if (!(s = slab_new(c)))
+            return NULL;
+        slab_link(&c->partial, s);
+    }
+    o = s->free;
+    s->free = o->u.next;
+    if (++s->used == c->per_slab)
+        slab_unlink(&c->partial, s);
+    return o + 1;
+}
+
+// must be called with pool_mutex held
+static void cache_free(object_t *o)
+{
+    slab_t *s  = o->slab;
+    cache_t *c = s->cache;
+    if (s->used-- == c->per_slab)
+        slab_link(&c->partial, s);
+    o->u.next = s->free;
+    s->free   = o;
+    if (s->used)
+        return;
+    slab_unlink(&c->partial, s);
+    if (c->empty_count && (c->empty_count + 1) * slab_bytes(c) > MAX_EMPTY_BYTES) {
+        slab_free(s);
+        return;
+    }
+    s->next = c->empty;
+    c->empty = s;
+    c->empty_count++;
+}
+
+static unsigned char *payload_alloc(size_t size)
+{
+    int size_class = payload_class(size);
+    object_t *o;
+    void *p;
+    if (size_class >= CLASSES) {
+        if (size > INT_MAX || !(o = malloc(sizeof(object_t) + size)))
+            return NULL;
+        o->slab   = NULL;
+        o->u.size = size;
+        ff_mutex_lock(&pool_mutex);
+        stats.requests++;
+        stats.large++;
+        ff_mutex_unlock(&pool_mutex);
+        return (unsigned char *)(o + 1);
+    }
+    ff_mutex_lock(&pool_mutex);
+    cache_init(&payload_cache[size_class], payload_class_size(size_class));
+    stats.requests++;
+    p = cache_alloc(&payload_cache[size_class]);
+    ff_mutex_unlock(&pool_mutex);
+    return p;
+}
+
+static size_t payload_size(unsigned char *buffer)
+{
+    object_t *o = (object_t *)buffer - 1;
+    return o->slab ? o->slab->cache->size : o->u.size;
+}
+
+static void payload_free(unsigned char *buffer)
+{
+    object_t *o;
+    if (!buffer)
+        return;
+    o = (object_t *)buffer - 1;
+    if (!o->slab) {
+        free(o);
+        return;
+    }
+    ff_mutex_lock(&pool_mutex);
+    cache_free(o);
+    ff_mutex_unlock(&pool_mutex);
+}
+
+static demux_packet_t *packet_alloc(void)
+{
+    demux_packet_t *dp;
+    ff_mutex_lock(&pool_mutex);
+    cache_init(&packet_cache, sizeof(demux_packet_t));
+    stats.packets++;
+    dp = cache_alloc(&packet_cache);
+    ff_mutex_unlock(&pool_mutex);
+    return dp;
+}
+
+static void packet_free(demux_packet_t *dp)
+{
+    ff_mutex_lock(&pool_mutex);
+    cache_free((object_t *)dp - 1);
+    ff_mutex_unlock(&pool_mutex);
+}
+
+demux_packet_t *new_demux_packet(int len)
+{
+    demux_packet_t *dp = packet_alloc();
+    if (!dp)
+        return NULL;
+    dp->len        = len;
+    dp->next       = NULL;
+    dp->pts        = MP_NOPTS_VALUE;
+    dp->endpts     = MP_NOPTS_VALUE;
+    dp->stream_pts = MP_NOPTS_VALUE;
+    dp->pos        = 0;
+    dp->flags      = 0;
+    dp->refcount   = 1;
+    dp->master     = NULL;
+    dp->buffer     = NULL;
+    if (len > 0 && len <= INT_MAX - MP_INPUT_BUFFER_PADDING_SIZE &&
+        (dp->buffer = payload_alloc(len + MP_INPUT_BUFFER_PADDING_SIZE)))
+        memset(dp->buffer + len, 0, MP_INPUT_BUFFER_PADDING_SIZE);
+    else if (len) {
+        // do not even return a valid packet if allocation failed
+        packet_free(dp);
+        return NULL;
+    }
+    return dp;
+}
+
+void resize_demux_packet(demux_packet_t *dp, int len)
+{
+    if (len > 0 && len <= INT_MAX - MP_INPUT_BUFFER_PADDING_SIZE) {
+        size_t size = len + MP_INPUT_BUFFER_PADDING_SIZE;
+        // stay in place unless the buffer is too small or more than twice
+        // as large as needed
+        if (!dp->buffer || payload_size(dp->buffer) < size ||
+            payload_size(dp->buffer) / 2 > size) {
+            unsigned char *buffer = payload_alloc(size);
+            if (buffer && dp->buffer && dp->len > 0) {
+                memcpy(buffer, dp->buffer, FFMIN(dp->len, len));
+                ff_mutex_lock(&pool_mutex);
+                stats.copies++;
+                ff_mutex_unlock(&pool_mutex);
+            }
+            payload_free(dp->buffer);
+            dp->buffer = buffer;
+        }
+    } else {
+        payload_free(dp->buffer);
+        dp->buffer = NULL;
+    }
+    dp->len = len;
+    if (dp->buffer)
+        memset(dp->buffer + len, 0, MP_INPUT_BUFFER_PADDING_SIZE);
+    else
+        dp->len = 0;
+}
+
+demux_packet_t *clone_demux_packet(demux_packet_t *pack)
+{
+    demux_packet_t *dp = packet_alloc();
+    if (!dp)
+        return NULL;
+    while (pack->master)
+        pack = pack->master; // find the master
+    memcpy(dp, pack, sizeof(demux_packet_t));
+    dp->next     = NULL;
+    dp->refcount = 0;
+    dp->master   = pack;
+    pack->refcount++;
+    return dp;
+}
+
+void free_demux_packet(demux_packet_t *dp)
+{
+    if (dp->master == NULL) { // dp is a master packet
+        dp->refcount--;
+        if (dp->refcount == 0) {
+            payload_free(dp->buffer);
+            packet_free(dp);
+        }
+        return;
+    }
+    // dp is a clone:
+    free_demux_packet(dp->master);
+    packet_free(dp);
+}
+
+void demux_packet_get_stats(demux_packet_stats_t *s)
+{
+    ff_mutex_lock(&pool_mutex);
+    *s = stats;
+    ff_mutex_unlock(&pool_mutex);
+}
+
+static void cache_release(cache_t *c)
+{
+    while (c->empty) {
+        slab_t *s = c->empty;
+        c->empty = s->next;
+        slab_free(s);
+    }
+    c->empty_count = 0;
+}
+
+void demux_packet_uninit(void)
+{
+    int i;
+    ff_mutex_lock(&pool_mutex);
+    cache_release(&packet_cache);
+    for (i = 0; i < CLASSES; i++)
+        cache_release(&payload_cache[i]);
+    ff_mutex_unlock(&pool_mutex);
+}
@@ -22,6 +22,8 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include <inttypes.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -31,6 +33,10 @@
 #include "mpcommon.h"
 #include "help_mp.h"
 
+#include "libavutil/common.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/thread.h"
+
 #include "libmpcodecs/dec_audio.h"
 #include "stream/stream.h"
 #include "demuxer.h"
@@ -39,6 +45,7 @@
 #include "ms_hdr.h"
 #include "mpeg_hdr.h"
 #include "demux_ts.h"
+#include "demux_index.h"
 
 #define TS_PH_PACKET_SIZE 192
 #define TS_FEC_PACKET_SIZE 204
@@ -61,6 +68,7 @@
 
 int ts_prog;
 int ts_keep_broken=0;
+int ts_index_mode = 1;
 off_t ts_probe = 0;
 int audio_substream_id = -1;
 
@@ -230,6 +238,33 @@ typedef struct {
 	double last_pts;
 } TS_stream_info;
 
+#define TS_INDEX_MAGIC "MPTSIDX1"
+#define TS_INDEX_MIN_GAP 0.4	// keep access points at least this far apart (s)
+#define TS_INDEX_MAX_GAP 10.0	// trust neighbours at most this far apart (s)
+
+typedef struct {
+	off_t pos;	// of the TS packet starting the PES
+	double pts;
+} ts_index_entry_t;
+
+typedef struct {
+	int progid;
+	int count, alloc;
+	ts_index_entry_t *entries;	// sorted by pos
+} ts_index_prog_t;
+
+typedef struct {
+	AVMutex lock;	// taken by playback and the background scan
+	ts_index_prog_t *progs;
+	int progs_cnt;
+	int dirty;	// changed since loaded
+	double start_pts;	// of the first video packet, for absolute seeks
+	char *path;	// of the file, NULL if it is not one
+	demux_index_scan_t scan;
+	int scan_pid, scan_type, scan_progid, scan_packet_size;
+	off_t scan_start;
+} ts_index_t;
+
 typedef struct {
 	MpegTSContext ts;
 	int last_pid;
@@ -245,6 +280,7 @@ typedef struct {
 	int last_sid;
 	char packet[TS_FEC_PACKET_SIZE];
 	TS_stream_info vstr, astr;
+	ts_index_t index;
 } ts_priv_t;
 
 
@@ -974,6 +1010,351 @@ static int parse_avc_sps(uint8_t *buf, int len, int *w, int *h)
 	return 1;
 }
 
+/*
+ * Seek index: the random access points of the video stream of each program,
+ * PTS to the position of the TS packet starting the PES. It is filled while
+ * playing and, for local files, by a thread scanning the whole file; with
+ * -tsindex 2 it is kept across sessions in <file>.tsidx.
+ * Entries are sorted by position; since PTS may jump in captures, lookups
+ * go through consecutive pairs instead of bisecting on the PTS.
+ */
+
+static ts_index_prog_t *ts_index_prog(ts_index_t *idx, int progid)
+{
+	ts_index_prog_t *ip;
+	int i;
+
+	for(i = 0; i < idx->progs_cnt; i++)
+		if(idx->progs[i].progid == progid)
+			return &idx->progs[i];
+	ip = realloc_struct(idx->progs, idx->progs_cnt + 1, sizeof(ts_index_prog_t));
+	if(ip == NULL)
+		return NULL;
+	idx->progs = ip;
+	ip = &idx->progs[idx->progs_cnt++];
+	memset(ip, 0, sizeof(ts_index_prog_t));
+	ip->progid = progid;
+	return ip;
+}
+
+// must be called with idx->lock held
+static void ts_index_insert(ts_index_t *idx, int progid, double pts, off_t pos)
+{
+	ts_index_prog_t *ip = ts_index_prog(idx, progid);
+	ts_index_entry_t *e;
+	int lo = 0, hi;
+
+	if(ip == NULL)
+		return;
+	hi = ip->count;
+	while(lo < hi)
+	{
+		int mid = (lo + hi) / 2;
+		if(ip->entries[mid].pos < pos)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	// already known, or too close after the previous access point
+	if(lo < ip->count && ip->entries[lo].pos == pos)
+		return;
+	if(lo > 0 && ip->entries[lo-1].pts <= pts && pts - ip->entries[lo-1].pts < TS_INDEX_MIN_GAP)
+		return;
+
+	if(ip->count == ip->alloc)
+	{
+		int alloc = ip->alloc ? 2 * ip->alloc : 256;
+		e = realloc_struct(ip->entries, alloc, sizeof(ts_index_entry_t));
+		if(e == NULL)
+			return;
+		ip->entries = e;
+		ip->alloc = alloc;
+	}
+	e = &ip->entries[lo];
+	memmove(e + 1, e, (ip->count - lo) * sizeof(ts_index_entry_t));
+	e->pos = pos;
+	e->pts = pts;
+	ip->count++;
+	idx->dirty = 1;
+}
+
+static void ts_index_add(ts_index_t *idx, int progid, double pts, off_t pos)
+{
+	ff_mutex_lock(&idx->lock);
+	ts_index_insert(idx, progid, pts, pos);
+	ff_mutex_unlock(&idx->lock);
+}
+
+/**
+ * \brief checks the start of a video PES payload for a sequence header or
+ * an intra coded picture, i.e. a point where decoding can begin
+ */
+static int ts_index_is_keyframe(int type, const uint8_t *buf, int len)
+{
+	int i;
+
+	for(i = 0; i + 4 < len; i++)
+	{
+		int code;
+
+		if(buf[i] || buf[i+1] || buf[i+2] != 1)
+			continue;
+		code = buf[i+3];
+		switch(type)
+		{
+			case VIDEO_MPEG1:
+			case VIDEO_MPEG2:
+				if(code == 0xB3 || code == 0xB8)
+					return 1;
+				break;
+			case VIDEO_MPEG4:
+				if(code == 0xB0 || (code == 0xB6 && !(buf[i+4] & 0xC0)))
+					return 1;
+				break;
+			case VIDEO_H264:
+			case VIDEO_AVC:
+				code &= 0x1F;
+				if(code == 5 || code == 7)
+					return 1;
+				break;
+			case VIDEO_HEVC:
+				code = (code >> 1) & 0x3F;
+				if((code >= 16 && code <= 21) || code == 32 || code == 33)
+					return 1;
+				break;
+			case VIDEO_VC1:
+				if(code == 0x0F)
+					return 1;
+				break;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * \brief looks up where to seek for target
+ * \param forward take the access point at or after target, else before it
+ * \param cur among several matches (PTS discontinuities) the one closest
+ *        to this position wins
+ * \return 2 if pos is an access point, 1 if it is interpolated between two
+ *         that are too far apart to be trusted, 0 if target is not covered
+ */
+static int ts_index_lookup(ts_index_t *idx, int progid, double target, int forward, off_t cur, off_t *pos)
+{
+	ts_index_prog_t *ip;
+	off_t best_dist = -1;
+	int i, ret = 0;
+
+	ff_mutex_lock(&idx->lock);
+	ip = ts_index_prog(idx, progid);
+	for(i = 0; ip && i + 1 < ip->count; i++)
+	{
+		ts_index_entry_t *a = &ip->entries[i], *b = &ip->entries[i+1];
+		int hit;
+		off_t p, dist;
+
+		if(a->pts > target || b->pts <= target)
+			continue;
+		hit = b->pts - a->pts <= TS_INDEX_MAX_GAP;
+		if(hit)
+			p = (forward && target > a->pts) ? b->pos : a->pos;
+		else
+			p = a->pos + (b->pos - a->pos) * ((target - a->pts) / (b->pts - a->pts));
+		dist = FFABS(p - cur);
+		// an access point beats an interpolation anywhere else
+		if(hit + 1 > ret || (hit + 1 == ret && dist < best_dist))
+		{
+			ret = hit + 1;
+			best_dist = dist;
+			*pos = p;
+		}
+	}
+	ff_mutex_unlock(&idx->lock);
+
+	return ret;
+}
+
+static int ts_index_is_entry(stream_t *s)
+{
+	return stream_read_char(s) == 0x47;
+}
+
+static void ts_index_load(demuxer_t *demuxer)
+{
+	ts_priv_t *priv = demuxer->priv;
+	ts_index_t *idx = &priv->index;
+	uint8_t buf[16];
+	FILE *f;
+	uint64_t size;
+	int64_t start_pts;
+	int progs, i, j, ok = 1;
+
+	f = demux_index_open_read(demuxer, idx->path, ".tsidx", TS_INDEX_MAGIC, &size);
+	if(f == NULL)
+		return;
+
+	if(fread(buf, 1, 12, f) != 12)
+		goto fail;
+	start_pts = AV_RL64(buf);
+	progs = AV_RL32(buf + 8);
+	for(i = 0; i < progs && ok; i++)
+	{
+		int progid, count;
+		off_t last = -1;
+
+		if(fread(buf, 1, 8, f) != 8)
+			goto fail;
+		progid = AV_RL32(buf);
+		count = AV_RL32(buf + 4);
+		for(j = 0; j < count; j++)
+		{
+			off_t pos;
+
+			if(fread(buf, 1, 16, f) != 16)
+				goto fail;
+			pos = AV_RL64(buf);
+			if(pos <= last || pos >= size)
+			{
+				ok = 0;
+				break;
+			}
+			last = pos;
+			ts_index_insert(idx, progid, (int64_t)AV_RL64(buf + 8) / 90000.0, pos);
+		}
+	}
+	fclose(f);
+
+	for(i = 0; i < idx->progs_cnt && ok; i++)
+		ok = demux_index_check(demuxer->stream, idx->progs[i].entries, idx->progs[i].count,
+		                       sizeof(ts_index_entry_t), ts_index_is_entry);
+	demux_index_loaded(idx->path, ".tsidx", ok);
+	if(!ok)
+	{
+		for(i = 0; i < idx->progs_cnt; i++)
+			free(idx->progs[i].entries);
+		free(idx->progs);
+		idx->progs = NULL;
+		idx->progs_cnt = 0;
+		return;
+	}
+	if(start_pts != INT64_MIN)
+		idx->start_pts = start_pts / 90000.0;
+	idx->dirty = 0;
+	return;
+
+fail:
+	fclose(f);
+}
+
+static void ts_index_save(demuxer_t *demuxer)
+{
+	ts_priv_t *priv = demuxer->priv;
+	ts_index_t *idx = &priv->index;
+	uint8_t buf[16];
+	FILE *f;
+	int i, j, ok;
+
+	if(!idx->dirty)
+		return;
+	f = demux_index_open_write(demuxer, idx->path, ".tsidx", TS_INDEX_MAGIC);
+	if(f == NULL)
+		return;
+
+	AV_WL64(buf, idx->start_pts == MP_NOPTS_VALUE ? INT64_MIN : llrint(idx->start_pts * 90000));
+	AV_WL32(buf + 8, idx->progs_cnt);
+	ok = fwrite(buf, 1, 12, f) == 12;
+	for(i = 0; i < idx->progs_cnt && ok; i++)
+	{
+		ts_index_prog_t *ip = &idx->progs[i];
+		AV_WL32(buf, ip->progid);
+		AV_WL32(buf + 4, ip->count);
+		ok &= fwrite(buf, 1, 8, f) == 8;
+		for(j = 0; j < ip->count && ok; j++)
+		{
+			AV_WL64(buf, ip->entries[j].pos);
+			AV_WL64(buf + 8, llrint(ip->entries[j].pts * 90000));
+			ok &= fwrite(buf, 1, 16, f) == 16;
+		}
+	}
+	demux_index_close_write(f, ok, idx->path, ".tsidx");
+}
+
+#if HAVE_THREADS
+/**
+ * \brief background scan of the whole file for the access points of the
+ * video stream, reading it through its own file handle
+ */
+static void *ts_index_scan(void *arg)
+{
+	ts_index_t *idx = arg;
+	int psize = idx->scan_packet_size;
+	int chunk = DEMUX_INDEX_SCAN_CHUNK / psize * psize;
+	uint8_t *buf = malloc(chunk);
+	off_t pos = idx->scan_start;
+	int len = 0, found = 0;
+	FILE *f = fopen(idx->path, "rb");
+
+	if(f == NULL || buf == NULL || fseeko(f, pos, SEEK_SET))
+		goto end;
+
+	while(!idx->scan.stop)
+	{
+		int i = 0, got = fread(buf + len, 1, chunk - len, f);
+		if(got <= 0)
+			break;
+		len += got;
+		while(i + psize <= len)
+		{
+			uint8_t *p = buf + i, *end = p + TS_PACKET_SIZE;
+			off_t pkt_pos = pos + i;
+			int pid, afc, rap = 0;
+
+			if(*p != 0x47 || (i + 2 * psize <= len && p[psize] != 0x47))
+			{
+				// lost sync, look for the next packet
+				i++;
+				continue;
+			}
+			i += psize;
+			pid = ((p[1] & 0x1f) << 8) | p[2];
+			if(pid != idx->scan_pid || !(p[1] & 0x40))
+				continue;
+			afc = (p[3] >> 4) & 3;
+			p += 4;
+			if(afc & 2)
+			{
+				if(p[0] > 0)
+					rap = p[1] & 0x40;
+				p += p[0] + 1;
+			}
+			// PES header with a PTS
+			if(!(afc & 1) || p + 14 > end || p[0] || p[1] || p[2] != 1 || !(p[7] & 0x80))
+				continue;
+			if(rap || ts_index_is_keyframe(idx->scan_type, p + 9 + p[8], end - p - 9 - p[8]))
+			{
+				int64_t pts = (int64_t)(p[9] & 0x0E) << 29 | p[10] << 22 |
+					(p[11] & 0xFE) << 14 | p[12] << 7 | p[13] >> 1;
+				ts_index_add(idx, idx->scan_progid, pts / 90000.0, pkt_pos);
+				found++;
+			}
+		}
+		memmove(buf, buf + i, len - i);
+		pos += i;
+		len -= i;
+		demux_index_scan_pause(&idx->scan, pos);
+	}
+	mp_msg(MSGT_DEMUX, MSGL_V, "TS index scan %s at %"PRIu64" with %d access points\n",
+		idx->scan.stop ? "stopped" : "finished", (uint64_t) pos, found);
+
+end:
+	if(f)
+		fclose(f);
+	free(buf);
+	return NULL;
+}
+#endif
+
 static demuxer_t *demux_open_ts(demuxer_t * demuxer)
 {
 	int i;
@@ -1074,6 +1455,25 @@ static demuxer_t *demux_open_ts(demuxer_t * demuxer)
                     demuxer->stream->start_pos :
                     start_pos - priv->ts.packet_size;
 	demuxer->movi_start = start_pos;
+
+	ff_mutex_init(&priv->index.lock, NULL);
+	priv->index.start_pts = MP_NOPTS_VALUE;
+	if(ts_index_mode && params.vtype != UNKNOWN)
+		priv->index.path = demux_index_path(demuxer);
+	if(priv->index.path && ts_index_mode >= DEMUX_INDEX_SIDECAR)
+		ts_index_load(demuxer);
+#if HAVE_THREADS
+	if(priv->index.path)
+	{
+		ts_index_t *idx = &priv->index;
+		idx->scan_pid = params.vpid;
+		idx->scan_type = params.vtype;
+		idx->scan_progid = priv->prog;
+		idx->scan_packet_size = priv->ts.packet_size;
+		idx->scan_start = start_pos;
+		demux_index_scan_start(&idx->scan, ts_index_scan, idx, start_pos);
+	}
+#endif
 	demuxer->reference_clock = MP_NOPTS_VALUE;
 	stream_reset(demuxer->stream);
 	stream_seek(demuxer->stream, start_pos);	//IF IT'S FROM A PIPE IT WILL FAIL, BUT WHO CARES?
@@ -1132,6 +1532,14 @@ static void demux_close_ts(demuxer_t * demuxer)
 				free_demux_packet(priv->fifo[i].pack);
 			priv->fifo[i].pack = NULL;
 		}
+		demux_index_scan_stop(&priv->index.scan);
+		if (priv->index.path && ts_index_mode >= DEMUX_INDEX_SIDECAR)
+			ts_index_save(demuxer);
+		for (i = 0; i < priv->index.progs_cnt; i++)
+			free(priv->index.progs[i].entries);
+		free(priv->index.progs);
+		free(priv->index.path);
+		ff_mutex_destroy(&priv->index.lock);
 		free(priv);
 	}
 	demuxer->priv=NULL;
@@ -2740,6 +3148,13 @@ static int fill_packet(demuxer_t *demuxer, demux_stream_t *ds, demux_packet_t **
 			si->size += ret;
 			dur = si->duration + (si->last_pts - si->first_pts);
 
+			if(ds == demuxer->video)
+			{
+				ts_priv_t * priv = (ts_priv_t*) demuxer->priv;
+				if(priv->index.start_pts == MP_NOPTS_VALUE)
+					priv->index.start_pts = (*dp)->pts;
+			}
+
 			if(dur > 0 && ds == demuxer->video)
 			{
 				ts_priv_t * priv = (ts_priv_t*) demuxer->priv;
@@ -2792,6 +3207,7 @@ static int ts_parse(demuxer_t *demuxer , ES_stream_t *es, int probe)
 	int *dp_offset = 0, *buffer_size = 0;
 	int32_t progid, pid_type, bad, ts_error;
 	int junk = 0, rap_flag = 0;
+	off_t pkt_pos;
 	pmt_t *pmt;
 	mp4_decoder_config_t *mp4_dec;
 	TS_stream_info *si;
@@ -2830,6 +3246,7 @@ static int ts_parse(demuxer_t *demuxer , ES_stream_t *es, int probe)
 			mp_msg(MSGT_DEMUX, MSGL_INFO, "TS_PARSE: COULDN'T SYNC\n");
 			return 0;
 		}
+		pkt_pos = stream_tell(stream) - 1;
 
 		len = stream_read(stream, &packet[1], 3);
 		if (len != 3)
@@ -3128,6 +3545,8 @@ static int ts_parse(demuxer_t *demuxer , ES_stream_t *es, int probe)
 			}
 			else
 			{
+				int has_pts = es->pts != 0.0;
+
 				if(es->pts == 0.0)
 					es->pts = tss->pts = tss->last_pts;
 				else
@@ -3142,6 +3561,9 @@ static int ts_parse(demuxer_t *demuxer , ES_stream_t *es, int probe)
 					mp_msg(MSGT_DEMUX, MSGL_ERR, "Broken ES packet size\n");
 					es->size = 0;
 				}
+				if(ts_index_mode && ds == demuxer->video && has_pts &&
+				   (rap_flag || ts_index_is_keyframe(es->type, es->start, es->size)))
+					ts_index_add(&priv->index, priv->prog, es->pts, pkt_pos);
 				memmove(p, es->start, es->size);
 				*dp_offset += es->size;
 				(*dp)->flags = 0;
@@ -3261,7 +3683,8 @@ static void demux_seek_ts(demuxer_t *demuxer, float rel_seek_secs, float audio_d
 	sh_video_t *sh_video=d_video->sh;
 	ts_priv_t * priv = (ts_priv_t*) demuxer->priv;
 	int i, video_stats;
-	off_t newpos;
+	off_t newpos, curpos = demuxer->filepos;
+	double curpts = sh_video ? sh_video->pts : 0, target = MP_NOPTS_VALUE;
 
 	//================= seek in MPEG-TS ==========================
 
@@ -3282,9 +3705,19 @@ static void demux_seek_ts(demuxer_t *demuxer, float rel_seek_secs, float audio_d
 			video_stats = sh_video->i_bps;
 	}
 
+	if(flags & SEEK_FACTOR)
+		;
+	else if(flags & SEEK_ABSOLUTE)
+		target = priv->index.start_pts == MP_NOPTS_VALUE ? MP_NOPTS_VALUE : priv->index.start_pts + rel_seek_secs;
+	else if(curpts != 0)
+		target = curpts + rel_seek_secs;
+
 	newpos = (flags & SEEK_ABSOLUTE) ? demuxer->movi_start : demuxer->filepos;
 	if(flags & SEEK_FACTOR) // float seek 0..1
 		newpos+=(demuxer->movi_end-demuxer->movi_start)*rel_seek_secs;
+	else if(ts_index_mode && sh_video && target != MP_NOPTS_VALUE &&
+		ts_index_lookup(&priv->index, priv->prog, target, target > curpts, curpos, &newpos))
+		mp_msg(MSGT_DEMUX, MSGL_V, "TS index: seek to %.3f at %"PRIu64"\n", target, (uint64_t) newpos);
 	else
 	{
 		// time seek (secs)
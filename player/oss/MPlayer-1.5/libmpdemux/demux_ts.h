@@ -26,6 +26,7 @@
 extern off_t ts_probe;
 extern int   ts_prog;
 extern int   ts_keep_broken;
+extern int   ts_index_mode;
 extern int audio_substream_id;
 
 #endif /* MPLAYER_DEMUX_TS_H */
@@ -412,14 +412,15 @@ static int demux_vivo_fill_buffer(demuxer_t *demux, demux_stream_t *dsds){
       } else {
         // append data to it!
         demux_packet_t* dp=ds->asf_packet;
+        int oldlen=dp->len;
         if(dp->len + len + MP_INPUT_BUFFER_PADDING_SIZE < 0)
 	    return 0;
-        dp->buffer=realloc(dp->buffer,dp->len+len+MP_INPUT_BUFFER_PADDING_SIZE);
-        memset(dp->buffer+dp->len+len, 0, MP_INPUT_BUFFER_PADDING_SIZE);
-        //memcpy(dp->buffer+dp->len,data,len);
-	stream_read(demux->stream,dp->buffer+dp->len,len);
-        mp_dbg(MSGT_DEMUX,MSGL_DBG4,"data appended! %d+%d\n",dp->len,len);
-        dp->len+=len;
+        resize_demux_packet(dp,dp->len+len);
+        if(dp->len!=oldlen+len)
+	    return 0;
+        //memcpy(dp->buffer+oldlen,data,len);
+	stream_read(demux->stream,dp->buffer+oldlen,len);
+        mp_dbg(MSGT_DEMUX,MSGL_DBG4,"data appended! %d+%d\n",oldlen,len);
         // we are ready now.
 	if((c&0xF0)==0x20) --ds->asf_seq; // hack!
         return 1;
@@ -131,6 +131,10 @@ typedef struct demux_packet {
   struct demux_packet* next;
 } demux_packet_t;
 
+// only needed to restore the decoder state, e.g. the MP3 bit reservoir
+// after a seek; its output is to be dropped
+#define DP_PREROLL 0x100
+
 typedef struct {
   int buffer_pos;          // current buffer position
   int buffer_size;         // current buffer size
@@ -282,70 +286,24 @@ typedef struct {
   int aid, vid, sid; //audio, video and subtitle id
 } demux_program_t;
 
-static inline demux_packet_t* new_demux_packet(int len){
-  demux_packet_t* dp=(demux_packet_t*)malloc(sizeof(demux_packet_t));
-  dp->len=len;
-  dp->next=NULL;
-  dp->pts=MP_NOPTS_VALUE;
-  dp->endpts=MP_NOPTS_VALUE;
-  dp->stream_pts = MP_NOPTS_VALUE;
-  dp->pos=0;
-  dp->flags=0;
-  dp->refcount=1;
-  dp->master=NULL;
-  dp->buffer=NULL;
-  if (len > 0 && (dp->buffer = (unsigned char *)malloc(len + MP_INPUT_BUFFER_PADDING_SIZE)))
-    memset(dp->buffer + len, 0, MP_INPUT_BUFFER_PADDING_SIZE);
-  else if (len) {
-    // do not even return a valid packet if allocation failed
-    free(dp);
-    return NULL;
-  }
-  return dp;
-}
-
-static inline void resize_demux_packet(demux_packet_t* dp, int len)
-{
-  if(len > 0)
-  {
-     dp->buffer=(unsigned char *)realloc(dp->buffer,len + MP_INPUT_BUFFER_PADDING_SIZE);
-  }
-  else
-  {
-     free(dp->buffer);
-     dp->buffer=NULL;
-  }
-  dp->len=len;
-  if (dp->buffer)
-     memset(dp->buffer + len, 0, MP_INPUT_BUFFER_PADDING_SIZE);
-  else
-     dp->len = 0;
-}
-
-static inline demux_packet_t* clone_demux_packet(demux_packet_t* pack){
-  demux_packet_t* dp=(demux_packet_t*)malloc(sizeof(demux_packet_t));
-  while(pack->master) pack=pack->master; // find the master
-  memcpy(dp,pack,sizeof(demux_packet_t));
-  dp->next=NULL;
-  dp->refcount=0;
-  dp->master=pack;
-  pack->refcount++;
-  return dp;
-}
-
-static inline void free_demux_packet(demux_packet_t* dp){
-  if (dp->master==NULL){  //dp is a master packet
-    dp->refcount--;
-    if (dp->refcount==0){
-      free(dp->buffer);
-      free(dp);
-    }
-    return;
-  }
-  // dp is a clone:
-  free_demux_packet(dp->master);
-  free(dp);
-}
+typedef struct demux_packet_stats {
+  unsigned packets;  // packet headers allocated, clones included
+  unsigned requests; // payload buffers allocated
+  unsigned large;    // of those, too large for any slab
+  unsigned copies;   // resizes that had to move the payload
+  unsigned slabs;    // slabs allocated
+  int64_t peak_bytes;
+} demux_packet_stats_t;
+
+// Packets and their payloads come from slab caches, see demux_packet.c.
+// The payload is always followed by MP_INPUT_BUFFER_PADDING_SIZE zero bytes,
+// use resize_demux_packet() and never realloc() or free() it directly.
+demux_packet_t* new_demux_packet(int len);
+void resize_demux_packet(demux_packet_t* dp, int len);
+demux_packet_t* clone_demux_packet(demux_packet_t* pack);
+void free_demux_packet(demux_packet_t* dp);
+void demux_packet_get_stats(demux_packet_stats_t *stats);
+void demux_packet_uninit(void);
 
 #ifndef SIZE_MAX
 #define SIZE_MAX ((size_t)-1)
@@ -49,6 +49,7 @@
 #include "sub/av_sub.h"
 #include "sub/sub_cc.h"
 #include "libmpcodecs/dec_teletext.h"
+#include "libmpcodecs/mp_image.h"
 #include "libavutil/intreadwrite.h"
 #include "m_option.h"
 #include "mpcommon.h"
@@ -75,12 +76,12 @@ void print_version(const char* name)
     GetCpuCaps(&gCpuCaps);
 #if ARCH_X86
     mp_msg(MSGT_CPLAYER, MSGL_V,
-           "CPUflags:  MMX: %d MMX2: %d 3DNow: %d 3DNowExt: %d SSE: %d SSE2: %d SSE3: %d SSSE3: %d SSE4: %d SSE4.2: %d AVX: %d\n",
+           "CPUflags:  MMX: %d MMX2: %d 3DNow: %d 3DNowExt: %d SSE: %d SSE2: %d SSE3: %d SSSE3: %d SSE4: %d SSE4.2: %d AVX: %d AVX2: %d\n",
            gCpuCaps.hasMMX, gCpuCaps.hasMMX2,
            gCpuCaps.has3DNow, gCpuCaps.has3DNowExt,
            gCpuCaps.hasSSE, gCpuCaps.hasSSE2, gCpuCaps.hasSSE3,
            gCpuCaps.hasSSSE3, gCpuCaps.hasSSE4, gCpuCaps.hasSSE42,
-           gCpuCaps.hasAVX);
+           gCpuCaps.hasAVX, gCpuCaps.hasAVX2);
 #if CONFIG_RUNTIME_CPUDETECT
     mp_msg(MSGT_CPLAYER, MSGL_V, "Compiled with runtime CPU detection.\n");
 #else
@@ -107,6 +108,8 @@ if (HAVE_SSE42)
     mp_msg(MSGT_CPLAYER,MSGL_V," SSE4.2");
 if (HAVE_AVX)
     mp_msg(MSGT_CPLAYER,MSGL_V," AVX");
+if (HAVE_AVX2)
+    mp_msg(MSGT_CPLAYER,MSGL_V," AVX2");
 if (HAVE_I686)
     mp_msg(MSGT_CPLAYER,MSGL_V," CMOV");
     mp_msg(MSGT_CPLAYER,MSGL_V,"\n");
@@ -659,6 +662,8 @@ void common_uninit(void)
     ass_library_done(ass_library);
     ass_library = NULL;
 #endif
+    mp_image_pool_uninit();
+    demux_packet_uninit();
 }
 
 /// Returns a_pts
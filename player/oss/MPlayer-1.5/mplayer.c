@@ -1808,8 +1808,13 @@ static int generate_video_frame(sh_video_t *sh_video, demux_stream_t *d_video)
                 break;
         } else if (drop_frame)
             return -1;
-        if (hit_eof)
+        if (hit_eof) {
+            // frames may still be on their way through threaded filters
+            if (((vf_instance_t *)sh_video->vfilter)->control(sh_video->vfilter,
+                    VFCTRL_DRAIN_FRAMES, NULL) == CONTROL_TRUE)
+                continue;
             return 0;
+        }
     }
     return 1;
 }
@@ -2327,6 +2332,17 @@ int reinit_video_chain(void)
             mp_msg(MSGT_CPLAYER, MSGL_ERR, MSGTR_FPSnotspecified);
             correct_pts = 1;
         }
+        // without the pts of the frames leaving the threads, the video
+        // would lag by the frames still being filtered
+        if (!correct_pts && vf_settings) {
+            int i;
+            for (i = 0; vf_settings[i].name; i++)
+                if (!strcmp(vf_settings[i].name, "thread")) {
+                    mp_msg(MSGT_CPLAYER, MSGL_ERR, MSGTR_ThreadNeedsCorrectPts);
+                    correct_pts = 1;
+                    break;
+                }
+        }
     }
     //================== Init VIDEO (codec & libvo) ==========================
     if (!fixed_vo || !(initialized_flags & INITIALIZED_VO)) {
@@ -4112,6 +4128,14 @@ goto_next_file:  // don't jump here after ao/vo/getch initialization!
                    100 * drop_frame_cnt / total_frame_cnt,
                    total_frame_cnt,
                    (total_time_usage > 0.5) ? (total_frame_cnt / total_time_usage) : 0);
+        {
+            mp_image_pool_stats_t pool;
+            mp_image_pool_get_stats(&pool);
+            mp_msg(MSGT_CPLAYER, MSGL_INFO, "BENCHMARKp: image buffers: %u requests, %u reused (%u%%), %u released, peak %"PRId64" kB\n",
+                   pool.requests, pool.reused,
+                   pool.requests ? 100 * pool.reused / pool.requests : 0,
+                   pool.released, pool.peak_bytes >> 10);
+        }
     }
 
     // time to uninit all, except global stuff:
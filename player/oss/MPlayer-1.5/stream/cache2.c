@@ -18,51 +18,34 @@
 
 #include "config.h"
 
-// Initial draft of my new cache system...
-// Note it runs in 2 processes (using fork()), but doesn't require locking!!
-// TODO: seeking, data consistency checking
+// Stream cache, filled by a thread.
+// The buffer is split into blocks, each holding one aligned piece of the
+// file, so several disjoint ranges can be cached at once. Seeking to a
+// cached range is served from memory; blocks of ranges not used for the
+// longest time are recycled first, then the oldest ones behind the read
+// position. How far ahead the thread reads follows the rate at which the
+// data is consumed.
 
 #define READ_SLEEP_TIME 10
-// These defines are used to reduce the cost of many successive
-// seeks (e.g. when a file has no index) by spinning quickly at first.
-#define INITIAL_FILL_USLEEP_TIME 1000
-#define INITIAL_FILL_USLEEP_COUNT 10
-#define FILL_USLEEP_TIME 50000
 #define PREFILL_SLEEP_TIME 200
 #define CONTROL_SLEEP_TIME 1
+// size of a cache block, rounded to a multiple of the sector size
+#define BLOCK_SIZE (64 * 1024)
+#define MIN_BLOCKS 16
+// the consumption rate is measured this often (ms)
+#define RATE_INTERVAL 500
+// read ahead this many seconds of data at the measured rate
+#define READAHEAD_TIME 10
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <signal.h>
-#include <sys/types.h>
-#include <unistd.h>
 #include <errno.h>
 
 #include "libavutil/avutil.h"
 #include "libavutil/common.h"
-#include "osdep/shmem.h"
+#include "libavutil/thread.h"
 #include "osdep/timer.h"
-#if defined(__MINGW32__)
-#include <windows.h>
-#ifdef _MSC_VER
-#include <process.h>
-#endif
-static void ThreadProc( void *s );
-#elif defined(__OS2__)
-#define INCL_DOS
-#include <os2.h>
-static void ThreadProc( void *s );
-#elif defined(PTHREAD_CACHE)
-#include <pthread.h>
-static void *ThreadProc(void *s);
-#else
-#include <sys/wait.h>
-#define FORKED_CACHE 1
-#endif
-#ifndef FORKED_CACHE
-#define FORKED_CACHE 0
-#endif
 
 #include "mp_msg.h"
 #include "help_mp.h"
@@ -72,198 +55,306 @@ static void *ThreadProc(void *s);
 #include "mp_global.h"
 
 typedef struct {
-  // constats:
-  unsigned char *buffer;      // base pointer of the allocated buffer memory
-  int64_t buffer_size; // size of the allocated buffer memory
-  int sector_size; // size of a single sector (2048/2324)
-  int64_t back_size;   // we should keep back_size amount of old bytes for backward seek
-  int64_t fill_limit;  // we should fill buffer only if space>=fill_limit
-  int64_t seek_limit;  // keep filling cache if distance is less that seek limit
-#if FORKED_CACHE
-  pid_t ppid; // parent PID to detect killed parent
-#endif
-  // filler's pointers:
-  int eof;
-  int64_t min_filepos; // buffer contain only a part of the file, from min-max pos
-  int64_t max_filepos;
-  int64_t offset;      // filepos <-> bufferpos  offset value (filepos of the buffer's first byte)
-  // reader's pointers:
+  int64_t filepos; // file position of the block start, -1 if unused
+  int lo, hi;      // the valid bytes are [lo, hi)
+  int next;        // next block in the same hash chain, -1 ends it
+  unsigned last_use;
+} cache_block_t;
+
+typedef struct {
+  // constants:
+  unsigned char *buffer; // memory of all blocks
+  int64_t buffer_size;
+  int sector_size;       // size of a single sector (2048/2324)
+  int block_size;
+  int num_blocks;
+  int hash_mask;
+  int64_t back_size;     // keep this much behind the read position if possible
+  int64_t seek_limit;    // read on instead of seeking if the gap is smaller
+  int64_t seek_target;   // a stream that cannot seek there is read up to it
+  int64_t min_readahead;
+  int64_t max_readahead;
+  int adaptive;          // readahead follows the consumption rate
+  // shared state, protected by lock:
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t wakeup; // the filler has something to do
+  int idle;              // the filler waits for wakeup
+  cache_block_t *blocks;
+  int *hash;             // first block of each hash chain
+  unsigned use_count;    // clock for last_use
   int64_t read_filepos;
-  // commands/locking:
-//  int seek_lock;   // 1 if we will seek/reset buffer, 2 if we are ready for cmd
-//  int fifo_flag;  // 1 if we should use FIFO to notice cache about buffer reads.
-  // callback
+  int64_t eof_pos;       // where the stream ended, -1 if unknown
+  int64_t ahead_end;     // end of the data cached from read_filepos on
+  int64_t readahead;     // current readahead target
+  int64_t filled;        // total bytes read from the stream
+  int64_t consumed;      // total bytes given to the reader
+  int64_t rate;          // bytes per second consumed
+  int64_t rate_consumed;
+  unsigned rate_time;
+  // the filler's copy of the stream:
   stream_t* stream;
-  volatile int control;
-  volatile uint64_t control_uint_arg;
-  volatile double control_double_arg;
-  volatile char *control_char_p_arg;
-  volatile struct stream_lang_req control_lang_arg;
-  volatile int control_res;
-  volatile double stream_time_length;
-  volatile double stream_time_pos;
+  int control;
+  uint64_t control_uint_arg;
+  double control_double_arg;
+  char *control_char_p_arg;
+  struct stream_lang_req control_lang_arg;
+  int control_res;
+  double stream_time_length;
+  double stream_time_pos;
+  int time_dirty;        // the stream was read since the times were updated
+  unsigned time_update;
 } cache_vars_t;
 
-static void cache_wakeup(stream_t *s)
+static int cache_hash(cache_vars_t *s, int64_t filepos)
+{
+  return (filepos / s->block_size) & s->hash_mask;
+}
+
+static cache_block_t *cache_find_block(cache_vars_t *s, int64_t pos)
+{
+  int64_t filepos = pos - pos % s->block_size;
+  int i;
+  for (i = s->hash[cache_hash(s, filepos)]; i >= 0; i = s->blocks[i].next)
+    if (s->blocks[i].filepos == filepos)
+      return &s->blocks[i];
+  return NULL;
+}
+
+static void cache_unlink_block(cache_vars_t *s, cache_block_t *b)
 {
-#if FORKED_CACHE
-  // signal process to wake up immediately
-  kill(s->cache_pid, SIGUSR1);
-#endif
+  int *link = &s->hash[cache_hash(s, b->filepos)];
+  while (&s->blocks[*link] != b)
+    link = &s->blocks[*link].next;
+  *link = b->next;
+  b->filepos = -1;
 }
 
 static void cache_flush(cache_vars_t *s)
 {
-  s->offset= // FIXME!?
-  s->min_filepos=s->max_filepos=s->read_filepos; // drop cache content :(
+  int i;
+  for (i = 0; i <= s->hash_mask; i++)
+    s->hash[i] = -1;
+  for (i = 0; i < s->num_blocks; i++)
+    s->blocks[i].filepos = -1;
+}
+
+/**
+ * \return the first position at or after pos that is not cached
+ */
+static int64_t cache_range_end(cache_vars_t *s, int64_t pos)
+{
+  cache_block_t *b;
+  while ((b = cache_find_block(s, pos))) {
+    int off = pos - b->filepos;
+    if (off < b->lo || off >= b->hi)
+      break;
+    pos = b->filepos + b->hi;
+    if (b->hi < s->block_size)
+      break;
+  }
+  return pos;
+}
+
+static unsigned char *block_data(cache_vars_t *s, cache_block_t *b)
+{
+  return s->buffer + (int64_t)(b - s->blocks) * s->block_size;
+}
+
+/**
+ * Find a block to recycle: unused ones first, then the least recently used
+ * one outside the readahead and the backward seek area, then the one
+ * furthest behind the read position.
+ */
+static cache_block_t *cache_get_block(cache_vars_t *s)
+{
+  int64_t ahead_start = s->read_filepos - s->read_filepos % s->block_size;
+  int64_t ahead_end = s->read_filepos + s->readahead;
+  int64_t back_start = s->read_filepos - s->back_size;
+  cache_block_t *lru = NULL, *behind = NULL;
+  int i;
+  for (i = 0; i < s->num_blocks; i++) {
+    cache_block_t *b = &s->blocks[i];
+    if (b->filepos < 0)
+      return b;
+    if (b->filepos >= ahead_start && b->filepos < ahead_end)
+      continue;
+    if (b->filepos < ahead_start && b->filepos + s->block_size > back_start) {
+      if (!behind || b->filepos < behind->filepos)
+        behind = b;
+    } else if (!lru || (int)(b->last_use - lru->last_use) < 0)
+      lru = b;
+  }
+  if (!lru)
+    lru = behind;
+  if (lru)
+    cache_unlink_block(s, lru);
+  return lru;
 }
 
 static int cache_read(cache_vars_t *s, unsigned char *buf, int size)
 {
   int total=0;
   int sleep_count = 0;
-  int64_t last_max = s->max_filepos;
+  int64_t last_filled;
+  pthread_mutex_lock(&s->lock);
+  last_filled = s->filled;
   while(size>0){
-    int64_t pos,newb,len;
-
-  //printf("CACHE2_READ: 0x%X <= 0x%X <= 0x%X  \n",s->min_filepos,s->read_filepos,s->max_filepos);
-
-    if(s->read_filepos>=s->max_filepos || s->read_filepos<s->min_filepos){
-	// eof?
-	if(s->eof) break;
-	if (s->max_filepos == last_max) {
-	    if (sleep_count++ == 10)
-	        mp_msg(MSGT_CACHE, MSGL_WARN, "Cache empty, consider increasing -cache and/or -cache-min. [performance issue]\n");
-	} else {
-	    last_max = s->max_filepos;
-	    sleep_count = 0;
-	}
-	// waiting for buffer fill...
-	if (stream_check_interrupt(READ_SLEEP_TIME)) {
-	    s->eof = 1;
-	    break;
-	}
-	continue; // try again...
+    cache_block_t *b = cache_find_block(s, s->read_filepos);
+    int off = b ? s->read_filepos - b->filepos : 0;
+    int len;
+
+    if (!b || off < b->lo || off >= b->hi) {
+      // eof?
+      if (s->eof_pos >= 0 && s->read_filepos >= s->eof_pos) break;
+      if (s->filled == last_filled) {
+        if (sleep_count++ == 10)
+          mp_msg(MSGT_CACHE, MSGL_WARN, "Cache empty, consider increasing -cache and/or -cache-min. [performance issue]\n");
+      } else {
+        last_filled = s->filled;
+        sleep_count = 0;
+      }
+      // waiting for buffer fill...
+      pthread_cond_signal(&s->wakeup);
+      pthread_mutex_unlock(&s->lock);
+      if (stream_check_interrupt(READ_SLEEP_TIME)) {
+        pthread_mutex_lock(&s->lock);
+        s->eof_pos = s->read_filepos;
+        break;
+      }
+      pthread_mutex_lock(&s->lock);
+      continue; // try again...
     }
     sleep_count = 0;
 
-    newb=s->max_filepos-s->read_filepos; // new bytes in the buffer
-
-//    printf("*** newb: %d bytes ***\n",newb);
-
-    pos=s->read_filepos - s->offset;
-    if(pos<0) pos+=s->buffer_size; else
-    if(pos>=s->buffer_size) pos-=s->buffer_size;
-
-    if(newb>s->buffer_size-pos) newb=s->buffer_size-pos; // handle wrap...
-    if(newb>size) newb=size;
-
-    // check:
-    if(s->read_filepos<s->min_filepos) mp_msg(MSGT_CACHE,MSGL_ERR,"Ehh. s->read_filepos<s->min_filepos !!! Report bug...\n");
-
-    // len=write(mem,newb)
-    //printf("Buffer read: %d bytes\n",newb);
-    memcpy(buf,&s->buffer[pos],newb);
-    buf+=newb;
-    len=newb;
-    // ...
-
+    len = FFMIN(b->hi - off, size);
+    memcpy(buf, block_data(s, b) + off, len);
+    b->last_use = ++s->use_count;
+    buf+=len;
     s->read_filepos+=len;
+    s->consumed+=len;
     size-=len;
     total+=len;
-
   }
+  // wake up the filler once there is room for another block
+  if (s->idle && s->ahead_end - s->read_filepos < s->readahead - s->block_size &&
+      (s->eof_pos < 0 || s->ahead_end < s->eof_pos))
+    pthread_cond_signal(&s->wakeup);
+  pthread_mutex_unlock(&s->lock);
   return total;
 }
 
-static int cache_fill(cache_vars_t *s)
+static void cache_update_readahead(cache_vars_t *s)
 {
-  int64_t back,back2,newb,space,len,pos;
-  int64_t read=s->read_filepos;
-  int read_chunk;
-  int wraparound_copy = 0;
-
-  if(read<s->min_filepos || read>s->max_filepos){
-      // seek...
-      mp_msg(MSGT_CACHE,MSGL_DBG2,"Out of boundaries... seeking to 0x%"PRIX64"  \n",read);
-      // drop cache contents only if seeking backward or too much fwd.
-      // This is also done for on-disk files, since it loses the backseek cache.
-      // That in turn can cause major bandwidth increase and performance
-      // issues with e.g. mov or badly interleaved files
-      if(read<s->min_filepos || read>=s->max_filepos+s->seek_limit)
-      {
-        cache_flush(s);
-        if(s->stream->eof) stream_reset(s->stream);
-        stream_seek_internal(s->stream,read);
-        mp_msg(MSGT_CACHE,MSGL_DBG2,"Seek done. new pos: 0x%"PRIX64"  \n",(int64_t)stream_tell(s->stream));
-      }
-  }
-
-  // calc number of back-bytes:
-  back=read - s->min_filepos;
-  if(back<0) back=0; // strange...
-  if(back>s->back_size) back=s->back_size;
-
-  // calc number of new bytes:
-  newb=s->max_filepos - read;
-  if(newb<0) newb=0; // strange...
-
-  // calc free buffer space:
-  space=s->buffer_size - (newb+back);
-
-  // calc bufferpos:
-  pos=s->max_filepos - s->offset;
-  if(pos>=s->buffer_size) pos-=s->buffer_size; // wrap-around
-
-  if(space<s->fill_limit){
-//    printf("Buffer is full (%d bytes free, limit: %d)\n",space,s->fill_limit);
-    return 0; // no fill...
-  }
-
-//  printf("### read=0x%X  back=%d  newb=%d  space=%d  pos=%d\n",read,back,newb,space,pos);
+  unsigned now = GetTimerMS();
+  unsigned elapsed = now - s->rate_time;
+  int64_t rate;
+  if (elapsed < RATE_INTERVAL)
+    return;
+  rate = (s->consumed - s->rate_consumed) * 1000 / elapsed;
+  // smooth out the bursts of demuxers reading whole packets
+  s->rate = (3 * s->rate + rate) / 4;
+  s->rate_consumed = s->consumed;
+  s->rate_time = now;
+  if (s->adaptive)
+    s->readahead = av_clip64(s->rate * READAHEAD_TIME,
+                             s->min_readahead, s->max_readahead);
+}
 
-  // try to avoid wrap-around. If not possible due to sector size
-  // do an extra copy.
-  if(space>s->buffer_size-pos) {
-    if (s->buffer_size-pos >= s->sector_size) {
-      space=s->buffer_size-pos;
-    } else {
-      space = s->sector_size;
-      wraparound_copy = 1;
+/**
+ * Read the next piece of the stream into the cache.
+ * Called with the lock held, which is released while reading.
+ * \return number of bytes read, 0 if there was nothing to do
+ */
+static int cache_fill(cache_vars_t *s)
+{
+  stream_t *stream = s->stream;
+  cache_block_t *b;
+  unsigned char *dest;
+  int64_t need, fill_pos;
+  int off, len, read_chunk, discard = 0;
+
+  need = s->ahead_end = cache_range_end(s, s->read_filepos);
+  if (s->eof_pos >= 0 && need >= s->eof_pos)
+    return 0;
+  if (need - s->read_filepos >= s->readahead)
+    return 0;
+
+  fill_pos = stream->pos;
+  if ((fill_pos > need || need - fill_pos > s->seek_limit) &&
+      (need != s->seek_target || fill_pos > need)) {
+    // seek only if the gap is too big to read through
+    mp_msg(MSGT_CACHE,MSGL_DBG2,"Out of boundaries... seeking to 0x%"PRIX64"  \n",need);
+    if(stream->eof) stream_reset(stream);
+    stream_seek_internal(stream,need);
+    mp_msg(MSGT_CACHE,MSGL_DBG2,"Seek done. new pos: 0x%"PRIX64"  \n",(int64_t)stream_tell(stream));
+    fill_pos = stream->pos;
+    s->seek_target = need;
+    if (fill_pos > need) {
+      // cannot seek back, this data is gone for good
+      s->eof_pos = need;
+      return 0;
     }
   }
 
   // limit one-time block size
-  read_chunk = s->stream->read_chunk;
+  read_chunk = stream->read_chunk;
   if (!read_chunk) read_chunk = 4*s->sector_size;
-  space = FFMIN(space, read_chunk);
-
-#if 1
-  // back+newb+space <= buffer_size
-  back2=s->buffer_size-(space+newb); // max back size
-  if(s->min_filepos<(read-back2)) s->min_filepos=read-back2;
-#else
-  s->min_filepos=read-back; // avoid seeking-back to temp area...
-#endif
-
-  if (wraparound_copy) {
-    int to_copy;
-    len = stream_read_internal(s->stream, s->stream->buffer, space);
-    to_copy = FFMIN(len, s->buffer_size-pos);
-    memcpy(s->buffer + pos, s->stream->buffer, to_copy);
-    memcpy(s->buffer, s->stream->buffer + to_copy, len - to_copy);
-  } else
-  len = stream_read_internal(s->stream, &s->buffer[pos], space);
-  s->eof= !len;
-
-  s->max_filepos+=len;
-  if(pos+len>=s->buffer_size){
-      // wrap...
-      s->offset+=s->buffer_size;
+
+  b = cache_find_block(s, fill_pos);
+  if (!b) {
+    b = cache_get_block(s);
+    if (!b)
+      return 0;
+    b->filepos = fill_pos - fill_pos % s->block_size;
+    b->lo = b->hi = 0;
+    b->next = s->hash[cache_hash(s, b->filepos)];
+    s->hash[cache_hash(s, b->filepos)] = b - s->blocks;
+  }
+  off = fill_pos - b->filepos;
+  len = FFMIN(read_chunk, s->block_size - off);
+  if (off >= b->lo && off < b->hi) {
+    // reading through data we already have
+    dest = stream->buffer;
+    len = FFMIN(len, b->hi - off);
+    len = FFMIN(len, sizeof(stream->buffer));
+    discard = 1;
+  } else {
+    if (off != b->hi)
+      b->lo = b->hi = off;
+    dest = block_data(s, b) + off;
   }
+  b->last_use = ++s->use_count;
+
+  // the reader only looks at [lo, hi), so no lock is needed here
+  pthread_mutex_unlock(&s->lock);
+  len = stream_read_internal(stream, dest, len);
+  pthread_mutex_lock(&s->lock);
 
+  if (len <= 0) {
+    s->eof_pos = fill_pos;
+    return 0;
+  }
+  if (!discard)
+    b->hi = off + len;
+  s->filled += len;
+  s->time_dirty = 1;
   return len;
+}
 
+static void cache_update_times(cache_vars_t *s)
+{
+  double len, pos;
+  if (s->stream->control(s->stream, STREAM_CTRL_GET_TIME_LENGTH, &len) == STREAM_OK)
+    s->stream_time_length = len;
+  else
+    s->stream_time_length = 0;
+  if (s->stream->control(s->stream, STREAM_CTRL_GET_CURRENT_TIME, &pos) == STREAM_OK)
+    s->stream_time_pos = pos;
+  else
+    s->stream_time_pos = MP_NOPTS_VALUE;
+  s->time_dirty = 0;
+  s->time_update = GetTimerMS();
 }
 
 static int cache_execute_control(cache_vars_t *s) {
@@ -271,7 +362,6 @@ static int cache_execute_control(cache_vars_t *s) {
   unsigned uint_res;
   uint64_t uint64_res;
   int needs_flush = 0;
-  static unsigned last;
   int quit = s->control == -2;
   uint64_t old_pos = s->stream->pos;
   int old_eof = s->stream->eof;
@@ -282,26 +372,6 @@ static int cache_execute_control(cache_vars_t *s) {
     s->control = -1;
     return !quit;
   }
-  if (GetTimerMS() - last > 99) {
-    double len, pos;
-    if (s->stream->control(s->stream, STREAM_CTRL_GET_TIME_LENGTH, &len) == STREAM_OK)
-      s->stream_time_length = len;
-    else
-      s->stream_time_length = 0;
-    if (s->stream->control(s->stream, STREAM_CTRL_GET_CURRENT_TIME, &pos) == STREAM_OK)
-      s->stream_time_pos = pos;
-    else
-      s->stream_time_pos = MP_NOPTS_VALUE;
-#if FORKED_CACHE
-    // if parent PID changed, main process was killed -> exit
-    if (s->ppid != getppid()) {
-      mp_msg(MSGT_CACHE, MSGL_WARN, "Parent process disappeared, exiting cache process.\n");
-      return 0;
-    }
-#endif
-    last = GetTimerMS();
-  }
-  if (s->control == -1) return 1;
   switch (s->control) {
     case STREAM_CTRL_SEEK_TO_TIME:
       needs_flush = 1;
@@ -339,9 +409,11 @@ static int cache_execute_control(cache_vars_t *s) {
       break;
   }
   if (s->control_res == STREAM_OK && needs_flush) {
+    // the same file positions may now hold different data
     s->read_filepos = s->stream->pos;
-    s->eof = s->stream->eof;
+    s->eof_pos = s->stream->eof ? s->read_filepos : -1;
     cache_flush(s);
+    cache_update_times(s);
   } else if (needs_flush &&
              (old_pos != s->stream->pos || old_eof != s->stream->eof))
     mp_msg(MSGT_STREAM, MSGL_ERR, "STREAM_CTRL changed stream pos but returned error, this is not allowed!\n");
@@ -349,108 +421,95 @@ static int cache_execute_control(cache_vars_t *s) {
   return 1;
 }
 
-static void *shared_alloc(int64_t size) {
-#if FORKED_CACHE
-    return shmem_alloc(size);
-#else
-    return malloc(size);
-#endif
-}
-
-static void shared_free(void *ptr, int64_t size) {
-#if FORKED_CACHE
-    shmem_free(ptr, size);
-#else
-    free(ptr);
-#endif
-}
-
 static cache_vars_t* cache_init(int64_t size,int sector){
   int64_t num;
-  cache_vars_t* s=shared_alloc(sizeof(cache_vars_t));
+  int i;
+  cache_vars_t* s=calloc(1, sizeof(cache_vars_t));
   if(s==NULL) return NULL;
 
-  memset(s,0,sizeof(cache_vars_t));
   num=size/sector;
   if(num < 16){
      num = 16;
   }//32kb min_size
-  s->buffer_size=num*sector;
   s->sector_size=sector;
-  s->buffer=shared_alloc(s->buffer_size);
-
-  if(s->buffer == NULL){
-    shared_free(s, sizeof(cache_vars_t));
+  s->block_size=sector*FFMAX(1, FFMIN(BLOCK_SIZE/sector, num/MIN_BLOCKS));
+  s->num_blocks=num*sector/s->block_size;
+  s->buffer_size=(int64_t)s->num_blocks*s->block_size;
+  for (i = 1; i < 2 * s->num_blocks; i <<= 1);
+  s->hash_mask=i-1;
+  s->buffer=malloc(s->buffer_size);
+  s->blocks=malloc(s->num_blocks*sizeof(*s->blocks));
+  s->hash=malloc((s->hash_mask+1)*sizeof(*s->hash));
+
+  if(!s->buffer || !s->blocks || !s->hash){
+    free(s->buffer);
+    free(s->blocks);
+    free(s->hash);
+    free(s);
     return NULL;
   }
+  cache_flush(s);
 
-  s->fill_limit=8*sector;
   s->back_size=s->buffer_size/2;
-#if FORKED_CACHE
-  s->ppid = getpid();
-#endif
+  // leave room for a block being filled and one being read
+  s->max_readahead=s->buffer_size-2*s->block_size;
+  s->eof_pos=-1;
+  s->seek_target=-1;
+  s->control=-1;
+  s->stream_time_pos=MP_NOPTS_VALUE;
+  pthread_mutex_init(&s->lock, NULL);
+  pthread_cond_init(&s->wakeup, NULL);
   return s;
 }
 
 void cache_uninit(stream_t *s) {
   cache_vars_t* c = s->cache_data;
   if(s->cache_pid) {
-#if !FORKED_CACHE
-    cache_do_control(s, -2, NULL);
-#else
-    kill(s->cache_pid,SIGKILL);
-    waitpid(s->cache_pid,NULL,0);
-#endif
+    pthread_mutex_lock(&c->lock);
+    c->control = -2;
+    pthread_cond_signal(&c->wakeup);
+    pthread_mutex_unlock(&c->lock);
+    pthread_join(c->thread, NULL);
     s->cache_pid = 0;
   }
   if(!c) return;
-  shared_free(c->buffer, c->buffer_size);
-  c->buffer = NULL;
-  c->stream = NULL;
-  shared_free(s->cache_data, sizeof(cache_vars_t));
+  pthread_cond_destroy(&c->wakeup);
+  pthread_mutex_destroy(&c->lock);
+  free(c->buffer);
+  free(c->blocks);
+  free(c->hash);
+  if (c->stream != s)
+    free(c->stream);
+  free(c);
   s->cache_data = NULL;
 }
 
-#if FORKED_CACHE
-static void exit_sighandler(int x){
-  // close stream
-  exit(0);
-}
-
-static void dummy_sighandler(int x) {
-}
-#endif
-
 /**
- * Main loop of the cache process or thread.
+ * Main loop of the cache thread.
  */
-static void cache_mainloop(cache_vars_t *s) {
-    int sleep_count = 0;
-#if FORKED_CACHE
-    struct sigaction sa = { .sa_handler = SIG_IGN };
-    sigaction(SIGUSR1, &sa, NULL);
-#endif
+static void *cache_mainloop(void *arg) {
+    cache_vars_t *s = arg;
+    pthread_mutex_lock(&s->lock);
+    s->rate_time = GetTimerMS();
+    if (s->stream->control)
+        cache_update_times(s);
     do {
-        if (!cache_fill(s)) {
-#if FORKED_CACHE
-            // Let signal wake us up, we cannot leave this
-            // enabled since we do not handle EINTR in most places.
-            // This might need extra code to work on BSD.
-            sa.sa_handler = dummy_sighandler;
-            sigaction(SIGUSR1, &sa, NULL);
-#endif
-            if (sleep_count < INITIAL_FILL_USLEEP_COUNT) {
-                sleep_count++;
-                usec_sleep(INITIAL_FILL_USLEEP_TIME);
-            } else
-                usec_sleep(FILL_USLEEP_TIME); // idle
-#if FORKED_CACHE
-            sa.sa_handler = SIG_IGN;
-            sigaction(SIGUSR1, &sa, NULL);
-#endif
-        } else
-            sleep_count = 0;
-    } while (cache_execute_control(s));
+        if (s->control != -1)
+            continue;
+        cache_update_readahead(s);
+        if (cache_fill(s)) {
+            if (s->stream->control && GetTimerMS() - s->time_update > 99)
+                cache_update_times(s);
+            continue;
+        }
+        if (s->stream->control && s->time_dirty)
+            cache_update_times(s);
+        s->idle = 1;
+        pthread_cond_wait(&s->wakeup, &s->lock);
+        s->idle = 0;
+    } while (s->control == -1 || cache_execute_control(s));
+    pthread_mutex_unlock(&s->lock);
+    return NULL;
 }
 
 /**
@@ -459,6 +518,9 @@ static void cache_mainloop(cache_vars_t *s) {
 int stream_enable_cache(stream_t *stream,int64_t size,int64_t min,int64_t seek_limit){
   int ss = stream->sector_size ? stream->sector_size : STREAM_BUFFER_SIZE;
   int res = -1;
+  int err;
+  int64_t ahead;
+  stream_t* stream2;
   cache_vars_t* s;
 
   if (stream->flags & STREAM_NON_CACHEABLE) {
@@ -475,90 +537,69 @@ int stream_enable_cache(stream_t *stream,int64_t size,int64_t min,int64_t seek_l
   stream->cache_data=s;
   s->stream=stream; // callback
   s->seek_limit=seek_limit;
+  s->read_filepos=stream->pos;
+  s->ahead_end=stream->pos;
 
 
   //make sure that we won't wait from cache_fill
   //more data than it is allowed to fill
-  if (s->seek_limit > s->buffer_size - s->fill_limit ){
-     s->seek_limit = s->buffer_size - s->fill_limit;
+  if (s->seek_limit > s->max_readahead){
+     s->seek_limit = s->max_readahead;
   }
-  if (min > s->buffer_size - s->fill_limit) {
-     min = s->buffer_size - s->fill_limit;
+  if (min > s->max_readahead) {
+     min = s->max_readahead;
   }
-  // to make sure we wait for the cache process/thread to be active
+  // to make sure we wait for the cache thread to be active
   // before continuing
   if (min <= 0)
     min = 1;
 
-#if FORKED_CACHE
-  if((stream->cache_pid=fork())){
-    if ((pid_t)stream->cache_pid == -1)
-      stream->cache_pid = 0;
-#else
-  {
-    stream_t* stream2=malloc(sizeof(stream_t));
-    memcpy(stream2,s->stream,sizeof(stream_t));
-    s->stream=stream2;
-#if defined(__MINGW32__)
-    stream->cache_pid = _beginthread( ThreadProc, 0, s );
-#elif defined(__OS2__)
-    stream->cache_pid = _beginthread( ThreadProc, NULL, 256 * 1024, s );
-#else
-    {
-    pthread_t tid;
-    pthread_create(&tid, NULL, ThreadProc, s);
-    stream->cache_pid = 1;
-    }
-#endif
-#endif
-    if (!stream->cache_pid) {
-        mp_msg(MSGT_CACHE, MSGL_ERR,
-               "Starting cache process/thread failed: %s.\n", strerror(errno));
-        goto err_out;
-    }
-    // wait until cache is filled at least prefill_init %
-    mp_msg(MSGT_CACHE,MSGL_V,"CACHE_PRE_INIT: %"PRId64" [%"PRId64"] %"PRId64"  pre:%"PRId64"  eof:%d  \n",
-	s->min_filepos,s->read_filepos,s->max_filepos,min,s->eof);
-    while(s->read_filepos<s->min_filepos || s->max_filepos-s->read_filepos<min){
-	mp_msg(MSGT_CACHE,MSGL_STATUS,MSGTR_CacheFill,
-	    100.0*(float)(s->max_filepos-s->read_filepos)/(float)(s->buffer_size),
-	    s->max_filepos-s->read_filepos
-	);
-	if(s->eof) break; // file is smaller than prefill size
-	if(stream_check_interrupt(PREFILL_SLEEP_TIME)) {
-	  res = 0;
-	  goto err_out;
-        }
+  // Only seekable streams can come back for the data that was not read
+  // ahead, live streams should buffer as much as they can.
+  // Seekable ones leave half of the cache to what was read before.
+  s->adaptive = (stream->flags & MP_STREAM_SEEK) == MP_STREAM_SEEK;
+  if (s->adaptive)
+    s->max_readahead = FFMAX(s->buffer_size / 2, min);
+  s->min_readahead = FFMAX(min, 4 * s->block_size);
+  s->min_readahead = FFMIN(s->min_readahead, s->max_readahead);
+  s->readahead = s->adaptive ? s->min_readahead : s->max_readahead;
+
+  stream2=malloc(sizeof(stream_t));
+  if (!stream2)
+    goto err_out;
+  memcpy(stream2,s->stream,sizeof(stream_t));
+  s->stream=stream2;
+  if ((err = pthread_create(&s->thread, NULL, cache_mainloop, s))) {
+    mp_msg(MSGT_CACHE, MSGL_ERR,
+           "Starting cache process/thread failed: %s.\n", strerror(err));
+    goto err_out;
+  }
+  stream->cache_pid = 1;
+
+  // wait until cache is filled at least prefill_init %
+  mp_msg(MSGT_CACHE,MSGL_V,"CACHE_PRE_INIT: [%"PRId64"] pre:%"PRId64"\n",
+         s->read_filepos,min);
+  while (1) {
+    pthread_mutex_lock(&s->lock);
+    ahead = cache_range_end(s, s->read_filepos) - s->read_filepos;
+    res = s->eof_pos >= 0; // file is smaller than prefill size
+    pthread_mutex_unlock(&s->lock);
+    if (ahead >= min || res)
+      break;
+    mp_msg(MSGT_CACHE,MSGL_STATUS,MSGTR_CacheFill,
+           100.0*(float)ahead/(float)(s->buffer_size), ahead);
+    if(stream_check_interrupt(PREFILL_SLEEP_TIME)) {
+      res = 0;
+      goto err_out;
     }
-    mp_msg(MSGT_CACHE,MSGL_STATUS,"\n");
-    return 1; // parent exits
-
-err_out:
-    cache_uninit(stream);
-    return res;
   }
+  mp_msg(MSGT_CACHE,MSGL_STATUS,"\n");
+  return 1;
 
-#if FORKED_CACHE
-  signal(SIGTERM,exit_sighandler); // kill
-  cache_mainloop(s);
-  // make sure forked code never leaves this function
-  exit(0);
-#endif
-}
-
-#if !FORKED_CACHE
-#if defined(__MINGW32__) || defined(__OS2__)
-static void ThreadProc( void *s ){
-  cache_mainloop(s);
-  _endthread();
-}
-#else
-static void *ThreadProc( void *s ){
-  cache_mainloop(s);
-  return NULL;
+err_out:
+  cache_uninit(stream);
+  return res;
 }
-#endif
-#endif
 
 int cache_stream_fill_buffer(stream_t *s){
   int len;
@@ -589,10 +630,14 @@ int cache_stream_fill_buffer(stream_t *s){
 
 int cache_fill_status(stream_t *s) {
   cache_vars_t *cv;
+  int64_t ahead;
   if (!s || !s->cache_data)
     return -1;
   cv = s->cache_data;
-  return (cv->max_filepos-cv->read_filepos)/(cv->buffer_size / 100);
+  pthread_mutex_lock(&cv->lock);
+  ahead = cache_range_end(cv, cv->read_filepos) - cv->read_filepos;
+  pthread_mutex_unlock(&cv->lock);
+  return ahead/(cv->buffer_size / 100);
 }
 
 int cache_stream_seek_long(stream_t *stream,int64_t pos){
@@ -601,14 +646,15 @@ int cache_stream_seek_long(stream_t *stream,int64_t pos){
   if(!stream->cache_pid) return stream_seek_long(stream,pos);
 
   s=stream->cache_data;
-//  s->seek_lock=1;
 
-  mp_msg(MSGT_CACHE,MSGL_DBG2,"CACHE2_SEEK: 0x%"PRIX64" <= 0x%"PRIX64" (0x%"PRIX64") <= 0x%"PRIX64"  \n",s->min_filepos,pos,s->read_filepos,s->max_filepos);
+  mp_msg(MSGT_CACHE,MSGL_DBG2,"CACHE2_SEEK: 0x%"PRIX64" (0x%"PRIX64")\n",pos,s->read_filepos);
 
   newpos=pos/s->sector_size; newpos*=s->sector_size; // align
+  pthread_mutex_lock(&s->lock);
   stream->pos=s->read_filepos=newpos;
-  s->eof=0; // !!!!!!!
-  cache_wakeup(stream);
+  s->eof_pos=-1; // try again, the stream may have grown
+  pthread_cond_signal(&s->wakeup);
+  pthread_mutex_unlock(&s->lock);
 
   cache_stream_fill_buffer(stream);
 
@@ -618,9 +664,6 @@ int cache_stream_seek_long(stream_t *stream,int64_t pos){
     return 1;
   }
 
-//  stream->buf_pos=stream->buf_len=0;
-//  return 1;
-
   mp_msg(MSGT_CACHE,MSGL_V,"cache_stream_seek: WARNING! Can't seek to 0x%"PRIX64" !\n",pos+newpos);
   return 0;
 }
@@ -628,7 +671,9 @@ int cache_stream_seek_long(stream_t *stream,int64_t pos){
 int cache_do_control(stream_t *stream, int cmd, void *arg) {
   int sleep_count = 0;
   int pos_change = 0;
+  int res;
   cache_vars_t* s = stream->cache_data;
+  pthread_mutex_lock(&s->lock);
   switch (cmd) {
     case STREAM_CTRL_SEEK_TO_TIME:
       s->control_double_arg = *(double *)arg;
@@ -644,10 +689,14 @@ int cache_do_control(stream_t *stream, int cmd, void *arg) {
     // the core might call these every frame, so cache them...
     case STREAM_CTRL_GET_TIME_LENGTH:
       *(double *)arg = s->stream_time_length;
-      return s->stream_time_length ? STREAM_OK : STREAM_UNSUPPORTED;
+      res = s->stream_time_length ? STREAM_OK : STREAM_UNSUPPORTED;
+      pthread_mutex_unlock(&s->lock);
+      return res;
     case STREAM_CTRL_GET_CURRENT_TIME:
       *(double *)arg = s->stream_time_pos;
-      return s->stream_time_pos != MP_NOPTS_VALUE ? STREAM_OK : STREAM_UNSUPPORTED;
+      res = s->stream_time_pos != MP_NOPTS_VALUE ? STREAM_OK : STREAM_UNSUPPORTED;
+      pthread_mutex_unlock(&s->lock);
+      return res;
     case STREAM_CTRL_GET_LANG:
       s->control_lang_arg = *(struct stream_lang_req *)arg;
     case STREAM_CTRL_GET_NUM_TITLES:
@@ -658,7 +707,6 @@ int cache_do_control(stream_t *stream, int cmd, void *arg) {
     case STREAM_CTRL_GET_NUM_ANGLES:
     case STREAM_CTRL_GET_ANGLE:
     case STREAM_CTRL_GET_SIZE:
-    case -2:
       s->control = cmd;
       break;
     case STREAM_CTRL_GET_CURRENT_CHANNEL:
@@ -666,19 +714,27 @@ int cache_do_control(stream_t *stream, int cmd, void *arg) {
       s->control = cmd;
       break;
     default:
+      pthread_mutex_unlock(&s->lock);
       return STREAM_UNSUPPORTED;
   }
-  cache_wakeup(stream);
+  pthread_cond_signal(&s->wakeup);
   while (s->control != -1) {
+    pthread_mutex_unlock(&s->lock);
     if (sleep_count++ == 1000)
       mp_msg(MSGT_CACHE, MSGL_WARN, "Cache not responding! [performance issue]\n");
     if (stream_check_interrupt(CONTROL_SLEEP_TIME)) {
-      s->eof = 1;
+      pthread_mutex_lock(&s->lock);
+      s->eof_pos = s->read_filepos;
+      pthread_mutex_unlock(&s->lock);
       return STREAM_UNSUPPORTED;
     }
+    pthread_mutex_lock(&s->lock);
+  }
+  res = s->control_res;
+  if (res != STREAM_OK) {
+    pthread_mutex_unlock(&s->lock);
+    return res;
   }
-  if (s->control_res != STREAM_OK)
-    return s->control_res;
   // We cannot do this on failure, since this would cause the
   // stream position to jump when e.g. STREAM_CTRL_SEEK_TO_TIME
   // is unsupported - but in that case we need the old value
@@ -688,7 +744,7 @@ int cache_do_control(stream_t *stream, int cmd, void *arg) {
   // when an error happened.
   if (pos_change) {
     stream->pos = s->read_filepos;
-    stream->eof = s->eof;
+    stream->eof = s->eof_pos >= 0 && s->read_filepos >= s->eof_pos;
   }
   switch (cmd) {
     case STREAM_CTRL_GET_TIME_LENGTH:
@@ -711,8 +767,9 @@ int cache_do_control(stream_t *stream, int cmd, void *arg) {
       *(struct stream_lang_req *)arg = s->control_lang_arg;
       break;
     case STREAM_CTRL_GET_CURRENT_CHANNEL:
-      *(char **)arg = (char *)s->control_char_p_arg;
+      *(char **)arg = s->control_char_p_arg;
       break;
   }
-  return s->control_res;
+  pthread_mutex_unlock(&s->lock);
+  return res;
 }
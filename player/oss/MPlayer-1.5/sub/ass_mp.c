@@ -53,6 +53,7 @@ char* ass_color = NULL;
 char* ass_border_color = NULL;
 char* ass_styles_file = NULL;
 int ass_hinting = ASS_HINTING_NATIVE + 4; // native hinting for unscaled osd
+int ass_threads = 1;
 
 static void init_style(ASS_Style *style, const char *name, double playres)
 {
@@ -268,6 +269,10 @@ static void ass_configure(ASS_Renderer* priv, int w, int h, int unscaled) {
 		hinting = ass_hinting & 3;
 	ass_set_hinting(priv, hinting);
 	ass_set_line_spacing(priv, ass_line_spacing);
+#ifdef CONFIG_ASS_INTERNAL
+	if (ass_set_threads(priv, ass_threads) < 0)
+		mp_msg(MSGT_ASS, MSGL_WARN, "[ass] Rendering on a single thread.\n");
+#endif
 }
 
 static void ass_configure_fonts(ASS_Renderer* priv) {
@@ -44,6 +44,7 @@ extern char* ass_color;
 extern char* ass_border_color;
 extern char* ass_styles_file;
 extern int ass_hinting;
+extern int ass_threads;
 
 ASS_Track* ass_default_track(ASS_Library* library);
 int ass_process_subtitle(ASS_Track* track, subtitle* sub);
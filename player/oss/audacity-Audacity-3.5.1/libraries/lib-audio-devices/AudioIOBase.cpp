@@ -310,6 +310,7 @@ void AudioIOBase::SetCaptureMeter(
    }
    else
       mInputMeter.reset();
+   OnMetersChanged();
 }
 
 void AudioIOBase::SetPlaybackMeter(
@@ -327,6 +328,11 @@ void AudioIOBase::SetPlaybackMeter(
    }
    else
       mOutputMeter.reset();
+   OnMetersChanged();
+}
+
+void AudioIOBase::OnMetersChanged()
+{
 }
 
 bool AudioIOBase::IsPaused() const
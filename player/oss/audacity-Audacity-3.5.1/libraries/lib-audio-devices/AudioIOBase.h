@@ -242,6 +242,10 @@ protected:
    static wxString DeviceName(const PaDeviceInfo* info);
    static wxString HostName(const PaDeviceInfo* info);
 
+   //! Called by SetCaptureMeter() and SetPlaybackMeter(), maybe while a
+   //! stream is running
+   virtual void OnMetersChanged();
+
    std::weak_ptr<AudacityProject> mOwningProject;
 
    /// True if audio playback is paused
@@ -532,6 +532,8 @@ bool AudioIO::StartPortAudioStream(const AudioIOStartStreamOptions &options,
 
    mNumPlaybackChannels = numPlaybackChannels;
    mNumCaptureChannels = numCaptureChannels;
+   mInputMeterTap.Start(numCaptureChannels);
+   mOutputMeterTap.Start(numPlaybackChannels);
 
    bool usePlayback = false, useCapture = false;
    PaStreamParameters playbackParameters{};
@@ -841,6 +843,7 @@ int AudioIO::StartStream(const TransportSequences &sequences,
    t1 = std::min(t1, mixerLimit);
 
    mLostSamples = 0;
+   mSpilledCaptureSamples = 0;
    mLostCaptureIntervals.clear();
    mDetectDropouts =
       gPrefs->Read( WarningDialogKey(wxT("DropoutDetected")), true ) != 0;
@@ -931,6 +934,7 @@ int AudioIO::StartStream(const TransportSequences &sequences,
    mPlaybackMixers.clear();
    mCaptureBuffers.clear();
    mResample.clear();
+   mCommitQueue.reset();
    mPlaybackSchedule.mTimeQueue.Clear();
 
    mPlaybackSchedule.Init(
@@ -1359,6 +1363,21 @@ bool AudioIO::AllocateBuffers(
                   std::make_unique<Resample>(true, mFactor, mFactor);
                   // constant rate resampling
             }
+
+            if (!mCaptureSequences.empty()) {
+               // Let the commit thread lag by about one more capture ring
+               // buffer's worth of batches before spilling to a file
+               const auto batches = std::max<size_t>(16,
+                  ceil(mCaptureRingBufferSecs / mMinCaptureSecsToCopy));
+               mCommitQueue = std::make_unique<RecordingCommitQueue>(
+                  batches * mNumCaptureChannels,
+                  [this](RecordingCommitQueue::Chunk &chunk) {
+                     return CommitCapture(chunk); },
+                  [this] {
+                     if (auto pListener = GetListener())
+                        pListener->OnAudioIONewBlocks();
+                  });
+            }
          }
       }
       catch(std::bad_alloc&)
@@ -1398,6 +1417,7 @@ void AudioIO::StartStreamCleanup(bool bOnlyBuffers)
    mPlaybackMixers.clear();
    mCaptureBuffers.clear();
    mResample.clear();
+   mCommitQueue.reset();
    mPlaybackSchedule.mTimeQueue.Clear();
 
    if(!bOnlyBuffers)
@@ -1423,6 +1443,14 @@ void AudioIO::SetMeters()
       pInputMeter->Reset(mRate, true);
    if (auto pOutputMeter = mOutputMeter.lock())
       pOutputMeter->Reset(mRate, true);
+   OnMetersChanged();
+}
+
+void AudioIO::OnMetersChanged()
+{
+   // The audio thread meters the stream through its own copies
+   mInputMeterTap.SetMeter(mInputMeter);
+   mOutputMeterTap.SetMeter(mOutputMeter);
 }
 
 void AudioIO::StopStream()
@@ -1570,6 +1598,18 @@ void AudioIO::StopStream()
          mCaptureBuffers.clear();
          mResample.clear();
 
+         // Wait for the commit thread to append everything drained by the
+         // last SequenceBufferExchange, before the sequences are flushed
+         if (mCommitQueue) {
+            mCommitQueue->Finish();
+            mSpilledCaptureSamples = mCommitQueue->SpilledSamples();
+            // Spilled samples that could not be read back were appended as
+            // silence; count them with the dropouts
+            mLostSamples += mCommitQueue->LostSamples() /
+               std::max<size_t>(1, mNumCaptureChannels);
+            mCommitQueue.reset();
+         }
+
          //
          // We only apply latency correction when we actually played back
          // sequences during the recording. If we did not play back sequences,
@@ -1624,6 +1664,9 @@ void AudioIO::StopStream()
 
 
 
+   mInputMeterTap.Stop();
+   mOutputMeterTap.Stop();
+
    if (auto pInputMeter = mInputMeter.lock())
       pInputMeter->Reset(mRate, false);
 
@@ -1861,6 +1904,8 @@ void AudioIO::AudioThread(std::atomic<bool> &finish)
       gAudioIO->mAudioThreadSequenceBufferExchangeLoopActive
          .store(false, std::memory_order_relaxed);
 
+      gAudioIO->DrainMeterTaps();
+
       std::this_thread::sleep_until( loopPassStart + interval );
    }
 }
@@ -2120,28 +2165,20 @@ void AudioIO::TransformPlayBuffers(
    }
 }
 
+void AudioIO::DrainMeterTaps()
+{
+   // Lock the meters only once per pass, not once per callback
+   mInputMeterTap.Drain();
+   mOutputMeterTap.Drain();
+}
+
 void AudioIO::DrainRecordBuffers()
 {
-   if (mRecordingException || mCaptureSequences.empty())
+   if (mRecordingException || mCaptureSequences.empty() || !mCommitQueue)
       return;
 
    auto delayedHandler = [this] ( AudacityException * pException ) {
-      // In the main thread, stop recording
-      // This is one place where the application handles disk
-      // exhaustion exceptions from RecordableSequence operations, without
-      // rolling back to the last pushed undo state.  Instead, partial recording
-      // results are pushed as a NEW undo state.  For this reason, as
-      // commented elsewhere, we want an exception safety guarantee for
-      // the output RecordableSequences, after the failed append operation, that
-      // the sequences remain as they were after the previous successful
-      // (block-level) appends.
-
-      // Note that the Flush in StopStream() may throw another exception,
-      // but StopStream() contains that exception, and the logic in
-      // AudacityException::DelayedHandlerAction prevents redundant message
-      // boxes.
-      StopStream();
-      DefaultDelayedHandlerAction( pException );
+      RecordingDelayedHandler(pException);
    };
 
    GuardedCall( [&] {
@@ -2159,8 +2196,6 @@ void AudioIO::DrainRecordBuffers()
           .load(std::memory_order_relaxed) ||
           deltat >= mMinCaptureSecsToCopy)
       {
-         bool newBlocks = false;
-
          // Append captured samples to the end of the RecordableSequences.
          // (WaveTracks have their own buffering for efficiency.)
          auto iter = mCaptureSequences.begin();
@@ -2186,9 +2221,8 @@ void AudioIO::DrainRecordBuffers()
                   size_t size = floor( correction * mRate * mFactor);
                   SampleBuffer temp(size, mCaptureFormat);
                   ClearSamples(temp.ptr(), mCaptureFormat, 0, size);
-                  (*iter)->Append(temp.ptr(), mCaptureFormat, size, 1,
-                     // Do not dither recordings
-                     narrowestSampleFormat, iChannel);
+                  mCommitQueue->Push({ iter->get(), iChannel,
+                     mCaptureFormat, size, std::move(temp) });
                }
                else {
                   // Leftward shift
@@ -2289,23 +2323,15 @@ void AudioIO::DrainRecordBuffers()
                }
             }
 
-            // Now append
-            // see comment in second handler about guarantee
-            newBlocks = (*iter)->Append(
-               temp.ptr(), format, size, 1,
-               // Do not dither recordings
-               narrowestSampleFormat, iChannel
-            ) || newBlocks;
+            // Now hand the samples to the commit thread, which appends them
+            // so that database writes never stall this thread
+            mCommitQueue->Push(
+               { iter->get(), iChannel, format, size, std::move(temp) });
          } // end loop over capture channels
 
          // Now update the recording schedule position
          mRecordingSchedule.mPosition += avail / mRate;
          mRecordingSchedule.mLatencyCorrected = latencyCorrected;
-
-         auto pListener = GetListener();
-         if (pListener && newBlocks)
-            pListener->OnAudioIONewBlocks();
-
       }
       // end of record buffering
    },
@@ -2324,6 +2350,54 @@ void AudioIO::DrainRecordBuffers()
    delayedHandler );
 }
 
+bool AudioIO::CommitCapture(RecordingCommitQueue::Chunk &chunk)
+{
+   // Called in the commit thread
+   return GuardedCall<bool>( [&] {
+      // see comment in second handler about guarantee
+      return chunk.pSequence->Append(
+         chunk.buffer.ptr(), chunk.format, chunk.size, 1,
+         // Do not dither recordings
+         narrowestSampleFormat, chunk.iChannel);
+   },
+   // handler
+   [this] ( AudacityException *pException ) {
+      if ( pException ) {
+         // So that we neither fill the recording buffer again, nor append
+         // what is still queued, before the main thread stops recording
+         SetRecordingException();
+         mCommitQueue->Abandon();
+         return false;
+      }
+      else
+         // Don't want to intercept other exceptions (?)
+         throw;
+   },
+   [this] ( AudacityException * pException ) {
+      RecordingDelayedHandler(pException);
+   } );
+}
+
+void AudioIO::RecordingDelayedHandler(AudacityException *pException)
+{
+   // In the main thread, stop recording
+   // This is one place where the application handles disk
+   // exhaustion exceptions from RecordableSequence operations, without
+   // rolling back to the last pushed undo state.  Instead, partial recording
+   // results are pushed as a NEW undo state.  For this reason, as
+   // commented elsewhere, we want an exception safety guarantee for
+   // the output RecordableSequences, after the failed append operation, that
+   // the sequences remain as they were after the previous successful
+   // (block-level) appends.
+
+   // Note that the Flush in StopStream() may throw another exception,
+   // but StopStream() contains that exception, and the logic in
+   // AudacityException::DelayedHandlerAction prevents redundant message
+   // boxes.
+   StopStream();
+   DefaultDelayedHandlerAction( pException );
+}
+
 void AudioIoCallback::SetListener(
    const std::shared_ptr< AudioIOListener > &listener)
 {
@@ -2994,20 +3068,13 @@ void AudioIoCallback::DoPlaythrough(
 }
 
 /* Send data to recording VU meter if applicable */
-// Also computes rms
+// The audio thread computes rms; see DrainMeterTaps()
 void AudioIoCallback::SendVuInputMeterData(
    const float *inputSamples,
    unsigned long framesPerBuffer
    )
 {
-   const auto numCaptureChannels = mNumCaptureChannels;
-   auto pInputMeter = mInputMeter.lock();
-   if ( !pInputMeter )
-      return;
-   if( pInputMeter->IsMeterDisabled())
-      return;
-   pInputMeter->UpdateDisplay(
-      numCaptureChannels, framesPerBuffer, inputSamples);
+   mInputMeterTap.Put(inputSamples, framesPerBuffer);
 }
 
 /* Send data to playback VU meter if applicable */
@@ -3015,17 +3082,7 @@ void AudioIoCallback::SendVuOutputMeterData(
    const float *outputMeterFloats,
    unsigned long framesPerBuffer)
 {
-   const auto numPlaybackChannels = mNumPlaybackChannels;
-
-   auto pOutputMeter = mOutputMeter.lock();
-   if (!pOutputMeter)
-      return;
-   if( pOutputMeter->IsMeterDisabled() )
-      return;
-   if( !outputMeterFloats)
-      return;
-   pOutputMeter->UpdateDisplay(
-      numPlaybackChannels, framesPerBuffer, outputMeterFloats);
+   mOutputMeterTap.Put(outputMeterFloats, framesPerBuffer);
 
       //v Vaughan, 2011-02-25: Moved this update back to TrackPanel::OnTimer()
       //    as it helps with playback issues reported by Bill and noted on Bug 258.
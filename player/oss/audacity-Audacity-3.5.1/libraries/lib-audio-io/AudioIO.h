@@ -15,7 +15,9 @@
 
 #include "AudioIOBase.h" // to inherit
 #include "AudioIOSequences.h"
+#include "MeterTap.h" // member variable
 #include "PlaybackSchedule.h" // member variable
+#include "RecordingCommitQueue.h" // member variable
 
 #include <functional>
 #include <memory>
@@ -38,6 +40,7 @@ class OtherPlayableSequence;
 class RealtimeEffectState;
 class Resample;
 
+class AudacityException;
 class AudacityProject;
 
 struct PaStreamCallbackTimeInfo;
@@ -234,6 +237,11 @@ public:
       unsigned long framesPerBuffer
    );
 
+   //! Samples for the meters are only copied in the callback; peak and RMS
+   //! are computed in the audio thread
+   MeterTap mInputMeterTap{ 1 << 18 };
+   MeterTap mOutputMeterTap{ 1 << 18 };
+
    /** \brief Get the number of audio samples ready in all of the playback
    * buffers.
    *
@@ -271,6 +279,9 @@ public:
    using RingBuffers = std::vector<std::unique_ptr<RingBuffer>>;
    RingBuffers mCaptureBuffers;
    RecordableSequences mCaptureSequences;
+   //! Filled by the audio thread; appends to mCaptureSequences in its own
+   //! thread
+   std::unique_ptr<RecordingCommitQueue> mCommitQueue;
    /*! Read by worker threads but unchanging during playback */
    RingBuffers mPlaybackBuffers;
    ConstPlayableSequences      mPlaybackSequences;
@@ -386,11 +397,19 @@ protected:
    std::vector< std::pair<double, double> > mLostCaptureIntervals;
    /*! Read by a worker thread but unchanging during playback */
    bool mDetectDropouts{ true };
+   unsigned long long mSpilledCaptureSamples{ 0 };
 
 public:
    // Pairs of starting time and duration
    const std::vector< std::pair<double, double> > &LostCaptureIntervals()
    { return mLostCaptureIntervals; }
+   //! Sample frames lost in the last recording
+   unsigned long long LostCaptureSamples() const
+   { return mLostSamples; }
+   //! Samples (over all channels) of the last recording that were written to
+   //! a temporary file because appending to the sequences lagged
+   unsigned long long SpilledCaptureSamples() const
+   { return mSpilledCaptureSamples; }
 
    // Used only for testing purposes in alpha builds
    bool mSimulateRecordingErrors{ false };
@@ -594,6 +613,8 @@ private:
    /** \brief Set the current VU meters - this should be done once after
     * each call to StartStream currently */
    void SetMeters();
+   //! Meters shown or hidden while a stream runs get its samples at once
+   void OnMetersChanged() override;
 
    /** \brief Opens the portaudio stream(s) used to do playback or recording
     * (or both) through.
@@ -630,6 +651,15 @@ private:
    //! Second part of SequenceBufferExchange
    void DrainRecordBuffers();
 
+   //! Compute meter levels from what the callback copied; called by the audio
+   //! thread even when not exchanging sequence buffers, as when monitoring
+   void DrainMeterTaps();
+
+   //! Append one chunk of captured samples, in the commit thread
+   bool CommitCapture(RecordingCommitQueue::Chunk &chunk);
+   //! Stop recording in the main thread after a failure to append
+   void RecordingDelayedHandler(AudacityException *pException);
+
    /** \brief Get the number of audio samples free in all of the playback
    * buffers.
    *
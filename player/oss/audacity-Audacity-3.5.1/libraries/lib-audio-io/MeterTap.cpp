@@ -0,0 +1,91 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  @file MeterTap.cpp
+
+**********************************************************************/
+
+#include "MeterTap.h"
+#include "Meter.h"
+
+#include <algorithm>
+
+namespace {
+// Same order as a typical callback buffer, so that the meter's clip detection
+// and smoothing see similar batches as before
+constexpr size_t MaxFramesPerUpdate = 1024;
+}
+
+MeterTap::MeterTap(size_t capacity)
+   : mBuffer{ floatSample, capacity }
+{
+}
+
+void MeterTap::Start(unsigned nChannels)
+{
+   mNumChannels.store(nChannels, std::memory_order_relaxed);
+   mDiscard.store(true, std::memory_order_release);
+}
+
+void MeterTap::Stop()
+{
+   mNumChannels.store(0, std::memory_order_relaxed);
+   mDiscard.store(true, std::memory_order_release);
+   SetMeter({});
+}
+
+void MeterTap::SetMeter(std::weak_ptr<Meter> wMeter)
+{
+   std::lock_guard<std::mutex> lock{ mMeterMutex };
+   mMeter = std::move(wMeter);
+}
+
+void MeterTap::Put(const float *interleaved, size_t nFrames)
+{
+   const auto nChannels = mNumChannels.load(std::memory_order_relaxed);
+   if (!nChannels || !interleaved)
+      return;
+   // Only whole frames, so the reader never loses alignment
+   nFrames = std::min(nFrames, mBuffer.AvailForPut() / nChannels);
+   if (!nFrames)
+      return;
+   mBuffer.Put(reinterpret_cast<constSamplePtr>(interleaved),
+      floatSample, nFrames * nChannels);
+   mBuffer.Flush();
+}
+
+void MeterTap::Drain()
+{
+   if (mDiscard.exchange(false, std::memory_order_acquire))
+      mBuffer.Discard(mBuffer.AvailForGet());
+
+   const auto nChannels = mNumChannels.load(std::memory_order_relaxed);
+   if (!nChannels)
+      return;
+   // Not the callback thread, so allocation is allowed
+   if (mScratch.size() < MaxFramesPerUpdate * nChannels)
+      mScratch.resize(MaxFramesPerUpdate * nChannels);
+
+   std::shared_ptr<Meter> pMeter;
+   {
+      std::lock_guard<std::mutex> lock{ mMeterMutex };
+      pMeter = mMeter.lock();
+   }
+   if (pMeter && pMeter->IsMeterDisabled())
+      pMeter.reset();
+
+   auto nFrames = mBuffer.AvailForGet() / nChannels;
+   while (nFrames > 0) {
+      const auto frames = std::min(nFrames, MaxFramesPerUpdate);
+      const auto samples = frames * nChannels;
+      if (pMeter) {
+         mBuffer.Get(reinterpret_cast<samplePtr>(mScratch.data()),
+            floatSample, samples);
+         pMeter->UpdateDisplay(nChannels, frames, mScratch.data());
+      }
+      else
+         mBuffer.Discard(samples);
+      nFrames -= frames;
+   }
+}
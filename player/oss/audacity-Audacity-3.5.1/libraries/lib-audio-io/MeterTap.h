@@ -0,0 +1,62 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  @file MeterTap.h
+  @brief Passes metered samples out of the audio callback
+
+**********************************************************************/
+
+#ifndef __AUDACITY_METER_TAP__
+#define __AUDACITY_METER_TAP__
+
+#include "RingBuffer.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class Meter;
+
+//! Lock-free copy of interleaved samples from the PortAudio callback, so that
+//! peak and RMS are computed by another thread
+/*!
+ The callback only copies; it never blocks, and drops frames that don't fit.
+ Start() and Stop() are for the main thread while the stream is not running,
+ SetMeter() for the main thread at any time; Drain() is for one other thread.
+ The meter is a copy taken by SetMeter(), so that the reader never touches
+ the owner's pointers, which the main thread may reassign at any time.
+ */
+class AUDIO_IO_API MeterTap final
+{
+public:
+   //! @param capacity in samples, over all channels
+   explicit MeterTap(size_t capacity);
+
+   void Start(unsigned nChannels);
+   //! Stop() forgets the meter
+   void Stop();
+   void SetMeter(std::weak_ptr<Meter> wMeter);
+
+   //! Called in the PortAudio callback
+   void Put(const float *interleaved, size_t nFrames);
+
+   //! Send everything copied so far to the meter, in batches
+   /*! If there is no meter or it is disabled, samples are discarded */
+   void Drain();
+
+private:
+   RingBuffer mBuffer;
+   //! Zero when stopped
+   std::atomic<unsigned> mNumChannels{ 0 };
+   //! Tells the reader to drop stale samples of a previous stream
+   std::atomic<bool> mDiscard{ false };
+   //! Used only by the reader
+   std::vector<float> mScratch;
+   //! Guards mMeter, which is copied only briefly by the reader
+   std::mutex mMeterMutex;
+   std::weak_ptr<Meter> mMeter;
+};
+
+#endif
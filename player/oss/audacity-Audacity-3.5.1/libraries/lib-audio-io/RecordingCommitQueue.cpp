@@ -0,0 +1,273 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  @file RecordingCommitQueue.cpp
+
+**********************************************************************/
+
+#include "RecordingCommitQueue.h"
+
+#include <chrono>
+#include <wx/filename.h>
+
+namespace {
+// Fixed-size record preceding the samples of each spilled chunk
+struct SpillHeader {
+   RecordableSequence *pSequence;
+   size_t iChannel;
+   size_t size;
+   int format;
+};
+
+// The commit thread also wakes on this period, in case a notification was
+// missed
+constexpr auto PollInterval = std::chrono::milliseconds(20);
+}
+
+RecordingCommitQueue::RecordingCommitQueue(size_t capacity,
+   CommitFunction commit, NewBlocksFunction newBlocks)
+   : mCapacity{ std::max<size_t>(capacity, 1) }
+   , mSlots( mCapacity )
+   , mCommit{ std::move(commit) }
+   , mNewBlocks{ std::move(newBlocks) }
+{
+   mThread = std::thread([this]{ CommitThread(); });
+}
+
+RecordingCommitQueue::~RecordingCommitQueue()
+{
+   Finish();
+   if (mSpillFile.IsOpened())
+      mSpillFile.Close();
+   if (!mSpillPath.empty())
+      wxRemoveFile(mSpillPath);
+}
+
+bool RecordingCommitQueue::RingEmpty() const
+{
+   return mHead.load(std::memory_order_relaxed) ==
+      mTail.load(std::memory_order_acquire);
+}
+
+bool RecordingCommitQueue::TryPush(Chunk &chunk)
+{
+   const auto tail = mTail.load(std::memory_order_relaxed);
+   const auto head = mHead.load(std::memory_order_acquire);
+   const auto backlog = tail - head;
+   if (backlog >= mCapacity)
+      return false;
+
+   // The slot was moved from by the consumer, so its buffer is null and
+   // nothing leaks by the move assignment
+   mSlots[tail % mCapacity] = std::move(chunk);
+   mTail.store(tail + 1, std::memory_order_release);
+
+   if (backlog + 1 > mMaxBacklog.load(std::memory_order_relaxed))
+      mMaxBacklog.store(backlog + 1, std::memory_order_relaxed);
+   return true;
+}
+
+bool RecordingCommitQueue::TryPop(Chunk &chunk)
+{
+   const auto head = mHead.load(std::memory_order_relaxed);
+   if (head == mTail.load(std::memory_order_acquire))
+      return false;
+   chunk.buffer.Free();
+   chunk = std::move(mSlots[head % mCapacity]);
+   mHead.store(head + 1, std::memory_order_release);
+   return true;
+}
+
+bool RecordingCommitQueue::WriteSpill(const Chunk &chunk)
+{
+   // mSpillMutex is held
+   if (mSpillFailed)
+      return false;
+
+   if (!mSpillFile.IsOpened()) {
+      mSpillPath = wxFileName::CreateTempFileName(
+         wxT("audacity-recording"), &mSpillFile);
+      if (mSpillPath.empty() || !mSpillFile.IsOpened()) {
+         mSpillFailed = true;
+         return false;
+      }
+   }
+
+   const SpillHeader header{
+      chunk.pSequence, chunk.iChannel, chunk.size, int(chunk.format) };
+   const auto bytes = chunk.size * SAMPLE_SIZE(chunk.format);
+   if (mSpillFile.Seek(mSpillWritePos) == wxInvalidOffset ||
+       mSpillFile.Write(&header, sizeof header) != sizeof header ||
+       mSpillFile.Write(chunk.buffer.ptr(), bytes) != bytes) {
+      // Probably the disk is full; don't try again during this recording
+      mSpillFailed = true;
+      return false;
+   }
+
+   mSpillWritePos += sizeof header + bytes;
+   mSpillIndex.push_back(
+      { chunk.pSequence, chunk.iChannel, chunk.format, chunk.size, {} });
+   return true;
+}
+
+bool RecordingCommitQueue::ReadSpill(Chunk &chunk)
+{
+   // mSpillMutex is held
+   if (mSpillIndex.empty())
+      return false;
+   if (mSpillFailed) {
+      ReplaceSpill(chunk);
+      return true;
+   }
+
+   SpillHeader header;
+   if (mSpillFile.Seek(mSpillReadPos) == wxInvalidOffset ||
+       mSpillFile.Read(&header, sizeof header) != ssize_t(sizeof header)) {
+      mSpillFailed = true;
+      ReplaceSpill(chunk);
+      return true;
+   }
+
+   const auto format = static_cast<sampleFormat>(header.format);
+   const auto bytes = header.size * SAMPLE_SIZE(format);
+   chunk.pSequence = header.pSequence;
+   chunk.iChannel = header.iChannel;
+   chunk.format = format;
+   chunk.size = header.size;
+   chunk.buffer.Allocate(header.size, format);
+   if (mSpillFile.Read(chunk.buffer.ptr(), bytes) != ssize_t(bytes)) {
+      mSpillFailed = true;
+      ReplaceSpill(chunk);
+      return true;
+   }
+
+   mSpillReadPos += sizeof header + bytes;
+   mSpillIndex.pop_front();
+   return true;
+}
+
+void RecordingCommitQueue::ReplaceSpill(Chunk &chunk)
+{
+   // mSpillMutex is held.  The samples of the next spilled chunk can't be
+   // read back; substitute silence, so that later chunks still land at the
+   // right times, and the file isn't used again during this recording
+   auto &lost = mSpillIndex.front();
+   chunk.pSequence = lost.pSequence;
+   chunk.iChannel = lost.iChannel;
+   chunk.format = lost.format;
+   chunk.size = lost.size;
+   chunk.buffer.Allocate(lost.size, lost.format);
+   ClearSamples(chunk.buffer.ptr(), lost.format, 0, lost.size);
+   mLostSamples.fetch_add(lost.size, std::memory_order_relaxed);
+   mSpillIndex.pop_front();
+}
+
+void RecordingCommitQueue::Push(Chunk &&chunk)
+{
+   // Once anything is spilled, keep spilling until the commit thread has
+   // read all of it back, so that chunks are committed in order
+   if (!mSpilling.load(std::memory_order_acquire) && TryPush(chunk)) {
+      Notify();
+      return;
+   }
+
+   {
+      std::lock_guard<std::mutex> lock{ mSpillMutex };
+      if (WriteSpill(chunk)) {
+         mSpilling.store(true, std::memory_order_release);
+         mSpilledSamples.fetch_add(chunk.size, std::memory_order_relaxed);
+         auto backlog = mCapacity + ++mSpillBacklog;
+         if (backlog > mMaxBacklog.load(std::memory_order_relaxed))
+            mMaxBacklog.store(backlog, std::memory_order_relaxed);
+         Notify();
+         return;
+      }
+   }
+
+   // The spill file is unusable.  Wait for the commit thread to empty the
+   // spill file and make room in the ring.  Meanwhile the capture ring buffers
+   // may overflow, which the audio callback reports as dropouts.
+   Notify();
+   while (!(!mSpilling.load(std::memory_order_acquire) && TryPush(chunk)))
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+   Notify();
+}
+
+void RecordingCommitQueue::Notify()
+{
+   mWake.notify_one();
+}
+
+void RecordingCommitQueue::Finish()
+{
+   if (!mThread.joinable())
+      return;
+   mFinishing.store(true, std::memory_order_release);
+   Notify();
+   mThread.join();
+}
+
+void RecordingCommitQueue::Abandon()
+{
+   mAbandoned.store(true, std::memory_order_release);
+}
+
+void RecordingCommitQueue::Commit(Chunk &chunk, bool &newBlocks)
+{
+   if (!mAbandoned.load(std::memory_order_acquire))
+      newBlocks = mCommit(chunk) || newBlocks;
+   chunk.buffer.Free();
+}
+
+void RecordingCommitQueue::CommitThread()
+{
+   Chunk chunk;
+   while (true) {
+      bool newBlocks = false;
+      bool any = false;
+
+      // Pop everything available now, ring first, because nothing newer than
+      // the contents of the spill file ever enters the ring
+      while (true) {
+         if (TryPop(chunk)) {
+            Commit(chunk, newBlocks);
+            any = true;
+            continue;
+         }
+         if (!mSpilling.load(std::memory_order_acquire))
+            break;
+
+         std::unique_lock<std::mutex> lock{ mSpillMutex };
+         // The producer may have filled the ring and then begun spilling
+         // since the failed TryPop
+         if (!RingEmpty())
+            continue;
+         if (ReadSpill(chunk)) {
+            --mSpillBacklog;
+            lock.unlock();
+            Commit(chunk, newBlocks);
+            any = true;
+            continue;
+         }
+         // The spill file is exhausted; reuse it from the start
+         mSpillReadPos = mSpillWritePos = 0;
+         mSpillBacklog = 0;
+         mSpilling.store(false, std::memory_order_release);
+         break;
+      }
+
+      if (newBlocks && mNewBlocks && !mAbandoned.load(std::memory_order_acquire))
+         mNewBlocks();
+
+      if (!any) {
+         // Test the finishing flag only after finding nothing, so that
+         // everything pushed before Finish() is committed
+         if (mFinishing.load(std::memory_order_acquire) && RingEmpty() &&
+             !mSpilling.load(std::memory_order_acquire))
+            break;
+         std::unique_lock<std::mutex> lock{ mWakeMutex };
+         mWake.wait_for(lock, PollInterval);
+      }
+   }
+}
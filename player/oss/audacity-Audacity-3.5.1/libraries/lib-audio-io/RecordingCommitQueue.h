@@ -0,0 +1,134 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  @file RecordingCommitQueue.h
+  @brief Hands captured samples to a worker thread that appends them
+
+**********************************************************************/
+
+#ifndef __AUDACITY_RECORDING_COMMIT_QUEUE__
+#define __AUDACITY_RECORDING_COMMIT_QUEUE__
+
+#include "MemoryX.h"
+#include "SampleFormat.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <wx/file.h>
+
+struct RecordableSequence;
+
+//! Decouples draining of the capture ring buffers from persistence
+/*!
+ The audio thread pushes chunks of processed capture data; a dedicated commit
+ thread pops them in order and appends them to the recordable sequences, which
+ may block on the database.
+
+ Chunks pass through a bounded lock-free ring.  When it is full, because the
+ commit thread lags, chunks are spilled to a temporary file instead, and read
+ back in order.  If even the spill file fails, Push() waits for the commit
+ thread, so that back-pressure reaches the capture ring buffers where it is
+ detected as a dropout as before.  Chunks that were spilled but can't be read
+ back are committed as silence, to keep the channels aligned, and counted as
+ lost.
+ */
+class AUDIO_IO_API RecordingCommitQueue final : public NonInterferingBase
+{
+public:
+   struct Chunk {
+      RecordableSequence *pSequence{};
+      size_t iChannel{};
+      sampleFormat format{ floatSample };
+      size_t size{};
+      SampleBuffer buffer;
+   };
+
+   //! Called in the commit thread; returns whether new blocks were made
+   using CommitFunction = std::function<bool(Chunk &chunk)>;
+   //! Called in the commit thread after a batch that made new blocks
+   using NewBlocksFunction = std::function<void()>;
+
+   //! @param capacity how many chunks the lock-free ring holds
+   RecordingCommitQueue(size_t capacity,
+      CommitFunction commit, NewBlocksFunction newBlocks);
+   ~RecordingCommitQueue();
+
+   RecordingCommitQueue(const RecordingCommitQueue&) = delete;
+   RecordingCommitQueue &operator=(const RecordingCommitQueue&) = delete;
+
+   //! Producer side; call from one thread only
+   void Push(Chunk &&chunk);
+
+   //! Commit all pending chunks, then join the commit thread
+   /*! Idempotent.  Call in the thread that owns the queue, after the last
+    Push() */
+   void Finish();
+
+   //! Stop appending, but keep consuming (and discarding) pushed chunks
+   void Abandon();
+
+   //! Total samples (over all channels) that passed through the spill file
+   unsigned long long SpilledSamples() const
+   { return mSpilledSamples.load(std::memory_order_relaxed); }
+   //! Total samples (over all channels) that were spilled but could not be
+   //! read back, and were replaced by silence
+   unsigned long long LostSamples() const
+   { return mLostSamples.load(std::memory_order_relaxed); }
+   //! Largest number of chunks waiting at once
+   size_t MaxBacklog() const
+   { return mMaxBacklog.load(std::memory_order_relaxed); }
+
+private:
+   bool TryPush(Chunk &chunk);
+   bool TryPop(Chunk &chunk);
+   bool RingEmpty() const;
+
+   bool WriteSpill(const Chunk &chunk);
+   bool ReadSpill(Chunk &chunk);
+   void ReplaceSpill(Chunk &chunk);
+
+   void Notify();
+   void CommitThread();
+   void Commit(Chunk &chunk, bool &newBlocks);
+
+   const size_t mCapacity;
+   std::vector<Chunk> mSlots;
+   // Written by the producer only
+   NonInterfering< std::atomic<size_t> > mTail{ 0 };
+   // Written by the consumer only
+   NonInterfering< std::atomic<size_t> > mHead{ 0 };
+
+   const CommitFunction mCommit;
+   const NewBlocksFunction mNewBlocks;
+
+   // Spill state; the file and its offsets are guarded by the mutex, but
+   // the flag may be read without it
+   std::mutex mSpillMutex;
+   std::atomic<bool> mSpilling{ false };
+   bool mSpillFailed{ false };
+   wxString mSpillPath;
+   wxFile mSpillFile;
+   wxFileOffset mSpillReadPos{ 0 };
+   wxFileOffset mSpillWritePos{ 0 };
+   //! Chunks in the spill file not yet read back, without their samples
+   std::deque<Chunk> mSpillIndex;
+
+   std::atomic<unsigned long long> mSpilledSamples{ 0 };
+   std::atomic<unsigned long long> mLostSamples{ 0 };
+   std::atomic<size_t> mMaxBacklog{ 0 };
+   std::atomic<size_t> mSpillBacklog{ 0 };
+
+   std::mutex mWakeMutex;
+   std::condition_variable mWake;
+   std::atomic<bool> mFinishing{ false };
+   std::atomic<bool> mAbandoned{ false };
+   std::thread mThread;
+};
+
+#endif
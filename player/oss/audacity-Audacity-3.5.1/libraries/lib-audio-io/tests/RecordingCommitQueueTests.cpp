@@ -0,0 +1,90 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  RecordingCommitQueueTests.cpp
+
+**********************************************************************/
+#include "RecordingCommitQueue.h"
+
+#include <catch2/catch.hpp>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace
+{
+RecordingCommitQueue::Chunk MakeChunk(size_t index, size_t size)
+{
+   RecordingCommitQueue::Chunk chunk;
+   chunk.iChannel = index % 2;
+   chunk.format = floatSample;
+   chunk.size = size;
+   chunk.buffer.Allocate(size, floatSample);
+   auto data = reinterpret_cast<float*>(chunk.buffer.ptr());
+   for (size_t i = 0; i < size; ++i)
+      data[i] = index;
+   return chunk;
+}
+
+void PushAll(RecordingCommitQueue &queue, size_t nChunks, size_t size)
+{
+   for (size_t i = 0; i < nChunks; ++i)
+      queue.Push(MakeChunk(i, size));
+   queue.Finish();
+}
+}
+
+TEST_CASE("RecordingCommitQueue commits in order", "[RecordingCommitQueue]")
+{
+   constexpr size_t nChunks = 200;
+   constexpr size_t size = 64;
+
+   // Slow the consumer at first, so that the ring overflows into the spill
+   // file; then keep going faster while more is pushed
+   const auto delay = GENERATE(0, 2);
+
+   std::vector<float> committed;
+   bool contentsOk = true;
+   size_t nBatches = 0;
+   RecordingCommitQueue queue{ 4,
+      [&](RecordingCommitQueue::Chunk &chunk) {
+         if (delay && committed.size() < 20)
+            std::this_thread::sleep_for(std::chrono::milliseconds(delay));
+         auto data = reinterpret_cast<const float*>(chunk.buffer.ptr());
+         const auto index = committed.size();
+         contentsOk = contentsOk && chunk.size == size &&
+            chunk.iChannel == index % 2 &&
+            data[0] == index && data[size - 1] == index;
+         committed.push_back(data[0]);
+         return true;
+      },
+      [&]{ ++nBatches; }
+   };
+
+   PushAll(queue, nChunks, size);
+
+   REQUIRE(committed.size() == nChunks);
+   REQUIRE(contentsOk);
+   REQUIRE(nBatches > 0);
+   if (delay)
+      REQUIRE(queue.SpilledSamples() > 0);
+   REQUIRE(queue.MaxBacklog() > 0);
+}
+
+TEST_CASE("RecordingCommitQueue discards when abandoned", "[RecordingCommitQueue]")
+{
+   size_t nCommitted = 0;
+   RecordingCommitQueue queue{ 8,
+      [&](RecordingCommitQueue::Chunk &) {
+         ++nCommitted;
+         return false;
+      },
+      {}
+   };
+   queue.Abandon();
+   PushAll(queue, 50, 16);
+   REQUIRE(nCommitted == 0);
+}
@@ -0,0 +1,69 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ * SPDX-FileName: WorkerPool.cpp
+ */
+
+#include "WorkerPool.h"
+
+#include <algorithm>
+
+namespace audacity::concurrency
+{
+WorkerPool& WorkerPool::Get()
+{
+   static WorkerPool pool { std::max(1u, std::thread::hardware_concurrency()) };
+   return pool;
+}
+
+WorkerPool::WorkerPool(size_t nThreads)
+{
+   for (size_t i = 0; i < nThreads; ++i)
+      mThreads.emplace_back([this] { Work(); });
+}
+
+WorkerPool::~WorkerPool()
+{
+   {
+      std::lock_guard<std::mutex> lock { mMutex };
+      mQuit = true;
+   }
+   mWake.notify_all();
+   for (auto& thread : mThreads)
+      thread.join();
+}
+
+size_t WorkerPool::Size() const noexcept
+{
+   return mThreads.size();
+}
+
+std::future<void> WorkerPool::Submit(std::function<void()> task)
+{
+   std::packaged_task<void()> packaged { std::move(task) };
+   auto result = packaged.get_future();
+   {
+      std::lock_guard<std::mutex> lock { mMutex };
+      mTasks.push_back(std::move(packaged));
+   }
+   mWake.notify_one();
+   return result;
+}
+
+void WorkerPool::Work()
+{
+   while (true)
+   {
+      std::packaged_task<void()> task;
+      {
+         std::unique_lock<std::mutex> lock { mMutex };
+         mWake.wait(lock, [this] { return mQuit || !mTasks.empty(); });
+         if (mTasks.empty())
+            return;
+         task = std::move(mTasks.front());
+         mTasks.pop_front();
+      }
+      // Exceptions are stored in the future
+      task();
+   }
+}
+} // namespace audacity::concurrency
@@ -0,0 +1,54 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ * SPDX-FileName: WorkerPool.h
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace audacity::concurrency
+{
+//! A fixed set of threads, started on first use and shared by all callers
+/*!
+ Work that is split into many short-lived tasks runs on the same threads
+ each time, so that per-thread state, such as the prepared statements that
+ a project's database connection caches for each thread, does not grow with
+ every call.
+
+ Tasks must not wait for other tasks of the pool.
+ */
+class CONCURRENCY_API WorkerPool final
+{
+public:
+   static WorkerPool& Get();
+
+   WorkerPool(const WorkerPool&)            = delete;
+   WorkerPool& operator=(const WorkerPool&) = delete;
+   ~WorkerPool();
+
+   //! Number of threads, at least one
+   size_t Size() const noexcept;
+
+   //! Runs the task in one of the threads
+   /*! @return becomes ready when the task is done, and rethrows what it
+    threw */
+   std::future<void> Submit(std::function<void()> task);
+
+private:
+   explicit WorkerPool(size_t nThreads);
+   void Work();
+
+   std::mutex mMutex;
+   std::condition_variable mWake;
+   std::deque<std::packaged_task<void()>> mTasks;
+   bool mQuit { false };
+   std::vector<std::thread> mThreads;
+}; // class WorkerPool
+} // namespace audacity::concurrency
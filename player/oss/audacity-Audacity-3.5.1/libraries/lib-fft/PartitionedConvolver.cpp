@@ -0,0 +1,108 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  @file PartitionedConvolver.cpp
+
+**********************************************************************/
+#include "PartitionedConvolver.h"
+
+#include <algorithm>
+#include <cassert>
+#include <pffft.h>
+
+PartitionedConvolver::PartitionedConvolver(const float *impulse,
+   size_t impulseLength, size_t partitionSize, size_t nChannels)
+   : mPartitionSize{ std::max(partitionSize, MinPartitionSize) }
+   , mFFTSize{ 2 * mPartitionSize }
+   , mnChannels{ std::max<size_t>(nChannels, 1) }
+   , mnPartitions{
+      std::max<size_t>(1, (impulseLength + mPartitionSize - 1) / mPartitionSize) }
+   , mSetup{ pffft_new_setup(mFFTSize, PFFFT_REAL) }
+   , mFilter(mFFTSize * mnPartitions)
+   , mDelayLine(mFFTSize * mnPartitions * mnChannels)
+   , mWindows(mFFTSize * mnChannels)
+   , mAccumulators(mFFTSize * mnChannels)
+   , mWork(mFFTSize)
+{
+   assert((partitionSize & (partitionSize - 1)) == 0);
+
+   // Each partition of the impulse, zero-padded to the FFT size, transformed
+   // to pffft's internal frequency domain order, which suits its convolution
+   PffftFloatVector padded(mFFTSize);
+   for (size_t iPartition = 0; iPartition < mnPartitions; ++iPartition) {
+      const auto first = iPartition * mPartitionSize;
+      const auto count =
+         std::min(mPartitionSize, impulseLength - std::min(first, impulseLength));
+      std::fill(padded.begin(), padded.end(), 0.0f);
+      std::copy(impulse + first, impulse + first + count, padded.begin());
+      pffft_transform(mSetup.get(), padded.data(),
+         mFilter.data() + iPartition * mFFTSize, mWork.data(), PFFFT_FORWARD);
+   }
+}
+
+PartitionedConvolver::~PartitionedConvolver() = default;
+
+float *PartitionedConvolver::Window(size_t iChannel)
+{
+   return mWindows.data() + iChannel * mFFTSize;
+}
+
+float *PartitionedConvolver::Spectrum(size_t iChannel, size_t iPartition)
+{
+   return mDelayLine.data() + (iChannel * mnPartitions + iPartition) * mFFTSize;
+}
+
+void PartitionedConvolver::Reset()
+{
+   std::fill(mDelayLine.begin(), mDelayLine.end(), 0.0f);
+   std::fill(mWindows.begin(), mWindows.end(), 0.0f);
+   mNewest = 0;
+}
+
+void PartitionedConvolver::Process(
+   const float *const *input, float *const *output)
+{
+   const auto B = mPartitionSize;
+   const auto setup = mSetup.get();
+   const auto work = mWork.data();
+
+   // Advance the delay line, overwriting the oldest spectra
+   mNewest = (mNewest + 1) % mnPartitions;
+
+   for (size_t iChannel = 0; iChannel < mnChannels; ++iChannel) {
+      // Slide the window by one block and transform it
+      const auto window = Window(iChannel);
+      std::copy(window + B, window + 2 * B, window);
+      std::copy(input[iChannel], input[iChannel] + B, window + B);
+      pffft_transform(setup, window, Spectrum(iChannel, mNewest), work,
+         PFFFT_FORWARD);
+   }
+
+   // Multiply-accumulate, partition by partition, with channels in the inner
+   // loop so each filter spectrum is fetched once per block
+   const float scale = 1.0f / mFFTSize;
+   for (size_t iPartition = 0; iPartition < mnPartitions; ++iPartition) {
+      const auto filter = mFilter.data() + iPartition * mFFTSize;
+      const auto iDelayed =
+         (mNewest + mnPartitions - iPartition) % mnPartitions;
+      for (size_t iChannel = 0; iChannel < mnChannels; ++iChannel) {
+         const auto accumulator = mAccumulators.data() + iChannel * mFFTSize;
+         const auto spectrum = Spectrum(iChannel, iDelayed);
+         if (iPartition == 0)
+            pffft_zconvolve_no_accu(setup, spectrum, filter, accumulator, scale);
+         else
+            pffft_zconvolve_accumulate(
+               setup, spectrum, filter, accumulator, scale);
+      }
+   }
+
+   // Back to time domain; the second half of each window is free of circular
+   // aliasing
+   for (size_t iChannel = 0; iChannel < mnChannels; ++iChannel) {
+      const auto accumulator = mAccumulators.data() + iChannel * mFFTSize;
+      pffft_transform(setup, accumulator, accumulator, work, PFFFT_BACKWARD);
+      std::copy(accumulator + B, accumulator + 2 * B, output[iChannel]);
+   }
+}
@@ -0,0 +1,85 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  @file PartitionedConvolver.h
+  @brief Low-latency FIR filtering by uniformly partitioned convolution
+
+**********************************************************************/
+#pragma once
+
+#include "PowerSpectrumGetter.h" // PffftFloatVector, PffftSetupHolder
+
+#include <cstddef>
+
+//! Applies a long finite impulse response with a latency of one partition
+/*!
+ The impulse response is split into partitions of equal size, each
+ transformed once to the frequency domain.  Each block of input is
+ transformed once, and kept in a frequency domain delay line; each block of
+ output is the sum of products of past input spectra with the partition
+ spectra (uniformly partitioned overlap-save).
+
+ All channels share the filter.  They are processed in a batch, so that each
+ partition spectrum is used for all channels while it is in cache.
+
+ Smaller partitions mean less latency; larger partitions mean less work per
+ sample for long filters.
+ */
+class FFT_API PartitionedConvolver final
+{
+public:
+   //! Smallest allowed partition size, for pffft
+   static constexpr size_t MinPartitionSize = 16;
+
+   /*!
+    @param impulse the filter taps
+    @param partitionSize a power of two, at least MinPartitionSize
+    @pre `impulseLength > 0`
+    */
+   PartitionedConvolver(const float *impulse, size_t impulseLength,
+      size_t partitionSize, size_t nChannels = 1);
+   ~PartitionedConvolver();
+
+   PartitionedConvolver(const PartitionedConvolver&) = delete;
+   PartitionedConvolver &operator=(const PartitionedConvolver&) = delete;
+
+   //! Number of samples per channel in each call to Process()
+   size_t PartitionSize() const { return mPartitionSize; }
+   size_t Channels() const { return mnChannels; }
+   size_t Partitions() const { return mnPartitions; }
+
+   //! Filter PartitionSize() samples of each channel
+   /*!
+    Output is the beginning of the linear convolution of all input since the
+    last Reset() with the impulse.
+    Input and output buffers may be the same.
+    */
+   void Process(const float *const *input, float *const *output);
+
+   //! Forget all previous input
+   void Reset();
+
+private:
+   float *Window(size_t iChannel);
+   float *Spectrum(size_t iChannel, size_t iPartition);
+
+   const size_t mPartitionSize;
+   const size_t mFFTSize;
+   const size_t mnChannels;
+   const size_t mnPartitions;
+
+   PffftSetupHolder mSetup;
+   //! Spectra of the impulse partitions, each of mFFTSize floats
+   PffftFloatVector mFilter;
+   //! For each channel, spectra of the last mnPartitions input blocks
+   PffftFloatVector mDelayLine;
+   //! For each channel, the previous and the current input block
+   PffftFloatVector mWindows;
+   //! For each channel, the sum of products
+   PffftFloatVector mAccumulators;
+   PffftFloatVector mWork;
+   //! Index in the delay line of the newest input spectrum
+   size_t mNewest{ 0 };
+};
@@ -0,0 +1,119 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  PartitionedConvolverTests.cpp
+
+**********************************************************************/
+#include "PartitionedConvolver.h"
+
+#include <catch2/catch.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace
+{
+std::vector<float> Noise(size_t length, unsigned seed)
+{
+   std::mt19937 gen{ seed };
+   std::uniform_real_distribution<float> dist{ -1.0f, 1.0f };
+   std::vector<float> result(length);
+   for (auto &x : result)
+      x = dist(gen);
+   return result;
+}
+
+std::vector<float> DirectConvolution(
+   const std::vector<float> &x, const std::vector<float> &h, size_t length)
+{
+   std::vector<float> y(length);
+   for (size_t n = 0; n < length; ++n) {
+      double sum = 0;
+      for (size_t k = 0; k < h.size() && k <= n; ++k)
+         if (n - k < x.size())
+            sum += double(h[k]) * x[n - k];
+      y[n] = sum;
+   }
+   return y;
+}
+}
+
+TEST_CASE("PartitionedConvolver matches direct convolution",
+   "[PartitionedConvolver]")
+{
+   const size_t partitionSize = GENERATE(16, 64, 256);
+   const size_t impulseLength = GENERATE(1, 100, 1001);
+   constexpr size_t nChannels = 2;
+
+   const auto impulse = Noise(impulseLength, 1);
+   std::vector<std::vector<float>> inputs{ Noise(3000, 2), Noise(3000, 3) };
+
+   PartitionedConvolver convolver{
+      impulse.data(), impulse.size(), partitionSize, nChannels };
+   REQUIRE(convolver.PartitionSize() == partitionSize);
+
+   // Feed the input and enough zeroes to flush the tail
+   const auto outputLength = inputs[0].size() + impulseLength - 1;
+   const auto nBlocks = (outputLength + partitionSize - 1) / partitionSize;
+   std::vector<std::vector<float>> outputs(nChannels,
+      std::vector<float>(nBlocks * partitionSize));
+   std::vector<std::vector<float>> blocks(nChannels,
+      std::vector<float>(partitionSize));
+   for (size_t iBlock = 0; iBlock < nBlocks; ++iBlock) {
+      std::vector<const float*> in;
+      std::vector<float*> out;
+      for (size_t iChannel = 0; iChannel < nChannels; ++iChannel) {
+         auto &block = blocks[iChannel];
+         for (size_t i = 0; i < partitionSize; ++i) {
+            const auto n = iBlock * partitionSize + i;
+            block[i] = n < inputs[iChannel].size() ? inputs[iChannel][n] : 0;
+         }
+         in.push_back(block.data());
+         // Output in place for one channel
+         out.push_back(iChannel == 0
+            ? block.data()
+            : outputs[iChannel].data() + iBlock * partitionSize);
+      }
+      convolver.Process(in.data(), out.data());
+      std::copy(blocks[0].begin(), blocks[0].end(),
+         outputs[0].begin() + iBlock * partitionSize);
+   }
+
+   for (size_t iChannel = 0; iChannel < nChannels; ++iChannel) {
+      const auto expected =
+         DirectConvolution(inputs[iChannel], impulse, outputLength);
+      for (size_t n = 0; n < outputLength; ++n)
+         REQUIRE(outputs[iChannel][n] ==
+            Approx(expected[n]).margin(1e-3));
+   }
+}
+
+TEST_CASE("PartitionedConvolver throughput", "[.benchmark]")
+{
+   const auto impulse = Noise(8191, 1);
+   const auto input = Noise(1 << 20, 2);
+   for (size_t partitionSize : { 128, 512, 2048, 8192 }) {
+      PartitionedConvolver convolver{
+         impulse.data(), impulse.size(), partitionSize, 2 };
+      std::vector<float> left(partitionSize), right(partitionSize);
+      float *buffers[]{ left.data(), right.data() };
+      const auto start = std::chrono::steady_clock::now();
+      for (size_t i = 0; i + partitionSize <= input.size();
+           i += partitionSize) {
+         std::copy(input.begin() + i, input.begin() + i + partitionSize,
+            left.begin());
+         std::copy(input.begin() + i, input.begin() + i + partitionSize,
+            right.begin());
+         convolver.Process(buffers, buffers);
+      }
+      const auto elapsed = std::chrono::duration<double, std::milli>(
+         std::chrono::steady_clock::now() - start).count();
+      std::cout << "Partition " << partitionSize << ": " << elapsed
+                << " ms for 2 x " << input.size() << " samples\n";
+   }
+}
@@ -394,6 +394,11 @@ FilePath FileNames::PluginSettings()
    return wxFileName( ConfigDir(), wxT("pluginsettings.cfg") ).GetFullPath();
 }
 
+FilePath FileNames::PluginValidationCache()
+{
+   return wxFileName( ConfigDir(), wxT("pluginvalidationcache.xml") ).GetFullPath();
+}
+
 FilePath FileNames::BaseDir()
 {
    wxFileName baseDir;
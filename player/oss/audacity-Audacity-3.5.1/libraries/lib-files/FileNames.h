@@ -138,6 +138,7 @@ namespace FileNames
    FILES_API FilePath Configuration();
    FILES_API FilePath PluginRegistry();
    FILES_API FilePath PluginSettings();
+   FILES_API FilePath PluginValidationCache();
 
    FILES_API FilePath BaseDir();
    FILES_API FilePath ModulesDir();
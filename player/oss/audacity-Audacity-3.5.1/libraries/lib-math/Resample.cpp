@@ -16,9 +16,10 @@
 
       libsoxr, written by Rob Sykes. LGPL.
 
-   Since Audacity always does resampling on mono streams that are
-   contiguous in memory, this class doesn't support multiple channels
-   or some of the other optional features of some of these resamplers.
+   Channels are passed to libsoxr non-interleaved, as Audacity stores
+   them; several channels sharing the same rate can be resampled by one
+   instance. This class doesn't support some of the other optional
+   features of some of these resamplers.
 
 *//*******************************************************************/
 
@@ -27,9 +28,13 @@
 #include "Internat.h"
 #include "ComponentInterface.h"
 
+#include <algorithm>
+#include <cassert>
 #include <soxr.h>
 
-Resample::Resample(const bool useBestMethod, const double dMinFactor, const double dMaxFactor)
+Resample::Resample(const bool useBestMethod, const double dMinFactor, const double dMaxFactor,
+   unsigned nChannels, unsigned nThreads)
+   : mnChannels{ std::max(1u, nChannels) }
 {
    this->SetMethod(useBestMethod);
    soxr_quality_spec_t q_spec;
@@ -43,7 +48,10 @@ Resample::Resample(const bool useBestMethod, const double dMinFactor, const doub
       mbWantConstRateResampling = false; // variable rate resampling
       q_spec = soxr_quality_spec(SOXR_HQ, SOXR_VR);
    }
-   mHandle.reset(soxr_create(1, dMinFactor, 1, 0, 0, &q_spec, 0));
+   const auto io_spec = soxr_io_spec(SOXR_FLOAT32_S, SOXR_FLOAT32_S);
+   const auto runtime_spec = soxr_runtime_spec(nThreads);
+   mHandle.reset(soxr_create(1, dMinFactor, mnChannels, 0,
+      &io_spec, &q_spec, &runtime_spec));
 }
 
 Resample::~Resample()
@@ -91,23 +99,28 @@ std::pair<size_t, size_t>
                         bool         lastFlag,
                         float       *outBuffer,
                         size_t       outBufferLen)
+{
+   assert(mnChannels == 1);
+   return Process(factor, &inBuffer, inBufferLen, lastFlag,
+      &outBuffer, outBufferLen);
+}
+
+std::pair<size_t, size_t>
+      Resample::Process(double              factor,
+                        const float *const *inBuffers,
+                        size_t              inBufferLen,
+                        bool                lastFlag,
+                        float *const       *outBuffers,
+                        size_t              outBufferLen)
 {
    size_t idone, odone;
-   if (mbWantConstRateResampling)
-   {
-      soxr_process(mHandle.get(),
-            inBuffer , (lastFlag? ~inBufferLen : inBufferLen), &idone,
-            outBuffer,                           outBufferLen, &odone);
-   }
-   else
-   {
+   if (!mbWantConstRateResampling)
       soxr_set_io_ratio(mHandle.get(), 1/factor, 0);
 
-      inBufferLen = lastFlag? ~inBufferLen : inBufferLen;
-      soxr_process(mHandle.get(),
-            inBuffer , inBufferLen , &idone,
-            outBuffer, outBufferLen, &odone);
-   }
+   // With split channels, soxr takes arrays of pointers to the channels
+   soxr_process(mHandle.get(),
+         inBuffers , (lastFlag? ~inBufferLen : inBufferLen), &idone,
+         const_cast<float **>(outBuffers),      outBufferLen, &odone);
    return { idone, odone };
 }
 
@@ -36,9 +36,15 @@ class MATH_API Resample final
    /// the fast method.
    // dMinFactor and dMaxFactor specify the range of factors for variable-rate resampling.
    // For constant-rate, pass the same value for both.
-   Resample(const bool useBestMethod, const double dMinFactor, const double dMaxFactor);
+   // nChannels channels are resampled together by one libsoxr instance, which
+   // may use up to nThreads threads of its own (0 lets libsoxr decide; that
+   // has an effect only when libsoxr was built with OpenMP).
+   Resample(const bool useBestMethod, const double dMinFactor, const double dMaxFactor,
+      unsigned nChannels = 1, unsigned nThreads = 1);
    ~Resample();
 
+   unsigned Channels() const { return mnChannels; }
+
    static EnumSetting< int > FastMethodSetting;
    static EnumSetting< int > BestMethodSetting;
 
@@ -72,6 +78,19 @@ class MATH_API Resample final
                         float       *outBuffer,
                         size_t       outBufferLen);
 
+   /** @brief Like the mono Process(), for all channels at once.
+    *
+    * Each of the arrays has Channels() pointers to non-interleaved buffers.
+    * All channels consume and produce the same numbers of samples.
+    */
+   std::pair<size_t, size_t>
+                Process(double              factor,
+                        const float *const *inBuffers,
+                        size_t              inBufferLen,
+                        bool                lastFlag,
+                        float *const       *outBuffers,
+                        size_t              outBufferLen);
+
  protected:
    void SetMethod(const bool useBestMethod);
 
@@ -79,6 +98,7 @@ class MATH_API Resample final
    int   mMethod; // resampler-specific enum for resampling method
    soxrHandle mHandle; // constant-rate or variable-rate resampler (XOR per instance)
    bool mbWantConstRateResampling;
+   unsigned mnChannels;
 };
 
 #endif // __AUDACITY_RESAMPLE_H__
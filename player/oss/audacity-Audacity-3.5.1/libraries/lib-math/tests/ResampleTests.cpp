@@ -0,0 +1,136 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  ResampleTests.cpp
+
+**********************************************************************/
+#include "Resample.h"
+#include "MockedPrefs.h"
+
+#include <catch2/catch.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+std::vector<std::vector<float>> MakeInput(size_t nChannels, size_t length)
+{
+   std::vector<std::vector<float>> input(nChannels);
+   for (size_t iChannel = 0; iChannel < nChannels; ++iChannel)
+   {
+      input[iChannel].resize(length);
+      for (size_t i = 0; i < length; ++i)
+         input[iChannel][i] = std::sin(0.01 * (iChannel + 1) * i);
+   }
+   return input;
+}
+
+//! Feeds input by blocks, as MixerSource does, and collects all output
+std::vector<std::vector<float>> ResampleAll(
+   Resample& resample, double factor,
+   const std::vector<std::vector<float>>& input)
+{
+   constexpr size_t blockSize = 1024;
+   const auto nChannels = input.size();
+   const auto length = input[0].size();
+   const auto outLength = static_cast<size_t>(length * factor) + blockSize;
+   std::vector<std::vector<float>> output(
+      nChannels, std::vector<float>(outLength));
+
+   std::vector<const float*> in(nChannels);
+   std::vector<float*> out(nChannels);
+   size_t inPos = 0, outPos = 0;
+   while (true)
+   {
+      const auto len = std::min(blockSize, length - inPos);
+      const bool last = inPos + len == length;
+      for (size_t iChannel = 0; iChannel < nChannels; ++iChannel)
+      {
+         in[iChannel] = input[iChannel].data() + inPos;
+         out[iChannel] = output[iChannel].data() + outPos;
+      }
+      const auto [used, produced] = resample.Process(
+         factor, in.data(), len, last, out.data(), outLength - outPos);
+      inPos += used;
+      outPos += produced;
+      if (last && produced == 0)
+         break;
+   }
+   for (auto& channel : output)
+      channel.resize(outPos);
+   return output;
+}
+
+//! The same, one channel at a time with a resampler per channel
+std::vector<std::vector<float>> ResamplePerChannel(
+   double factor, const std::vector<std::vector<float>>& input)
+{
+   std::vector<std::vector<float>> output;
+   for (const auto& channel : input)
+   {
+      Resample resample { true, factor, factor };
+      output.push_back(ResampleAll(resample, factor, { channel })[0]);
+   }
+   return output;
+}
+} // namespace
+
+TEST_CASE("Resample", "[Resample]")
+{
+   MockedPrefs mockedPrefs;
+
+   SECTION("multi-channel output matches per-channel output")
+   {
+      const auto nChannels = GENERATE(1u, 2u, 6u);
+      const auto factor = GENERATE(48000.0 / 44100.0, 44100.0 / 96000.0);
+      const auto input = MakeInput(nChannels, 20000);
+
+      Resample resample { true, factor, factor, nChannels };
+      REQUIRE(resample.Channels() == nChannels);
+      const auto together = ResampleAll(resample, factor, input);
+      const auto separately = ResamplePerChannel(factor, input);
+
+      REQUIRE(together == separately);
+   }
+}
+
+TEST_CASE("Resample throughput", "[Resample][.benchmark]")
+{
+   MockedPrefs mockedPrefs;
+
+   using Clock = std::chrono::steady_clock;
+   const auto rates = { std::pair { 44100.0, 48000.0 },
+                        std::pair { 48000.0, 44100.0 },
+                        std::pair { 96000.0, 44100.0 } };
+   for (const auto nChannels : { 2u, 6u })
+   {
+      const auto input = MakeInput(nChannels, 44100 * 60);
+      for (const auto [from, to] : rates)
+      {
+         const auto factor = to / from;
+
+         auto start = Clock::now();
+         ResamplePerChannel(factor, input);
+         const auto perChannel = Clock::now() - start;
+
+         start = Clock::now();
+         Resample resample { true, factor, factor, nChannels };
+         ResampleAll(resample, factor, input);
+         const auto together = Clock::now() - start;
+
+         using std::chrono::duration_cast;
+         using std::chrono::milliseconds;
+         std::cout << nChannels << " channels, " << from << " -> " << to
+                   << ": per-channel "
+                   << duration_cast<milliseconds>(perChannel).count()
+                   << " ms, multi-channel "
+                   << duration_cast<milliseconds>(together).count()
+                   << " ms\n";
+      }
+   }
+}
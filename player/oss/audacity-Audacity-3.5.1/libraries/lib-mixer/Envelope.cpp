@@ -29,6 +29,7 @@ a draggable point type.
 
 #include "Envelope.h"
 
+#include <algorithm>
 #include <float.h>
 #include <math.h>
 
@@ -942,119 +943,207 @@ void Envelope::GetValues( double *buffer, int bufferLen,
    GetValuesRelative( buffer, bufferLen, t0, tstep);
 }
 
+void Envelope::GetValues( double *buffer, int bufferLen,
+   double t0, double tstep, Cursor &cursor ) const
+{
+   GetValuesRelative( buffer, bufferLen, t0 - mOffset, tstep, false,
+      cursor.mIndex );
+}
+
 void Envelope::GetValuesRelative
    (double *buffer, int bufferLen, double t0, double tstep, bool leftLimit)
    const
+{
+   GetValuesRelative( buffer, bufferLen, t0, tstep, leftLimit, mSearchGuess );
+}
+
+/// Find the interval containing t, trying a short forward walk from a
+/// previous result before resorting to binary search
+/// @param guess in: a previous result; out: Lo
+/// @param Lo returns last index at (or, for a left limit, before) t
+/// @param Hi returns Lo + 1
+/// @pre t is strictly within the envelope, as limits are defined
+void Envelope::FindInterval(
+   int &Lo, int &Hi, double t, bool leftLimit, int &guess ) const
+{
+   const int len = mEnv.size();
+   const auto before = [&](int iPoint){
+      const auto tPoint = mEnv[iPoint].GetT();
+      return leftLimit ? tPoint < t : tPoint <= t;
+   };
+
+   // Sequential evaluation usually stays in the same interval, or passes
+   // into one of the next few
+   constexpr int maxWalk = 4;
+   if (guess >= 0 && guess < len - 1 && before(guess)) {
+      for (int lo = guess, end = std::min(len - 1, guess + maxWalk);
+           lo < end; ++lo)
+         if (!before(lo + 1)) {
+            guess = Lo = lo, Hi = lo + 1;
+            return;
+         }
+   }
+
+   if ( leftLimit )
+      BinarySearchForTime_LeftLimit( Lo, Hi, t );
+   else
+      BinarySearchForTime( Lo, Hi, t );
+   guess = Lo;
+}
+
+namespace {
+/// Fill buffer[b] for b in [first, last) with the linear function of
+/// sample time, a + slope * (t0 + b * tstep - tprev).
+/// Each value is computed independently, so that the loop vectorizes, and
+/// rounding errors don't accumulate over long intervals.
+void FillLinear(double *buffer, int first, int last,
+   double t0, double tstep, double tprev, double a, double slope)
+{
+   const auto origin = a + slope * (t0 - tprev);
+   const auto step = slope * tstep;
+   for (int b = first; b < last; ++b)
+      buffer[b] = origin + step * b;
+}
+
+/// Fill buffer[b] for b in [first, last) with 10 raised to the linear
+/// function.
+/// Computing pow() for every sample is too costly; instead a geometric
+/// sequence is computed in independent lanes, each multiplied by the ratio
+/// raised to the number of lanes, so the loop vectorizes.  The lanes are
+/// reseeded exactly at intervals to bound the accumulated error.
+void FillExponential(double *buffer, int first, int last,
+   double t0, double tstep, double tprev, double a, double slope)
+{
+   constexpr int nLanes = 4;
+   constexpr int reseedInterval = 1024;
+   static_assert(reseedInterval % nLanes == 0);
+
+   const auto ratio = pow(10.0, slope * tstep);
+   double lanesRatio = 1.0;
+   for (int j = 0; j < nLanes; ++j)
+      lanesRatio *= ratio;
+
+   for (int start = first; start < last; start += reseedInterval) {
+      const auto end = std::min(last, start + reseedInterval);
+      double lanes[nLanes];
+      lanes[0] = pow(10.0, a + slope * (t0 + start * tstep - tprev));
+      for (int j = 1; j < nLanes; ++j)
+         lanes[j] = lanes[j - 1] * ratio;
+
+      int b = start;
+      for (; b + nLanes <= end; b += nLanes)
+         for (int j = 0; j < nLanes; ++j) {
+            buffer[b + j] = lanes[j];
+            lanes[j] *= lanesRatio;
+         }
+      for (int j = 0; b < end; ++b, ++j)
+         buffer[b] = lanes[j];
+   }
+}
+}
+
+void Envelope::GetValuesRelative(double *buffer, int bufferLen,
+   double t0, double tstep, bool leftLimit, int &guess) const
 {
    // JC: If bufferLen ==0 we have probably just allocated a zero sized buffer.
    // wxASSERT( bufferLen > 0 );
 
    const auto epsilon = tstep / 2;
-   int len = mEnv.size();
+   const int len = mEnv.size();
 
-   double t = t0;
-   double increment = 0;
-   if ( len > 1 && t <= mEnv[0].GetT() && mEnv[0].GetT() == mEnv[1].GetT() )
-      increment = leftLimit ? -epsilon : epsilon;
+   // IF empty envelope THEN default value
+   if (len <= 0) {
+      std::fill(buffer, buffer + std::max(0, bufferLen), mDefaultValue);
+      return;
+   }
 
-   double tprev, vprev, tnext = 0, vnext, vstep = 0;
+   const auto tFirst = mEnv[0].GetT();
+   const auto tLast = mEnv[len - 1].GetT();
 
-   for (int b = 0; b < bufferLen; b++) {
+   double increment = 0;
+   if ( len > 1 && t0 <= tFirst && tFirst == mEnv[1].GetT() )
+      increment = leftLimit ? -epsilon : epsilon;
 
-      // Get easiest cases out the way first...
-      // IF empty envelope THEN default value
-      if (len <= 0) {
-         buffer[b] = mDefaultValue;
-         t += tstep;
-         continue;
-      }
+   // Sample times are computed from the index, not accumulated
+   const auto timeAt = [&](int b){ return t0 + b * tstep; };
 
-      auto tplus = t + increment;
+   int b = 0;
+   while (b < bufferLen) {
+      auto tplus = timeAt(b) + increment;
 
       // IF before envelope THEN first value
-      if ( leftLimit ? tplus <= mEnv[0].GetT() : tplus < mEnv[0].GetT() ) {
-         buffer[b] = mEnv[0].GetVal();
-         t += tstep;
+      if ( leftLimit ? tplus <= tFirst : tplus < tFirst ) {
+         buffer[b++] = mEnv[0].GetVal();
          continue;
       }
       // IF after envelope THEN last value
-      if ( leftLimit
-            ? tplus > mEnv[len - 1].GetT() : tplus >= mEnv[len - 1].GetT() ) {
-         buffer[b] = mEnv[len - 1].GetVal();
-         t += tstep;
+      if ( leftLimit ? tplus > tLast : tplus >= tLast ) {
+         // Times only increase, so the rest of the buffer is also after
+         if (tstep >= 0) {
+            std::fill(buffer + b, buffer + bufferLen, mEnv[len - 1].GetVal());
+            return;
+         }
+         buffer[b++] = mEnv[len - 1].GetVal();
          continue;
       }
 
-      // be careful to get the correct limit even in case epsilon == 0
-      if ( b == 0 ||
-           ( leftLimit ? tplus > tnext : tplus >= tnext ) ) {
-
-         // We're beyond our tnext, so find the next one.
-         // Don't just increment lo or hi because we might
-         // be zoomed far out and that could be a large number of
-         // points to move over.  That's why we binary search.
-
-         int lo,hi;
-         if ( leftLimit )
-            BinarySearchForTime_LeftLimit( lo, hi, tplus );
-         else
-            BinarySearchForTime( lo, hi, tplus );
-
-         // mEnv[0] is before tplus because of eliminations above, therefore lo >= 0
-         // mEnv[len - 1] is after tplus, therefore hi <= len - 1
-         wxASSERT( lo >= 0 && hi <= len - 1 );
-
-         tprev = mEnv[lo].GetT();
-         tnext = mEnv[hi].GetT();
-
-         if ( hi + 1 < len && tnext == mEnv[ hi + 1 ].GetT() )
-            // There is a discontinuity after this point-to-point interval.
-            // Usually will stop evaluating in this interval when time is slightly
-            // before tNext, then use the right limit.
-            // This is the right intent
-            // in case small roundoff errors cause a sample time to be a little
-            // before the envelope point time.
-            // Less commonly we want a left limit, so we continue evaluating in
-            // this interval until shortly after the discontinuity.
-            increment = leftLimit ? -epsilon : epsilon;
-         else
-            increment = 0;
-
-         vprev = GetInterpolationStartValueAtPoint( lo );
-         vnext = GetInterpolationStartValueAtPoint( hi );
+      // Find the interval between points.  The cursor makes this cheap for
+      // dense envelopes evaluated sequentially, buffer after buffer.
+      int lo, hi;
+      FindInterval( lo, hi, tplus, leftLimit, guess );
+
+      // mEnv[0] is before tplus because of eliminations above, therefore lo >= 0
+      // mEnv[len - 1] is after tplus, therefore hi <= len - 1
+      wxASSERT( lo >= 0 && hi <= len - 1 );
+
+      const auto tprev = mEnv[lo].GetT();
+      const auto tnext = mEnv[hi].GetT();
+
+      if ( hi + 1 < len && tnext == mEnv[ hi + 1 ].GetT() )
+         // There is a discontinuity after this point-to-point interval.
+         // Usually will stop evaluating in this interval when time is slightly
+         // before tNext, then use the right limit.
+         // This is the right intent
+         // in case small roundoff errors cause a sample time to be a little
+         // before the envelope point time.
+         // Less commonly we want a left limit, so we continue evaluating in
+         // this interval until shortly after the discontinuity.
+         increment = leftLimit ? -epsilon : epsilon;
+      else
+         increment = 0;
 
-         // Interpolate, either linear or log depending on mDB.
-         double dt = (tnext - tprev);
-         double to = t - tprev;
-         double v;
-         if (dt > 0.0)
-         {
-            v = (vprev * (dt - to) + vnext * to) / dt;
-            vstep = (vnext - vprev) * tstep / dt;
-         }
-         else
-         {
-            v = vnext;
-            vstep = 0.0;
-         }
+      // Find the end of the run of samples in this interval.
+      // be careful to get the correct limit even in case epsilon == 0
+      const auto inside = [&](int bb){
+         const auto tt = timeAt(bb) + increment;
+         return leftLimit ? tt <= tnext : tt < tnext;
+      };
+      int end = b + 1;
+      if (tstep > 0 && end < bufferLen) {
+         // Estimate, then correct for roundoff
+         const auto estimate =
+            ceil((tnext - increment - timeAt(b)) / tstep);
+         end = b + static_cast<int>(std::max(1.0,
+            std::min<double>(estimate, bufferLen - b)));
+         while (end > b + 1 && !inside(end - 1))
+            --end;
+         while (end < bufferLen && inside(end))
+            ++end;
+      }
 
-         // An adjustment if logarithmic scale.
-         if( mDB )
-         {
-            v = pow(10.0, v);
-            vstep = pow( 10.0, vstep );
-         }
+      const auto vprev = GetInterpolationStartValueAtPoint( lo );
+      const auto vnext = GetInterpolationStartValueAtPoint( hi );
 
-         buffer[b] = v;
-      } else {
-         if (mDB){
-            buffer[b] = buffer[b - 1] * vstep;
-         }else{
-            buffer[b] = buffer[b - 1] + vstep;
-         }
-      }
+      // Interpolate, either linear or log depending on mDB.
+      const double dt = (tnext - tprev);
+      const auto slope = dt > 0.0 ? (vnext - vprev) / dt : 0.0;
+      const auto a = dt > 0.0 ? vprev : vnext;
+      if (mDB)
+         FillExponential(buffer, b, end, t0, tstep, tprev, a, slope);
+      else
+         FillLinear(buffer, b, end, t0, tstep, tprev, a, slope);
 
-      t += tstep;
+      b = end;
    }
 }
 
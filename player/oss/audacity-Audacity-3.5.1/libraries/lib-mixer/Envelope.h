@@ -139,6 +139,20 @@ public:
     * more than one value in a row. */
    void GetValues(double *buffer, int len, double t0, double tstep) const;
 
+   //! Remembers where the last evaluation ended, for sequential evaluation
+   /*! A dense envelope evaluated buffer after buffer, as in playback or
+    export, then needs no search for the interval between points.  Valid for
+    any state of the envelope; it is only a hint. */
+   class Cursor {
+      friend Envelope;
+      int mIndex{ -1 };
+   };
+
+   //! Like the other overload, but resuming from and updating a cursor that
+   //! the caller holds, rather than the one shared in the envelope
+   void GetValues(double *buffer, int len, double t0, double tstep,
+      Cursor &cursor) const;
+
    // Guarantee an envelope point at the end of the domain.
    void Cap( double sampleDur );
 
@@ -153,6 +167,8 @@ private:
    void GetValuesRelative
       (double *buffer, int len, double t0, double tstep, bool leftLimit = false)
       const;
+   void GetValuesRelative(double *buffer, int len, double t0, double tstep,
+      bool leftLimit, int &guess) const;
    // relative time
    int NumberOfPointsAfter(double t) const;
    // relative time
@@ -231,6 +247,8 @@ private:
    // relative time
    void BinarySearchForTime( int &Lo, int &Hi, double t ) const;
    void BinarySearchForTime_LeftLimit( int &Lo, int &Hi, double t ) const;
+   void FindInterval(
+      int &Lo, int &Hi, double t, bool leftLimit, int &guess ) const;
    double GetInterpolationStartValueAtPoint( int iPoint ) const;
 
    // The list of envelope control points.
@@ -37,12 +37,14 @@ initVector(size_t dim1, size_t dim2)
 }
 }
 
-void MixerSource::MakeResamplers()
+void MixerSource::MakeResamplers(unsigned nChannels)
 {
-   for (size_t j = 0; j < mnChannels; ++j)
-      mResample[j] = std::make_unique<Resample>(
-         mResampleParameters.mHighQuality,
-         mResampleParameters.mMinFactor, mResampleParameters.mMaxFactor);
+   // One resampler for all channels; the high quality (offline) mixer may let
+   // libsoxr use its own threads, but never the real-time one
+   mResample = std::make_unique<Resample>(
+      mResampleParameters.mHighQuality,
+      mResampleParameters.mMinFactor, mResampleParameters.mMaxFactor,
+      nChannels, mResampleParameters.mHighQuality ? 0 : 1);
 }
 
 namespace {
@@ -137,7 +139,7 @@ size_t MixerSource::MixVariableRates(
             }
             mpLeader->GetEnvelopeValues(
                mEnvValues.data(), getLen, (pos).as_double() / sequenceRate,
-               backwards);
+               backwards, &mEnvCursor);
             for (size_t iChannel = 0; iChannel < nChannels; ++iChannel) {
                const auto queue = mSampleQueue[iChannel].data();
                for (decltype(getLen) i = 0; i < getLen; i++)
@@ -174,28 +176,26 @@ size_t MixerSource::MixVariableRates(
                t, t + (double)thisProcessLen / sequenceRate);
       }
 
-      std::pair<size_t, size_t> results;
+      // All channels go through one resampler together
+      if (mResample->Channels() != nChannels)
+         MakeResamplers(nChannels);
       for (size_t iChannel = 0; iChannel < nChannels; ++iChannel) {
-         const auto queue = mSampleQueue[iChannel].data();
-         const auto pResample = mResample[iChannel].get();
-         const auto pFloat = floatBuffers[iChannel];
-         // Assuming that progress of the Resampler depends only
-         // on the size of its inputs, this assignment has the same effect on
-         // each pass.
-         results = pResample->Process(factor,
-            &queue[queueStart],
-            thisProcessLen,
-            last,
-            // PRL:  Bug2536: crash in soxr happened on Mac, sometimes, when
-            // maxOut - out == 1 and &pFloat[out + 1] was an unmapped
-            // address, because soxr, strangely, fetched an 8-byte (misaligned!)
-            // value from &pFloat[out], but did nothing with it anyway,
-            // in soxr_output_no_callback.
-            // Now we make the bug go away by allocating a little more space in
-            // the buffer than we need.
-            &pFloat[out],
-            maxOut - out);
+         mResampleIn[iChannel] = &mSampleQueue[iChannel][queueStart];
+         mResampleOut[iChannel] = &floatBuffers[iChannel][out];
       }
+      const auto results = mResample->Process(factor,
+         mResampleIn.data(),
+         thisProcessLen,
+         last,
+         // PRL:  Bug2536: crash in soxr happened on Mac, sometimes, when
+         // maxOut - out == 1 and &pFloat[out + 1] was an unmapped
+         // address, because soxr, strangely, fetched an 8-byte (misaligned!)
+         // value from &pFloat[out], but did nothing with it anyway,
+         // in soxr_output_no_callback.
+         // Now we make the bug go away by allocating a little more space in
+         // the buffer than we need.
+         mResampleOut.data(),
+         maxOut - out);
 
       const auto input_used = results.first;
       queueStart += input_used;
@@ -260,7 +260,8 @@ size_t MixerSource::MixSameRate(unsigned nChannels, const size_t maxOut,
       
    }
 
-   mpLeader->GetEnvelopeValues(mEnvValues.data(), slen, t, backwards);
+   mpLeader->GetEnvelopeValues(
+      mEnvValues.data(), slen, t, backwards, &mEnvCursor);
 
    for (size_t iChannel = 0; iChannel < nChannels; ++iChannel) {
       const auto pFloat = floatBuffers[iChannel];
@@ -301,14 +302,15 @@ MixerSource::MixerSource(
    , mQueueStart{ 0 }
    , mQueueLen{ 0 }
    , mResampleParameters{ highQuality, mpLeader->GetRate(), rate, options }
-   , mResample( mnChannels )
+   , mResampleIn( mnChannels )
+   , mResampleOut( mnChannels )
    , mEnvValues( std::max(sQueueMaxLen, bufferSize) )
    , mpMap{ pMap }
 {
    assert(mTimesAndSpeed);
    auto t0 = mTimesAndSpeed->mT0;
    mSamplePos = GetSequence().TimeToLongSamples(t0);
-   MakeResamplers();
+   MakeResamplers(mnChannels);
 }
 
 MixerSource::~MixerSource() = default;
@@ -416,5 +418,5 @@ void MixerSource::Reposition(double time, bool skipping)
    // flushed.  Should that be considered a bug in sox?  This works around it.
    // (See also bug 1887, and the same work around in Mixer::Restart().)
    if (skipping)
-      MakeResamplers();
+      MakeResamplers(mResample->Channels());
 }
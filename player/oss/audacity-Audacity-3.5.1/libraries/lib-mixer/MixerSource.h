@@ -15,6 +15,7 @@
 #define __AUDACITY_MIXER_SOURCE__
 
 #include "AudioGraphSource.h"
+#include "Envelope.h"
 #include "MixerOptions.h"
 #include "SampleCount.h"
 #include <memory>
@@ -65,7 +66,7 @@ public:
    bool VariableRates() const { return mResampleParameters.mVariableRates; }
 
 private:
-   void MakeResamplers();
+   void MakeResamplers(unsigned nChannels);
 
    //! Cut the queue into blocks of this finer size
    //! for variable rate resampling.  Each block is resampled at some
@@ -125,10 +126,17 @@ private:
    int mQueueLen;
 
    const ResampleParameters mResampleParameters;
-   std::vector<std::unique_ptr<Resample>> mResample;
+   //! Resamples all channels together, created for the number of channels
+   //! being mixed
+   std::unique_ptr<Resample> mResample;
+   //! Per-channel pointers passed to mResample
+   std::vector<const float *> mResampleIn;
+   std::vector<float *> mResampleOut;
 
    //! Gain envelopes are applied to input before other transformations
    std::vector<double> mEnvValues;
+   //! Where the last buffer of envelope values ended
+   Envelope::Cursor mEnvCursor;
 
    //! many-to-one mixing of channels
    //! Pointer into array of arrays
@@ -11,6 +11,7 @@ Paul Licameli split from SampleFrame.h
 #define __AUDACITY_WIDE_SAMPLE_SEQUENCE_
 
 #include "AudioGraphChannel.h"
+#include "Envelope.h"
 #include "SampleCount.h"
 #include "SampleFormat.h"
 
@@ -124,9 +125,12 @@ public:
    /*!
     @param backwards if true, fetch values in reverse order, from `t0` to
        `t0 - bufferLen / rate`
+    @param pCursor if not null, resumed and updated by each envelope
+       evaluated; hold one across sequential calls, as in playback or export
     */
    virtual void GetEnvelopeValues(
-      double* buffer, size_t bufferLen, double t0, bool backwards) const = 0;
+      double* buffer, size_t bufferLen, double t0, bool backwards,
+      Envelope::Cursor *pCursor = nullptr) const = 0;
 };
 
 #endif
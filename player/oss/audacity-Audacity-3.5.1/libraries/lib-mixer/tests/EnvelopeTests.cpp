@@ -0,0 +1,153 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  @file EnvelopeTests.cpp
+
+**********************************************************************/
+#include <catch2/catch.hpp>
+
+#include "Envelope.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace {
+constexpr double rate = 44100.0;
+constexpr double totalDuration = 60.0;
+
+// Dense automation: a point every few milliseconds, with some random jitter
+void AddDensePoints(Envelope &envelope, size_t nPoints)
+{
+   std::mt19937 engine{ 1234 };
+   std::uniform_real_distribution<double> value{ 0.1, 2.0 };
+   std::uniform_real_distribution<double> jitter{ -0.25, 0.25 };
+   const auto spacing = totalDuration / nPoints;
+   for (size_t ii = 0; ii < nPoints; ++ii)
+      envelope.InsertOrReplace(
+         (ii + 0.5 + jitter(engine)) * spacing, value(engine));
+}
+
+// Evaluation by the definition, independent of the envelope's search
+double Reference(const Envelope &envelope, double t)
+{
+   const auto nPoints = envelope.GetNumberOfPoints();
+   if (nPoints == 0)
+      return 1.0;
+   if (t < envelope[0].GetT())
+      return envelope[0].GetVal();
+   if (t >= envelope[nPoints - 1].GetT())
+      return envelope[nPoints - 1].GetVal();
+   size_t hi = 1;
+   while (envelope[hi].GetT() <= t)
+      ++hi;
+   const auto &prev = envelope[hi - 1], &next = envelope[hi];
+   const auto fraction =
+      (t - prev.GetT()) / (next.GetT() - prev.GetT());
+   if (envelope.GetExponential())
+      return std::pow(10.0, std::log10(prev.GetVal()) +
+         fraction * (std::log10(next.GetVal()) - std::log10(prev.GetVal())));
+   return prev.GetVal() + fraction * (next.GetVal() - prev.GetVal());
+}
+}
+
+TEST_CASE("Envelope::GetValues", "[Envelope]")
+{
+   const bool exponential = GENERATE(false, true);
+   Envelope envelope{ exponential, 0.01, 10.0, 1.0 };
+   envelope.SetTrackLen(totalDuration);
+   AddDensePoints(envelope, 5000);
+
+   const auto tstep = 1.0 / rate;
+   const size_t bufferSize = 4096;
+   std::vector<double> values(bufferSize);
+
+   SECTION("Matches pointwise evaluation")
+   {
+      // Start a little before the first point, and read past the last
+      for (double t0 : { -0.01, 1.0, 30.0, totalDuration - 0.05 }) {
+         envelope.GetValues(values.data(), bufferSize, t0, tstep);
+         for (size_t ii = 0; ii < bufferSize; ++ii) {
+            const auto expected = Reference(envelope, t0 + ii * tstep);
+            REQUIRE(values[ii] == Approx(expected).epsilon(1e-9));
+         }
+      }
+   }
+
+   SECTION("Cursor continues across buffers")
+   {
+      const size_t total = 16 * bufferSize;
+      const double t0 = 10.0;
+      std::vector<double> whole(total);
+      envelope.GetValues(whole.data(), total, t0, tstep);
+
+      Envelope::Cursor cursor;
+      for (size_t start = 0; start < total; start += bufferSize) {
+         envelope.GetValues(
+            values.data(), bufferSize, t0 + start * tstep, tstep, cursor);
+         for (size_t ii = 0; ii < bufferSize; ++ii)
+            REQUIRE(values[ii] == Approx(whole[start + ii]).epsilon(1e-9));
+      }
+   }
+
+   SECTION("Empty envelope gives the default value")
+   {
+      Envelope empty{ exponential, 0.01, 10.0, 0.5 };
+      empty.GetValues(values.data(), bufferSize, 0.0, tstep);
+      REQUIRE(std::all_of(values.begin(), values.end(),
+         [](double value){ return value == 0.5; }));
+   }
+}
+
+TEST_CASE("Envelope discontinuity", "[Envelope]")
+{
+   Envelope envelope{ false, 0.0, 2.0, 1.0 };
+   envelope.SetTrackLen(1.0);
+   // A step at 0.5
+   envelope.Insert(0.0, 0.0);
+   envelope.Insert(0.5, 1.0);
+   envelope.Insert(0.5, 2.0);
+   envelope.Insert(1.0, 2.0);
+
+   const double tstep = 0.125;
+   std::vector<double> values(9);
+   envelope.GetValues(values.data(), values.size(), 0.0, tstep);
+   const std::vector<double> expected{
+      0.0, 0.25, 0.5, 0.75, 2.0, 2.0, 2.0, 2.0, 2.0 };
+   for (size_t ii = 0; ii < values.size(); ++ii)
+      REQUIRE(values[ii] == Approx(expected[ii]));
+}
+
+TEST_CASE("Envelope::GetValues benchmark", "[.benchmark]")
+{
+   using namespace std::chrono;
+   const size_t bufferSize = 512;
+   const auto nSamples = static_cast<size_t>(totalDuration * rate);
+   std::vector<double> values(bufferSize);
+
+   for (bool exponential : { false, true })
+   for (size_t nPoints : { 100u, 10000u, 100000u }) {
+      Envelope envelope{ exponential, 0.01, 10.0, 1.0 };
+      envelope.SetTrackLen(totalDuration);
+      AddDensePoints(envelope, nPoints);
+
+      double sum = 0;
+      const auto start = steady_clock::now();
+      Envelope::Cursor cursor;
+      for (size_t first = 0; first < nSamples; first += bufferSize) {
+         envelope.GetValues(
+            values.data(), bufferSize, first / rate, 1.0 / rate, cursor);
+         sum += values[0];
+      }
+      const auto elapsed =
+         duration_cast<microseconds>(steady_clock::now() - start).count();
+      std::cout << (exponential ? "exponential, " : "linear, ")
+         << nPoints << " points: " << elapsed / 1000.0 << " ms for "
+         << totalDuration << " s of audio (" << sum << ")\n";
+   }
+}
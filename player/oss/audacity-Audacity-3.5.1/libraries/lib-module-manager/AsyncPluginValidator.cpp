@@ -116,7 +116,8 @@ class AsyncPluginValidator::Impl final :
                   wxString pluginPath;
                   detail::ParseRequestString(*request, providerId, pluginPath);
 
-                  self->mDelegate->OnPluginValidationFailed(providerId, pluginPath);
+                  self->mDelegate->OnPluginValidationFailed(
+                     providerId, pluginPath, !result.HasError());
                }
                self->mDelegate->OnValidationFinished();
             }
@@ -43,7 +43,10 @@ public:
 
       ///Called for each plugin instance found inside module
       virtual void OnPluginFound(const PluginDescriptor& plugin) = 0;
-      virtual void OnPluginValidationFailed(const wxString& providerId, const wxString& path) = 0;
+      ///Called when module wasn't recognized by the provider, or validation
+      ///failed. `definitive` is false when the failure is not a property of
+      ///the module itself (e.g. host process crashed or disconnected)
+      virtual void OnPluginValidationFailed(const wxString& providerId, const wxString& path, bool definitive) = 0;
       ///Called when module processing finished
       virtual void OnValidationFinished() = 0;
       ///Called on error, further processing is not possible.
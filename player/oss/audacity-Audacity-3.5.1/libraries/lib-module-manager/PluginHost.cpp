@@ -36,7 +36,7 @@ namespace
          {
             TranslatableString errorMessage{};
             auto validator = provider->MakeValidator();
-            auto numPlugins = provider->DiscoverPluginsAtPath(
+            provider->DiscoverPluginsAtPath(
                pluginPath, errorMessage, [&](PluginProvider *provider, ComponentInterface *ident) -> const PluginID&
             {
                //Workaround: use DefaultRegistrationCallback to create all descriptors for us
@@ -59,10 +59,11 @@ namespace
                }
                return id;
             });
+            //An empty result without error means that provider
+            //doesn't recognize the module, which is worth remembering,
+            //unlike errors that may be specific to this attempt
             if(!errorMessage.empty())
                result.SetError(errorMessage.Debug());
-            else if(numPlugins == 0)
-               result.SetError("no plugins found");
          }
          else
             result.SetError("provider not found");
@@ -0,0 +1,292 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  @file PluginValidationCache.cpp
+
+  Part of lib-module-manager library
+
+**********************************************************************/
+
+#include "PluginValidationCache.h"
+
+#include <algorithm>
+#include <cstdint>
+
+#include <wx/dir.h>
+#include <wx/filename.h>
+#include <wx/ffile.h>
+
+#include "AudacityException.h"
+#include "Internat.h" // for macro XO
+#include "XMLFileReader.h"
+#include "XMLWriter.h"
+
+namespace
+{
+   constexpr auto NodeCache = "PluginValidationCache";
+   constexpr auto NodeModule = "Module";
+   constexpr auto AttrVersion = "version";
+   constexpr auto AttrProvider = "provider";
+   constexpr auto AttrPath = "path";
+   constexpr auto AttrModificationTime = "mtime";
+   constexpr auto AttrSize = "size";
+   constexpr auto AttrHash = "hash";
+
+   //Bump when the layout of the file changes
+   constexpr auto CacheVersion = 1;
+
+   //Only the head of a module is hashed: it is enough to catch a
+   //replacement of the module which preserved its mtime and size, and
+   //keeps the lookup cheap even for modules that are hundreds of megabytes
+   constexpr size_t HashedBytes = 64 * 1024;
+
+   //64-bit FNV-1a
+   class Hasher
+   {
+      std::uint64_t mValue { 14695981039346656037ull };
+   public:
+      void Update(const void* data, size_t size) noexcept
+      {
+         auto bytes = static_cast<const unsigned char*>(data);
+         for(size_t i = 0; i < size; ++i)
+         {
+            mValue ^= bytes[i];
+            mValue *= 1099511628211ull;
+         }
+      }
+
+      template<typename T>
+      void Update(T value) noexcept
+      {
+         Update(&value, sizeof(value));
+      }
+
+      wxString Finalize() const
+      {
+         return wxString::Format("%016llx", static_cast<unsigned long long>(mValue));
+      }
+   };
+
+   long long GetModificationTime(const wxString& path)
+   {
+      const auto time = wxFileName(path).GetModificationTime();
+      return time.IsValid() ? time.GetValue().GetValue() : 0;
+   }
+
+   bool HashFileHead(const wxString& path, Hasher& hasher)
+   {
+      wxFFile file(path, "rb");
+      if(!file.IsOpened())
+         return false;
+
+      std::vector<char> buffer(HashedBytes);
+      const auto bytesRead = file.Read(buffer.data(), buffer.size());
+      if(file.Error())
+         return false;
+      hasher.Update(buffer.data(), bytesRead);
+      return true;
+   }
+}
+
+bool PluginValidationCache::Fingerprint::operator==(const Fingerprint& other) const noexcept
+{
+   return modificationTime == other.modificationTime &&
+      size == other.size &&
+      hash == other.hash;
+}
+
+class PluginValidationCache::Entry final : public XMLTagHandler
+{
+public:
+   wxString providerId;
+   wxString pluginPath;
+   Fingerprint fingerprint;
+   std::vector<PluginDescriptor> descriptors;
+
+   bool HandleXMLTag(const std::string_view&, const AttributesList& attrs) override
+   {
+      for(auto& [name, value] : attrs)
+      {
+         if(name == AttrProvider)
+            providerId = value.ToWString();
+         else if(name == AttrPath)
+            pluginPath = value.ToWString();
+         else if(name == AttrModificationTime)
+            fingerprint.modificationTime = value.Get<long long>();
+         else if(name == AttrSize)
+            fingerprint.size = value.Get<long long>();
+         else if(name == AttrHash)
+            fingerprint.hash = value.ToWString();
+      }
+      return !providerId.empty() && !pluginPath.empty();
+   }
+
+   XMLTagHandler* HandleXMLChild(const std::string_view& tag) override
+   {
+      if(tag == PluginDescriptor::XMLNodeName)
+      {
+         descriptors.resize(descriptors.size() + 1);
+         return &descriptors.back();
+      }
+      return nullptr;
+   }
+};
+
+PluginValidationCache::PluginValidationCache(const wxString& cachePath)
+   : mCachePath(cachePath)
+{
+}
+
+PluginValidationCache::~PluginValidationCache() = default;
+
+std::optional<PluginValidationCache::Fingerprint>
+PluginValidationCache::GetFingerprint(const wxString& pluginPath)
+{
+   Fingerprint fingerprint;
+   Hasher hasher;
+
+   if(wxFileName::FileExists(pluginPath))
+   {
+      const auto size = wxFileName::GetSize(pluginPath);
+      if(size == wxInvalidSize)
+         return {};
+      fingerprint.size = size.GetValue();
+      fingerprint.modificationTime = GetModificationTime(pluginPath);
+      if(!HashFileHead(pluginPath, hasher))
+         return {};
+   }
+   else if(wxFileName::DirExists(pluginPath))
+   {
+      //Bundles (VST3, AU, ...): a binary inside may be replaced without
+      //touching the bundle directory itself, so account for every file
+      wxArrayString files;
+      wxDir::GetAllFiles(pluginPath, &files);
+      files.Sort();
+      for(const auto& file : files)
+      {
+         const auto size = wxFileName::GetSize(file);
+         const auto mtime = GetModificationTime(file);
+         hasher.Update(file.wx_str(), file.length() * sizeof(wxStringCharType));
+         hasher.Update(size == wxInvalidSize ? -1 : size.GetValue());
+         hasher.Update(mtime);
+         fingerprint.size += size == wxInvalidSize ? 0 : size.GetValue();
+         fingerprint.modificationTime = std::max(fingerprint.modificationTime, mtime);
+      }
+   }
+   else
+      return {};
+
+   fingerprint.hash = hasher.Finalize();
+   return fingerprint;
+}
+
+void PluginValidationCache::Load()
+{
+   mEntries.clear();
+   mModified = false;
+
+   if(!wxFileName::FileExists(mCachePath))
+      return;
+
+   XMLFileReader reader;
+   const auto success = reader.Parse(this, mCachePath);
+   auto loadedEntries = std::move(mLoadedEntries);
+   if(!success)
+   {
+      //Corrupted or outdated, start from scratch
+      mModified = true;
+      return;
+   }
+   for(auto& entry : loadedEntries)
+   {
+      if(entry->providerId.empty() || entry->pluginPath.empty())
+         continue;
+      Key key { entry->providerId, entry->pluginPath };
+      mEntries[std::move(key)] = std::move(entry);
+   }
+}
+
+void PluginValidationCache::Save() noexcept
+{
+   if(!mModified)
+      return;
+
+   GuardedCall([&] {
+      XMLFileWriter writer { mCachePath, XO("Error Saving Plugin Validation Cache") };
+
+      writer.StartTag(NodeCache);
+      writer.WriteAttr(AttrVersion, CacheVersion);
+      for(const auto& [key, entry] : mEntries)
+      {
+         writer.StartTag(NodeModule);
+         writer.WriteAttr(AttrProvider, key.first);
+         writer.WriteAttr(AttrPath, key.second);
+         writer.WriteAttr(AttrModificationTime, entry->fingerprint.modificationTime);
+         writer.WriteAttr(AttrSize, entry->fingerprint.size);
+         writer.WriteAttr(AttrHash, entry->fingerprint.hash);
+         for(const auto& desc : entry->descriptors)
+            desc.WriteXML(writer);
+         writer.EndTag(NodeModule);
+      }
+      writer.EndTag(NodeCache);
+
+      writer.Commit();
+      mModified = false;
+   });
+}
+
+std::optional<std::vector<PluginDescriptor>>
+PluginValidationCache::Lookup(const wxString& providerId, const wxString& pluginPath) const
+{
+   const auto it = mEntries.find({ providerId, pluginPath });
+   if(it == mEntries.end())
+      return {};
+
+   const auto fingerprint = GetFingerprint(pluginPath);
+   if(!fingerprint || !(*fingerprint == it->second->fingerprint))
+      return {};
+
+   return it->second->descriptors;
+}
+
+void PluginValidationCache::Store(
+   const wxString& providerId, const wxString& pluginPath,
+   std::vector<PluginDescriptor> descriptors)
+{
+   auto fingerprint = GetFingerprint(pluginPath);
+   if(!fingerprint)
+      return;
+
+   auto entry = std::make_unique<Entry>();
+   entry->providerId = providerId;
+   entry->pluginPath = pluginPath;
+   entry->fingerprint = std::move(*fingerprint);
+   entry->descriptors = std::move(descriptors);
+   mEntries[{ providerId, pluginPath }] = std::move(entry);
+   mModified = true;
+}
+
+bool PluginValidationCache::HandleXMLTag(const std::string_view& tag, const AttributesList& attrs)
+{
+   if(tag != NodeCache)
+      return false;
+
+   for(auto& [name, value] : attrs)
+   {
+      if(name == AttrVersion && value.Get<int>() != CacheVersion)
+         return false;
+   }
+   return true;
+}
+
+XMLTagHandler* PluginValidationCache::HandleXMLChild(const std::string_view& tag)
+{
+   if(tag != NodeModule)
+      return nullptr;
+
+   //Key is not known until attributes are read, entries are indexed
+   //once the whole file is parsed
+   mLoadedEntries.push_back(std::make_unique<Entry>());
+   return mLoadedEntries.back().get();
+}
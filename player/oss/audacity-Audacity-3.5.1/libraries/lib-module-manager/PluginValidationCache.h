@@ -0,0 +1,84 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  @file PluginValidationCache.h
+
+  Part of lib-module-manager library
+
+**********************************************************************/
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include <wx/string.h>
+
+#include "PluginDescriptor.h"
+#include "XMLTagHandler.h"
+
+/**
+ * \brief Persistent record of plugin validation results.
+ *
+ * Each entry is keyed by provider id and module path, and remembers the
+ * modification time, size and a content hash of the module at the moment
+ * it was validated. As long as the module on disk still matches that
+ * fingerprint, the stored result is reused and no plugin host process needs
+ * to be started for it.
+ *
+ * Paths that do not name a file or a directory (e.g. LV2 URIs) can't be
+ * fingerprinted and are never cached.
+ */
+class MODULE_MANAGER_API PluginValidationCache final : public XMLTagHandler
+{
+public:
+   struct Fingerprint
+   {
+      long long modificationTime{};
+      long long size{};
+      wxString hash;
+
+      bool operator==(const Fingerprint& other) const noexcept;
+   };
+
+   explicit PluginValidationCache(const wxString& cachePath);
+   ~PluginValidationCache() override;
+
+   ///Reads the cache file, if any. Unreadable files are treated as empty.
+   void Load();
+   ///Writes the cache file if it was modified since it was loaded.
+   ///Does not throw, failure only makes next startup slower.
+   void Save() noexcept;
+
+   /**
+    * \brief Looks for a result of previous validation of the module
+    * \return Descriptors found by the provider, possibly none if the
+    * module failed validation; std::nullopt if module has changed or has
+    * never been validated by that provider
+    */
+   std::optional<std::vector<PluginDescriptor>>
+   Lookup(const wxString& providerId, const wxString& pluginPath) const;
+
+   ///Remembers validation result along with the current fingerprint of the module
+   void Store(
+      const wxString& providerId, const wxString& pluginPath,
+      std::vector<PluginDescriptor> descriptors);
+
+   static std::optional<Fingerprint> GetFingerprint(const wxString& pluginPath);
+
+   bool HandleXMLTag(const std::string_view& tag, const AttributesList& attrs) override;
+   XMLTagHandler* HandleXMLChild(const std::string_view& tag) override;
+
+private:
+   class Entry;
+   using Key = std::pair<wxString, wxString>;
+
+   const wxString mCachePath;
+   std::map<Key, std::unique_ptr<Entry>> mEntries;
+   std::vector<std::unique_ptr<Entry>> mLoadedEntries;
+   bool mModified{false};
+};
@@ -221,14 +221,14 @@ public:
       mHandlers.pop_back();
    }
 
-   void WriteAttr(const std::string_view& name, std::string value)
+   void WriteAttr(const std::string_view& name, const std::string& value)
    {
       assert(mInTag);
 
       if (!mInTag)
          return;
 
-      mAttributes.emplace_back(name, CacheString(std::move(value)));
+      mAttributes.emplace_back(name, CacheString(value));
    }
 
    template <typename T> void WriteAttr(const std::string_view& name, T value)
@@ -241,16 +241,16 @@ public:
       mAttributes.emplace_back(name, XMLAttributeValueView(value));
    }
 
-   void WriteData(std::string value)
+   void WriteData(const std::string_view& value)
    {
       if (mInTag)
          EmitStartTag();
 
       if (XMLTagHandler* const handler = mHandlers.back())
-         handler->HandleXMLContent(CacheString(std::move(value)));
+         handler->HandleXMLContent(CacheString(value));
    }
 
-   void WriteRaw(std::string)
+   void WriteRaw(const std::string_view&)
    {
       // This method is intentionally left empty.
       // The only data that is serialized by FT_Raw
@@ -295,15 +295,23 @@ private:
          }
       }
 
-      mStringsCache.clear();
+      // Keep the cached strings allocated, so that the next tag
+      // can reuse their storage
+      mUsedStrings = 0;
       mAttributes.clear();
       mInTag = false;
    }
 
-   std::string_view CacheString(std::string string)
+   std::string_view CacheString(const std::string_view& string)
    {
-      mStringsCache.emplace_back(std::move(string));
-      return mStringsCache.back();
+      // std::deque never relocates existing elements on push_back, so the
+      // views handed out earlier for the current tag stay valid
+      if (mUsedStrings == mStringsCache.size())
+         mStringsCache.emplace_back();
+
+      auto& cached = mStringsCache[mUsedStrings++];
+      cached.assign(string.data(), string.size());
+      return cached;
    }
 
    XMLTagHandler* mBaseHandler;
@@ -313,19 +321,14 @@ private:
    std::string_view mCurrentTagName;
 
    std::deque<std::string> mStringsCache;
+   size_t mUsedStrings { 0 };
    AttributesList mAttributes;
 
    bool mInTag { false };
 };
 
-// template<typename BaseCharType>
-// std::string FastStringConvertFromAscii(const BaseCharType* begin, const BaseCharType* end)
-// {
-// 
-// }
-
 template<typename BaseCharType>
-std::string FastStringConvert(const void* bytes, int bytesCount)
+void FastStringConvert(const void* bytes, int bytesCount, std::string& result)
 {
    constexpr int charSize = sizeof(BaseCharType);
 
@@ -340,11 +343,50 @@ std::string FastStringConvert(const void* bytes, int bytesCount)
       { return static_cast<std::make_unsigned_t<BaseCharType>>(c) < 0x7f; });
 
    if (isAscii)
-      return std::string(begin, end);
-   
-   return std::wstring_convert<std::codecvt_utf8<BaseCharType>, BaseCharType>()
-      .to_bytes(begin, end);
+      result.assign(begin, end);
+   else
+      result = std::wstring_convert<std::codecvt_utf8<BaseCharType>, BaseCharType>()
+         .to_bytes(begin, end);
 }
+
+//! Names of the current dictionary, indexed by their 2-byte identifier
+/*! Identifiers are assigned densely by ProjectSerializer::WriteName, so an
+ indexed container gives a constant-time lookup without hashing on every field.
+ A deque is used so that views of names already handed to the adapter survive
+ the growth of the table. */
+class NamesTable final
+{
+public:
+   void Set(UShort id, std::string name)
+   {
+      if (id >= mNames.size())
+         mNames.resize(id + 1);
+
+      mNames[id] = std::move(name);
+      mDefined.resize(mNames.size());
+      mDefined[id] = true;
+   }
+
+   //! Returns false if the id was never defined
+   bool Lookup(UShort id, std::string_view& name) const noexcept
+   {
+      if (id >= mNames.size() || !mDefined[id])
+         return false;
+
+      name = mNames[id];
+      return true;
+   }
+
+   void Swap(NamesTable& other) noexcept
+   {
+      mNames.swap(other.mNames);
+      mDefined.swap(other.mDefined);
+   }
+
+private:
+   std::deque<std::string> mNames;
+   std::vector<bool> mDefined;
+};
 } // namespace
 
 ProjectSerializer::ProjectSerializer(size_t allocSize)
@@ -528,32 +570,36 @@ bool ProjectSerializer::Decode(BufferedStreamReader& in, XMLTagHandler* handler)
    XMLTagHandlerAdapter adapter(handler);
 
    std::vector<char> bytes;
-   IdMap mIds;
-   std::vector<IdMap> mIdStack;
+   // Decoded text of the current string field, reused for every field
+   std::string text;
+   NamesTable mIds;
+   std::vector<NamesTable> mIdStack;
    char mCharSize = 0;
 
-   mIds.clear();
-
    struct Error{}; // exception type for short-range try/catch
    auto Lookup = [&mIds]( UShort id ) -> std::string_view
    {
-      auto iter = mIds.find( id );
-      if (iter == mIds.end())
+      std::string_view name;
+      if (!mIds.Lookup(id, name))
       {
          throw Error{};
       }
 
-      return iter->second;
+      return name;
    };
 
    int64_t stringsCount = 0;
    int64_t stringsLength = 0;
 
-   auto ReadString = [&mCharSize, &in, &bytes, &stringsCount, &stringsLength](int len) -> std::string
+   auto ReadString = [&mCharSize, &in, &bytes, &text, &stringsCount, &stringsLength](int len) -> const std::string&
    {
-      bytes.reserve( len );
-      auto data = bytes.data();
-      in.Read( data, len );
+      if (len < 0)
+         throw Error{};
+
+      if (bytes.size() < size_t(len))
+         bytes.resize(len);
+      if (in.Read(bytes.data(), len) != size_t(len))
+         throw Error{};
 
       stringsCount++;
       stringsLength += len;
@@ -561,20 +607,24 @@ bool ProjectSerializer::Decode(BufferedStreamReader& in, XMLTagHandler* handler)
       switch (mCharSize)
       {
          case 1:
-            return std::string(bytes.data(), len);
+            text.assign(bytes.data(), len);
+            break;
 
          case 2:
-            return FastStringConvert<char16_t>(bytes.data(), len);
+            FastStringConvert<char16_t>(bytes.data(), len, text);
+            break;
 
          case 4:
-            return FastStringConvert<char32_t>(bytes.data(), len);
+            FastStringConvert<char32_t>(bytes.data(), len, text);
+            break;
 
          default:
             wxASSERT_MSG(false, wxT("Characters size not 1, 2, or 4"));
+            text.clear();
          break;
       }
 
-      return {};
+      return text;
    };
 
    try
@@ -587,14 +637,18 @@ bool ProjectSerializer::Decode(BufferedStreamReader& in, XMLTagHandler* handler)
          {
             case FT_Push:
             {
-               mIdStack.push_back(mIds);
-               mIds.clear();
+               // Move, rather than copy, the active dictionary aside
+               mIdStack.emplace_back();
+               mIdStack.back().Swap(mIds);
             }
             break;
 
             case FT_Pop:
             {
-               mIds = mIdStack.back();
+               if (mIdStack.empty())
+                  throw Error{};
+
+               mIds.Swap(mIdStack.back());
                mIdStack.pop_back();
             }
             break;
@@ -603,7 +657,7 @@ bool ProjectSerializer::Decode(BufferedStreamReader& in, XMLTagHandler* handler)
             {
                id = ReadUShort( in );
                auto len = ReadUShort( in );
-               mIds[id] = ReadString(len);
+               mIds.Set(id, ReadString(len));
             }
             break;
 
@@ -529,15 +529,14 @@ MinMaxRMS SqliteSampleBlock::DoGetMinMaxRMS(size_t start, size_t len)
       Load(mBlockID);
    }
 
-   if (start < mSampleCount)
-   {
-      len = std::min(len, mSampleCount - start);
-
-      // TODO: actually use summaries
-      SampleBuffer blockData(len, floatSample);
+   const auto accumulate = [&](size_t first, size_t count) {
+      if (count == 0)
+         return;
+      SampleBuffer blockData(count, floatSample);
       float *samples = (float *) blockData.ptr();
 
-      size_t copied = DoGetSamples((samplePtr) samples, floatSample, start, len);
+      size_t copied =
+         DoGetSamples((samplePtr) samples, floatSample, first, count);
       for (size_t i = 0; i < copied; ++i, ++samples)
       {
          float sample = *samples;
@@ -554,6 +553,39 @@ MinMaxRMS SqliteSampleBlock::DoGetMinMaxRMS(size_t start, size_t len)
 
          sumsq += (sample * sample);
       }
+   };
+
+   if (start < mSampleCount)
+   {
+      len = std::min(len, mSampleCount - start);
+
+      // Use the 256-sample summaries for the frames wholly in the region,
+      // and read samples only at the ends.  That costs more queries, so
+      // only do it when it saves much reading.
+      constexpr size_t frameSize = 256, minFrames = 16;
+      const auto firstFrame = (start + frameSize - 1) / frameSize;
+      const auto endFrame = (start + len) / frameSize;
+      bool summarized = false;
+      if (endFrame >= firstFrame + minFrames)
+      {
+         const auto nFrames = endFrame - firstFrame;
+         Floats summary{ nFrames * fields };
+         if (GetSummary256(summary.get(), firstFrame, nFrames))
+         {
+            summarized = true;
+            for (size_t i = 0; i < nFrames; ++i)
+            {
+               min = std::min(min, summary[i * fields]);
+               max = std::max(max, summary[i * fields + 1]);
+               const auto rms = summary[i * fields + 2];
+               sumsq += rms * rms * frameSize;
+            }
+            accumulate(start, firstFrame * frameSize - start);
+            accumulate(endFrame * frameSize, start + len - endFrame * frameSize);
+         }
+      }
+      if (!summarized)
+         accumulate(start, len);
    }
 
    return { min, max, (float) sqrt(sumsq / len) };
@@ -0,0 +1,176 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  ProjectSerializerTests.cpp
+
+**********************************************************************/
+#include "ProjectSerializer.h"
+
+#include "BufferedStreamReader.h"
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+//! Reads the dict and then the doc of a serializer, as ProjectFileIO does
+class MemoryStreamReader final : public BufferedStreamReader
+{
+public:
+   explicit MemoryStreamReader(const ProjectSerializer& serializer)
+       : BufferedStreamReader(32 * 1024)
+   {
+      for (auto stream : { &serializer.GetDict(), &serializer.GetData() })
+         for (auto chunk : *stream)
+            mBytes.insert(
+               mBytes.end(), static_cast<const char*>(chunk.first),
+               static_cast<const char*>(chunk.first) + chunk.second);
+   }
+
+protected:
+   bool HasMoreData() const override
+   {
+      return mOffset < mBytes.size();
+   }
+
+   size_t ReadData(void* buffer, size_t maxBytes) override
+   {
+      const auto count = std::min(maxBytes, mBytes.size() - mOffset);
+      std::memcpy(buffer, mBytes.data() + mOffset, count);
+      mOffset += count;
+      return count;
+   }
+
+private:
+   std::vector<char> mBytes;
+   size_t mOffset { 0 };
+};
+
+//! Collects the values of a synthetic project
+struct ProjectCollector final : XMLTagHandler
+{
+   bool HandleXMLTag(
+      const std::string_view& tag, const AttributesList& attrs) override
+   {
+      if (tag == "waveblock")
+      {
+         ++blocks;
+         for (auto& [attr, value] : attrs)
+         {
+            if (attr == "start")
+               startSum += value.Get<long long>();
+            else if (attr == "blockid")
+               idSum += value.Get<long long>();
+         }
+      }
+      else if (tag == "waveclip")
+      {
+         ++clips;
+         for (auto& [attr, value] : attrs)
+            if (attr == "offset")
+               offsetSum += value.Get<double>();
+      }
+      else if (tag == "wavetrack")
+      {
+         for (auto& [attr, value] : attrs)
+            if (attr == "name")
+               names.emplace_back(value.ToWString());
+      }
+      return true;
+   }
+
+   XMLTagHandler* HandleXMLChild(const std::string_view&) override
+   {
+      return this;
+   }
+
+   size_t blocks { 0 };
+   size_t clips { 0 };
+   long long startSum { 0 };
+   long long idSum { 0 };
+   double offsetSum { 0 };
+   std::vector<wxString> names;
+};
+
+constexpr size_t BlocksPerClip = 1000;
+
+void WriteProject(ProjectSerializer& serializer, size_t nBlocks)
+{
+   serializer.StartTag(wxT("project"));
+   serializer.WriteAttr(wxT("rate"), 44100.0);
+
+   serializer.StartTag(wxT("wavetrack"));
+   serializer.WriteAttr(wxT("name"), wxString(wxT("Tr\u00e4ck 1")));
+
+   for (size_t clip = 0; clip * BlocksPerClip < nBlocks; ++clip)
+   {
+      serializer.StartTag(wxT("waveclip"));
+      serializer.WriteAttr(wxT("offset"), double(clip), 8);
+      serializer.StartTag(wxT("sequence"));
+      serializer.WriteAttr(wxT("maxsamples"), 262144LL);
+      serializer.WriteAttr(wxT("sampleformat"), 262159L);
+      serializer.WriteAttr(wxT("numsamples"), 262144LL * BlocksPerClip);
+
+      const auto last = std::min(nBlocks, (clip + 1) * BlocksPerClip);
+      for (auto block = clip * BlocksPerClip; block < last; ++block)
+      {
+         serializer.StartTag(wxT("waveblock"));
+         serializer.WriteAttr(wxT("start"), 262144LL * block);
+         serializer.WriteAttr(wxT("blockid"), static_cast<long long>(block + 1));
+         serializer.EndTag(wxT("waveblock"));
+      }
+
+      serializer.EndTag(wxT("sequence"));
+      serializer.EndTag(wxT("waveclip"));
+   }
+
+   serializer.EndTag(wxT("wavetrack"));
+   serializer.EndTag(wxT("project"));
+}
+} // namespace
+
+TEST_CASE("ProjectSerializer round trip", "[ProjectSerializer]")
+{
+   constexpr size_t nBlocks = 2500;
+
+   ProjectSerializer serializer;
+   WriteProject(serializer, nBlocks);
+
+   MemoryStreamReader reader { serializer };
+   ProjectCollector collector;
+   REQUIRE(ProjectSerializer::Decode(reader, &collector));
+
+   REQUIRE(collector.blocks == nBlocks);
+   REQUIRE(collector.clips == 3);
+   REQUIRE(collector.idSum == nBlocks * (nBlocks + 1) / 2);
+   REQUIRE(collector.startSum == 262144LL * nBlocks * (nBlocks - 1) / 2);
+   REQUIRE(collector.offsetSum == 0.0 + 1.0 + 2.0);
+   REQUIRE(collector.names.size() == 1);
+   REQUIRE(collector.names[0] == wxString(wxT("Tr\u00e4ck 1")));
+}
+
+TEST_CASE("ProjectSerializer load time", "[ProjectSerializer][.benchmark]")
+{
+   constexpr size_t nBlocks = 100000;
+
+   ProjectSerializer serializer;
+   WriteProject(serializer, nBlocks);
+
+   MemoryStreamReader reader { serializer };
+   ProjectCollector collector;
+
+   const auto start = std::chrono::steady_clock::now();
+   REQUIRE(ProjectSerializer::Decode(reader, &collector));
+   const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - start);
+
+   REQUIRE(collector.blocks == nBlocks);
+   std::cout << "Decoded " << nBlocks << " blocks in " << elapsed.count()
+             << " ms\n";
+}
@@ -144,9 +144,10 @@ bool StretchingSequence::HasTrivialEnvelope() const
 }
 
 void StretchingSequence::GetEnvelopeValues(
-   double* buffer, size_t bufferLen, double t0, bool backwards) const
+   double* buffer, size_t bufferLen, double t0, bool backwards,
+   Envelope::Cursor *pCursor) const
 {
-   mSequence.GetEnvelopeValues(buffer, bufferLen, t0, backwards);
+   mSequence.GetEnvelopeValues(buffer, bufferLen, t0, backwards, pCursor);
 }
 
 AudioGraph::ChannelType StretchingSequence::GetChannelType() const
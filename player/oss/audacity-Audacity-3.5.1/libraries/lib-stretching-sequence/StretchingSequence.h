@@ -44,7 +44,7 @@ public:
    bool HasTrivialEnvelope() const override;
    void GetEnvelopeValues(
       double* buffer, size_t bufferLen, double t0,
-      bool backwards) const override;
+      bool backwards, Envelope::Cursor *pCursor = nullptr) const override;
    bool DoGet(
       size_t iChannel, size_t nBuffers, const samplePtr buffers[],
       sampleFormat format, sampleCount start, size_t len, bool backwards,
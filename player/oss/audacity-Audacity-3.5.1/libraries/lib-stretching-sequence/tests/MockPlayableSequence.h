@@ -68,7 +68,7 @@ public:
 
    void GetEnvelopeValues(
       double* buffer, size_t bufferLen, double t0,
-      bool backwards) const override
+      bool backwards, Envelope::Cursor *) const override
    {
    }
 
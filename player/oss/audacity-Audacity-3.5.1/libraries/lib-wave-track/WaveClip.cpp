@@ -1199,11 +1199,21 @@ void WaveClip::Resample(int rate, BasicUI::ProgressDialog *progress)
    // This function does its own RAII without a Transaction
 
    double factor = (double)rate / (double)mRate;
-   ::Resample resample(true, factor, factor); // constant rate resampling
+   const auto nChannels = mSequences.size();
+   // constant rate resampling, of all channels together
+   ::Resample resample(true, factor, factor, nChannels);
 
    const size_t bufsize = 65536;
-   Floats inBuffer{ bufsize };
-   Floats outBuffer{ bufsize };
+   std::vector<Floats> inBuffers(nChannels);
+   std::vector<Floats> outBuffers(nChannels);
+   std::vector<const float *> inPointers(nChannels);
+   std::vector<float *> outPointers(nChannels);
+   for (size_t iChannel = 0; iChannel < nChannels; ++iChannel) {
+      inBuffers[iChannel].reinit(bufsize);
+      outBuffers[iChannel].reinit(bufsize);
+      inPointers[iChannel] = inBuffers[iChannel].get();
+      outPointers[iChannel] = outBuffers[iChannel].get();
+   }
    sampleCount pos = 0;
    bool error = false;
    int outGenerated = 0;
@@ -1222,39 +1232,33 @@ void WaveClip::Resample(int rate, BasicUI::ProgressDialog *progress)
 
       bool isLast = ((pos + inLen) == numSamples);
 
-      auto ppNewSequence = newSequences.begin();
-      std::optional<std::pair<size_t, size_t>> results{};
-      for (auto &pSequence : mSequences) {
-         auto &pNewSequence = *ppNewSequence++;
-         if (!pSequence->Get((samplePtr)inBuffer.get(), floatSample, pos, inLen, true))
+      for (size_t iChannel = 0; iChannel < nChannels; ++iChannel) {
+         if (!mSequences[iChannel]->Get(
+            (samplePtr)inBuffers[iChannel].get(), floatSample, pos, inLen, true))
          {
             error = true;
             break;
          }
+      }
+      if (error)
+         break;
 
-         // Expect the same results for all channels, or else fail
-         auto newResults = resample.Process(factor, inBuffer.get(), inLen,
-            isLast, outBuffer.get(), bufsize);
-         if (!results)
-            results.emplace(newResults);
-         else if (*results != newResults) {
-            error = true;
-            break;
-         }
+      const auto results = resample.Process(factor, inPointers.data(), inLen,
+         isLast, outPointers.data(), bufsize);
 
-         outGenerated = results->second;
-         if (outGenerated < 0) {
-            error = true;
-            break;
-         }
+      outGenerated = results.second;
+      if (outGenerated < 0) {
+         error = true;
+         break;
+      }
 
-         pNewSequence->Append((samplePtr)outBuffer.get(), floatSample,
+      for (size_t iChannel = 0; iChannel < nChannels; ++iChannel)
+         newSequences[iChannel]->Append(
+            (samplePtr)outBuffers[iChannel].get(), floatSample,
             outGenerated, 1,
             widestSampleFormat /* computed samples need dither */
          );
-      }
-      if (results)
-         pos += results->first;
+      pos += results.first;
 
       if (progress)
       {
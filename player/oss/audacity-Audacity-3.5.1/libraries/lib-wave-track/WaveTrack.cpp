@@ -3632,7 +3632,8 @@ bool WaveTrack::HasTrivialEnvelope() const
 }
 
 void WaveTrack::GetEnvelopeValues(
-   double* buffer, size_t bufferLen, double t0, bool backwards) const
+   double* buffer, size_t bufferLen, double t0, bool backwards,
+   Envelope::Cursor *pCursor) const
 {
    auto pTrack = this;
    if (GetOwner())
@@ -3699,8 +3700,12 @@ void WaveTrack::GetEnvelopeValues(
             rlen = std::min(rlen, size_t(floor(0.5 + (dClipEndTime - rt0) / tstep)));
          }
          // Samples are obtained for the purpose of rendering a wave track,
-         // so quantize time
-         clip->GetEnvelope()->GetValues(rbuf, rlen, rt0, tstep);
+         // so quantize time.  One cursor serves all clips; it is only a
+         // hint, and playback stays within one clip for many calls
+         if (pCursor)
+            clip->GetEnvelope()->GetValues(rbuf, rlen, rt0, tstep, *pCursor);
+         else
+            clip->GetEnvelope()->GetValues(rbuf, rlen, rt0, tstep);
       }
    }
    if (backwards)
@@ -620,7 +620,7 @@ public:
 
    void GetEnvelopeValues(
       double* buffer, size_t bufferLen, double t0,
-      bool backwards) const override;
+      bool backwards, Envelope::Cursor *pCursor = nullptr) const override;
 
    //
    // MM: We now have more than one sequence and envelope per track, so
@@ -110,23 +110,77 @@ void PipeServer()
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
 #include <stdio.h>
 #include <unistd.h>
 #include <string.h>
+#include <string>
 
 const char fifotmpl[] = "/tmp/audacity_script_pipe.%s.%d";
 
 const int nBuff = 1024;
 
+// Read from the script in pieces this large
+const size_t nReadBuff = 64 * 1024;
+// Send pending responses once they grow this large, even if more commands
+// are waiting
+const size_t nMaxPendingOutput = 256 * 1024;
+
 extern "C" int DoSrv( char * pIn );
 extern "C" int DoSrvMore( char * pOut, size_t nMax );
 
+// Scripts may pipeline: write many commands, one per line, before reading
+// any responses.  All complete lines already received are executed in order,
+// and their responses are written together when the input runs dry, so that
+// a batch of commands costs one round trip rather than one each.
+// A script sending very large batches should read responses while it
+// writes, because the pipes have limited capacity.
+
+static bool WriteAll(int fd, const char *data, size_t len)
+{
+   while (len > 0)
+   {
+      ssize_t written = write(fd, data, len);
+      if (written < 0)
+      {
+         if (errno == EINTR)
+            continue;
+         return false;
+      }
+      data += written;
+      len -= written;
+   }
+   return true;
+}
+
+static bool InputWaiting(int fd)
+{
+   pollfd pfd{ fd, POLLIN, 0 };
+   return poll(&pfd, 1, 0) > 0 && (pfd.revents & POLLIN);
+}
+
+// Execute one command, appending its response to output
+static void Serve(std::string &command, std::string &output)
+{
+   char buf[nBuff];
+   DoSrv(&command[0]);
+   while (true)
+   {
+      int len = DoSrvMore(buf, nBuff);
+      if (len <= 1)
+         break;
+      // len - 1 because we do not send the null character
+      output.append(buf, len - 1);
+   }
+}
+
 void PipeServer()
 {
-   FILE *fromFifo = NULL;
-   FILE *toFifo = NULL;
+   int fromFifo = -1;
+   int toFifo = -1;
    int rc;
-   char buf[nBuff];
    char toFifoName[nBuff];
    char fromFifoName[nBuff];
 
@@ -147,58 +201,78 @@ void PipeServer()
    }
 
    // open to (incoming) pipe first.  
-   toFifo = fopen(toFifoName, "r");
-   if (toFifo == NULL)
+   toFifo = open(toFifoName, O_RDONLY);
+   if (toFifo < 0)
    {
       perror("Unable to open fifo to server from script");
-      if (fromFifo != NULL)
-         fclose(fromFifo);
       return;
    }
 
    // open from (outgoing) pipe second.  This could block if there is no reader.
-   fromFifo = fopen(fromFifoName, "w");
-   if (fromFifo == NULL)
+   fromFifo = open(fromFifoName, O_WRONLY);
+   if (fromFifo < 0)
    {
       perror("Unable to open fifo from server to script");
+      close(toFifo);
       return;
    }
 
-   while (fgets(buf, sizeof(buf), toFifo) != NULL)
+   std::string input;
+   std::string output;
+   std::string command;
+   char buf[nReadBuff];
+   size_t start = 0;
+   bool ok = true;
+   while (ok)
    {
-      int len = strlen(buf);
-      if (len <= 1)
-      {
+      ssize_t nRead = read(toFifo, buf, sizeof(buf));
+      if (nRead < 0 && errno == EINTR)
          continue;
-      }
-
-      buf[len - 1] = '\0';
-
-      printf("Server received %s\n", buf);
-      DoSrv(buf);
+      if (nRead <= 0)
+         break;
+      input.append(buf, nRead);
 
-      while (true)
+      // Execute every complete line
+      size_t end;
+      while ((end = input.find('\n', start)) != std::string::npos)
       {
-         len = DoSrvMore(buf, nBuff);
-         if (len <= 1)
+         command.assign(input, start, end - start);
+         start = end + 1;
+         if (command.empty() || command == "\r")
+            continue;
+
+         Serve(command, output);
+         if (output.size() >= nMaxPendingOutput)
          {
-            break;
+            ok = WriteAll(fromFifo, output.data(), output.size());
+            output.clear();
+            if (!ok)
+               break;
          }
-         printf("Server sending %s",buf);
+      }
+      input.erase(0, start);
+      start = 0;
 
-         // len - 1 because we do not send the null character
-         fwrite(buf, 1, len - 1, fromFifo);
+      // Respond when the script has nothing more queued for us
+      if (ok && !output.empty() && !InputWaiting(toFifo))
+      {
+         ok = WriteAll(fromFifo, output.data(), output.size());
+         output.clear();
       }
-      fflush(fromFifo);
    }
 
    printf("Read failed on fifo, quitting\n");
 
-   if (toFifo != NULL)
-      fclose(toFifo);
+   // The script may have closed the pipe after a last command with no
+   // newline; execute that too
+   if (ok && !input.empty() && input != "\r")
+      Serve(input, output);
+
+   if (ok && !output.empty())
+      WriteAll(fromFifo, output.data(), output.size());
 
-   if (fromFifo != NULL)
-      fclose(fromFifo);
+   close(toFifo);
+   close(fromFifo);
 
    unlink(toFifoName);
    unlink(fromFifoName);
@@ -9,6 +9,7 @@ Paul Licameli split from ProjectAudioManager.cpp
 
 **********************************************************************/
 
+#include "AudioIO.h"
 #include "ClientData.h"
 #include "LabelTrack.h"
 #include "Observer.h"
@@ -19,13 +20,85 @@ Paul Licameli split from ProjectAudioManager.cpp
 #include "widgets/Warning.h"
 #include <wx/app.h>
 #include <wx/frame.h>
+#include <wx/log.h>
+
+#include <chrono>
 
 namespace {
+//! Logs dropout statistics at most once per LogInterval, adding up the
+//! events in between, so that repeated dropouts don't flood the log; what
+//! is still pending is logged when the stream stops
+class DropoutLog {
+public:
+   void Add(const RecordingDropoutEvent &evt)
+   {
+      ++mEvents;
+      mIntervals += evt.intervals.size();
+      mLostSamples += evt.lostSamples;
+      mSpilledSamples += evt.spilledSamples;
+
+      if (mLogged &&
+          std::chrono::steady_clock::now() - mLastLog < LogInterval)
+         return;
+      Flush();
+   }
+
+   void Flush()
+   {
+      if (mEvents == 0)
+         return;
+      wxLogMessage(wxT("Recording dropouts in %zu recordings: %zu intervals, %llu samples lost, %llu samples spilled to a temporary file"),
+         mEvents, mIntervals, mLostSamples, mSpilledSamples);
+      mLogged = true;
+      mLastLog = std::chrono::steady_clock::now();
+      mEvents = mIntervals = 0;
+      mLostSamples = mSpilledSamples = 0;
+   }
+
+private:
+   static constexpr auto LogInterval = std::chrono::seconds(10);
+   std::chrono::steady_clock::time_point mLastLog;
+   bool mLogged{ false };
+   size_t mEvents{ 0 };
+   size_t mIntervals{ 0 };
+   unsigned long long mLostSamples{ 0 };
+   unsigned long long mSpilledSamples{ 0 };
+};
+
+void ShowDropoutWarning(AudacityProject &project)
+{
+   // CallAfter so that we avoid any problems of yielding
+   // to the event loop while still inside the timer callback,
+   // entering StopStream() recursively
+   auto &window = GetProjectFrame( project );
+   wxTheApp->CallAfter( [&window] {
+      ShowWarningDialog(&window, wxT("DropoutDetected"), XO("\
+Recorded audio was lost at the labeled locations. Possible causes:\n\
+\n\
+Other applications are competing with Audacity for processor time\n\
+\n\
+You are saving directly to a slow external storage device\n\
+"
+         ),
+         false,
+         XXO("Turn off dropout detection"));
+   });
+}
+
 struct DropoutSubscription : ClientData::Base {
    DropoutSubscription(AudacityProject &project)
    {
       mSubscription = ProjectAudioManager::Get(project).Subscribe(
-      [&project](const RecordingDropoutEvent &evt){
+      [this, &project](const RecordingDropoutEvent &evt){
+         mLog.Add(evt);
+         if (evt.intervals.empty()) {
+            // Recording lagged; if some of the spilled audio could not be
+            // read back, it was replaced by silence that can't be labeled
+            if (evt.lostSamples > 0)
+               ShowDropoutWarning(project);
+            return;
+         }
+
          // Make a track with labels for recording errors
          auto &tracks = TrackList::Get( project );
 
@@ -45,25 +118,18 @@ struct DropoutSubscription : ClientData::Base {
          auto &history = ProjectHistory::Get( project );
          history.ModifyState( true ); // this might fail and throw
 
-         // CallAfter so that we avoid any problems of yielding
-         // to the event loop while still inside the timer callback,
-         // entering StopStream() recursively
-         auto &window = GetProjectFrame( project );
-         wxTheApp->CallAfter( [&window] {
-            ShowWarningDialog(&window, wxT("DropoutDetected"), XO("\
-Recorded audio was lost at the labeled locations. Possible causes:\n\
-\n\
-Other applications are competing with Audacity for processor time\n\
-\n\
-You are saving directly to a slow external storage device\n\
-"
-               ),
-               false,
-               XXO("Turn off dropout detection"));
-         });
+         ShowDropoutWarning(project);
+      });
+      mAudioIOSubscription = AudioIO::Get()->Subscribe(
+      [this, &project](const AudioIOEvent &evt){
+         if (evt.pProject == &project &&
+             evt.type == AudioIOEvent::CAPTURE && !evt.on)
+            mLog.Flush();
       });
    }
+   DropoutLog mLog;
    Observer::Subscription mSubscription;
+   Observer::Subscription mAudioIOSubscription;
 };
 }
 
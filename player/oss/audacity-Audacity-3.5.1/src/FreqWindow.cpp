@@ -190,7 +190,7 @@ FrequencyPlotDialog::FrequencyPlotDialog(wxWindow * parent, wxWindowID id,
 :  wxDialogWrapper(parent, id, title, pos, wxDefaultSize,
             wxDEFAULT_DIALOG_STYLE | wxRESIZE_BORDER | wxMAXIMIZE_BOX),
    mProject{ &project }
-,  mAnalyst(std::make_unique<SpectrumAnalyst>())
+,  mAnalyst(std::make_shared<SpectrumAnalyst>())
 {
    SetName();
 
@@ -585,6 +585,7 @@ bool FrequencyPlotDialog::GetAudio()
 {
    mData.reset();
    mDataLen = 0;
+   mSpectrumCache.clear();
 
    int selcount = 0;
    bool warning = false;
@@ -606,7 +607,7 @@ bool FrequencyPlotDialog::GetAudio()
          }
          else
             mDataLen = dataLen.as_size_t();
-         mData = Floats{ mDataLen };
+         mData = std::shared_ptr<float[]>{ safenew float[mDataLen] };
       }
       const auto nChannels = track->NChannels();
       if (track->GetRate() != mRate) {
@@ -1012,6 +1013,7 @@ void FrequencyPlotDialog::PlotPaint(wxPaintEvent & event)
 
 void FrequencyPlotDialog::OnCloseWindow(wxCloseEvent & WXUNUSED(event))
 {
+   CancelRecalc();
    Show(false);
 }
 
@@ -1023,7 +1025,9 @@ void FrequencyPlotDialog::OnCloseButton(wxCommandEvent & WXUNUSED(event))
    gPrefs->Write(wxT("/FrequencyPlotDialog/FuncChoice"), mFuncChoice->GetSelection());
    gPrefs->Write(wxT("/FrequencyPlotDialog/AxisChoice"), mAxisChoice->GetSelection());
    gPrefs->Flush();
+   CancelRecalc();
    mData.reset();
+   mSpectrumCache.clear();
    Show(false);
 }
 
@@ -1035,6 +1039,14 @@ void FrequencyPlotDialog::SendRecalcEvent()
 
 void FrequencyPlotDialog::Recalc()
 {
+   if (mCalculation) {
+      // Called while yielding to the event loop in Calculate() below;
+      // abandon that and start again when it returns
+      mRecalcPending = true;
+      mCalculation->Cancel();
+      return;
+   }
+
    if (!mData || mDataLen < mWindowSize) {
       DrawPlot();
       return;
@@ -1043,24 +1055,70 @@ void FrequencyPlotDialog::Recalc()
    SpectrumAnalyst::Algorithm alg =
       SpectrumAnalyst::Algorithm(mAlgChoice->GetSelection());
    int windowFunc = mFuncChoice->GetSelection();
-
-   wxWindow *hadFocus = FindFocus();
-   // In wxMac, the skipped window MUST be a top level window.  I'd originally made it
-   // just the mProgress window with the idea of preventing user interaction with the
-   // controls while the plot was being recalculated.  This doesn't appear to be necessary
-   // so just use the top level window instead.
-   {
-      std::optional<wxWindowDisabler> blocker;
-      if (IsShown())
-         blocker.emplace(this);
-      wxYieldIfNeeded();
-
-      mAnalyst->Calculate(alg, windowFunc, mWindowSize, mRate,
-         mData.get(), mDataLen,
-         &mYMin, &mYMax, mProgress);
+   const auto windowSize = mWindowSize;
+
+   const auto cached = std::find_if(
+      mSpectrumCache.begin(), mSpectrumCache.end(), [&](auto &entry){
+         return entry.alg == alg && entry.windowFunc == windowFunc &&
+            entry.windowSize == windowSize;
+      });
+   if (cached != mSpectrumCache.end()) {
+      mAnalyst = cached->analyst;
+      mYMin = cached->yMin;
+      mYMax = cached->yMax;
    }
-   if (hadFocus) {
-      hadFocus->SetFocus();
+   else {
+      // Keep the audio alive, and the previous results on display, while
+      // the event loop runs
+      const auto data = mData;
+      const auto analyst = std::make_shared<SpectrumAnalyst>();
+      float yMin, yMax;
+      bool success;
+
+      wxWindow *hadFocus = FindFocus();
+      // In wxMac, the skipped window MUST be a top level window.  I'd originally made it
+      // just the mProgress window with the idea of preventing user interaction with the
+      // controls while the plot was being recalculated.  This doesn't appear to be necessary
+      // so just use the top level window instead.
+      {
+         std::optional<wxWindowDisabler> blocker;
+         if (IsShown())
+            blocker.emplace(this);
+         wxYieldIfNeeded();
+
+         mCalculation = audacity::concurrency::CancellationContext::Create();
+         success = analyst->Calculate(alg, windowFunc, windowSize, mRate,
+            data.get(), mDataLen,
+            &yMin, &yMax, mProgress, mCalculation);
+         mCalculation.reset();
+      }
+      if (hadFocus) {
+         hadFocus->SetFocus();
+      }
+
+      if (mRecalcPending) {
+         mRecalcPending = false;
+         SendRecalcEvent();
+         return;
+      }
+      if (data != mData)
+         return;
+      if (!success) {
+         // Plot nothing
+         mAnalyst = analyst;
+         DrawPlot();
+         return;
+      }
+
+      // Remember a limited number of results
+      constexpr size_t MaxCachedSpectra = 16;
+      if (mSpectrumCache.size() >= MaxCachedSpectra)
+         mSpectrumCache.erase(mSpectrumCache.begin());
+      mSpectrumCache.push_back({ alg, windowFunc, windowSize, analyst,
+         yMin, yMax });
+      mAnalyst = analyst;
+      mYMin = yMin;
+      mYMax = yMax;
    }
 
    if (alg == SpectrumAnalyst::Spectrum) {
@@ -1078,6 +1136,12 @@ void FrequencyPlotDialog::Recalc()
    DrawPlot();
 }
 
+void FrequencyPlotDialog::CancelRecalc()
+{
+   if (mCalculation)
+      mCalculation->Cancel();
+}
+
 void FrequencyPlotDialog::OnExport(wxCommandEvent & WXUNUSED(event))
 {
    wxString fName = _("spectrum.txt");
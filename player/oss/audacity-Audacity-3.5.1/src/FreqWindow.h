@@ -89,6 +89,7 @@ private:
 
    void SendRecalcEvent();
    void Recalc();
+   void CancelRecalc();
    void DrawPlot();
    void DrawBackground(wxMemoryDC & dc);
 
@@ -138,7 +139,8 @@ private:
 
    double mRate;
    size_t mDataLen;
-   Floats mData;
+   //! Shared with a calculation in progress, so that it survives GetAudio()
+   std::shared_ptr<float[]> mData;
    size_t mWindowSize;
 
    bool mLogAxis;
@@ -151,7 +153,23 @@ private:
    int mMouseX;
    int mMouseY;
 
-   std::unique_ptr<SpectrumAnalyst> mAnalyst;
+   std::shared_ptr<SpectrumAnalyst> mAnalyst;
+
+   //! Results for the current audio, so that changing back to previous
+   //! options does not analyze again
+   struct CachedSpectrum {
+      SpectrumAnalyst::Algorithm alg;
+      int windowFunc;
+      size_t windowSize;
+      std::shared_ptr<SpectrumAnalyst> analyst;
+      float yMin;
+      float yMax;
+   };
+   std::vector<CachedSpectrum> mSpectrumCache;
+
+   //! Not null while Recalc() waits for the analyst
+   audacity::concurrency::CancellationContextPtr mCalculation;
+   bool mRecalcPending{ false };
 
    DECLARE_EVENT_TABLE()
 
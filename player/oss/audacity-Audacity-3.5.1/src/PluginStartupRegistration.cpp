@@ -10,6 +10,8 @@
 
 #include "PluginStartupRegistration.h"
 
+#include <algorithm>
+#include <optional>
 #include <thread>
 
 #include <wx/log.h>
@@ -20,6 +22,7 @@
 #include <wx/timer.h>
 #include <wx/sizer.h>
 
+#include "FileNames.h"
 #include "PluginManager.h"
 #include "PluginDescriptor.h"
 #include "wxPanelWrapper.h"
@@ -127,79 +130,259 @@ namespace
    };
 }
 
-PluginStartupRegistration::PluginStartupRegistration(const std::map<wxString, std::vector<wxString>>& pluginsToProcess)
+class PluginStartupRegistration::ValidationSlot final :
+   public AsyncPluginValidator::Delegate
 {
-   for(auto& p : pluginsToProcess)
-      mPluginsToProcess.push_back(p);
-}
+   PluginStartupRegistration& mOwner;
+   std::unique_ptr<AsyncPluginValidator> mValidator;
+   std::optional<size_t> mPluginIndex;
+   size_t mProviderIndex{0};
+   bool mValidProviderFound{false};
+   std::vector<PluginDescriptor> mFailedPluginsCache;
+   //Descriptors reported by the current provider, stored in the cache
+   //once the provider is done with the module
+   std::vector<PluginDescriptor> mProviderResult;
+   //Cleared when the current provider failed for a reason that may
+   //not repeat next time, such results are never cached
+   bool mProviderResultIsFinal{true};
+   std::chrono::system_clock::time_point mRequestStartTime{};
+
+public:
+   explicit ValidationSlot(PluginStartupRegistration& owner)
+      : mOwner(owner)
+   {
+   }
 
-void PluginStartupRegistration::OnInternalError(const wxString& error)
-{
-   StopWithError(error);
-}
+   bool IsBusy() const noexcept
+   {
+      return mPluginIndex.has_value();
+   }
 
-void PluginStartupRegistration::OnPluginFound(const PluginDescriptor& desc)
-{
-   if(!mValidProviderFound)
+   std::chrono::system_clock::time_point GetRequestStartTime() const noexcept
+   {
+      return mRequestStartTime;
+   }
+
+   bool IsStuck(std::chrono::system_clock::duration timeout) const noexcept
+   {
+      return IsBusy() && mValidator &&
+         std::chrono::system_clock::now() - mRequestStartTime >= timeout &&
+         mValidator->InactiveSince() < mRequestStartTime;
+   }
+
+   void Start(size_t pluginIndex)
+   {
+      mPluginIndex = pluginIndex;
+      mProviderIndex = 0;
+      mValidProviderFound = false;
       mFailedPluginsCache.clear();
+      mProviderResult.clear();
+      mProviderResultIsFinal = true;
 
-   mValidProviderFound = true;
-   if(!desc.IsValid())
-      mFailedPluginsCache.push_back(desc);
-   PluginManager::Get().RegisterPlugin(PluginDescriptor { desc });
-}
+      if(ProcessProviders())
+         Complete();
+   }
 
-void PluginStartupRegistration::OnPluginValidationFailed(const wxString& providerId, const wxString& path)
-{
-   PluginID ID = providerId + wxT("_") + path;
-   PluginDescriptor pluginDescriptor;
-   pluginDescriptor.SetPluginType(PluginTypeStub);
-   pluginDescriptor.SetID(ID);
-   pluginDescriptor.SetProviderID(providerId);
-   pluginDescriptor.SetPath(path);
-   pluginDescriptor.SetEnabled(false);
-   pluginDescriptor.SetValid(false);
-
-   //Multiple providers can report same module paths
-   //do not register until all associated providers have tried to load the module
-   mFailedPluginsCache.push_back(std::move(pluginDescriptor));
-}
+   void Skip()
+   {
+      if(!IsBusy())
+         return;
 
+      if(mValidator)
+      {
+         //Drop current validator, no more callbacks will be received from now
+         mValidator->SetDelegate(nullptr);
+         //While on Linux and MacOS socket `shutdown()` wakes up `select()` almost
+         //immediately, on Windows it sometimes get delayed on unspecified amount
+         //of time. As we do not expect any data we can safely move remaining
+         //operations to another thread.
+         std::thread([validator = std::shared_ptr<AsyncPluginValidator>(std::move(mValidator))]{ }).detach();
+      }
 
-void PluginStartupRegistration::OnValidationFinished()
-{
-   ++mCurrentPluginProviderIndex;
-   if(mValidProviderFound ||
-      mPluginsToProcess[mCurrentPluginIndex].second.size() == mCurrentPluginProviderIndex)
+      if(!mValidProviderFound)
+      {
+         // Validator didn't report anything yet or it tried
+         // one or more providers that didn't recognize the plugin.
+         // In that case we assume that none of the remaining providers
+         // can recognize that plugin.
+         // Note: create stub `PluginDescriptors` for each associated provider
+         for(;mProviderIndex < GetProviders().size(); ++mProviderIndex)
+            OnPluginValidationFailed(GetProviders()[mProviderIndex], GetPath(), false);
+      }
+      //Result of an interrupted validation is never cached
+      mProviderResult.clear();
+
+      Complete();
+   }
+
+   void Reset()
    {
-      if(!mFailedPluginsCache.empty())
+      mValidator.reset();
+      mPluginIndex.reset();
+   }
+
+   void OnInternalError(const wxString& error) override
+   {
+      mOwner.StopWithError(error);
+   }
+
+   void OnPluginFound(const PluginDescriptor& desc) override
+   {
+      mProviderResult.push_back(desc);
+      RegisterPlugin(desc);
+   }
+
+   void OnPluginValidationFailed(const wxString& providerId, const wxString& path, bool definitive) override
+   {
+      if(!definitive)
+         mProviderResultIsFinal = false;
+
+      PluginID ID = providerId + wxT("_") + path;
+      PluginDescriptor pluginDescriptor;
+      pluginDescriptor.SetPluginType(PluginTypeStub);
+      pluginDescriptor.SetID(ID);
+      pluginDescriptor.SetProviderID(providerId);
+      pluginDescriptor.SetPath(path);
+      pluginDescriptor.SetEnabled(false);
+      pluginDescriptor.SetValid(false);
+
+      //Multiple providers can report same module paths
+      //do not register until all associated providers have tried to load the module
+      mFailedPluginsCache.push_back(std::move(pluginDescriptor));
+   }
+
+   void OnValidationFinished() override
+   {
+      if(mProviderResultIsFinal)
+         mOwner.mCache.Store(
+            GetProviders()[mProviderIndex], GetPath(), std::move(mProviderResult));
+      mProviderResult.clear();
+      mProviderResultIsFinal = true;
+
+      if(NextProvider() || ProcessProviders())
       {
-         //we've tried all providers associated with same module path...
-         if(!mValidProviderFound)
-         {
-            //...but none of them succeeded
-            mFailedPluginsPaths.push_back(mFailedPluginsCache[0].GetPath());
+         Complete();
+         mOwner.ProcessNext();
+      }
+   }
 
-            //Same plugin path, but different providers, we need to register all of them
-            for(auto& desc : mFailedPluginsCache)
-               PluginManager::Get().RegisterPlugin(std::move(desc));
-         }
-         //plugin type was detected, but plugin instance validation has failed
-         else
+private:
+   const wxString& GetPath() const
+   {
+      return mOwner.mPluginsToProcess[*mPluginIndex].first;
+   }
+
+   const std::vector<wxString>& GetProviders() const
+   {
+      return mOwner.mPluginsToProcess[*mPluginIndex].second;
+   }
+
+   void RegisterPlugin(const PluginDescriptor& desc)
+   {
+      if(!mValidProviderFound)
+         mFailedPluginsCache.clear();
+
+      mValidProviderFound = true;
+      if(!desc.IsValid())
+         mFailedPluginsCache.push_back(desc);
+      PluginManager::Get().RegisterPlugin(PluginDescriptor { desc });
+   }
+
+   ///@return true if there are no more providers to try for the module
+   bool NextProvider()
+   {
+      ++mProviderIndex;
+      return mValidProviderFound || GetProviders().size() == mProviderIndex;
+   }
+
+   ///Tries remaining providers, using cached results where possible,
+   ///until validation by a host process is required
+   ///@return true if the module is done
+   bool ProcessProviders()
+   {
+      try
+      {
+         while(true)
          {
-            for(auto& desc : mFailedPluginsCache)
+            const auto& providerId = GetProviders()[mProviderIndex];
+            if(auto descriptors = mOwner.mCache.Lookup(providerId, GetPath()))
             {
-               if(desc.GetPluginType() != PluginTypeStub)
-                  mFailedPluginsPaths.push_back(desc.GetPath());
+               if(descriptors->empty())
+                  OnPluginValidationFailed(providerId, GetPath(), true);
+               else
+               {
+                  for(auto& desc : *descriptors)
+                     RegisterPlugin(desc);
+               }
+               if(NextProvider())
+                  return true;
+               continue;
             }
+
+            if(!mValidator)
+               mValidator = std::make_unique<AsyncPluginValidator>(*this);
+
+            mValidator->Validate(providerId, GetPath());
+            mRequestStartTime = std::chrono::system_clock::now();
+            return false;
          }
       }
-      ++mCurrentPluginIndex;
-      mCurrentPluginProviderIndex = 0;
-      mValidProviderFound = false;
+      catch(std::exception& e)
+      {
+         mOwner.StopWithError(e.what());
+      }
+      catch(...)
+      {
+         mOwner.StopWithError("unknown error");
+      }
+      return false;
+   }
+
+   void Complete()
+   {
+      const auto& path = GetPath();
+      mPluginIndex.reset();
+      mOwner.OnPluginProcessed(path, mFailedPluginsCache, mValidProviderFound);
       mFailedPluginsCache.clear();
+      mValidProviderFound = false;
    }
-   ProcessNext();
+};
+
+PluginStartupRegistration::PluginStartupRegistration(const std::map<wxString, std::vector<wxString>>& pluginsToProcess)
+   : mCache(FileNames::PluginValidationCache())
+{
+   for(auto& p : pluginsToProcess)
+      mPluginsToProcess.push_back(p);
+}
+
+PluginStartupRegistration::~PluginStartupRegistration() = default;
+
+void PluginStartupRegistration::OnPluginProcessed(
+   const wxString& path, std::vector<PluginDescriptor>& failedPlugins, bool validProviderFound)
+{
+   if(!failedPlugins.empty())
+   {
+      //we've tried all providers associated with same module path...
+      if(!validProviderFound)
+      {
+         //...but none of them succeeded
+         mFailedPluginsPaths.push_back(path);
+
+         //Same plugin path, but different providers, we need to register all of them
+         for(auto& desc : failedPlugins)
+            PluginManager::Get().RegisterPlugin(std::move(desc));
+      }
+      //plugin type was detected, but plugin instance validation has failed
+      else
+      {
+         for(auto& desc : failedPlugins)
+         {
+            if(desc.GetPluginType() != PluginTypeStub)
+               mFailedPluginsPaths.push_back(desc.GetPath());
+         }
+      }
+   }
+   ++mProcessedPluginsCount;
 }
 
 const std::vector<wxString>& PluginStartupRegistration::GetFailedPluginsPaths() const noexcept
@@ -207,12 +390,22 @@ const std::vector<wxString>& PluginStartupRegistration::GetFailedPluginsPaths()
    return mFailedPluginsPaths;
 }
 
-void PluginStartupRegistration::Run(std::chrono::seconds timeout)
+void PluginStartupRegistration::Run(std::chrono::seconds timeout, size_t concurrency)
 {
+   if(concurrency == 0)
+      //Validation is mostly spent waiting for plugin hosts to load
+      //modules from disk, leave some cores for the rest of the system
+      concurrency = std::clamp(std::thread::hardware_concurrency() / 2, 1u, 8u);
+
+   mSlots.clear();
+   for(size_t i = 0; i < concurrency; ++i)
+      mSlots.push_back(std::make_unique<ValidationSlot>(*this));
+
+   mCache.Load();
+
    PluginScanDialog dialog(nullptr, wxID_ANY, XO("Searching for plugins"));
    wxTimer timeoutTimer(&dialog, OnPluginScanTimeout);
    mScanDialog = &dialog;
-   mTimeoutTimer = &timeoutTimer;
    mTimeout = timeout;
 
    dialog.Bind(wxEVT_BUTTON, [this](wxCommandEvent& evt) {
@@ -222,24 +415,31 @@ void PluginStartupRegistration::Run(std::chrono::seconds timeout)
    });
    dialog.Bind(wxEVT_TIMER, [this](wxTimerEvent& evt) {
       if(evt.GetId() == OnPluginScanTimeout)
-      {
-         if(mValidator && mValidator->InactiveSince() < mRequestStartTime)
-            Skip();
-         //else
-         //   wxMessageBox("Please check for plugin popups!");
-      }
+         CheckTimeouts();
       else
          evt.Skip();
    });
-   dialog.Bind(wxEVT_CLOSE_WINDOW, [this](wxCloseEvent& evt) {
+   dialog.Bind(wxEVT_CLOSE_WINDOW, [this, &timeoutTimer](wxCloseEvent& evt) {
       evt.Skip();
-      mValidator.reset();
+      timeoutTimer.Stop();
+      //Slots themselves may be on the stack at this point
+      for(auto& slot : mSlots)
+         slot->Reset();
+      mScanDialog = nullptr;
+      mCache.Save();
       PluginManager::Get().Save();
       PluginManager::Get().NotifyPluginsChanged();
    });
 
    dialog.CenterOnScreen();
    ProcessNext();
+   if(mScanDialog.get() == nullptr)
+      //Everything was resolved from the cache or an error occurred,
+      //no need to show the dialog
+      return;
+   if(timeout.count() > 0)
+      //Each slot runs its own request, poll for the stuck ones
+      timeoutTimer.Start(1000);
    dialog.ShowModal();
 }
 
@@ -251,32 +451,37 @@ void PluginStartupRegistration::Stop()
 
 void PluginStartupRegistration::Skip()
 {
-   //Drop current validator, no more callbacks will be received from now
-   mValidator->SetDelegate(nullptr);
-   //While on Linux and MacOS socket `shutdown()` wakes up `select()` almost
-   //immediately, on Windows it sometimes get delayed on unspecified amount
-   //of time. As we do not expect any data we can safely move remaining
-   //operations to another thread.
-   std::thread([validator = std::shared_ptr<AsyncPluginValidator>(std::move(mValidator))]{ }).detach();
-
-   if(!mValidProviderFound)
+   //Skip the request that waits for the longest time,
+   //that's the one most likely to be stuck
+   ValidationSlot* oldest = nullptr;
+   for(auto& slot : mSlots)
    {
-      // Validator didn't report anything yet or it tried
-      // one or more providers that didn't recognize the plugin.
-      // In that case we assume that none of the remaining providers
-      // can recognize that plugin.
-      // Note: create stub `PluginDescriptors` for each associated provider
-      for(;mCurrentPluginProviderIndex < mPluginsToProcess[mCurrentPluginIndex].second.size(); ++mCurrentPluginProviderIndex)
-         OnPluginValidationFailed(
-            mPluginsToProcess[mCurrentPluginIndex].second[mCurrentPluginProviderIndex],
-            mPluginsToProcess[mCurrentPluginIndex].first);
-      mCurrentPluginProviderIndex = mPluginsToProcess[mCurrentPluginIndex].second.size() - 1;
+      if(slot->IsBusy() &&
+         (oldest == nullptr || slot->GetRequestStartTime() < oldest->GetRequestStartTime()))
+         oldest = slot.get();
    }
-   //else
-   //    Don't assume that `OnValidationFinished()` and `OnPluginFound()`
-   //    aren't deferred within run loop
+   if(oldest != nullptr)
+   {
+      oldest->Skip();
+      ProcessNext();
+   }
+}
 
-   OnValidationFinished();
+void PluginStartupRegistration::CheckTimeouts()
+{
+   bool skipped = false;
+   for(auto& slot : mSlots)
+   {
+      if(slot->IsStuck(mTimeout))
+      {
+         slot->Skip();
+         skipped = true;
+      }
+   }
+   if(skipped)
+      ProcessNext();
+   //else
+   //   wxMessageBox("Please check for plugin popups!");
 }
 
 void PluginStartupRegistration::StopWithError(const wxString& msg)
@@ -288,39 +493,30 @@ void PluginStartupRegistration::StopWithError(const wxString& msg)
 
 void PluginStartupRegistration::ProcessNext()
 {
-   if(mCurrentPluginIndex == mPluginsToProcess.size())
+   //Plugins found in the cache are done synchronously by Start,
+   //so keep going until every slot waits for a host process
+   while(mNextPluginIndex < mPluginsToProcess.size())
    {
-      Stop();
-      return;
-   }
+      if(mScanDialog.get() == nullptr)
+         //Stopped
+         return;
 
-   try
-   {
+      auto it = std::find_if(mSlots.begin(), mSlots.end(),
+         [](const auto& slot) { return !slot->IsBusy(); });
+      if(it == mSlots.end())
+         return;
+
+      const auto pluginIndex = mNextPluginIndex++;
       if(auto dialog = static_cast<PluginScanDialog*>(mScanDialog.get()))
       {
-         const auto progress = static_cast<float>(mCurrentPluginIndex) / static_cast<float>(mPluginsToProcess.size());
+         const auto progress = static_cast<float>(mProcessedPluginsCount) / static_cast<float>(mPluginsToProcess.size());
          dialog->UpdateProgress(
-            mPluginsToProcess[mCurrentPluginIndex].first,
+            mPluginsToProcess[pluginIndex].first,
             progress);
       }
-      if(!mValidator)
-         mValidator = std::make_unique<AsyncPluginValidator>(*this);
-
-      mValidator->Validate(
-         mPluginsToProcess[mCurrentPluginIndex].second[mCurrentPluginProviderIndex],
-         mPluginsToProcess[mCurrentPluginIndex].first
-      );
-      mRequestStartTime = std::chrono::system_clock::now();
-      if(auto timer = mTimeoutTimer.get())
-         timer->StartOnce(std::chrono::duration_cast<std::chrono::milliseconds>(mTimeout).count());
+      (*it)->Start(pluginIndex);
    }
-   catch(std::exception& e)
-   {
-      StopWithError(e.what());
-   }
-   catch(...)
-   {
-      StopWithError("unknown error");
-   }
-}
 
+   if(mProcessedPluginsCount == mPluginsToProcess.size())
+      Stop();
+}
@@ -17,47 +17,49 @@
 #include <wx/string.h>
 #include <wx/timer.h>
 #include "AsyncPluginValidator.h"
+#include "PluginValidationCache.h"
 #include "wxPanelWrapper.h"
 
 ///Helper class that passes plugins provided in constructor
-///to plugin validator, then "good" plugins are registered in
-///PluginManager. 
-class PluginStartupRegistration final :
-   public AsyncPluginValidator::Delegate
+///to plugin validators, then "good" plugins are registered in
+///PluginManager. Several modules are validated concurrently, each
+///by its own plugin host process. Results are remembered in
+///PluginValidationCache, so that modules that didn't change since
+///they were validated last time are registered without starting a host.
+class PluginStartupRegistration final
 {
-   std::unique_ptr<AsyncPluginValidator> mValidator;
+   class ValidationSlot;
+
    std::vector<std::pair<wxString, std::vector<wxString>>> mPluginsToProcess;
-   size_t mCurrentPluginIndex{0};
-   size_t mCurrentPluginProviderIndex{0};
-   bool mValidProviderFound{false};
+   std::vector<std::unique_ptr<ValidationSlot>> mSlots;
+   PluginValidationCache mCache;
+   size_t mNextPluginIndex{0};
+   size_t mProcessedPluginsCount{0};
    std::vector<wxString> mFailedPluginsPaths;
-   std::vector<PluginDescriptor> mFailedPluginsCache;
    wxWeakRef<wxDialogWrapper> mScanDialog;
-   wxWeakRef<wxTimer> mTimeoutTimer;
    std::chrono::system_clock::duration mTimeout{};
-   std::chrono::system_clock::time_point mRequestStartTime{};
 public:
 
    PluginStartupRegistration(const std::map<wxString, std::vector<wxString>>& pluginsToProcess);
+   ~PluginStartupRegistration();
 
    ///Starts validation, showing dialog that blocks execution until
    ///process is complete or canceled
    ///@param timeout Time allowed to spend on a single plugin validation.
    ///Pass 0 to disable timeout.
-   void Run(std::chrono::seconds timeout = std::chrono::seconds(30));
+   ///@param concurrency Maximum number of plugin host processes running
+   ///at the same time. Pass 0 to pick it from the number of CPU cores.
+   void Run(std::chrono::seconds timeout = std::chrono::seconds(30), size_t concurrency = 0);
 
    ///Returns list of paths of plugins that didn't pass validation for some reason
    const std::vector<wxString>& GetFailedPluginsPaths() const noexcept;
 
-   void OnInternalError(const wxString& error) override;
-   void OnPluginFound(const PluginDescriptor& desc) override;
-   void OnPluginValidationFailed(const wxString& providerId, const wxString& path) override;
-   void OnValidationFinished() override;
-
 private:
    
    void Stop();
    void Skip();
+   void CheckTimeouts();
    void StopWithError(const wxString& msg);
    void ProcessNext();
+   void OnPluginProcessed(const wxString& path, std::vector<PluginDescriptor>& failedPlugins, bool validProviderFound);
 };
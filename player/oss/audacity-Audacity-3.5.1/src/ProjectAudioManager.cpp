@@ -1097,8 +1097,10 @@ void ProjectAudioManager::OnAudioIOStopRecording()
          // dropouts.  We allow failure of this.
          auto gAudioIO = AudioIO::Get();
          auto &intervals = gAudioIO->LostCaptureIntervals();
-         if (intervals.size())
-            Publish( RecordingDropoutEvent{ intervals } );
+         const auto spilled = gAudioIO->SpilledCaptureSamples();
+         if (intervals.size() || spilled)
+            Publish( RecordingDropoutEvent{ intervals,
+               gAudioIO->LostCaptureSamples(), spilled } );
       }
    }
 }
@@ -49,12 +49,20 @@ struct RecordingDropoutEvent {
    using Interval = std::pair<double, double>;
    using Intervals = std::vector<Interval>;
 
-   explicit RecordingDropoutEvent(const Intervals &intervals)
+   RecordingDropoutEvent(const Intervals &intervals,
+      unsigned long long lostSamples, unsigned long long spilledSamples)
       : intervals{ intervals }
+      , lostSamples{ lostSamples }
+      , spilledSamples{ spilledSamples }
    {}
 
-   //! Disjoint and sorted increasingly
+   //! Disjoint and sorted increasingly; may be empty if nothing was lost
    const Intervals &intervals;
+   //! Sample frames that were lost, some perhaps outside of intervals
+   const unsigned long long lostSamples;
+   //! Samples over all channels that were not lost, but had to be written
+   //! to a temporary file first because the project file lagged
+   const unsigned long long spilledSamples;
 };
 
 class AUDACITY_DLL_API ProjectAudioManager final
@@ -26,8 +26,16 @@ and in the spectrogram spectral selection.
 #include "FFT.h"
 
 #include "SampleFormat.h"
+#include "BasicUI.h"
+#include "concurrency/ICancellable.h"
+#include "concurrency/WorkerPool.h"
 #include <wx/dcclient.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+
 FreqGauge::FreqGauge(wxWindow * parent, wxWindowID winid)
 :  wxStatusBar(parent, winid, wxST_SIZEGRIP)
 {
@@ -88,11 +96,119 @@ SpectrumAnalyst::~SpectrumAnalyst()
 {
 }
 
+namespace {
+// Fewer windows than this are not worth another thread
+constexpr size_t MinWindowsPerThread = 16;
+
+// How often the calling thread updates the progress gauge while it waits
+constexpr auto PollInterval = std::chrono::milliseconds(50);
+
+struct CancelFlag final : audacity::concurrency::ICancellable
+{
+   void Cancel() override { cancelled.store(true, std::memory_order_relaxed); }
+   std::atomic<bool> cancelled{ false };
+};
+
+// Sum the results for windows [first, last) into sums, which has half the
+// window size
+void AccumulateWindows(SpectrumAnalyst::Algorithm alg,
+   const float *win, size_t windowSize, const float *data,
+   size_t first, size_t last, float *sums,
+   std::atomic<size_t> &done, const std::atomic<bool> &cancelled)
+{
+   const auto half = windowSize / 2;
+   Floats in{ windowSize };
+   Floats out{ windowSize };
+   Floats out2{ windowSize };
+
+   for (auto iWindow = first; iWindow < last; ++iWindow) {
+      if (cancelled.load(std::memory_order_relaxed))
+         return;
+
+      const auto start = iWindow * half;
+      for (size_t i = 0; i < windowSize; i++)
+         in[i] = win[i] * data[start + i];
+
+      switch (alg) {
+         case SpectrumAnalyst::Spectrum:
+            PowerSpectrum(windowSize, in.get(), out.get());
+
+            for (size_t i = 0; i < half; i++)
+               sums[i] += out[i];
+            break;
+
+         case SpectrumAnalyst::Autocorrelation:
+         case SpectrumAnalyst::CubeRootAutocorrelation:
+         case SpectrumAnalyst::EnhancedAutocorrelation:
+
+            // Take FFT
+            RealFFT(windowSize, in.get(), out.get(), out2.get());
+            // Compute power
+            for (size_t i = 0; i < windowSize; i++)
+               in[i] = (out[i] * out[i]) + (out2[i] * out2[i]);
+
+            if (alg == SpectrumAnalyst::Autocorrelation) {
+               for (size_t i = 0; i < windowSize; i++)
+                  in[i] = sqrt(in[i]);
+            }
+            if (alg == SpectrumAnalyst::CubeRootAutocorrelation ||
+                alg == SpectrumAnalyst::EnhancedAutocorrelation) {
+               // Tolonen and Karjalainen recommend taking the cube root
+               // of the power, instead of the square root
+
+               for (size_t i = 0; i < windowSize; i++)
+                  in[i] = pow(in[i], 1.0f / 3.0f);
+            }
+            // Take FFT
+            RealFFT(windowSize, in.get(), out.get(), out2.get());
+
+            // Take real part of result
+            for (size_t i = 0; i < half; i++)
+               sums[i] += out[i];
+            break;
+
+         case SpectrumAnalyst::Cepstrum:
+            RealFFT(windowSize, in.get(), out.get(), out2.get());
+
+            // Compute log power
+            // Set a sane lower limit assuming maximum time amplitude of 1.0
+            {
+               float power;
+               float minpower = 1e-20*windowSize*windowSize;
+               for (size_t i = 0; i < windowSize; i++)
+               {
+                  power = (out[i] * out[i]) + (out2[i] * out2[i]);
+                  if(power < minpower)
+                     in[i] = log(minpower);
+                  else
+                     in[i] = log(power);
+               }
+               // Take IFFT
+               InverseRealFFT(windowSize, in.get(), NULL, out.get());
+
+               // Take real part of result
+               for (size_t i = 0; i < half; i++)
+                  sums[i] += out[i];
+            }
+
+            break;
+
+         default:
+            wxASSERT(false);
+            break;
+      }                         //switch
+
+      done.fetch_add(1, std::memory_order_relaxed);
+   }
+}
+}
+
 bool SpectrumAnalyst::Calculate(Algorithm alg, int windowFunc,
                                 size_t windowSize, double rate,
                                 const float *data, size_t dataLen,
                                 float *pYMin, float *pYMax,
-                                FreqGauge *progress)
+                                FreqGauge *progress,
+                                const audacity::concurrency::CancellationContextPtr &cancellation)
 {
    // Wipe old data
    mProcessed.resize(0);
@@ -121,9 +237,7 @@ bool SpectrumAnalyst::Calculate(Algorithm alg, int windowFunc,
    auto half = mWindowSize / 2;
    mProcessed.resize(mWindowSize);
 
-   Floats in{ mWindowSize };
    Floats out{ mWindowSize };
-   Floats out2{ mWindowSize };
    Floats win{ mWindowSize };
 
    for (size_t i = 0; i < mWindowSize; i++) {
@@ -147,88 +261,42 @@ bool SpectrumAnalyst::Calculate(Algorithm alg, int windowFunc,
       progress->SetRange(dataLen);
    }
 
-   size_t start = 0;
-   int windows = 0;
-   while (start + mWindowSize <= dataLen) {
-      for (size_t i = 0; i < mWindowSize; i++)
-         in[i] = win[i] * data[start + i];
-
-      switch (alg) {
-         case Spectrum:
-            PowerSpectrum(mWindowSize, in.get(), out.get());
-
-            for (size_t i = 0; i < half; i++)
-               mProcessed[i] += out[i];
-            break;
-
-         case Autocorrelation:
-         case CubeRootAutocorrelation:
-         case EnhancedAutocorrelation:
-
-            // Take FFT
-            RealFFT(mWindowSize, in.get(), out.get(), out2.get());
-            // Compute power
-            for (size_t i = 0; i < mWindowSize; i++)
-               in[i] = (out[i] * out[i]) + (out2[i] * out2[i]);
-
-            if (alg == Autocorrelation) {
-               for (size_t i = 0; i < mWindowSize; i++)
-                  in[i] = sqrt(in[i]);
-            }
-            if (alg == CubeRootAutocorrelation ||
-                alg == EnhancedAutocorrelation) {
-               // Tolonen and Karjalainen recommend taking the cube root
-               // of the power, instead of the square root
-
-               for (size_t i = 0; i < mWindowSize; i++)
-                  in[i] = pow(in[i], 1.0f / 3.0f);
+   const auto cancelFlag = std::make_shared<CancelFlag>();
+   if (cancellation)
+      cancellation->OnCancelled(cancelFlag);
+
+   // Windows overlap by half; each pool task takes a contiguous run of them
+   // and sums into its own buffer, and the partial sums are added in order
+   auto &pool = audacity::concurrency::WorkerPool::Get();
+   const size_t windows = (dataLen - mWindowSize) / half + 1;
+   const size_t nThreads = std::clamp<size_t>(
+      pool.Size(), 1,
+      std::max<size_t>(1, windows / MinWindowsPerThread));
+   std::vector<std::vector<float>> partials(
+      nThreads, std::vector<float>(half, 0.0f));
+   std::atomic<size_t> done{ 0 };
+
+   const auto accumulate = [&](size_t iThread) {
+      AccumulateWindows(alg, win.get(), mWindowSize, data,
+         windows * iThread / nThreads, windows * (iThread + 1) / nThreads,
+         partials[iThread].data(), done, cancelFlag->cancelled);
+   };
+
+   if (nThreads == 1 && !progress)
+      accumulate(0);
+   else {
+      std::vector<std::future<void>> tasks;
+      for (size_t iThread = 0; iThread < nThreads; ++iThread)
+         tasks.push_back(
+            pool.Submit([&accumulate, iThread]{ accumulate(iThread); }));
+      for (auto &task : tasks)
+         while (task.wait_for(PollInterval) != std::future_status::ready) {
+            // Update the progress bar, and let the user cancel
+            if (progress) {
+               progress->SetValue(done.load(std::memory_order_relaxed) * half);
+               BasicUI::Yield();
             }
-            // Take FFT
-            RealFFT(mWindowSize, in.get(), out.get(), out2.get());
-
-            // Take real part of result
-            for (size_t i = 0; i < half; i++)
-               mProcessed[i] += out[i];
-            break;
-
-         case Cepstrum:
-            RealFFT(mWindowSize, in.get(), out.get(), out2.get());
-
-            // Compute log power
-            // Set a sane lower limit assuming maximum time amplitude of 1.0
-            {
-               float power;
-               float minpower = 1e-20*mWindowSize*mWindowSize;
-               for (size_t i = 0; i < mWindowSize; i++)
-               {
-                  power = (out[i] * out[i]) + (out2[i] * out2[i]);
-                  if(power < minpower)
-                     in[i] = log(minpower);
-                  else
-                     in[i] = log(power);
-               }
-               // Take IFFT
-               InverseRealFFT(mWindowSize, in.get(), NULL, out.get());
-
-               // Take real part of result
-               for (size_t i = 0; i < half; i++)
-                  mProcessed[i] += out[i];
-            }
-
-            break;
-
-         default:
-            wxASSERT(false);
-            break;
-      }                         //switch
-
-      // Update the progress bar
-      if (progress) {
-         progress->SetValue(start);
-      }
-
-      start += half;
-      windows++;
+         }
    }
 
    if (progress) {
@@ -236,6 +304,17 @@ bool SpectrumAnalyst::Calculate(Algorithm alg, int windowFunc,
       progress->Reset();
    }
 
+   if (cancelFlag->cancelled.load(std::memory_order_relaxed)) {
+      mProcessed.resize(0);
+      mRate = 0.0;
+      mWindowSize = 0;
+      return false;
+   }
+
+   for (const auto &partial : partials)
+      for (size_t i = 0; i < half; i++)
+         mProcessed[i] += partial[i];
+
    float mYMin = 1000000, mYMax = -1000000;
    double scale;
    switch (alg) {
@@ -15,6 +15,8 @@
 #include <vector>
 #include <wx/statusbr.h>
 
+#include "concurrency/CancellationContext.h"
+
 class FreqGauge;
 
 class AUDACITY_DLL_API SpectrumAnalyst
@@ -35,12 +37,19 @@ public:
    ~SpectrumAnalyst();
 
    // Return true iff successful
+   /*!
+    Windows are analyzed by several threads when there are many.  If there is
+    a progress gauge, the calling thread updates it and yields to the event
+    loop while it waits for them.
+    @param cancellation if it is cancelled, stop early and return false
+    */
    bool Calculate(Algorithm alg,
       int windowFunc, // see FFT.h for values
       size_t windowSize, double rate,
       const float *data, size_t dataLen,
       float *pYMin = NULL, float *pYMax = NULL, // outputs
-      FreqGauge *progress = NULL);
+      FreqGauge *progress = NULL,
+      const audacity::concurrency::CancellationContextPtr &cancellation = {});
 
    const float *GetProcessed() const;
    int GetProcessedSize() const;
@@ -26,11 +26,20 @@ threshold of difference in two selected tracks
 #include "../CommonCommandFlags.h"
 #include "LoadCommands.h"
 #include "ViewInfo.h"
+#include "SampleBlock.h"
+#include "Sequence.h"
 #include "WaveTrack.h"
 
 
 #include <float.h>
-
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <vector>
+
+#include "concurrency/WorkerPool.h"
 #include "SettingsVisitor.h"
 #include "ShuttleGui.h"
 #include "AudacityMessageBox.h"
@@ -106,14 +115,135 @@ bool CompareAudioCommand::GetSelection(const CommandContext &context, AudacityPr
    return true;
 }
 
-double CompareAudioCommand::CompareSample(double value1, double value2)
+namespace {
+//! Statistics of differences of corresponding samples
+struct Differences {
+   sampleCount count{ 0 };
+   //! How many differed by more than the threshold
+   sampleCount errors{ 0 };
+   double maxDiff{ 0 };
+   double sumSquares{ 0 };
+   //! Position of the first sample exceeding the threshold, or -1
+   sampleCount first{ -1 };
+
+   void Merge(const Differences &other)
+   {
+      count += other.count;
+      errors += other.errors;
+      maxDiff = std::max(maxDiff, other.maxDiff);
+      sumSquares += other.sumSquares;
+      if (other.first >= 0 && (first < 0 || other.first < first))
+         first = other.first;
+   }
+};
+
+//! Compare buffers of samples starting at position
+/*!
+ Differences are computed in double, exactly, as before; the loops are
+ written in independent lanes so that they vectorize without reassociation
+ */
+Differences CompareBuffers(const float *buff0, const float *buff1, size_t len,
+   double threshold, sampleCount position)
+{
+   constexpr size_t Lanes = 4;
+   constexpr size_t Group = 64;
+   Differences result;
+   result.count = len;
+   size_t errors = 0;
+   double maxDiff[Lanes]{}, sumSquares[Lanes]{};
+   size_t ii = 0;
+   for (; ii + Group <= len; ii += Group) {
+      size_t groupErrors = 0;
+      for (size_t jj = ii; jj < ii + Group; jj += Lanes)
+         for (size_t kk = 0; kk < Lanes; ++kk) {
+            const double diff =
+               std::fabs(double(buff0[jj + kk]) - double(buff1[jj + kk]));
+            groupErrors += (diff > threshold);
+            maxDiff[kk] = std::max(maxDiff[kk], diff);
+            sumSquares[kk] += diff * diff;
+         }
+      if (groupErrors > 0 && result.first < 0)
+         for (auto jj = ii;; ++jj)
+            if (std::fabs(double(buff0[jj]) - double(buff1[jj])) > threshold) {
+               result.first = position + jj;
+               break;
+            }
+      errors += groupErrors;
+   }
+   for (; ii < len; ++ii) {
+      const double diff = std::fabs(double(buff0[ii]) - double(buff1[ii]));
+      if (diff > threshold) {
+         if (result.first < 0)
+            result.first = position + ii;
+         ++errors;
+      }
+      maxDiff[0] = std::max(maxDiff[0], diff);
+      sumSquares[0] += diff * diff;
+   }
+   result.errors = errors;
+   for (size_t kk = 0; kk < Lanes; ++kk) {
+      result.maxDiff = std::max(result.maxDiff, maxDiff[kk]);
+      result.sumSquares += sumSquares[kk];
+   }
+   return result;
+}
+
+//! Where the samples of a channel in a range are only those of one clip's
+//! sequence, find the sequence and the corresponding position in it
+const Sequence *FindSequence(const WaveChannel &channel,
+   sampleCount start, size_t len, sampleCount &seqStart)
 {
-   return fabs(value1 - value2);
+   for (const auto pInterval : channel.Intervals()) {
+      const auto &clip = pInterval->GetClip();
+      const auto playStart = clip.GetPlayStartSample();
+      const auto playEnd = std::min(clip.GetPlayEndSample(),
+         playStart + clip.GetVisibleSampleCount());
+      if (start >= playStart && start + len <= playEnd) {
+         if (clip.HasPitchOrSpeed())
+            return nullptr;
+         const auto &sequence = pInterval->GetSequence();
+         seqStart = start - playStart + clip.TimeToSamples(clip.GetTrimLeft());
+         if (seqStart + len > sequence.GetNumSamples())
+            return nullptr;
+         return &sequence;
+      }
+   }
+   return nullptr;
 }
 
-inline int min(int a, int b)
+//! Whether the two channels share the same sample blocks, at the same
+//! offsets, for a range; then their samples there must be equal
+bool SameBlocks(const WaveChannel &channel0, const WaveChannel &channel1,
+   sampleCount start, size_t len)
 {
-   return (a < b) ? a : b;
+   sampleCount seqStart0, seqStart1;
+   const auto pSequence0 = FindSequence(channel0, start, len, seqStart0);
+   if (!pSequence0)
+      return false;
+   const auto pSequence1 = FindSequence(channel1, start, len, seqStart1);
+   if (!pSequence1)
+      return false;
+
+   const auto &blocks0 = pSequence0->GetBlockArray();
+   const auto &blocks1 = pSequence1->GetBlockArray();
+   const auto seqEnd0 = seqStart0 + len;
+   size_t b0 = pSequence0->FindBlock(seqStart0);
+   size_t b1 = pSequence1->FindBlock(seqStart1);
+   while (true) {
+      if (b0 >= blocks0.size() || b1 >= blocks1.size())
+         return false;
+      const auto &block0 = blocks0[b0], &block1 = blocks1[b1];
+      if (block0.start - seqStart0 != block1.start - seqStart1 ||
+          block0.sb->GetBlockID() != block1.sb->GetBlockID())
+         return false;
+      if (block0.start + block0.sb->GetSampleCount() >= seqEnd0)
+         return true;
+      ++b0, ++b1;
+   }
+}
+
+//! Samples of each channel per unit of work
+constexpr size_t ChunkSize = 1 << 18;
 }
 
 bool CompareAudioCommand::Apply(const CommandContext & context)
@@ -128,47 +258,85 @@ bool CompareAudioCommand::Apply(const CommandContext & context)
       + mTrack1->GetName() + wxT("'.");
    context.Status(msg);
 
-   long errorCount = 0;
-   // Initialize buffers for track data to be analyzed
-   auto buffSize = std::min(mTrack0->GetMaxBlockSize(), mTrack1->GetMaxBlockSize());
-
-   Floats buff0{ buffSize };
-   Floats buff1{ buffSize };
-
-   // Compare tracks block by block
+   // Divide the channels into chunks, to be compared in parallel
    auto s0 = mTrack0->TimeToLongSamples(mT0);
    auto s1 = mTrack0->TimeToLongSamples(mT1);
+   struct Chunk {
+      const WaveChannel *pChannel0;
+      const WaveChannel *pChannel1;
+      sampleCount start;
+      size_t len;
+   };
+   std::vector<Chunk> chunks;
    const auto channels0 = mTrack0->Channels();
    auto iter = mTrack1->Channels().begin();
    for (const auto pChannel0 : channels0) {
       const auto pChannel1 = *iter++;
-      auto position = s0;
-      auto length = s1 - s0;
-      while (position < s1) {
-         // Get a block of data into the buffers
-         auto block = limitSampleBufferSize(
-            pChannel0->GetBestBlockSize(position), s1 - position
-         );
-         pChannel0->GetFloats(buff0.get(), position, block);
-         pChannel1->GetFloats(buff1.get(), position, block);
-
-         for (decltype(block) buffPos = 0; buffPos < block; ++buffPos)
-            if (CompareSample(buff0[buffPos], buff1[buffPos]) > errorThreshold)
-               ++errorCount;
-
+      for (auto position = s0; position < s1;) {
+         auto block = limitSampleBufferSize(ChunkSize, s1 - position);
+         chunks.push_back({ pChannel0.get(), pChannel1.get(), position, block });
          position += block;
-         context.Progress(
-            (position - s0).as_double() /
-            length.as_double()
-         );
       }
    }
 
+   const double threshold = errorThreshold;
+   std::vector<Differences> results(chunks.size());
+   std::atomic<size_t> nextChunk{ 0 };
+   std::atomic<size_t> nDone{ 0 };
+   auto worker = [&]{
+      Floats buff0{ ChunkSize };
+      Floats buff1{ ChunkSize };
+      for (size_t ii; (ii = nextChunk++) < chunks.size(); ++nDone) {
+         const auto &chunk = chunks[ii];
+         auto &result = results[ii];
+         if (SameBlocks(
+            *chunk.pChannel0, *chunk.pChannel1, chunk.start, chunk.len))
+            result.count = chunk.len;
+         else {
+            chunk.pChannel0->GetFloats(buff0.get(), chunk.start, chunk.len);
+            chunk.pChannel1->GetFloats(buff1.get(), chunk.start, chunk.len);
+            result = CompareBuffers(buff0.get(), buff1.get(), chunk.len,
+               threshold, chunk.start);
+         }
+      }
+   };
+
+   auto &pool = audacity::concurrency::WorkerPool::Get();
+   const auto nThreads = std::clamp<size_t>(
+      pool.Size(), 1, std::max<size_t>(chunks.size(), 1));
+   std::vector<std::future<void>> futures;
+   for (size_t ii = 0; ii < nThreads; ++ii)
+      futures.push_back(pool.Submit(worker));
+   for (auto &future : futures) {
+      while (future.wait_for(std::chrono::milliseconds(50)) !=
+         std::future_status::ready)
+         context.Progress(double(nDone) / chunks.size());
+   }
+   // Rethrows any exception from reading
+   for (auto &future : futures)
+      future.get();
+   context.Progress(1.0);
+
+   Differences total;
+   for (const auto &result : results)
+      total.Merge(result);
+
    // Output the results
+   long errorCount = total.errors.as_long_long();
    double errorSeconds = mTrack0->LongSamplesToTime(errorCount);
    context.Status(wxString::Format(wxT("%li"), errorCount));
    context.Status(wxString::Format(wxT("%.4f"), errorSeconds));
    context.Status(wxString::Format(wxT("Finished comparison: %li samples (%.3f seconds) exceeded the error threshold of %f."), errorCount, errorSeconds, errorThreshold));
+   const double rms = total.count > 0
+      ? sqrt(total.sumSquares / total.count.as_double())
+      : 0.0;
+   context.Status(wxString::Format(
+      wxT("Maximum difference: %g, RMS difference: %g"), total.maxDiff, rms));
+   if (total.first >= 0)
+      context.Status(wxString::Format(
+         wxT("First sample exceeding the threshold: %lld (%.6f seconds)"),
+         total.first.as_long_long(),
+         mTrack0->LongSamplesToTime(total.first)));
    return true;
 }
 
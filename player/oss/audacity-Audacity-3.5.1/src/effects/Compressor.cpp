@@ -26,8 +26,12 @@
 #include "Compressor.h"
 #include "EffectEditor.h"
 #include "LoadEffects.h"
+#include "concurrency/WorkerPool.h"
 
 #include <math.h>
+#include <algorithm>
+#include <future>
+#include <vector>
 
 #include <wx/brush.h>
 #include <wx/checkbox.h>
@@ -400,11 +404,8 @@ bool EffectCompressor::TwoBufferProcessPass1
       Follow(buffer2, mFollow2.get(), len2, mFollow1.get(), len1);
    }
 
-   if(buffer1 != NULL) {
-      for (size_t i = 0; i < len1; i++) {
-         buffer1[i] = DoCompression(buffer1[i], mFollow1[i]);
-      }
-   }
+   if(buffer1 != NULL)
+      DoCompression(buffer1, mFollow1.get(), len1);
 
 
 #if 0
@@ -448,7 +449,8 @@ float EffectCompressor::AvgCircle(float value)
    mCircle[mCirclePos] = value*value;
    mRMSSum += mCircle[mCirclePos];
    level = sqrt(mRMSSum/mCircleSize);
-   mCirclePos = (mCirclePos+1)%mCircleSize;
+   if (++mCirclePos == mCircleSize)
+      mCirclePos = 0;
 
    return level;
 }
@@ -566,22 +568,64 @@ void EffectCompressor::Follow(float *buffer, float *env, size_t len, float *prev
    }
 }
 
-float EffectCompressor::DoCompression(float value, double env)
+namespace {
+// Samples per thread, at least, when applying gains
+constexpr size_t MinCompressionChunk = 16384;
+
+// Apply gain pow(base / env, compression) to each sample, and return the
+// maximum absolute result
+float Compress(float *buffer, const float *env, size_t len,
+   double base, double compression)
 {
-   float out;
-   if(mUsePeak) {
-      // Peak values map 1.0 to 1.0 - 'upward' compression
-      out = value * pow(1.0/env, mCompression);
-   } else {
-      // With RMS-based compression don't change values below mThreshold - 'downward' compression
-      out = value * pow(mThreshold/env, mCompression);
+   // The envelope often holds steady, at the threshold or the noise floor
+   // hold, so reuse the gain for repeated values
+   float lastEnv = -1;
+   double gain = 1;
+   for (size_t i = 0; i < len; ++i) {
+      if (env[i] != lastEnv) {
+         lastEnv = env[i];
+         gain = pow(base / lastEnv, compression);
+      }
+      buffer[i] = buffer[i] * gain;
    }
+   float max = 0;
+   for (size_t i = 0; i < len; ++i)
+      max = std::max(max, std::fabs(buffer[i]));
+   return max;
+}
+}
 
-   // Retain the maximum value for use in the normalization pass
-   if(mMax < fabs(out))
-      mMax = fabs(out);
+void EffectCompressor::DoCompression(float *buffer, const float *env,
+   size_t len)
+{
+   // Peak values map 1.0 to 1.0 - 'upward' compression
+   // With RMS-based compression don't change values below mThreshold -
+   // 'downward' compression
+   const double base = mUsePeak ? 1.0 : mThreshold;
+   const double compression = mCompression;
+
+   // Samples are independent, so divide a long buffer between this thread
+   // and the worker pool
+   auto &pool = audacity::concurrency::WorkerPool::Get();
+   const auto nThreads = std::clamp<size_t>(
+      std::min<size_t>(1 + pool.Size(), len / MinCompressionChunk), 1, 16);
+   const auto chunk = (len + nThreads - 1) / nThreads;
+   std::vector<float> maxima(nThreads, 0.0f);
+   std::vector<std::future<void>> futures;
+   for (size_t start = chunk, i = 1; start < len; start += chunk, ++i)
+      futures.push_back(pool.Submit([=, &maxima]{
+         maxima[i] = Compress(buffer + start, env + start,
+            std::min(chunk, len - start), base, compression);
+      }));
+   float max = Compress(buffer, env, std::min(chunk, len), base, compression);
+   for (auto &future : futures)
+      future.get();
+   for (auto m : maxima)
+      max = std::max(max, m);
 
-   return out;
+   // Retain the maximum value for use in the normalization pass
+   if(mMax < max)
+      mMax = max;
 }
 
 void EffectCompressor::OnSlider(wxCommandEvent & WXUNUSED(evt))
@@ -71,7 +71,8 @@ private:
    void FreshenCircle();
    float AvgCircle(float x);
    void Follow(float *buffer, float *env, size_t len, float *previous, size_t previous_len);
-   float DoCompression(float x, double env);
+   //! Apply the gains for the envelope, and update mMax
+   void DoCompression(float *buffer, const float *env, size_t len);
 
    void OnSlider(wxCommandEvent & evt);
    void UpdateUI();
@@ -364,13 +364,13 @@ bool EffectEqualization::Init()
 }
 
 struct EffectEqualization::Task {
-   Task(size_t M, size_t idealBlockLen, WaveChannel &channel)
+   Task(size_t M, size_t idealBlockLen,
+      const WaveChannel &input, WaveChannel &output)
       : buffer{ idealBlockLen }
-      , idealBlockLen{ idealBlockLen }
-      , output{ channel }
+      , input{ input }
+      , output{ output }
       , leftTailRemaining{ (M - 1) / 2 }
    {
-      memset(lastWindow, 0, windowSize * sizeof(float));
    }
 
    void AccumulateSamples(constSamplePtr buffer, size_t len)
@@ -382,16 +382,9 @@ struct EffectEqualization::Task {
       output.Append(buffer, floatSample, len);
    }
 
-   static constexpr auto windowSize = EqualizationFilter::windowSize;
-   Floats window1{ windowSize };
-   Floats window2{ windowSize };
-
    Floats buffer;
-   const size_t idealBlockLen;
 
-   // These pointers are swapped after each FFT window
-   float *thisWindow{ window1.get() };
-   float *lastWindow{ window2.get() };
+   const WaveChannel &input;
 
    // a new WaveChannel to hold all of the output,
    // including 'tails' each end
@@ -421,24 +414,25 @@ bool EffectEqualization::Process(EffectInstance &, EffectSettings &)
          auto temp = track->WideEmptyCopy();
          auto pTempTrack = *temp->Any<WaveTrack>().begin();
          pTempTrack->ConvertToSampleFormat(floatSample);
-         auto iter0 = pTempTrack->Channels().begin();
 
-         for (const auto pChannel : track->Channels()) {
-            constexpr auto windowSize = EqualizationFilter::windowSize;
-            const auto &M = mParameters.mM;
-
-            wxASSERT(M - 1 < windowSize);
-            size_t L = windowSize - (M - 1);   //Process L samples at a go
-            auto s = start;
-            auto idealBlockLen = pChannel->GetMaxBlockSize() * 4;
-            if (idealBlockLen % L != 0)
-               idealBlockLen += (L - (idealBlockLen % L));
-            auto pNewChannel = *iter0++;
-            Task task{ M, idealBlockLen, *pNewChannel };
-            bGoodResult = ProcessOne(task, count, *pChannel, start, len);
-            if (!bGoodResult)
-               goto done;
-         }
+         // All channels share one convolution engine, which batches them
+         const auto pConvolver = mParameters.MakeConvolver(track->NChannels());
+         const auto B = pConvolver->PartitionSize();
+         auto idealBlockLen = track->GetMaxBlockSize() * 4;
+         if (idealBlockLen % B != 0)
+            idealBlockLen += (B - (idealBlockLen % B));
+
+         std::vector<Task> tasks;
+         tasks.reserve(track->NChannels());
+         auto iter0 = pTempTrack->Channels().begin();
+         for (const auto pChannel : track->Channels())
+            tasks.emplace_back(
+               mParameters.mM, idealBlockLen, *pChannel, **iter0++);
+
+         bGoodResult = ProcessOne(
+            tasks, *pConvolver, idealBlockLen, count, start, len);
+         if (!bGoodResult)
+            goto done;
          pTempTrack->Flush();
          // Remove trailing data from the temp track
          pTempTrack->Clear(t1 - t0, pTempTrack->GetEndTime());
@@ -473,85 +467,53 @@ bool EffectEqualization::TransferDataToWindow(const EffectSettings &settings)
 
 // EffectEqualization implementation
 
-bool EffectEqualization::ProcessOne(Task &task,
-   int count, const WaveChannel &t, sampleCount start, sampleCount len)
+bool EffectEqualization::ProcessOne(std::vector<Task> &tasks,
+   PartitionedConvolver &convolver, size_t idealBlockLen,
+   int count, sampleCount start, sampleCount len)
 {
-   constexpr auto windowSize = EqualizationFilter::windowSize;
-
    const auto &M = mParameters.mM;
-
-   wxASSERT(M - 1 < windowSize);
-   size_t L = windowSize - (M - 1);   //Process L samples at a go
+   const auto B = convolver.PartitionSize();
+   const auto nChannels = tasks.size();
+   std::vector<const float *> inputs(nChannels);
+   std::vector<float *> outputs(nChannels);
+
+   // Output the full convolution, including M - 1 samples of 'tail'; feed
+   // zeroes after the input runs out
+   const auto originalLen = len + M - 1;
+   auto remaining = originalLen;
    auto s = start;
 
-   auto &buffer = task.buffer;
-   auto &window1 = task.window1;
-   auto &window2 = task.window2;
-   auto &thisWindow = task.thisWindow;
-   auto &lastWindow = task.lastWindow;
-
-   auto originalLen = len;
-
-   auto &output = task.output;
-
    TrackProgress(count, 0.);
-   bool bLoopSuccess = true;
-   size_t wcopy = 0;
-
-   while (len != 0)
+   while (remaining != 0)
    {
-      auto block = limitSampleBufferSize( task.idealBlockLen, len );
-
-      t.GetFloats(buffer.get(), s, block);
-
-      for(size_t i = 0; i < block; i += L)   //go through block in lumps of length L
-      {
-         wcopy = std::min <size_t> (L, block - i);
-         for(size_t j = 0; j < wcopy; j++)
-            thisWindow[j] = buffer[i+j];   //copy the L (or remaining) samples
-         for(auto j = wcopy; j < windowSize; j++)
-            thisWindow[j] = 0;   //this includes the padding
-
-         mParameters.Filter(windowSize, thisWindow);
-
-         // Overlap - Add
-         for(size_t j = 0; (j < M - 1) && (j < wcopy); j++)
-            buffer[i+j] = thisWindow[j] + lastWindow[L + j];
-         for(size_t j = M - 1; j < wcopy; j++)
-            buffer[i+j] = thisWindow[j];
+      auto block = limitSampleBufferSize( idealBlockLen, remaining );
+      auto toGet = limitSampleBufferSize( block, len );
+
+      for (auto &task : tasks) {
+         if (toGet > 0)
+            task.input.GetFloats(task.buffer.get(), s, toGet);
+         std::fill(task.buffer.get() + toGet,
+            task.buffer.get() + idealBlockLen, 0.0f);
+      }
 
-         std::swap( thisWindow, lastWindow );
-      }  //next i, lump of this block
+      // Filter in place, one partition at a time; idealBlockLen is a
+      // multiple of B, so a short last block is zero padded
+      for (size_t i = 0; i < block; i += B) {
+         for (size_t iChannel = 0; iChannel < nChannels; ++iChannel)
+            inputs[iChannel] = outputs[iChannel] =
+               tasks[iChannel].buffer.get() + i;
+         convolver.Process(inputs.data(), outputs.data());
+      }
 
-      task.AccumulateSamples((samplePtr)buffer.get(), block);
-      len -= block;
-      s += block;
+      for (auto &task : tasks)
+         task.AccumulateSamples((samplePtr)task.buffer.get(), block);
+      remaining -= block;
+      len -= toGet;
+      s += toGet;
 
-      if (TrackProgress(count, ( s - start ).as_double() /
+      if (TrackProgress(count, ( originalLen - remaining ).as_double() /
                         originalLen.as_double()))
-      {
-         bLoopSuccess = false;
-         break;
-      }
-   }
-
-   if (bLoopSuccess) {
-      // M-1 samples of 'tail' left in lastWindow, get them now
-      if(wcopy < (M - 1)) {
-         // Still have some overlap left to process
-         // (note that lastWindow and thisWindow have been exchanged at this point
-         //  so that 'thisWindow' is really the window prior to 'lastWindow')
-         size_t j = 0;
-         for(; j < M - 1 - wcopy; j++)
-            buffer[j] = lastWindow[wcopy + j] + thisWindow[L + wcopy + j];
-         // And fill in the remainder after the overlap
-         for( ; j < M - 1; j++)
-            buffer[j] = lastWindow[wcopy + j];
-      } else {
-         for(size_t j = 0; j < M - 1; j++)
-            buffer[j] = lastWindow[wcopy + j];
-      }
-      task.AccumulateSamples((samplePtr)buffer.get(), M - 1);
+         return false;
    }
-   return bLoopSuccess;
+   return true;
 }
@@ -17,6 +17,7 @@
 #include "StatefulEffect.h"
 #include "EqualizationUI.h"
 
+class PartitionedConvolver;
 class WaveChannel;
 
 class EffectEqualization : public StatefulEffect
@@ -69,8 +70,8 @@ private:
    // EffectEqualization implementation
 
    struct Task;
-   bool ProcessOne(Task &task, int count, const WaveChannel &t,
-      sampleCount start, sampleCount len);
+   bool ProcessOne(std::vector<Task> &tasks, PartitionedConvolver &convolver,
+      size_t idealBlockLen, int count, sampleCount start, sampleCount len);
    
    wxWeakRef<wxWindow> mUIParent{};
    EqualizationFilter mParameters;
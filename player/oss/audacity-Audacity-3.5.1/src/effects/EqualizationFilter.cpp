@@ -14,6 +14,7 @@
 #include "EqualizationFilter.h"
 #include "Envelope.h"
 #include "FFT.h"
+#include "PartitionedConvolver.h"
 
 EqualizationFilter::EqualizationFilter(const EffectSettingsManager &manager)
    : EqualizationParameters{ manager }
@@ -134,6 +135,7 @@ bool EqualizationFilter::CalcFilter()
    for (size_t i = 0; i < mM; i++)
    {   //and copy useful values back
       outr[i] = tempr[i];
+      mImpulse[i] = tempr[i];
    }
    for (size_t i = mM; i < mWindowSize; i++)
    {   //rest is padding
@@ -174,3 +176,10 @@ void EqualizationFilter::Filter(size_t len, float *buffer) const
    InverseRealFFTf(mFFTBuffer.get(), hFFT.get());
    ReorderToTime(hFFT.get(), mFFTBuffer.get(), buffer);
 }
+
+std::unique_ptr<PartitionedConvolver>
+EqualizationFilter::MakeConvolver(size_t nChannels, size_t partition) const
+{
+   return std::make_unique<PartitionedConvolver>(
+      mImpulse.get(), mM, partition, nChannels);
+}
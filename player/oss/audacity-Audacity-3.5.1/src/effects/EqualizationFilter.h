@@ -17,6 +17,8 @@
 #include "EqualizationParameters.h" // base class
 #include "Envelope.h" // member
 #include "RealFFTf.h" // member
+
+class PartitionedConvolver;
 using Floats = ArrayOf<float>;
 
 //! Extend EqualizationParameters with frequency domain coefficients computed
@@ -31,6 +33,10 @@ struct EqualizationFilter : EqualizationParameters {
    // Have a dialog box for it?
    static constexpr size_t windowSize = 16384u;
 
+   // Default partition size for convolution with the impulse response;
+   // smaller is less latency, larger is less work per sample
+   static constexpr size_t partitionSize = 2048u;
+
    explicit EqualizationFilter(const EffectSettingsManager &manager);
 
    //! Adjust given coefficients so there is a finite impulse response in time
@@ -41,6 +47,11 @@ struct EqualizationFilter : EqualizationParameters {
    //! padded left and right for the tails
    void Filter(size_t len, float *buffer) const;
 
+   //! Make a convolution engine for the impulse response computed by
+   //! CalcFilter(), which it does not track
+   std::unique_ptr<PartitionedConvolver> MakeConvolver(
+      size_t nChannels, size_t partition = partitionSize) const;
+
    const Envelope &ChooseEnvelope() const
    { return mLin ? mLinEnvelope : mLogEnvelope; }
    Envelope &ChooseEnvelope()
@@ -54,6 +65,8 @@ struct EqualizationFilter : EqualizationParameters {
    HFFT hFFT{ GetFFT(windowSize) };
    Floats mFFTBuffer{ windowSize };
    Floats mFilterFuncR{ windowSize }, mFilterFuncI{ windowSize };
+   //! Time domain equivalent of the coefficients, mM taps
+   Floats mImpulse{ windowSize };
    double mLoFreq{ loFreqI };
    double mHiFreq{ mLoFreq };
    size_t mWindowSize{ windowSize };
@@ -19,13 +19,20 @@
 #include "LoadEffects.h"
 
 #include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <future>
+#include <vector>
 
 #include <math.h>
 
+#include "concurrency/WorkerPool.h"
+
 #include <wx/valgen.h>
 
 #include "ShuttleGui.h"
 #include "FFT.h"
+#include "PowerSpectrumGetter.h" // PffftFloatVector, PffftSetupHolder
 #include "../widgets/valnum.h"
 #include "AudacityMessageBox.h"
 #include "Prefs.h"
@@ -44,20 +51,37 @@ const EffectParameterMethods& EffectPaulstretch::Parameters() const
 
 /// \brief Class that helps EffectPaulStretch.  It does the FFTs and inner loop
 /// of the effect.
+/*!
+ Each hop of output is computed from a window of input whose spectrum gets
+ random phases.  Hops are independent except for the final overlap of
+ consecutive outputs, so they are queued in batches and their spectra
+ computed in parallel, by this thread and those of the shared WorkerPool.
+ Random phases derive from the seed and the number of the hop only, so the
+ output does not depend on the scheduling of threads.
+ */
 class PaulStretch
 {
 public:
-   PaulStretch(float rap_, size_t in_bufsize_, float samplerate_);
+   PaulStretch(float rap_, size_t in_bufsize_, float samplerate_,
+      unsigned seed_);
    //in_bufsize is also a half of a FFT buffer (in samples)
    virtual ~PaulStretch();
 
-   void process(float *smps, size_t nsmps);
+   //! Add samples to the pool, and queue a hop of output from the pool
+   void push(const float *smps, size_t nsmps);
+   //! Whether enough hops are queued to be worth rendering together
+   bool batch_full() const { return nqueued >= batch_size; }
+   //! Compute the queued hops, in parallel
+   void render();
+   //! Make out_buf from the next rendered hop
+   /*! @pre there was a push() not yet popped, and render() was called since */
+   void pop();
 
    size_t get_nsamples();//how many samples are required to be added in the pool next time
    size_t get_nsamples_for_fill();//how many samples are required to be added for a complete buffer refill (at start of the song or after seek)
 
 private:
-   void process_spectrum(float *WXUNUSED(freq)) {};
+   void render_hop(float *hop, float *work, unsigned long long number) const;
 
    const float samplerate;
    const float rap;
@@ -78,7 +102,24 @@ private:
 
    double remained_samples;//how many fraction of samples has remained (0..1)
 
-   const Floats fft_smps, fft_c, fft_s, fft_freq, fft_tmp;
+   const unsigned seed;
+   unsigned long long hop_count{ 0 };
+
+   PffftSetupHolder setup;
+   //! Analysis window
+   PffftFloatVector window;
+   //! Crossfade and gain of the output, which are the same for every hop
+   Floats out_fade, out_gain;
+
+   //! The calling thread and those of the pool
+   const size_t nthreads;
+   const size_t batch_size;
+   //! Room for the extra hop queued at the start
+   PffftFloatVector hops;
+   std::vector<PffftFloatVector> works;
+   size_t nqueued{ 0 };
+   size_t nrendered{ 0 };
+   size_t npopped{ 0 };
 };
 
 //
@@ -348,7 +389,7 @@ bool EffectPaulstretch::ProcessOne(const WaveChannel &track,
       // This encloses all the allocations of buffers, including those in
       // the constructor of the PaulStretch object
 
-      PaulStretch stretch(amount, stretch_buf_size, rate);
+      PaulStretch stretch(amount, stretch_buf_size, rate, count);
 
       auto nget = stretch.get_nsamples_for_fill();
 
@@ -363,45 +404,62 @@ bool EffectPaulstretch::ProcessOne(const WaveChannel &track,
       {
          Floats fade_track_smps{ fade_len };
          decltype(len) s=0;
+         // Input position after each queued hop that makes output
+         std::vector<decltype(len)> positions;
+
+         while (s < len && !cancelled) {
+            // Read input for a batch of hops
+            positions.clear();
+            while (s < len && !stretch.batch_full()) {
+               track.GetFloats(bufferptr0, start + s, nget);
+               stretch.push(buffer0.get(), nget);
+
+               if (s == 0) {
+                  // An extra hop at the start, from the same input, only
+                  // to begin the overlap of outputs
+                  stretch.push(buffer0.get(), 0);
+               };
+
+               s += nget;
+               positions.push_back(s);
+               nget = stretch.get_nsamples();
+            }
 
-         while (s < len) {
-            track.GetFloats(bufferptr0, start + s, nget);
-            stretch.process(buffer0.get(), nget);
-
-            if (first_time) {
-               stretch.process(buffer0.get(), 0);
-            };
-
-            s += nget;
-
-            if (first_time){//blend the start of the selection
-               track.GetFloats(fade_track_smps.get(), start, fade_len);
-               first_time = false;
-               for (size_t i = 0; i < fade_len; i++){
-                  float fi = (float)i / (float)fade_len;
-                  stretch.out_buf[i] =
-                     stretch.out_buf[i] * fi + (1.0 - fi) * fade_track_smps[i];
+            stretch.render();
+
+            for (auto position : positions) {
+               if (first_time)
+                  stretch.pop();
+               stretch.pop();
+
+               if (first_time){//blend the start of the selection
+                  track.GetFloats(fade_track_smps.get(), start, fade_len);
+                  first_time = false;
+                  for (size_t i = 0; i < fade_len; i++){
+                     float fi = (float)i / (float)fade_len;
+                     stretch.out_buf[i] =
+                        stretch.out_buf[i] * fi + (1.0 - fi) * fade_track_smps[i];
+                  }
                }
-            }
-            if (s >= len){//blend the end of the selection
-               track.GetFloats(fade_track_smps.get(), end - fade_len, fade_len);
-               for (size_t i = 0; i < fade_len; i++){
-                  float fi = (float)i / (float)fade_len;
-                  auto i2 = bufsize / 2 - 1 - i;
-                  stretch.out_buf[i2] =
-                     stretch.out_buf[i2] * fi + (1.0 - fi) *
-                     fade_track_smps[fade_len - 1 - i];
+               if (position >= len){//blend the end of the selection
+                  track.GetFloats(fade_track_smps.get(), end - fade_len, fade_len);
+                  for (size_t i = 0; i < fade_len; i++){
+                     float fi = (float)i / (float)fade_len;
+                     auto i2 = bufsize / 2 - 1 - i;
+                     stretch.out_buf[i2] =
+                        stretch.out_buf[i2] * fi + (1.0 - fi) *
+                        fade_track_smps[fade_len - 1 - i];
+                  }
                }
-            }
 
-            outputTrack.Append((samplePtr)stretch.out_buf.get(), floatSample, stretch.out_bufsize);
+               outputTrack.Append((samplePtr)stretch.out_buf.get(), floatSample, stretch.out_bufsize);
 
-            nget = stretch.get_nsamples();
-            if (TrackProgress(count,
-               s.as_double() / len.as_double()
-            )) {
-               cancelled = true;
-               break;
+               if (TrackProgress(count,
+                  position.as_double() / len.as_double()
+               )) {
+                  cancelled = true;
+                  break;
+               }
             }
          }
       }
@@ -418,7 +476,54 @@ bool EffectPaulstretch::ProcessOne(const WaveChannel &track,
 /*************************************************************/
 
 
-PaulStretch::PaulStretch(float rap_, size_t in_bufsize_, float samplerate_ )
+namespace {
+//! Cosines and sines of the phases that may be assigned to bins
+struct PhaseTable {
+   static constexpr size_t size = 0x8000;
+   PhaseTable()
+   {
+      const float inv_2p15_2pi = 1.0 / 16384.0 * (float)M_PI;
+      for (size_t i = 0; i < size; ++i) {
+         const float phase = i * inv_2p15_2pi;
+         cosines[i] = cos(phase);
+         sines[i] = sin(phase);
+      }
+   }
+   float cosines[size], sines[size];
+};
+
+const PhaseTable &GetPhaseTable()
+{
+   static const PhaseTable table;
+   return table;
+}
+
+//! Counter-based generator, so each hop can be seeded independently
+inline unsigned long long SplitMix64(unsigned long long &state)
+{
+   auto z = (state += 0x9E3779B97F4A7C15ull);
+   z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+   z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+   return z ^ (z >> 31);
+}
+
+// Bound the memory for queued hops, but queue enough to amortize the
+// handing of work to other threads
+constexpr size_t batchFloats = 1 << 21;
+constexpr size_t maxBatch = 256;
+
+//! Hops to queue: as many as fit the budget, with the extra hop, and then a
+//! multiple of the threads if there is room for more than one round
+size_t BatchSize(size_t poolsize, size_t nthreads)
+{
+   const auto fit = batchFloats / std::max<size_t>(1, poolsize);
+   const auto batch = std::min(maxBatch, fit > 1 ? fit - 1 : 1);
+   return batch > nthreads ? batch - batch % nthreads : batch;
+}
+}
+
+PaulStretch::PaulStretch(float rap_, size_t in_bufsize_, float samplerate_,
+   unsigned seed_)
    : samplerate { samplerate_ }
    , rap { std::max(1.0f, rap_) }
    , in_bufsize { in_bufsize_ }
@@ -428,20 +533,47 @@ PaulStretch::PaulStretch(float rap_, size_t in_bufsize_, float samplerate_ )
    , poolsize { in_bufsize_ * 2 }
    , in_pool { poolsize, true }
    , remained_samples { 0.0 }
-   , fft_smps { poolsize, true }
-   , fft_c { poolsize, true }
-   , fft_s { poolsize, true }
-   , fft_freq { poolsize, true }
-   , fft_tmp { poolsize }
+   , seed { seed_ }
+   , setup { pffft_new_setup(poolsize, PFFFT_REAL) }
+   , window( poolsize, 1.0f )
+   , out_fade { out_bufsize }
+   , out_gain { out_bufsize }
+   , nthreads { 1 + audacity::concurrency::WorkerPool::Get().Size() }
+   , batch_size { BatchSize(poolsize, nthreads) }
+   , hops( (batch_size + 1) * poolsize )
+   , works( nthreads )
 {
+   if (!setup)
+      throw std::bad_alloc{};
+
+   WindowFunc(eWinFuncHann, poolsize, window.data());
+
+   //make the output buffer
+   float tmp = 1.0 / (float) out_bufsize * M_PI;
+   float hinv_sqrt2 = 0.853553390593f;//(1.0+1.0/sqrt(2))*0.5;
+
+   float ampfactor = 1.0;
+   if (rap < 1.0)
+      ampfactor = rap * 0.707;
+   else
+      ampfactor = (out_bufsize / (float)poolsize) * 4.0;
+
+   for (size_t i = 0; i < out_bufsize; i++) {
+      out_fade[i] = (0.5 + 0.5 * cos(i * tmp));
+      out_gain[i] =
+         (hinv_sqrt2 - (1.0 - hinv_sqrt2) * cos(i * 2.0 * tmp)) * ampfactor;
+   }
 }
 
 PaulStretch::~PaulStretch()
 {
 }
 
-void PaulStretch::process(float *smps, size_t nsmps)
+void PaulStretch::push(const float *smps, size_t nsmps)
 {
+   assert(nqueued <= batch_size);
+   assert(nrendered == 0);
+
    //add NEW samples to the pool
    if ((smps != NULL) && (nsmps != 0)) {
       if (nsmps > poolsize) {
@@ -450,71 +582,97 @@ void PaulStretch::process(float *smps, size_t nsmps)
       int nleft = poolsize - nsmps;
 
       //move left the samples from the pool to make room for NEW samples
-      for (int i = 0; i < nleft; i++)
-         in_pool[i] = in_pool[i + nsmps];
+      std::copy(in_pool.get() + nsmps, in_pool.get() + poolsize, in_pool.get());
 
       //add NEW samples to the pool
-      for (size_t i = 0; i < nsmps; i++)
-         in_pool[i + nleft] = smps[i];
+      std::copy(smps, smps + nsmps, in_pool.get() + nleft);
    }
 
    //get the samples from the pool
-   for (size_t i = 0; i < poolsize; i++)
-      fft_smps[i] = in_pool[i];
-   WindowFunc(eWinFuncHann, poolsize, fft_smps.get());
-
-   RealFFT(poolsize, fft_smps.get(), fft_c.get(), fft_s.get());
-
-   for (size_t i = 0; i < poolsize / 2; i++)
-      fft_freq[i] = sqrt(fft_c[i] * fft_c[i] + fft_s[i] * fft_s[i]);
-   process_spectrum(fft_freq.get());
+   std::copy(in_pool.get(), in_pool.get() + poolsize,
+      hops.data() + nqueued * poolsize);
+   ++nqueued;
+}
 
+void PaulStretch::render_hop(
+   float *hop, float *work, unsigned long long number) const
+{
+   const auto half = poolsize / 2;
 
-   //put randomize phases to frequencies and do a IFFT
-   float inv_2p15_2pi = 1.0 / 16384.0 * (float)M_PI;
-   for (size_t i = 1; i < poolsize / 2; i++) {
-      unsigned int random = (rand()) & 0x7fff;
-      float phase = random * inv_2p15_2pi;
-      float s = fft_freq[i] * sin(phase);
-      float c = fft_freq[i] * cos(phase);
+   const auto pWindow = window.data();
+   for (size_t i = 0; i < poolsize; i++)
+      hop[i] *= pWindow[i];
 
-      fft_c[i] = fft_c[poolsize - i] = c;
+   // Output is interleaved complex numbers, except the first pair holds the
+   // real parts of the bins at 0 and the Nyquist frequency
+   pffft_transform_ordered(setup.get(), hop, hop, work, PFFFT_FORWARD);
 
-      fft_s[i] = s; fft_s[poolsize - i] = -s;
+   // Magnitudes, with the normalization of the inverse transform folded in
+   const float scale = 1.0f / poolsize;
+   for (size_t i = 1; i < half; i++) {
+      const auto c = hop[2 * i], s = hop[2 * i + 1];
+      hop[2 * i] = sqrt(c * c + s * s) * scale;
    }
-   fft_c[0] = fft_s[0] = 0.0;
-   fft_c[poolsize / 2] = fft_s[poolsize / 2] = 0.0;
-
-   FFT(poolsize, true, fft_c.get(), fft_s.get(), fft_smps.get(), fft_tmp.get());
 
-   float max = 0.0, max2 = 0.0;
-   for (size_t i = 0; i < poolsize; i++) {
-      max = std::max(max, fabsf(fft_tmp[i]));
-      max2 = std::max(max2, fabsf(fft_smps[i]));
+   //put randomize phases to frequencies and do a IFFT
+   auto &table = GetPhaseTable();
+   unsigned long long state = (static_cast<unsigned long long>(seed) << 48)
+      ^ (number * 0xD1B54A32D192ED03ull);
+   for (size_t i = 1; i < half; i++) {
+      const auto random = SplitMix64(state) & 0x7fff;
+      const auto freq = hop[2 * i];
+      hop[2 * i] = freq * table.cosines[random];
+      hop[2 * i + 1] = freq * table.sines[random];
    }
+   hop[0] = hop[1] = 0.0;
 
+   pffft_transform_ordered(setup.get(), hop, hop, work, PFFFT_BACKWARD);
+}
 
-   //make the output buffer
-   float tmp = 1.0 / (float) out_bufsize * M_PI;
-   float hinv_sqrt2 = 0.853553390593f;//(1.0+1.0/sqrt(2))*0.5;
+void PaulStretch::render()
+{
+   assert(nrendered == 0);
+   const auto first = hop_count;
+   const auto nhops = nqueued;
+   std::atomic<size_t> next{ 0 };
+   const auto work = [&](size_t iThread){
+      auto &buffer = works[iThread];
+      if (buffer.size() != poolsize)
+         buffer = PffftFloatVector(poolsize);
+      for (size_t ii; (ii = next++) < nhops;)
+         render_hop(hops.data() + ii * poolsize, buffer.data(), first + ii);
+   };
+
+   const auto nworkers = std::min(nthreads, nhops);
+   auto &pool = audacity::concurrency::WorkerPool::Get();
+   std::vector<std::future<void>> futures;
+   for (size_t iThread = 1; iThread < nworkers; ++iThread)
+      futures.push_back(pool.Submit([&work, iThread]{ work(iThread); }));
+   work(0);
+   for (auto &future : futures)
+      future.get();
+
+   hop_count += nhops;
+   nrendered = nhops;
+}
 
-   float ampfactor = 1.0;
-   if (rap < 1.0)
-      ampfactor = rap * 0.707;
-   else
-      ampfactor = (out_bufsize / (float)poolsize) * 4.0;
+void PaulStretch::pop()
+{
+   assert(npopped < nrendered);
+   const float *hop = hops.data() + npopped * poolsize;
 
+   //make the output buffer
    for (size_t i = 0; i < out_bufsize; i++) {
-      float a = (0.5 + 0.5 * cos(i * tmp));
-      float out = fft_smps[i + out_bufsize] * (1.0 - a) + old_out_smp_buf[i] * a;
-      out_buf[i] =
-         out * (hinv_sqrt2 - (1.0 - hinv_sqrt2) * cos(i * 2.0 * tmp)) *
-         ampfactor;
+      float a = out_fade[i];
+      float out = hop[i + out_bufsize] * (1.0 - a) + old_out_smp_buf[i] * a;
+      out_buf[i] = out * out_gain[i];
    }
 
    //copy the current output buffer to old buffer
-   for (size_t i = 0; i < out_bufsize * 2; i++)
-      old_out_smp_buf[i] = fft_smps[i];
+   std::copy(hop, hop + out_bufsize * 2, old_out_smp_buf.get());
+
+   if (++npopped == nrendered)
+      nqueued = nrendered = npopped = 0;
 }
 
 size_t PaulStretch::get_nsamples()
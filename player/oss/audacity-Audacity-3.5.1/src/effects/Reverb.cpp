@@ -16,6 +16,9 @@
 #include "Reverb.h"
 #include "EffectEditor.h"
 #include "LoadEffects.h"
+#include "concurrency/WorkerPool.h"
+
+#include <future>
 
 #include <wx/arrstr.h>
 #include <wx/checkbox.h>
@@ -267,7 +270,8 @@ struct EffectReverb::Instance
 
       if (group >= mSlaves.size())
          return 0;
-      return InstanceProcess(settings, mSlaves[group].mState, inbuf, outbuf, numSamples);
+      return InstanceProcess(settings, mSlaves[group].mState, inbuf, outbuf, numSamples,
+         /* parallel = */ false);
    }
 
 
@@ -298,8 +302,10 @@ struct EffectReverb::Instance
    bool InstanceInit(EffectSettings& settings, double sampleRate,
       EffectReverbState& data, ChannelNames chanMap, bool forceStereo);
 
+   //! @param parallel whether stereo channels may be processed in two threads
    size_t InstanceProcess(EffectSettings& settings, EffectReverbState& data,
-      const float* const* inBlock, float* const* outBlock, size_t blockLen);
+      const float* const* inBlock, float* const* outBlock, size_t blockLen,
+      bool parallel);
 
    EffectReverbState mState;
    std::vector<EffectReverb::Instance> mSlaves;
@@ -358,6 +364,8 @@ auto EffectReverb::RealtimeSupport() const -> RealtimeSince
 }
 
 static size_t BLOCK = 16384;
+// Shortest run of samples for which channels are processed in parallel
+static constexpr size_t MinParallelLen = 4096;
 
 bool EffectReverb::Instance::ProcessInitialize(EffectSettings& settings,
    double sampleRate, ChannelNames chanMap)
@@ -415,11 +423,13 @@ bool EffectReverb::Instance::ProcessFinalize() noexcept
 size_t EffectReverb::Instance::ProcessBlock(EffectSettings& settings,
    const float* const* inBlock, float* const* outBlock, size_t blockLen)
 {
-   return InstanceProcess(settings, mState, inBlock, outBlock, blockLen);
+   return InstanceProcess(settings, mState, inBlock, outBlock, blockLen,
+      /* parallel = */ true);
 }
 
 size_t EffectReverb::Instance::InstanceProcess(EffectSettings& settings, EffectReverbState& state,
-   const float* const* inBlock, float* const* outBlock, size_t blockLen)
+   const float* const* inBlock, float* const* outBlock, size_t blockLen,
+   bool parallel)
 {
    auto& rs = GetSettings(settings);
 
@@ -439,13 +449,26 @@ size_t EffectReverb::Instance::InstanceProcess(EffectSettings& settings, EffectR
    while (remaining)
    {
       auto len = std::min(remaining, decltype(remaining)(BLOCK));
-      for (unsigned int c = 0; c < state.mNumChans; c++)
+      auto process = [&](unsigned int c)
       {
          // Write the input samples to the reverb fifo.  Returned value is the address of the
          // fifo buffer which contains a copy of the input samples.
          state.mP[c].dry = (float *) fifo_write(&state.mP[c].reverb.input_fifo, len, ichans[c]);
          reverb_process(&state.mP[c].reverb, len);
+      };
+      // The channels are independent until mixed below.  Handing one to the
+      // worker pool is worth it for the large blocks of offline processing,
+      // not for realtime.
+      if (parallel && state.mNumChans == 2 && len >= MinParallelLen)
+      {
+         auto future = audacity::concurrency::WorkerPool::Get().Submit(
+            [&]{ process(1); });
+         process(0);
+         future.get();
       }
+      else
+         for (unsigned int c = 0; c < state.mNumChans; c++)
+            process(c);
 
       if (state.mNumChans == 2)
       {
@@ -13,6 +13,7 @@ effect that uses SBSMS to do its processing (TimeScale)
 #if USE_SBSMS
 #include "SBSMSEffect.h"
 #include "EffectOutputTracks.h"
+#include "SegmentedStretch.h"
 
 #include <math.h>
 
@@ -25,7 +26,8 @@ effect that uses SBSMS to do its processing (TimeScale)
 #include <cassert>
 
 enum {
-  SBSMSOutBlockSize = 512
+  SBSMSOutBlockSize = 512,
+  SBSMSSegmentBlockSize = 8192
 };
 
 class ResampleBuf
@@ -50,8 +52,11 @@ public:
    sampleCount end;
    ArrayOf<float> leftBuffer;
    ArrayOf<float> rightBuffer;
-   WaveChannel *leftTrack;
-   WaveChannel *rightTrack;
+   WaveChannel *leftTrack{};
+   WaveChannel *rightTrack{};
+   // If not null, read interleaved samples from here instead of the tracks
+   const float *input{};
+   size_t nInputChannels{};
    std::unique_ptr<SBSMS> sbsms;
    std::unique_ptr<SBSMSInterface> iface;
    ArrayOf<audio> SBSMSBuf;
@@ -91,32 +96,46 @@ long resampleCB(void *cb_data, SBSMSFrame *data)
 {
    ResampleBuf *r = (ResampleBuf*) cb_data;
 
-   auto blockSize = limitSampleBufferSize(
-      r->leftTrack->GetBestBlockSize(r->offset),
-      r->end - r->offset
-   );
-
-   // Get the samples from the tracks and put them in the buffers.
-   // I don't know if we can safely propagate errors through sbsms, and it
-   // does not seem to let us report error codes, so use this roundabout to
-   // stop the effect early.
-   try {
-      r->leftTrack->GetFloats(
-         (r->leftBuffer.get()), r->offset, blockSize);
-      r->rightTrack->GetFloats(
-         (r->rightBuffer.get()), r->offset, blockSize);
-   }
-   catch ( ... ) {
-      // Save the exception object for re-throw when out of the library
-      r->mpException = std::current_exception();
-      data->size = 0;
-      return 0;
+   size_t blockSize;
+   if (r->input) {
+      blockSize = limitSampleBufferSize(r->blockSize, r->end - r->offset);
+      const auto nChannels = r->nInputChannels;
+      const auto input = r->input + r->offset.as_size_t() * nChannels;
+
+      // convert to sbsms audio format
+      for(decltype(blockSize) i=0; i<blockSize; i++) {
+         r->buf[i][0] = input[i * nChannels];
+         r->buf[i][1] = input[i * nChannels + nChannels - 1];
+      }
    }
+   else {
+      blockSize = limitSampleBufferSize(
+         r->leftTrack->GetBestBlockSize(r->offset),
+         r->end - r->offset
+      );
+
+      // Get the samples from the tracks and put them in the buffers.
+      // I don't know if we can safely propagate errors through sbsms, and it
+      // does not seem to let us report error codes, so use this roundabout to
+      // stop the effect early.
+      try {
+         r->leftTrack->GetFloats(
+            (r->leftBuffer.get()), r->offset, blockSize);
+         r->rightTrack->GetFloats(
+            (r->rightBuffer.get()), r->offset, blockSize);
+      }
+      catch ( ... ) {
+         // Save the exception object for re-throw when out of the library
+         r->mpException = std::current_exception();
+         data->size = 0;
+         return 0;
+      }
 
-   // convert to sbsms audio format
-   for(decltype(blockSize) i=0; i<blockSize; i++) {
-      r->buf[i][0] = r->leftBuffer[i];
-      r->buf[i][1] = r->rightBuffer[i];
+      // convert to sbsms audio format
+      for(decltype(blockSize) i=0; i<blockSize; i++) {
+         r->buf[i][0] = r->leftBuffer[i];
+         r->buf[i][1] = r->rightBuffer[i];
+      }
    }
 
    data->buf = r->buf.get();
@@ -268,6 +287,31 @@ bool EffectSBSMS::Process(EffectInstance &, EffectSettings &)
             const float srTrack = track.GetRate();
             const float srProcess = bLinkRatePitch ? srTrack : 44100.0;
 
+            // Long selections at constant rate and pitch are divided among
+            // several instances
+            const bool constant = !bLinkRatePitch &&
+               (rateStart == rateEnd || rateSlideType == SlideConstant) &&
+               (pitchStart == pitchEnd || pitchSlideType == SlideConstant);
+            if (constant &&
+                SegmentedStretch::Worthwhile(end - start, srTrack)) {
+               const double duration = (mT1 - mT0) * mTotalStretch;
+               if (duration > maxDuration)
+                  maxDuration = duration;
+               const auto warper = createTimeWarper(
+                  mT0, mT1, maxDuration, rateStart, rateEnd, rateSlideType);
+
+               std::shared_ptr<TrackList> tempList = track.WideEmptyCopy();
+               const auto outputTrack = *tempList->Any<WaveTrack>().begin();
+               if (!ProcessSegmented(track, *outputTrack, start, end)) {
+                  bGoodResult = false;
+                  return;
+               }
+               outputTrack->Flush();
+               Finalize(track, *outputTrack, *warper);
+               mCurTrackNum++;
+               return;
+            }
+
             // the resampler needs a callback to supply its samples
             ResampleBuf rb;
             const auto maxBlockSize = track.GetMaxBlockSize();
@@ -427,6 +471,136 @@ bool EffectSBSMS::Process(EffectInstance &, EffectSettings &)
    return bGoodResult;
 }
 
+bool EffectSBSMS::ProcessSegmented(WaveTrack &track, WaveTrack &outputTrack,
+   sampleCount start, sampleCount end)
+{
+   // TODO: more-than-two-channels
+   auto channels = track.Channels();
+   const size_t nChannels = std::min<size_t>(2, channels.size());
+   const auto leftTrack = (*channels.first).get();
+   const auto rightTrack =
+      (nChannels > 1) ? (* ++channels.first).get() : leftTrack;
+
+   auto iter = outputTrack.Channels().begin();
+   const auto outputLeftChannel = (*iter++).get();
+   const auto outputRightChannel =
+      (nChannels > 1) ? (*iter).get() : outputLeftChannel;
+
+   const float srTrack = track.GetRate();
+   const float srProcess = 44100.0;
+   const auto slideType =
+      (srProcess == srTrack ? SlideIdentity : SlideConstant);
+
+   const auto reader = [&](float *buffer, sampleCount offset, size_t frames) {
+      Floats leftBuffer{ frames };
+      Floats rightBuffer{ nChannels > 1 ? frames : 0 };
+      leftTrack->GetFloats(leftBuffer.get(), start + offset, frames);
+      if (nChannels > 1) {
+         rightTrack->GetFloats(rightBuffer.get(), start + offset, frames);
+         for (size_t i = 0; i < frames; ++i) {
+            buffer[i * 2] = leftBuffer[i];
+            buffer[i * 2 + 1] = rightBuffer[i];
+         }
+      }
+      else
+         std::copy(leftBuffer.get(), leftBuffer.get() + frames, buffer);
+   };
+
+   // Called in worker threads; as in Process(), but reading from memory
+   const auto stretcher = [&](const float *input, size_t frames,
+      const SegmentedStretch::Consumed &consumed)
+   {
+      ResampleBuf rb;
+      rb.blockSize = SBSMSSegmentBlockSize;
+      rb.buf.reinit(rb.blockSize, true);
+      rb.input = input;
+      rb.nInputChannels = nChannels;
+      rb.offset = 0;
+      rb.end = frames;
+      rb.bPitch = false;
+      rb.ratio = srProcess/srTrack;
+      rb.quality = std::make_unique<SBSMSQuality>(&SBSMSQualityStandard);
+      rb.resampler = std::make_unique<Resampler>(resampleCB, &rb, slideType);
+      rb.sbsms = std::make_unique<SBSMS>(nChannels, rb.quality.get(), true);
+      rb.SBSMSBlockSize = rb.sbsms->getInputFrameSize();
+      rb.SBSMSBuf.reinit(static_cast<size_t>(rb.SBSMSBlockSize), true);
+
+      Slide rateSlide(rateSlideType, rateStart, rateEnd);
+      Slide pitchSlide(pitchSlideType, pitchStart, pitchEnd);
+      const auto samplesToProcess = static_cast<sampleCount>(
+         sampleCount{ frames }.as_float() * (srProcess/srTrack));
+      rb.iface = std::make_unique<SBSMSEffectInterface>(
+         rb.resampler.get(), &rateSlide, &pitchSlide,
+         bPitchReferenceInput,
+         static_cast<_sbsms_::SampleCountType>(
+            samplesToProcess.as_long_long()),
+         0,
+         rb.quality.get());
+
+      Resampler resampler(postResampleCB, &rb, slideType);
+
+      const sampleCount samplesToOutput = rb.iface->getSamplesToOutput();
+      const auto samplesOut = static_cast<sampleCount>(
+         samplesToOutput.as_float() * (srTrack / srProcess));
+
+      std::vector<float> output;
+      output.reserve(samplesOut.as_size_t() * nChannels);
+      audio outBuf[SBSMSOutBlockSize];
+      long pos = 0;
+      long outputCount = -1;
+      sampleCount reported = 0;
+      while (pos < samplesOut && outputCount) {
+         const auto count =
+            limitSampleBufferSize(SBSMSOutBlockSize, samplesOut - pos);
+         outputCount = resampler.read(outBuf, count);
+         for (int i = 0; i < outputCount; ++i)
+            for (size_t iChannel = 0; iChannel < nChannels; ++iChannel)
+               output.push_back(outBuf[i][iChannel]);
+         pos += outputCount;
+
+         if (!consumed((rb.offset - reported).as_size_t()))
+            return std::vector<float>{};
+         reported = rb.offset;
+      }
+      return output;
+   };
+
+   const auto writer = [&](const float *buffer, size_t frames) {
+      if (nChannels == 1) {
+         outputLeftChannel->Append((constSamplePtr)buffer, floatSample, frames);
+         return;
+      }
+      Floats leftBuffer{ frames };
+      Floats rightBuffer{ frames };
+      for (size_t i = 0; i < frames; ++i) {
+         leftBuffer[i] = buffer[i * 2];
+         rightBuffer[i] = buffer[i * 2 + 1];
+      }
+      outputLeftChannel->Append(
+         (samplePtr)leftBuffer.get(), floatSample, frames);
+      outputRightChannel->Append(
+         (samplePtr)rightBuffer.get(), floatSample, frames);
+   };
+
+   const auto progress = [&](double frac) {
+      int nWhichTrack = mCurTrackNum;
+      if (nChannels > 1) {
+         nWhichTrack = 2 * (mCurTrackNum / 2);
+         // Show twice as far for each track,
+         // because we're doing 2 at once.
+         frac *= 2.0;
+         if (frac >= 1.0) {
+            nWhichTrack++;
+            frac -= 1.0;
+         }
+      }
+      return TrackProgress(nWhichTrack, frac);
+   };
+
+   SegmentedStretch segmented{ nChannels, srTrack, mTotalStretch };
+   return segmented.Process(end - start, reader, stretcher, writer, progress);
+}
+
 void EffectSBSMS::Finalize(
    WaveTrack &orig, const WaveTrack &out, const TimeWarper &warper)
 {
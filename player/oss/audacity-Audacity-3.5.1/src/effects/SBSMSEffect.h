@@ -55,6 +55,10 @@ private:
     */
    void Finalize(
       WaveTrack &orig, const WaveTrack &out, const TimeWarper &warper);
+   //! Stretch overlapping segments of a long selection in parallel
+   /*! @pre rate and pitch are constant, and not linked */
+   bool ProcessSegmented(WaveTrack &orig, WaveTrack &out,
+      sampleCount start, sampleCount end);
 
    double rateStart, rateEnd, pitchStart, pitchEnd;
    bool bLinkRatePitch, bRateReferenceInput, bPitchReferenceInput;
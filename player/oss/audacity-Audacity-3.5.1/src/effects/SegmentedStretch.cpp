@@ -0,0 +1,224 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  SegmentedStretch.cpp
+
+*******************************************************************//**
+
+\class SegmentedStretch
+\brief Divides a selection among several instances of a time or pitch
+stretching engine, running in parallel, and splices the results
+
+*//*******************************************************************/
+#include "SegmentedStretch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <thread>
+
+namespace {
+// Nominal length of segments, and the extension of each on both sides, which
+// gives each engine time to settle before the seam
+constexpr double SegmentSeconds = 30.0;
+constexpr double OverlapSeconds = 1.0;
+
+// Length of the cross-fade at each seam, and the greatest shift of the
+// following segment to align it with the preceding one
+constexpr double FadeSeconds = 0.05;
+constexpr double MaxLagSeconds = 0.025;
+
+// How often to update progress while waiting for the workers
+constexpr auto PollInterval = std::chrono::milliseconds(50);
+
+size_t Threads()
+{
+   return std::max(1u, std::thread::hardware_concurrency());
+}
+}
+
+bool SegmentedStretch::Worthwhile(sampleCount length, double rate)
+{
+   return Threads() > 1 && length.as_double() >= 2 * SegmentSeconds * rate;
+}
+
+SegmentedStretch::SegmentedStretch(size_t nChannels, double rate, double ratio)
+   : mnChannels{ nChannels }
+   , mRate{ rate }
+   , mRatio{ ratio }
+{
+}
+
+bool SegmentedStretch::Process(sampleCount length, const Reader &reader,
+   const Stretcher &stretcher, const Writer &writer, const Progress &progress)
+{
+   const auto nThreads = static_cast<long long>(Threads());
+   const auto nSegments = std::max<long long>(2,
+      static_cast<long long>(length.as_double() / (SegmentSeconds * mRate)));
+   const auto overlap = sampleCount(OverlapSeconds * mRate);
+   const auto bound = [&](long long iSegment) {
+      return length * iSegment / nSegments;
+   };
+
+   // Count the overlaps too, for progress
+   const auto total = (length + overlap * 2 * (nSegments - 1)).as_double();
+   std::atomic<long long> consumed{ 0 };
+   std::atomic<bool> stopped{ false };
+
+   struct Segment {
+      std::vector<float> input;
+      //! Positions in the output corresponding to the nominal bounds
+      size_t head;
+      size_t tail;
+      std::future<std::vector<float>> result;
+   };
+
+   mPrevious.clear();
+   mPreviousFrom = mPreviousSeam = 0;
+
+   // Process as many segments at once as there are threads, so that only
+   // that many are held in memory
+   for (long long first = 0; first < nSegments; first += nThreads) {
+      const auto last = std::min(nSegments, first + nThreads);
+      std::vector<Segment> segments(last - first);
+      for (auto iSegment = first; iSegment < last; ++iSegment) {
+         auto &segment = segments[iSegment - first];
+         const auto start = bound(iSegment);
+         const auto end = bound(iSegment + 1);
+         const auto inStart = (iSegment == 0)
+            ? start : std::max<sampleCount>(0, start - overlap);
+         const auto inEnd = (iSegment == nSegments - 1)
+            ? end : std::min(length, end + overlap);
+         const auto frames = (inEnd - inStart).as_size_t();
+
+         segment.input.resize(frames * mnChannels);
+         reader(segment.input.data(), inStart, frames);
+         segment.head = std::lround((start - inStart).as_double() * mRatio);
+         segment.tail = std::lround((end - inStart).as_double() * mRatio);
+
+         // Start each worker as soon as its input is ready
+         segment.result = std::async(std::launch::async,
+            [&stretcher, &consumed, &stopped,
+               input = segment.input.data(), frames
+            ]{
+               const Consumed report = [&](size_t count){
+                  consumed.fetch_add(count, std::memory_order_relaxed);
+                  return !stopped.load(std::memory_order_relaxed);
+               };
+               return stretcher(input, frames, report);
+            });
+      }
+
+      for (auto &segment : segments)
+         while (segment.result.wait_for(PollInterval) !=
+            std::future_status::ready) {
+            if (!stopped.load(std::memory_order_relaxed) && progress(
+               consumed.load(std::memory_order_relaxed) / total))
+               stopped.store(true, std::memory_order_relaxed);
+         }
+
+      // All workers are finished; get() may rethrow
+      for (auto iSegment = first; iSegment < last; ++iSegment) {
+         auto &segment = segments[iSegment - first];
+         auto output = segment.result.get();
+         if (stopped.load(std::memory_order_relaxed) || output.empty())
+            return false;
+         segment.input = {};
+
+         const auto from = (iSegment == 0)
+            ? 0 : Splice(output, segment.head, writer);
+         mPrevious = std::move(output);
+         mPreviousFrom = from;
+         mPreviousSeam = segment.tail;
+      }
+
+      if (progress(consumed.load(std::memory_order_relaxed) / total))
+         return false;
+   }
+
+   // The last segment is written to its end
+   const auto frames = mPrevious.size() / mnChannels;
+   if (frames > mPreviousFrom)
+      writer(mPrevious.data() + mPreviousFrom * mnChannels,
+         frames - mPreviousFrom);
+   mPrevious = {};
+   return true;
+}
+
+size_t SegmentedStretch::Splice(
+   const std::vector<float> &next, size_t nextSeam, const Writer &writer)
+{
+   const auto nChannels = mnChannels;
+   const auto &previous = mPrevious;
+   const auto previousFrames = previous.size() / nChannels;
+   const auto nextFrames = next.size() / nChannels;
+
+   // In case an engine made less output than expected
+   const auto previousSeam =
+      std::clamp(mPreviousSeam, mPreviousFrom, previousFrames);
+   nextSeam = std::min(nextSeam, nextFrames);
+
+   // Center the fade on the seam, shortening it and the search for alignment
+   // as needed to stay within both outputs
+   auto half = static_cast<size_t>(FadeSeconds * mRate / 2);
+   half = std::min({ half, previousSeam - mPreviousFrom,
+      previousFrames - previousSeam, nextSeam, nextFrames - nextSeam });
+   auto maxLag = static_cast<size_t>(MaxLagSeconds * mRate);
+   maxLag = std::min({ maxLag, nextSeam - half, nextFrames - nextSeam - half });
+   const auto fade = 2 * half;
+   const auto samples = fade * nChannels;
+
+   const float *const fadingOut =
+      previous.data() + (previousSeam - half) * nChannels;
+   const float *const fadingIn = next.data() + (nextSeam - half) * nChannels;
+
+   // Choose the shift of the following segment that best correlates it with
+   // the preceding one, preferring no shift
+   const auto score = [&](long lag) {
+      const auto shifted = fadingIn + lag * static_cast<long>(nChannels);
+      double product = 0, energy = 0;
+      for (size_t i = 0; i < samples; ++i) {
+         product += fadingOut[i] * shifted[i];
+         energy += shifted[i] * shifted[i];
+      }
+      return energy > 0 ? product / std::sqrt(energy) : 0.0;
+   };
+   long bestLag = 0;
+   if (samples > 0) {
+      auto bestScore = score(0);
+      for (long lag = -static_cast<long>(maxLag);
+         lag <= static_cast<long>(maxLag); ++lag) {
+         if (lag == 0)
+            continue;
+         const auto value = score(lag);
+         if (value > bestScore) {
+            bestScore = value;
+            bestLag = lag;
+         }
+      }
+   }
+
+   // Write the preceding segment up to the fade
+   if (previousSeam - half > mPreviousFrom)
+      writer(previous.data() + mPreviousFrom * nChannels,
+         previousSeam - half - mPreviousFrom);
+
+   // Raised cosine cross-fade
+   if (fade > 0) {
+      const auto shifted = fadingIn + bestLag * static_cast<long>(nChannels);
+      std::vector<float> faded(samples);
+      for (size_t i = 0; i < fade; ++i) {
+         const float weight = 0.5 - 0.5 * std::cos(M_PI * (i + 0.5) / fade);
+         for (size_t iChannel = 0; iChannel < nChannels; ++iChannel) {
+            const auto j = i * nChannels + iChannel;
+            faded[j] = fadingOut[j] + weight * (shifted[j] - fadingOut[j]);
+         }
+      }
+      writer(faded.data(), fade);
+   }
+
+   return nextSeam - half + bestLag + fade;
+}
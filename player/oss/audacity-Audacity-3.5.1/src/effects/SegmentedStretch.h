@@ -0,0 +1,85 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  SegmentedStretch.h
+
+  Common code for time and pitch stretching effects that process
+  long selections in independent segments (SoundTouch and SBSMS)
+
+**********************************************************************/
+
+#ifndef __AUDACITY_SEGMENTED_STRETCH__
+#define __AUDACITY_SEGMENTED_STRETCH__
+
+#include "SampleCount.h"
+
+#include <functional>
+#include <vector>
+
+//! Runs a stretching engine on overlapping segments in worker threads
+/*!
+ The selection is divided into segments, each extended by an overlap on both
+ sides, and each given to an independent engine instance.  Consecutive
+ results are aligned where they meet, by cross-correlation, to absorb the
+ small timing jitter of the engines, and cross-faded.
+
+ The ratio of output to input length must be constant over the selection.
+
+ Reading, writing, and progress happen in the calling thread only.
+ */
+class SegmentedStretch final
+{
+public:
+   //! Report input frames consumed; returns false if the engine should stop
+   using Consumed = std::function<bool(size_t frames)>;
+
+   //! Stretch interleaved input; called in a worker thread
+   /*! @return interleaved output, all that the engine makes after flushing,
+    or empty if stopped */
+   using Stretcher = std::function<std::vector<float>(
+      const float *input, size_t frames, const Consumed &consumed)>;
+
+   //! Fill interleaved frames, from the given offset into the selection
+   using Reader =
+      std::function<void(float *buffer, sampleCount offset, size_t frames)>;
+
+   //! Take interleaved output frames
+   using Writer = std::function<void(const float *buffer, size_t frames)>;
+
+   //! Receives the fraction done; returns true to cancel
+   using Progress = std::function<bool(double fraction)>;
+
+   //! Whether dividing a selection of this many samples is worthwhile
+   static bool Worthwhile(sampleCount length, double rate);
+
+   /*!
+    @param rate sample rate of input and output
+    @param ratio output frames per input frame
+    */
+   SegmentedStretch(size_t nChannels, double rate, double ratio);
+
+   //! @return false if cancelled or stopped
+   bool Process(sampleCount length, const Reader &reader,
+      const Stretcher &stretcher, const Writer &writer,
+      const Progress &progress);
+
+private:
+   //! Write from mPrevious, then cross-fade to next, where the nominal
+   //! positions of the segment boundary are mPreviousSeam and nextSeam
+   /*! @return first frame of next not yet written */
+   size_t Splice(
+      const std::vector<float> &next, size_t nextSeam, const Writer &writer);
+
+   const size_t mnChannels;
+   const double mRate;
+   const double mRatio;
+
+   //! Output of the segment before the one being spliced, and how far it was
+   //! written, and where its nominal end is
+   std::vector<float> mPrevious;
+   size_t mPreviousFrom{};
+   size_t mPreviousSeam{};
+};
+
+#endif
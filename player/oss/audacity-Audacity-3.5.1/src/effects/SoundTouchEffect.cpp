@@ -17,6 +17,7 @@ effect that uses SoundTouch to do its processing (ChangeTempo
 #if USE_SOUNDTOUCH
 #include "SoundTouchEffect.h"
 #include "EffectOutputTracks.h"
+#include "SegmentedStretch.h"
 
 #include <math.h>
 
@@ -128,7 +129,14 @@ bool EffectSoundTouch::ProcessWithTimeWarper(InitFunction initer,
 
             // TODO: more-than-two-channels
             auto channels = orig.Channels();
-            if (channels.size() > 1) {
+            if (SegmentedStretch::Worthwhile(end - start, orig.GetRate())) {
+               // Long selection; divide it among several instances
+               if (!ProcessSegmented(initer, orig, out, start, end, warper))
+                  bGoodResult = false;
+               if (channels.size() > 1)
+                  mCurTrackNum++; // Increment for rightTrack, too.
+            }
+            else if (channels.size() > 1) {
 
                //Inform soundtouch there's 2 channels
                pSoundTouch->setChannels(2);
@@ -365,6 +373,124 @@ bool EffectSoundTouch::ProcessStereoResults(soundtouch::SoundTouch *pSoundTouch,
    return true;
 }
 
+//ProcessSegmented() processes overlapping segments of a long selection in
+//parallel, each with its own SoundTouch, and splices the results
+bool EffectSoundTouch::ProcessSegmented(const InitFunction &initer,
+   WaveTrack &orig, WaveTrack &out,
+   sampleCount start, sampleCount end, const TimeWarper &warper)
+{
+   // TODO: more-than-two-channels
+   auto channels = orig.Channels();
+   const size_t nChannels = std::min<size_t>(2, channels.size());
+   auto &leftTrack = **channels.first;
+   auto &rightTrack = (nChannels > 1) ? **++channels.first : leftTrack;
+
+   auto newChannels = out.Channels();
+   auto &outputLeftTrack = **newChannels.first;
+   auto &outputRightTrack =
+      (nChannels > 1) ? **++newChannels.first : outputLeftTrack;
+
+   const auto rate = orig.GetRate();
+   const auto sampleRate = static_cast<unsigned int>(rate + 0.5);
+
+   // The output is longer or shorter in the same proportion throughout
+   const double ratio = (warper.Warp(mT1) - warper.Warp(mT0)) / (mT1 - mT0);
+
+   const auto reader = [&](float *buffer, sampleCount offset, size_t frames) {
+      Floats leftBuffer{ frames };
+      Floats rightBuffer{ nChannels > 1 ? frames : 0 };
+      leftTrack.GetFloats(leftBuffer.get(), start + offset, frames);
+      if (nChannels > 1) {
+         rightTrack.GetFloats(rightBuffer.get(), start + offset, frames);
+         // Interleave for SoundTouch
+         for (size_t index = 0; index < frames; index++) {
+            buffer[index * 2] = leftBuffer[index];
+            buffer[(index * 2) + 1] = rightBuffer[index];
+         }
+      }
+      else
+         std::copy(leftBuffer.get(), leftBuffer.get() + frames, buffer);
+   };
+
+   // Called in worker threads
+   const auto stretcher = [&](const float *input, size_t frames,
+      const SegmentedStretch::Consumed &consumed)
+   {
+      soundtouch::SoundTouch soundTouch;
+      initer(&soundTouch);
+      soundTouch.setChannels(nChannels);
+      soundTouch.setSampleRate(sampleRate);
+
+      std::vector<float> output;
+      const auto receive = [&]{
+         if (const auto count = soundTouch.numSamples()) {
+            const auto size = output.size();
+            output.resize(size + count * nChannels);
+            soundTouch.receiveSamples(output.data() + size, count);
+         }
+      };
+
+      for (size_t pos = 0; pos < frames;) {
+         const auto block = std::min<size_t>(8192, frames - pos);
+         soundTouch.putSamples(input + pos * nChannels, block);
+         receive();
+         pos += block;
+         if (!consumed(block))
+            return std::vector<float>{};
+      }
+
+      // Tell SoundTouch to finish processing any remaining samples
+      soundTouch.flush();
+      receive();
+      return output;
+   };
+
+   const auto writer = [&](const float *buffer, size_t frames) {
+      if (nChannels == 1) {
+         outputLeftTrack.Append((constSamplePtr)buffer, floatSample, frames);
+         return;
+      }
+      // Dis-interleave into separate track buffers.
+      Floats outputLeftBuffer{ frames };
+      Floats outputRightBuffer{ frames };
+      for (size_t index = 0; index < frames; ++index) {
+         outputLeftBuffer[index] = buffer[index * 2];
+         outputRightBuffer[index] = buffer[(index * 2) + 1];
+      }
+      outputLeftTrack.Append(
+         (samplePtr)outputLeftBuffer.get(), floatSample, frames);
+      outputRightTrack.Append(
+         (samplePtr)outputRightBuffer.get(), floatSample, frames);
+   };
+
+   const auto progress = [&](double frac) {
+      // mCurTrackNum is left track. Include right track.
+      int nWhichTrack = mCurTrackNum;
+      if (nChannels > 1) {
+         frac *= 2.0; // Show twice as far for each track, because we're doing 2 at once.
+         if (frac >= 1.0) {
+            nWhichTrack++;
+            frac -= 1.0;
+         }
+      }
+      return TrackProgress(nWhichTrack, frac);
+   };
+
+   SegmentedStretch segmented{ nChannels, rate, ratio };
+   if (!segmented.Process(end - start, reader, stretcher, writer, progress))
+      return false;
+   out.Flush();
+
+   // Transfer output samples to the original
+   Finalize(orig, out, warper);
+
+   // Track the longest result length
+   double newLength = out.GetEndTime();
+   m_maxNewLength = std::max(m_maxNewLength, newLength);
+
+   return true;
+}
+
 void EffectSoundTouch::Finalize(
    WaveTrack &orig, WaveTrack &out, const TimeWarper &warper)
 {
@@ -68,6 +68,10 @@ private:
       const size_t outputCount,
       WaveChannel &outputLeftTrack,
       WaveChannel &outputRightTrack);
+   bool ProcessSegmented(const InitFunction &initer,
+      WaveTrack &orig, WaveTrack &out,
+      sampleCount start, sampleCount end,
+      const TimeWarper &warper);
    /*!
     @pre `orig.IsLeader()`
     @pre `out.IsLeader()`
@@ -21,10 +21,15 @@
 #include "LoadEffects.h"
 
 #include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <future>
 #include <list>
 #include <limits>
 #include <math.h>
 
+#include "concurrency/WorkerPool.h"
+
 #include <wx/checkbox.h>
 #include <wx/choice.h>
 #include <wx/valgen.h>
@@ -213,18 +218,14 @@ double EffectTruncSilence::CalcPreviewInputLength(
    // Start with the whole selection silent
    silences.push_back(Region(mT0, mT1));
 
-   int whichTrack = 0;
-
    for (auto wt : inputTracks()->Selected<const WaveTrack>()) {
       RegionList trackSilences;
 
       auto index = wt->TimeToLongSamples(mT0);
       sampleCount silentFrame = 0; // length of the current silence
 
-      Analyze(silences, trackSilences, *wt, &silentFrame, &index, whichTrack,
-         &inputLength, &minInputLength);
-
-      whichTrack += wt->NChannels();
+      Analyze(silences, trackSilences, *wt, &silentFrame, &index,
+         wt->TimeToLongSamples(mT1), {}, &inputLength, &minInputLength);
    }
    return inputLength;
 }
@@ -337,43 +338,124 @@ bool EffectTruncSilence::FindSilences(RegionList &silences,
    // Start with the whole selection silent
    silences.push_back(Region(mT0, mT1));
 
-   // Remove non-silent regions in each track
-   int whichTrack = 0;
-   for (auto wt : range) {
+   // Each track is scanned only where all previous tracks are silent, so
+   // the tracks are done in turn.  A track is divided into segments, scanned
+   // concurrently, whose results are joined afterwards
+   const std::vector<const WaveTrack*> tracks{ range.begin(), range.end() };
+   const auto nTracks = tracks.size();
+   auto &pool = audacity::concurrency::WorkerPool::Get();
+
+   for (size_t iTrack = 0; iTrack < nTracks; ++iTrack) {
+      const auto wt = tracks[iTrack];
       assert(wt->IsLeader());
+
       // Smallest silent region to detect in frames
       auto minSilenceFrames =
          sampleCount(std::max(mInitialAllowedSilence, DEF_MinTruncMs)
             * wt->GetRate());
 
-      //
-      // Scan the track for silences
-      //
-      RegionList trackSilences;
-
-      auto index = wt->TimeToLongSamples(mT0);
-      sampleCount silentFrame = 0;
+      // A whole number of blocks, so that each segment begins where a
+      // serial scan would begin a block; independent of the number of
+      // threads, so that results are too
+      const sampleCount segmentLen = 16 * wt->GetMaxBlockSize();
+      const auto start = wt->TimeToLongSamples(mT0);
+      const auto end = wt->TimeToLongSamples(mT1);
+      const auto nSegments = std::max<size_t>(1,
+         ((end - start + segmentLen - 1) / segmentLen).as_size_t());
+
+      struct Segment {
+         sampleCount start, end;
+         RegionList silences;
+         //! Silence running to the end of the segment, including the seed
+         sampleCount silentFrame;
+         NonInterfering<std::atomic<double>> fraction{ 0.0 };
+      };
+      std::vector<Segment> segments(nSegments);
+      std::atomic<bool> cancelled{ false };
+      std::vector<std::future<void>> futures;
+      for (size_t iSegment = 0; iSegment < nSegments; ++iSegment) {
+         auto &segment = segments[iSegment];
+         segment.start = start + segmentLen * iSegment;
+         segment.end = std::min(end, segment.start + segmentLen);
+         // Except for the first segment, pretend that a silence long enough
+         // to count precedes it, so that the silence leading the segment is
+         // always recorded and can be joined to the one before
+         segment.silentFrame = iSegment > 0 ? minSilenceFrames : 0;
+         futures.push_back(pool.Submit([this, wt, &silences, &cancelled,
+            &segment]{
+            auto index = segment.start;
+            const auto progress = [&](double fraction){
+               segment.fraction.store(fraction, std::memory_order_relaxed);
+               return !cancelled.load(std::memory_order_relaxed);
+            };
+            if (Analyze(silences, segment.silences, *wt,
+                  &segment.silentFrame, &index, segment.end, progress))
+               segment.fraction.store(1.0, std::memory_order_relaxed);
+            else
+               cancelled.store(true, std::memory_order_relaxed);
+         }));
+      }
 
-      // Detect silences
-      bool cancelled = !(Analyze(
-         silences, trackSilences, *wt, &silentFrame, &index, whichTrack));
+      // Show progress dialog, test for cancellation, in this thread only
+      using namespace std::chrono_literals;
+      for (auto &future : futures)
+         while (future.wait_for(50ms) != std::future_status::ready) {
+            double done = 0;
+            for (auto &segment : segments)
+               done += segment.fraction.load(std::memory_order_relaxed) *
+                  (segment.end - segment.start).as_double();
+            if (TotalProgress(detectFrac * (iTrack +
+                  done / std::max(1.0, (end - start).as_double())) /
+                  GetNumWaveTracks()))
+               cancelled.store(true, std::memory_order_relaxed);
+         }
+      // Rethrow any exception from reading of samples
+      for (auto &future : futures)
+         future.get();
 
-      // Buffer has been freed, so we're OK to return if cancelled
-      if (cancelled)
+      if (cancelled.load())
          return false;
 
+      // Join the segments
+      RegionList trackSilences;
+      sampleCount silentFrame = 0; // silence running into the next segment
+      for (size_t iSegment = 0; iSegment < nSegments; ++iSegment) {
+         auto &segment = segments[iSegment];
+         auto &regions = segment.silences;
+         if (iSegment == 0) {
+            trackSilences.splice(trackSilences.end(), regions);
+            silentFrame = segment.silentFrame;
+            continue;
+         }
+         if (regions.empty()) {
+            // Silent throughout
+            silentFrame += segment.end - segment.start;
+            continue;
+         }
+         // The first region begins with the seed; replace that with the
+         // real silence before the segment
+         const auto leadEnd = regions.front().end;
+         regions.pop_front();
+         const auto lead =
+            wt->TimeToLongSamples(leadEnd) - segment.start;
+         if (silentFrame + lead >= minSilenceFrames)
+            trackSilences.push_back(Region(
+               wt->LongSamplesToTime(segment.start - silentFrame), leadEnd));
+         trackSilences.splice(trackSilences.end(), regions);
+         silentFrame = segment.silentFrame;
+      }
+
       if (silentFrame >= minSilenceFrames)
       {
          // Track ended in silence -- record region
          trackSilences.push_back(Region(
-            wt->LongSamplesToTime(index - silentFrame),
-            wt->LongSamplesToTime(index)
+            wt->LongSamplesToTime(end - silentFrame),
+            wt->LongSamplesToTime(end)
          ));
       }
 
       // Intersect with the overall silent region list
       Intersect(silences, trackSilences);
-      whichTrack++;
    }
 
    return true;
@@ -515,10 +597,62 @@ bool EffectTruncSilence::DoRemoval(const RegionList &silences,
    return true;
 }
 
-bool EffectTruncSilence::Analyze(RegionList& silenceList,
+namespace {
+//! Length of the run of samples from `first`, below the threshold in all
+//! channels
+/*!
+ Tests groups of samples at once, with a loop over channels and samples that
+ vectorizes, and only then finds the exact end of the run
+ */
+size_t SilentRun(const Floats *buffers, size_t nChannels,
+   size_t first, size_t count, float threshold)
+{
+   constexpr size_t groupSize = 16;
+   auto i = first;
+   while (i + groupSize <= count) {
+      float peak = 0;
+      for (size_t iChannel = 0; iChannel < nChannels; ++iChannel) {
+         const auto buffer = buffers[iChannel].get() + i;
+         for (size_t j = 0; j < groupSize; ++j)
+            peak = std::max(peak, std::fabs(buffer[j]));
+      }
+      if (!(peak < threshold))
+         break;
+      i += groupSize;
+   }
+   for (; i < count; ++i) {
+      const bool silent = std::all_of(buffers, buffers + nChannels,
+      [&](const Floats &buffer){
+         return std::fabs(buffer[i]) < threshold;
+      });
+      if (!silent)
+         break;
+   }
+   return i - first;
+}
+
+//! Whether stored summaries show that all samples in the span are below the
+//! threshold, so that they need not be read
+bool SummarySilent(const WaveTrack &wt,
+   sampleCount start, size_t count, float threshold)
+{
+   // Widen by a sample on each side, in case of roundoff in the conversion
+   // of times to samples in the clips
+   const auto t0 = wt.LongSamplesToTime(start - 1);
+   const auto t1 = wt.LongSamplesToTime(start + count + 1);
+   for (const auto pChannel : wt.Channels()) {
+      const auto [min, max] = pChannel->GetMinMax(t0, t1);
+      if (!(min > -threshold && max < threshold))
+         return false;
+   }
+   return true;
+}
+}
+
+bool EffectTruncSilence::Analyze(const RegionList& silenceList,
    RegionList& trackSilences, const WaveTrack &wt, sampleCount* silentFrame,
-   sampleCount* index, int whichTrack, double* inputLength,
-   double* minInputLength) const
+   sampleCount* index, sampleCount end, const ProgressReport &progress,
+   double* inputLength, double* minInputLength) const
 {
    assert(wt.IsLeader());
    const auto rate = wt.GetRate();
@@ -527,25 +661,46 @@ bool EffectTruncSilence::Analyze(RegionList& silenceList,
    auto minSilenceFrames =
       sampleCount(std::max(mInitialAllowedSilence, DEF_MinTruncMs) * rate);
 
-   double truncDbSilenceThreshold = DB_TO_LINEAR(mThresholdDB);
+   // Compare floats with floats, but with the same results as comparison
+   // with the double: use the least float not less than it
+   const double threshold = DB_TO_LINEAR(mThresholdDB);
+   float truncDbSilenceThreshold = threshold;
+   if (truncDbSilenceThreshold < threshold)
+      truncDbSilenceThreshold = std::nextafter(
+         truncDbSilenceThreshold, std::numeric_limits<float>::infinity());
    auto blockLen = wt.GetMaxBlockSize();
-   auto start = wt.TimeToLongSamples(mT0);
-   auto end = wt.TimeToLongSamples(mT1);
+   const auto start = *index;
    sampleCount outLength = 0;
 
-   double previewLength;
-   gPrefs->Read(wxT("/AudioIO/EffectsPreviewLen"), &previewLength, 6.0);
-   // Minimum required length in samples.
-   const sampleCount previewLen(previewLength * rate);
+   // Minimum required length in samples, when previewing.
+   // Preferences are read only then, because analysis of whole tracks may
+   // happen in worker threads.
+   sampleCount previewLen = 0;
+   if (inputLength) {
+      double previewLength;
+      gPrefs->Read(wxT("/AudioIO/EffectsPreviewLen"), &previewLength, 6.0);
+      previewLen = sampleCount(previewLength * rate);
+   }
+
+   // Block minima and maxima are stored with the samples, but don't apply
+   // to clips that are stretched or pitch shifted
+   bool useSummaries = true;
+   for (const auto &pInterval : wt.Intervals())
+      if (pInterval->Start() < mT1 && pInterval->End() > mT0 &&
+          pInterval->HasPitchOrSpeed()) {
+         useSummaries = false;
+         break;
+      }
 
    // Keep position in overall silences list for optimization
-   RegionList::iterator rit(silenceList.begin());
+   auto rit = silenceList.begin();
 
    // Allocate buffers
    Floats buffers[] {
       Floats{ blockLen },
       Floats{ blockLen }
    };
+   const auto nChannels = wt.NChannels();
 
    // Loop through current track
    while (*index < end) {
@@ -559,14 +714,10 @@ bool EffectTruncSilence::Analyze(RegionList& silenceList,
          return true;
       }
 
-      if (!inputLength) {
-         // Show progress dialog, test for cancellation
-         bool cancelled = TotalProgress(
-               detectFrac * (whichTrack +
-                             (*index - start).as_double() /
-                             (end - start).as_double()) /
-                             (double)GetNumWaveTracks());
-         if (cancelled)
+      if (!inputLength && progress) {
+         // Report progress, test for cancellation
+         if (!progress((*index - start).as_double() /
+               (end - start).as_double()))
             return false;
       }
 
@@ -612,13 +763,37 @@ bool EffectTruncSilence::Analyze(RegionList& silenceList,
                : newIndex - *index;
          }
 
-         *index = newIndex;
+         *index = std::min(newIndex, end);
+         if (*index == end)
+            break;
       }
       // End of optimization
 
       // Limit size of current block if we've reached the end
       auto count = limitSampleBufferSize( blockLen, end - *index );
 
+      // The test for the end of preview depends only on outLength, which
+      // changes only at samples that are not silent
+      const auto previewDone = [&](size_t i){
+         if (inputLength && ((outLength >= previewLen) ||
+            (outLength > wt.TimeToLongSamples(*minInputLength)))
+         ) {
+            *inputLength =
+               wt.LongSamplesToTime(*index + i) - wt.LongSamplesToTime(start);
+            return true;
+         }
+         return false;
+      };
+
+      // Another optimization: a span that is wholly silent, as known
+      // without reading the samples, only lengthens the current silence
+      if (useSummaries && !previewDone(0) &&
+          SummarySilent(wt, *index, count, truncDbSilenceThreshold)) {
+         *silentFrame += count;
+         *index += count;
+         continue;
+      }
+
       // Fill buffers
       size_t iChannel = 0;
       for (const auto pChannel : wt.Channels())
@@ -626,55 +801,51 @@ bool EffectTruncSilence::Analyze(RegionList& silenceList,
 
       // Look for silenceList in current block
       for (decltype(count) i = 0; i < count; ++i) {
-         if (inputLength && ((outLength >= previewLen) ||
-            (outLength > wt.TimeToLongSamples(*minInputLength)))
-         ) {
-            *inputLength =
-               wt.LongSamplesToTime(*index + i) - wt.LongSamplesToTime(start);
+         if (previewDone(i))
             break;
-         }
 
-         const bool silent = std::all_of(buffers, buffers + iChannel,
-         [&](const Floats &buffer){
-            return fabs(buffer[i]) < truncDbSilenceThreshold;
-         });
-         if (silent)
-            (*silentFrame)++;
-         else {
-            sampleCount allowed = 0;
-            if (*silentFrame >= minSilenceFrames) {
-               if (inputLength) {
-                  switch (mActionIndex) {
-                     case kTruncate:
-                        outLength +=
-                           wt.TimeToLongSamples(mTruncLongestAllowedSilence);
-                        break;
-                     case kCompress:
-                        allowed =
-                           wt.TimeToLongSamples(mInitialAllowedSilence);
-                        outLength += sampleCount(
-                           allowed.as_double() +
-                              (*silentFrame - allowed).as_double()
-                                 * mSilenceCompressPercent / 100.0
-                        );
-                        break;
-                     // default: // Not currently used.
-                  }
-               }
+         // Skip over silent samples quickly
+         const auto run =
+            SilentRun(buffers, nChannels, i, count, truncDbSilenceThreshold);
+         *silentFrame += run;
+         i += run;
+         if (i == count)
+            break;
 
-               // Record the silent region
-               trackSilences.push_back(Region(
-                  wt.LongSamplesToTime(*index + i - *silentFrame),
-                  wt.LongSamplesToTime(*index + i)
-               ));
-            }
-            else if (inputLength) {   // included as part of non-silence
-               outLength += *silentFrame;
-            }
-            *silentFrame = 0;
+         // Sample i is not silent
+         sampleCount allowed = 0;
+         if (*silentFrame >= minSilenceFrames) {
             if (inputLength) {
-                ++outLength;   // Add non-silent sample to outLength
+               switch (mActionIndex) {
+                  case kTruncate:
+                     outLength +=
+                        wt.TimeToLongSamples(mTruncLongestAllowedSilence);
+                     break;
+                  case kCompress:
+                     allowed =
+                        wt.TimeToLongSamples(mInitialAllowedSilence);
+                     outLength += sampleCount(
+                        allowed.as_double() +
+                           (*silentFrame - allowed).as_double()
+                              * mSilenceCompressPercent / 100.0
+                     );
+                     break;
+                  // default: // Not currently used.
+               }
             }
+
+            // Record the silent region
+            trackSilences.push_back(Region(
+               wt.LongSamplesToTime(*index + i - *silentFrame),
+               wt.LongSamplesToTime(*index + i)
+            ));
+         }
+         else if (inputLength) {   // included as part of non-silence
+            outLength += *silentFrame;
+         }
+         *silentFrame = 0;
+         if (inputLength) {
+             ++outLength;   // Add non-silent sample to outLength
          }
       }
       // Next block
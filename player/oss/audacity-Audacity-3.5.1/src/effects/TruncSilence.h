@@ -20,6 +20,7 @@
 #include "StatefulEffect.h"
 #include "ShuttleAutomation.h"
 #include "Track.h"
+#include <functional>
 #include <wx/weakref.h>
 
 class ShuttleGui;
@@ -56,16 +57,23 @@ public:
    double CalcPreviewInputLength(
       const EffectSettings &settings, double previewLength) const override;
 
+   //! Receives the fraction of the span analyzed; returns false to cancel
+   using ProgressReport = std::function<bool(double fraction)>;
+
    // Analyze a single track to find silences
    // If inputLength is not NULL we are calculating the minimum
    // amount of input for previewing.
    /*!
+    Scans from `*index` to `end`, which may be a part of the selection, to be
+    continued by another call with the same `*silentFrame`.
+    Does not use the user interface or preferences when inputLength is null,
+    so it may then be called in a worker thread
     @pre `wt.IsLeader()`
     */
-   bool Analyze(RegionList &silenceList, RegionList &trackSilences,
+   bool Analyze(const RegionList &silenceList, RegionList &trackSilences,
       const WaveTrack &wt, sampleCount* silentFrame, sampleCount* index,
-      int whichTrack, double* inputLength = nullptr,
-      double* minInputLength = nullptr) const;
+      sampleCount end, const ProgressReport &progress,
+      double* inputLength = nullptr, double* minInputLength = nullptr) const;
 
    bool Process(EffectInstance &instance, EffectSettings &settings) override;
    std::unique_ptr<EffectEditor> PopulateOrExchange(
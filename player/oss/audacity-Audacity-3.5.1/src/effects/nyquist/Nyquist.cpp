@@ -31,9 +31,13 @@ effects from this one class.
 #include <algorithm>
 #include <cmath>
 #include <cstring>
+#include <future>
+#include <memory>
 
 #include <locale.h>
 
+#include "concurrency/WorkerPool.h"
+
 #include <wx/checkbox.h>
 #include <wx/choice.h>
 #include <wx/datetime.h>
@@ -662,6 +666,131 @@ bool NyquistEffect::Init()
 
 static void RegisterFunctions();
 
+namespace {
+//! Reads one channel in large chunks for Nyquist, reading ahead on the
+//! shared WorkerPool while the previous chunk is consumed
+/*!
+ Nyquist asks for a small buffer at a time, usually in increasing order;
+ other orders are served correctly, but without the read-ahead.
+ */
+class ChannelPrefetcher {
+public:
+   static constexpr size_t ChunkSize = 1 << 20;
+
+   ChannelPrefetcher(const WaveChannel &channel,
+      sampleCount start, sampleCount len)
+      : mChannel{ channel }, mEnd{ start + len }
+   {}
+   ~ChannelPrefetcher() { Stop(); }
+
+   //! Copy samples from absolute position pos
+   /*!
+    May throw, also exceptions from reading in the worker thread
+    @pre `pos + len <= start + len` of the constructor
+    */
+   void Get(float *buffer, sampleCount pos, size_t len)
+   {
+      while (len > 0) {
+         if (pos < mCurrent.start || pos >= mCurrent.start + mCurrent.len) {
+            if (mNext.valid() && pos >= mNextStart &&
+                pos < mNextStart + ChunkLength(mNextStart)) {
+               mNext.get();
+               mCurrent = std::move(mNextChunk);
+            }
+            else {
+               Stop();
+               mCurrent = Read(pos);
+            }
+            // Read ahead
+            const auto next = mCurrent.start + mCurrent.len;
+            if (next < mEnd) {
+               mNextStart = next;
+               mNext = audacity::concurrency::WorkerPool::Get().Submit(
+                  [this, next]{ mNextChunk = Read(next); });
+            }
+         }
+         const auto offset = (pos - mCurrent.start).as_size_t();
+         const auto count = std::min(len, mCurrent.len - offset);
+         std::copy_n(mCurrent.data.get() + offset, count, buffer);
+         buffer += count;
+         pos += count;
+         len -= count;
+      }
+   }
+
+   //! Wait for any read in progress, discarding its result
+   void Stop()
+   {
+      if (mNext.valid()) {
+         try { mNext.get(); }
+         catch (...) {}
+      }
+   }
+
+private:
+   struct Chunk {
+      sampleCount start{};
+      size_t len{};
+      Floats data;
+   };
+
+   size_t ChunkLength(sampleCount start) const
+   {
+      return limitSampleBufferSize(ChunkSize, mEnd - start);
+   }
+
+   Chunk Read(sampleCount start) const
+   {
+      Chunk result{ start, ChunkLength(start) };
+      result.data.reinit(result.len);
+      mChannel.GetFloats(result.data.get(), start, result.len);
+      return result;
+   }
+
+   const WaveChannel &mChannel;
+   const sampleCount mEnd;
+   Chunk mCurrent;
+   //! Filled by the pending read
+   Chunk mNextChunk;
+   std::future<void> mNext;
+   sampleCount mNextStart{};
+};
+
+//! Collects samples from Nyquist for one channel, to append in large chunks
+class ChannelAppender {
+public:
+   static constexpr size_t ChunkSize = 1 << 16;
+
+   void Put(WaveChannel &channel, const float *buffer, size_t len)
+   {
+      mpChannel = &channel;
+      if (!mBuffer)
+         mBuffer.reinit(ChunkSize);
+      while (len > 0) {
+         const auto count = std::min(len, ChunkSize - mLen);
+         std::copy_n(buffer, count, mBuffer.get() + mLen);
+         buffer += count;
+         len -= count;
+         if ((mLen += count) == ChunkSize)
+            Flush();
+      }
+   }
+
+   //! May throw
+   void Flush()
+   {
+      if (mpChannel && mLen > 0)
+         mpChannel->Append((samplePtr)mBuffer.get(), floatSample, mLen);
+      mLen = 0;
+   }
+
+private:
+   WaveChannel *mpChannel{};
+   Floats mBuffer;
+   size_t mLen{};
+};
+}
+
 //! Reads and writes Audacity's track objects, interchanging with Nyquist
 //! sound objects (implemented in the library layer written in C)
 struct NyquistEffect::NyxContext {
@@ -682,19 +811,25 @@ struct NyquistEffect::NyxContext {
    static int StaticPutCallback(float *buffer, int channel,
       int64_t start, int64_t len, int64_t totlen, void *userdata);
 
+   //! Stop reading ahead, and append the rest of the output
+   /*! Call after nyx_get_audio, before modifying the input tracks
+    @return success */
+   bool FinishAudio();
+
    WaveTrack *mCurChannelGroup{};
    WaveChannel       *mCurTrack[2]{};
    sampleCount       mCurStart{};
 
    unsigned          mCurNumChannels{}; //!< Not used in the callbacks
 
-   using Buffer = std::unique_ptr<float[]>;
-   Buffer            mCurBuffer[2]; //!< used only in GetCallback
-   sampleCount       mCurBufferStart[2]{};
-   size_t            mCurBufferLen[2]{};
+   //! used only in GetCallback
+   std::unique_ptr<ChannelPrefetcher> mPrefetchers[2];
    sampleCount       mCurLen{};
 
    std::shared_ptr<TrackList> mOutputTracks;
+   //! used only in PutCallback
+   ChannelAppender   mAppenders[2];
+   WaveChannel       *mOutputChannels[2]{};
 
    double            mProgressIn{};
    double            mProgressOut{};
@@ -1714,6 +1849,8 @@ bool NyquistEffect::ProcessOne(
 
    // Now fully evaluate the sound
    int success = nyx_get_audio(NyxContext::StaticPutCallback, &nyxContext);
+   if (!nyxContext.FinishAudio())
+      success = 0;
 
    // See if GetCallback found read errors
    if (auto pException = nyxContext.mpException)
@@ -2565,44 +2702,19 @@ int NyquistEffect::NyxContext::StaticGetCallback(float *buffer, int channel,
 int NyquistEffect::NyxContext::GetCallback(float *buffer, int ch,
    int64_t start, int64_t len, int64_t)
 {
-   if (mCurBuffer[ch]) {
-      if ((mCurStart + start) < mCurBufferStart[ch] ||
-          (mCurStart + start) + len >
-          mCurBufferStart[ch] + mCurBufferLen[ch]) {
-         mCurBuffer[ch].reset();
-      }
+   try {
+      auto &pPrefetcher = mPrefetchers[ch];
+      if (!pPrefetcher)
+         pPrefetcher = std::make_unique<ChannelPrefetcher>(
+            *mCurTrack[ch], mCurStart, mCurLen);
+      pPrefetcher->Get(buffer, mCurStart + start, len);
    }
-
-   if (!mCurBuffer[ch]) {
-      mCurBufferStart[ch] = (mCurStart + start);
-      mCurBufferLen[ch] = mCurTrack[ch]->GetBestBlockSize(mCurBufferStart[ch]);
-
-      if (mCurBufferLen[ch] < (size_t) len)
-         mCurBufferLen[ch] = mCurTrack[ch]->GetIdealBlockSize();
-
-      mCurBufferLen[ch] = limitSampleBufferSize(mCurBufferLen[ch],
-         mCurStart + mCurLen - mCurBufferStart[ch]);
-
-      // C++20
-      // mCurBuffer[ch] = std::make_unique_for_overwrite(mCurBufferLen[ch]);
-      mCurBuffer[ch] = Buffer{ safenew float[ mCurBufferLen[ch] ] };
-      try {
-         mCurTrack[ch]->GetFloats( mCurBuffer[ch].get(),
-            mCurBufferStart[ch], mCurBufferLen[ch]);
-      }
-      catch ( ... ) {
-         // Save the exception object for re-throw when out of the library
-         mpException = std::current_exception();
-         return -1;
-      }
+   catch ( ... ) {
+      // Save the exception object for re-throw when out of the library
+      mpException = std::current_exception();
+      return -1;
    }
 
-   // We have guaranteed above that this is nonnegative and bounded by
-   // mCurBufferLen[ch]:
-   auto offset = (mCurStart + start - mCurBufferStart[ch]).as_size_t();
-   const void *src = &mCurBuffer[ch][offset];
-   std::memcpy(buffer, src, len * sizeof(float));
-
    if (ch == 0) {
       double progress = mScale * ((start + len) / mCurLen.as_double());
       if (progress > mProgressIn)
@@ -2634,16 +2746,31 @@ int NyquistEffect::NyxContext::PutCallback(float *buffer, int channel,
             return -1;
       }
 
-      auto iChannel =
-         (*mOutputTracks->Any<WaveTrack>().begin())->Channels().begin();
-      std::advance(iChannel, channel);
-      const auto pChannel = *iChannel;
-      pChannel->Append((samplePtr)buffer, floatSample, len);
+      auto &pChannel = mOutputChannels[channel];
+      if (!pChannel) {
+         auto iChannel =
+            (*mOutputTracks->Any<WaveTrack>().begin())->Channels().begin();
+         std::advance(iChannel, channel);
+         pChannel = (*iChannel).get();
+      }
+      mAppenders[channel].Put(*pChannel, buffer, len);
 
       return 0; // success
    }, MakeSimpleGuard(-1)); // translate all exceptions into failure
 }
 
+bool NyquistEffect::NyxContext::FinishAudio()
+{
+   for (auto &pPrefetcher : mPrefetchers)
+      if (pPrefetcher)
+         pPrefetcher->Stop();
+   return GuardedCall<bool>( [&] {
+      for (auto &appender : mAppenders)
+         appender.Flush();
+      return true;
+   }, MakeSimpleGuard(false));
+}
+
 void NyquistEffect::StaticOutputCallback(int c, void *This)
 {
    ((NyquistEffect *)This)->OutputCallback(c);
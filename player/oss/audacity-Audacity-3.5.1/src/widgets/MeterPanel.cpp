@@ -959,23 +959,47 @@ static float ToDB(float v, float range)
 void MeterPanel::UpdateDisplay(
    unsigned numChannels, int numFrames, const float *sampleData)
 {
-   auto sptr = sampleData;
    auto num = std::min(numChannels, mNumBars);
    MeterUpdateMsg msg;
 
    memset(&msg, 0, sizeof(msg));
    msg.numFrames = numFrames;
 
-   for(int i=0; i<numFrames; i++) {
-      for(unsigned int j=0; j<num; j++) {
-         msg.peak[j] = floatMax(msg.peak[j], fabs(sptr[j]));
-         msg.rms[j] += sptr[j]*sptr[j];
+   for(unsigned int j=0; j<num; j++) {
+      const auto sptr = sampleData + j;
+
+      // Accumulate in independent lanes without branches, so that the
+      // compiler can keep them in SIMD registers
+      constexpr int lanes = 4;
+      float peak[lanes]{}, power[lanes]{};
+      int i = 0;
+      for(; i + lanes <= numFrames; i += lanes) {
+         for(int k=0; k<lanes; k++) {
+            const auto sample = sptr[(i + k) * numChannels];
+            peak[k] = std::max(peak[k], std::fabs(sample));
+            power[k] += sample * sample;
+         }
+      }
+      for(; i<numFrames; i++) {
+         const auto sample = sptr[i * numChannels];
+         peak[0] = std::max(peak[0], std::fabs(sample));
+         power[0] += sample * sample;
+      }
+      for(int k=0; k<lanes; k++) {
+         msg.peak[j] = floatMax(msg.peak[j], peak[k]);
+         msg.rms[j] += power[k];
+      }
 
+      // Peaked samples are rare; look for runs of them only when the peak
+      // shows that there are some.
+      if (msg.peak[j] < MAX_AUDIO)
+         continue;
+      for(i=0; i<numFrames; i++) {
          // In addition to looking for mNumPeakSamplesToClip peaked
          // samples in a row, also send the number of peaked samples
          // at the head and tail, in case there's a run of peaked samples
          // that crosses block boundaries
-         if (fabs(sptr[j])>=MAX_AUDIO) {
+         if (fabs(sptr[i * numChannels])>=MAX_AUDIO) {
             if (msg.headPeakCount[j]==i)
                msg.headPeakCount[j]++;
             msg.tailPeakCount[j]++;
@@ -985,7 +1009,6 @@ void MeterPanel::UpdateDisplay(
          else
             msg.tailPeakCount[j] = 0;
       }
-      sptr += numChannels;
    }
    for(unsigned int j=0; j<mNumBars; j++)
       msg.rms[j] = sqrt(msg.rms[j]/numFrames);